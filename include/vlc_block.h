@@ -142,6 +142,35 @@ VLC_API void block_Init( block_t *, void *, size_t );
  */
 VLC_API block_t *block_Alloc(size_t size) VLC_USED VLC_MALLOC;
 
+/**
+ * Block pool statistics.
+ */
+typedef struct block_pool_stats_t
+{
+    uint64_t hits; /**< Allocations served from the pool */
+    uint64_t misses; /**< Allocations that needed a new heap buffer */
+    size_t retained; /**< Bytes of free blocks kept in the pool */
+} block_pool_stats_t;
+
+/**
+ * Enables or disables the block pool.
+ *
+ * When enabled, block_Alloc() serves common block sizes from per-thread
+ * caches of free blocks, backed by a process-wide depot. Alignment and
+ * padding are the same as with the heap allocator.
+ * Disabling the pool frees the depot; per-thread caches are freed when their
+ * thread exits.
+ */
+VLC_API void block_PoolSetEnabled(bool enabled);
+
+/**
+ * Reads the block pool statistics.
+ *
+ * Counters of other threads are accounted in batches, so the values are
+ * approximate while the pool is in use.
+ */
+VLC_API void block_PoolGetStats(block_pool_stats_t *stats);
+
 VLC_API block_t *block_TryRealloc(block_t *, ssize_t pre, size_t body) VLC_USED;
 
 /**
@@ -213,6 +242,36 @@ static inline block_t *block_Duplicate( block_t *p_block )
     return p_dup;
 }
 
+/**
+ * Makes the payload of a block shareable.
+ *
+ * Converts a block into a block whose payload can be referenced by several
+ * blocks with block_Share(), without copying it. The payload is freed when
+ * the last of these blocks is released.
+ *
+ * Shared payloads are read-only: block_Realloc() and block_TryRealloc() copy
+ * the payload of a block that still shares it with other blocks. Code writing
+ * into a block it did not allocate, without resizing it, shall therefore
+ * call block_Realloc(block, 0, block->i_buffer) first; this is a no-op for
+ * blocks that do not share their payload. The decoder core does so before
+ * packetizers and decoders get the block.
+ *
+ * @param block block to convert (it is consumed, even on error)
+ * @return the shareable block (possibly the same one), or NULL on error.
+ */
+VLC_API block_t *block_Shareable(block_t *block) VLC_USED;
+
+/**
+ * Shares the payload of a block.
+ *
+ * Creates a new block, with the same properties and payload as a block made
+ * shareable with block_Shareable(). The payload is not copied.
+ * Other blocks are duplicated, as with block_Duplicate().
+ *
+ * @return the new block on success, NULL on error.
+ */
+VLC_API block_t *block_Share(const block_t *block) VLC_USED;
+
 /**
  * Wraps heap in a block.
  *
@@ -621,6 +680,89 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 
 /** @} */
 
+/**
+ * \defgroup block_ring Single producer single consumer block queue
+ * @{
+ *
+ * A bounded block queue without locking on the data path, for queues with
+ * exactly one thread queueing and exactly one thread dequeueing blocks.
+ * A mutex is only taken to wake up a thread waiting on an empty (or full)
+ * queue.
+ *
+ * Unlike block FIFOs, queued blocks cannot be dequeued or flushed from the
+ * producing thread.
+ */
+
+typedef struct block_ring_t block_ring_t;
+
+/**
+ * Creates a single producer single consumer block queue.
+ *
+ * @param capacity maximum number of queued blocks (rounded up to a power of
+ * two)
+ * @return the queue or NULL on memory error
+ */
+VLC_API block_ring_t *block_RingNew(size_t capacity) VLC_USED VLC_MALLOC;
+
+/**
+ * Destroys a queue created by block_RingNew().
+ *
+ * @note Any queued blocks are also destroyed.
+ * @warning No other threads may be using the queue.
+ */
+VLC_API void block_RingRelease(block_ring_t *);
+
+/**
+ * Queues one block at the end of the queue, if there is room.
+ * This function is not a cancellation point.
+ *
+ * @note Only the producer thread may call this function.
+ *
+ * @param block a single block (not a chain)
+ * @return false if the queue is full (the block is not queued)
+ */
+VLC_API bool block_RingQueue(block_ring_t *, block_t *block) VLC_USED;
+
+/**
+ * Queues one block at the end of the queue. If necessary, waits until there
+ * is room in the queue. This function is (always) a cancellation point:
+ * the block is released if the thread is cancelled.
+ *
+ * @note Only the producer thread may call this function.
+ */
+VLC_API void block_RingPut(block_ring_t *, block_t *block);
+
+/**
+ * Dequeues the first block from the queue, if any.
+ * This function is not a cancellation point.
+ *
+ * @note Only the consumer thread may call this function.
+ *
+ * @return the first block or NULL if the queue is empty
+ */
+VLC_API block_t *block_RingDequeue(block_ring_t *) VLC_USED;
+
+/**
+ * Dequeues the first block from the queue. If necessary, waits until there
+ * is one block in the queue. This function is (always) a cancellation point.
+ *
+ * @note Only the consumer thread may call this function.
+ *
+ * @return a valid block
+ */
+VLC_API block_t *block_RingGet(block_ring_t *) VLC_USED;
+
+/**
+ * Counts blocks in the queue.
+ *
+ * @note The value may be outdated as soon as it is returned, unless it is
+ * called from the producer (resp. consumer) thread and only an upper (resp.
+ * lower) bound is needed.
+ */
+VLC_API size_t block_RingGetCount(block_ring_t *) VLC_USED;
+
+/** @} */
+
 /** @} */
 
 #endif /* VLC_BLOCK_H */
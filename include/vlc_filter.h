@@ -278,6 +278,46 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Rows of a picture plane processed by a slice kernel.
+ */
+typedef struct
+{
+    unsigned plane; /**< Plane index */
+    int y_start; /**< First row to process */
+    int y_end; /**< Row after the last row to process */
+    int y_context_start; /**< First row of the slice with its overlap */
+    int y_context_end; /**< Row after the slice with its overlap */
+} filter_slice_t;
+
+/**
+ * Processes the rows of a slice.
+ *
+ * The kernel may read any row of its input pictures, and compute
+ * intermediate results over the context rows, but it must only write the
+ * output rows of its slice.
+ */
+typedef void (*filter_slice_cb)( filter_t *, const filter_slice_t *,
+                                 void *opaque );
+
+/**
+ * Runs a row-range kernel over a picture, in parallel.
+ *
+ * The visible lines of the first planes of the picture are split into
+ * horizontal slices, which are processed by the calling thread and by the
+ * video filter threads ("filter-threads") concurrently. The function returns
+ * once all the slices have been processed.
+ *
+ * \param pic picture whose planes geometry defines the slices
+ * \param planes number of planes to process, from the first one
+ * \param overlap number of context rows on either side of each slice
+ * \param kernel slice processing callback
+ * \param opaque data pointer for the callback
+ */
+VLC_API void filter_RunSlices( filter_t *, const picture_t *pic,
+                               unsigned planes, unsigned overlap,
+                               filter_slice_cb kernel, void *opaque );
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
@@ -48,6 +48,9 @@ enum vlc_module_properties
     VLC_MODULE_DESCRIPTION,
     VLC_MODULE_HELP,
     VLC_MODULE_TEXTDOMAIN,
+    VLC_MODULE_PROBE_SIGNATURES,
+    VLC_MODULE_PROBE_EXTENSIONS,
+    VLC_MODULE_PROBE_MIME_TYPES,
     /* Insert new VLC_MODULE_* here */
 
     /* DO NOT EVER REMOVE, INSERT OR REPLACE ANY ITEM! It would break the ABI!
@@ -308,6 +311,24 @@ VLC_METADATA_EXPORTS
                        (void *)(deactivate))) \
         goto error;
 
+/* Probe hints tell the core which streams a module can possibly accept,
+ * without loading the module. A module declaring hints must reject (unless
+ * forced) any stream that matches none of them.
+ * Signatures are space-separated "offset:hexbytes" patterns, with offset
+ * "*" matching anywhere within the first few hundred bytes. Extensions and
+ * MIME types are comma-separated lists. */
+#define set_probe_signatures( sigs ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_SIGNATURES, (const char *)(sigs))) \
+        goto error;
+
+#define set_probe_extensions( exts ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_EXTENSIONS, (const char *)(exts))) \
+        goto error;
+
+#define set_probe_mime_types( types ) \
+    if (vlc_module_set (VLC_MODULE_PROBE_MIME_TYPES, (const char *)(types))) \
+        goto error;
+
 #define cannot_unload_broken_library( ) \
     if (vlc_module_set (VLC_MODULE_NO_UNLOAD)) \
         goto error;
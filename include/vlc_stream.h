@@ -144,6 +144,8 @@ enum stream_query_e
     /* */
     STREAM_GET_SIZE=6,          /**< arg1= uint64_t *     res=can fail */
     STREAM_IS_DIRECTORY,        /**< res=can fail */
+    STREAM_IS_MAPPED,           /**< res=can fail: whether blocks map the
+                                     storage directly and need no cache */
 
     /* */
     STREAM_GET_PTS_DELAY = 0x101,/**< arg1= int64_t* res=cannot fail */
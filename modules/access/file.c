@@ -51,12 +51,16 @@
 #else
 #   include <unistd.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 #include <dirent.h>
 
 #include <vlc_common.h>
 #include "fs.h"
 #include <vlc_input.h>
 #include <vlc_access.h>
+#include <vlc_block.h>
 #ifdef _WIN32
 # include <vlc_charset.h>
 #endif
@@ -69,6 +73,10 @@ struct access_sys_t
     int fd;
 
     bool b_pace_control;
+#ifdef HAVE_MMAP
+    uint64_t offset; /**< Read offset (memory-mapped mode only) */
+    size_t page_mask;
+#endif
 };
 
 #if !defined (_WIN32) && !defined (__OS2__)
@@ -128,6 +136,9 @@ static bool IsRemote (const char *path)
 #endif
 
 static ssize_t Read (stream_t *, void *, size_t);
+#ifdef HAVE_MMAP
+static block_t *MmapBlock (stream_t *, bool *);
+#endif
 static int FileSeek (stream_t *, uint64_t);
 static int NoSeek (stream_t *, uint64_t);
 static int FileControl (stream_t *, int, va_list);
@@ -231,6 +242,19 @@ int FileOpen( vlc_object_t *p_this )
             fcntl (fd, F_RDAHEAD, 0);
         else
             fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef HAVE_MMAP
+        /* Files on network file systems can be truncated behind our back
+         * more easily, and the mapped pages would then fault. */
+        if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap")
+         && !IsRemote(fd, p_access->psz_filepath))
+        {
+            p_access->pf_read = NULL;
+            p_access->pf_block = MmapBlock;
+            p_sys->offset = 0;
+            p_sys->page_mask = sysconf (_SC_PAGESIZE) - 1;
+            msg_Dbg (p_access, "memory-mapped mode");
+        }
 #endif
     }
     else
@@ -253,7 +277,7 @@ void FileClose (vlc_object_t * p_this)
 {
     stream_t     *p_access = (stream_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_readdir != NULL)
     {
         DirClose (p_this);
         return;
@@ -287,6 +311,92 @@ static ssize_t Read (stream_t *p_access, void *p_buffer, size_t i_len)
     return val;
 }
 
+#ifdef HAVE_MMAP
+/* Size of the mapped blocks */
+#define MMAP_BLOCK_SIZE (1 << 20)
+
+/* Fallback for regions which cannot be mapped */
+static block_t *PreadBlock (stream_t *p_access, size_t length,
+                            bool *restrict eof)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    block_t *block = block_Alloc (length);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    ssize_t val = pread (p_sys->fd, block->p_buffer, length, p_sys->offset);
+    if (val <= 0)
+    {
+        if (val < 0)
+            msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+        block_Release (block);
+        *eof = true;
+        return NULL;
+    }
+
+    block->i_buffer = val;
+    p_sys->offset += val;
+    return block;
+}
+
+/**
+ * Hands out the file contents as blocks over memory mappings, saving one copy
+ * from the page cache.
+ */
+static block_t *MmapBlock (stream_t *p_access, bool *restrict eof)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    struct stat st;
+
+    /* Never map beyond the current end of the file: the file may be
+     * growing, or may have been truncated. */
+    if (fstat (p_sys->fd, &st))
+    {
+        msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+        *eof = true;
+        return NULL;
+    }
+    if ((uint64_t)st.st_size <= p_sys->offset)
+    {
+        *eof = true;
+        return NULL;
+    }
+
+    uint64_t left = st.st_size - p_sys->offset;
+    size_t length = (left < MMAP_BLOCK_SIZE) ? left : MMAP_BLOCK_SIZE;
+    size_t inner = p_sys->offset & p_sys->page_mask;
+
+    /* Blocks are writable: changes are private (copy-on-write) */
+    void *addr = mmap (NULL, inner + length, PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE, p_sys->fd, p_sys->offset - inner);
+    if (addr == MAP_FAILED)
+    {
+        msg_Dbg (p_access, "cannot map %zu bytes at %"PRIu64": %s", length,
+                 p_sys->offset, vlc_strerror_c(errno));
+        return PreadBlock (p_access, length, eof);
+    }
+
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise (addr, inner + length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (addr, inner + length, POSIX_MADV_WILLNEED);
+#endif
+    /* Read the next block ahead while this one is being demuxed */
+    posix_fadvise (p_sys->fd, p_sys->offset + length, MMAP_BLOCK_SIZE,
+                   POSIX_FADV_WILLNEED);
+
+    /* The block covers the whole mapping, so that it is unmapped from its
+     * start, including on error. */
+    block_t *block = block_mmap_Alloc (addr, inner + length);
+    if (unlikely(block == NULL))
+        return NULL;
+    block->p_buffer += inner;
+    block->i_buffer -= inner;
+
+    p_sys->offset += length;
+    return block;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
@@ -294,6 +404,13 @@ static int FileSeek (stream_t *p_access, uint64_t i_pos)
 {
     access_sys_t *sys = p_access->p_sys;
 
+#ifdef HAVE_MMAP
+    if (p_access->pf_block != NULL)
+    {
+        sys->offset = i_pos;
+        return VLC_SUCCESS;
+    }
+#endif
     if (lseek(sys->fd, i_pos, SEEK_SET) == (off_t)-1)
         return VLC_EGENERIC;
     return VLC_SUCCESS;
@@ -352,6 +469,13 @@ static int FileControl( stream_t *p_access, int i_query, va_list args )
             /* Nothing to do */
             break;
 
+#ifdef HAVE_MMAP
+        case STREAM_IS_MAPPED:
+            if (p_access->pf_block != MmapBlock)
+                return VLC_EGENERIC;
+            break;
+#endif
+
         default:
             return VLC_EGENERIC;
 
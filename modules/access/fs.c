@@ -39,6 +39,11 @@ vlc_module_begin ()
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
+    add_bool( "file-mmap", false, N_("Memory-mapped file input"),
+              N_("Read local files through memory mappings instead of "
+                 "copying their contents. This saves memory bandwidth with "
+                 "large media, but a file being truncated while it is read "
+                 "may crash the program."), true )
 
     add_submodule()
     set_section( N_("Directory" ), NULL )
@@ -23,6 +23,9 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vlc_common.h>
 #include <vlc_network.h>
 #include <vlc_tls.h>
@@ -92,53 +95,142 @@ static char *vlc_http_proxy_find(const char *hostname, unsigned port,
 }
 
 
+/** Maximum number of connections kept by a manager */
+#define VLC_HTTP_MGR_MAX_CONNS 8
+/** Delay after which an unused connection is closed */
+#define VLC_HTTP_MGR_IDLE_TIMEOUT (60 * CLOCK_FREQ)
+
+/**
+ * Pooled connection.
+ *
+ * Connections are keyed by scheme, host and port. The proxy, if any, is
+ * determined from those, so that it need not be looked up before reusing a
+ * connection.
+ */
+struct vlc_http_mgr_conn
+{
+    struct vlc_http_mgr_conn *next;
+    struct vlc_http_conn *conn;
+    mtime_t last_used;
+    bool secure;
+    unsigned port;
+    char host[];
+};
+
 struct vlc_http_mgr
 {
     vlc_object_t *obj;
     vlc_tls_creds_t *creds;
     struct vlc_http_cookie_jar_t *jar;
-    struct vlc_http_conn *conn;
+    struct vlc_http_mgr_conn *conns; /**< Most recently added first */
+    unsigned count;
 };
 
-static struct vlc_http_conn *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
-                                               const char *host, unsigned port)
+static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
+                                 struct vlc_http_mgr_conn **restrict pp)
+{
+    struct vlc_http_mgr_conn *c = *pp;
+
+    *pp = c->next;
+    assert(mgr->count > 0);
+    mgr->count--;
+
+    /* Streams still open keep the connection alive until they are closed */
+    vlc_http_conn_release(c->conn);
+    free(c);
+}
+
+static void vlc_http_mgr_expire(struct vlc_http_mgr *mgr, mtime_t now)
 {
-    (void) host; (void) port;
-    return mgr->conn;
+    struct vlc_http_mgr_conn **pp = &mgr->conns;
+
+    while (*pp != NULL)
+        if ((*pp)->last_used + VLC_HTTP_MGR_IDLE_TIMEOUT <= now)
+        {
+            vlc_http_dbg(mgr->obj, "closing idle connection to %s:%u",
+                         (*pp)->host, (*pp)->port);
+            vlc_http_mgr_release(mgr, pp);
+        }
+        else
+            pp = &(*pp)->next;
 }
 
-static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
-                                 struct vlc_http_conn *conn)
+static int vlc_http_mgr_add(struct vlc_http_mgr *mgr, bool secure,
+                            const char *host, unsigned port,
+                            struct vlc_http_conn *conn)
 {
-    assert(mgr->conn == conn);
-    mgr->conn = NULL;
+    size_t len = strlen(host) + 1;
+    struct vlc_http_mgr_conn *c = malloc(sizeof (*c) + len);
+    if (unlikely(c == NULL))
+        return -1;
+
+    if (mgr->count >= VLC_HTTP_MGR_MAX_CONNS)
+    {   /* Evict the least recently used connection */
+        struct vlc_http_mgr_conn **pp = &mgr->conns, **lru = pp;
+
+        for (; *pp != NULL; pp = &(*pp)->next)
+            if ((*pp)->last_used <= (*lru)->last_used)
+                lru = pp;
+        vlc_http_mgr_release(mgr, lru);
+    }
 
-    vlc_http_conn_release(conn);
+    c->conn = conn;
+    c->last_used = mdate();
+    c->secure = secure;
+    c->port = port;
+    memcpy(c->host, host, len);
+    c->next = mgr->conns;
+    mgr->conns = c;
+    mgr->count++;
+    return 0;
 }
 
 static
-struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
+struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr, bool secure,
                                         const char *host, unsigned port,
                                         const struct vlc_http_msg *req)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
-        return NULL;
+    struct vlc_http_mgr_conn **pp = &mgr->conns;
+    mtime_t now = mdate();
+
+    vlc_http_mgr_expire(mgr, now);
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    while (*pp != NULL)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
-        if (m != NULL)
-            return m;
-
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        struct vlc_http_mgr_conn *c = *pp;
+
+        if (c->secure != secure || c->port != port || strcmp(c->host, host))
+        {
+            pp = &c->next;
+            continue;
+        }
+
+        errno = 0;
+
+        struct vlc_http_stream *stream = vlc_http_stream_open(c->conn, req);
+        if (stream != NULL)
+        {
+            c->last_used = now;
+
+            struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+            if (m != NULL)
+                return m;
+
+            /* NOTE: If the request were not idempotent, we would not know if
+             * it was processed by the other end. Thus POST is not
+             * used/supported so far, and CONNECT is treated as if it were
+             * idempotent (which works fine here). */
+        }
+        else if (errno == EBUSY)
+        {   /* HTTP/1 connection serving another resource: keep it */
+            c->last_used = now;
+            pp = &c->next;
+            continue;
+        }
+
+        /* Get rid of closing or reset connection */
+        vlc_http_mgr_release(mgr, pp);
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
     return NULL;
 }
 
@@ -149,9 +241,6 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
     vlc_tls_t *tls;
     bool http2 = true;
 
-    if (mgr->creds == NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTP to HTTPS not implemented */
-
     if (mgr->creds == NULL)
     {   /* First TLS connection: load x509 credentials */
         mgr->creds = vlc_tls_ClientCreate(mgr->obj);
@@ -160,7 +249,8 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
     }
 
     /* TODO? non-idempotent request support */
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, true, host, port,
+                                                   req);
     if (resp != NULL)
         return resp; /* existing connection reused */
 
@@ -197,19 +287,21 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
+    if (vlc_http_mgr_add(mgr, true, host, port, conn))
+    {
+        vlc_http_conn_release(conn);
+        return NULL;
+    }
 
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    return vlc_http_mgr_reuse(mgr, true, host, port, req);
 }
 
 static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTPS to HTTP not implemented */
-
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, false, host, port,
+                                                   req);
     if (resp != NULL)
         return resp;
 
@@ -234,20 +326,15 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
         vlc_UrlClean(&url);
     }
     else
-        stream = vlc_h1_request(mgr->obj, host, port ? port : 80, false, req,
-                                true, &conn);
+        stream = vlc_h1_request(mgr->obj, host, port, false, req, true,
+                                &conn);
 
     if (stream == NULL)
         return NULL;
 
     resp = vlc_http_msg_get_initial(stream);
-    if (resp == NULL)
-    {
-        vlc_http_conn_release(conn);
-        return NULL;
-    }
-
-    mgr->conn = conn;
+    if (resp == NULL || vlc_http_mgr_add(mgr, false, host, port, conn))
+        vlc_http_conn_release(conn); /* not kept for reuse */
     return resp;
 }
 
@@ -255,6 +342,9 @@ struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
                                           const char *host, unsigned port,
                                           const struct vlc_http_msg *m)
 {
+    if (port == 0)
+        port = https ? 443 : 80;
+
     return (https ? vlc_https_request : vlc_http_request)(mgr, host, port, m);
 }
 
@@ -273,14 +363,15 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     mgr->obj = obj;
     mgr->creds = NULL;
     mgr->jar = jar;
-    mgr->conn = NULL;
+    mgr->conns = NULL;
+    mgr->count = 0;
     return mgr;
 }
 
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
 {
-    if (mgr->conn != NULL)
-        vlc_http_mgr_release(mgr, mgr->conn);
+    while (mgr->conns != NULL)
+        vlc_http_mgr_release(mgr, &mgr->conns);
     if (mgr->creds != NULL)
         vlc_tls_Delete(mgr->creds);
     free(mgr);
@@ -39,6 +39,14 @@ struct vlc_http_cookie_jar_t;
  * establishing a new one. If succesful, the initial HTTP response header is
  * returned.
  *
+ * Connections are pooled per scheme, host and port. An HTTP/2 connection
+ * carries the requests of any number of resources concurrently, whereas an
+ * HTTP/1.x connection is only reused once the previous response is closed.
+ * Connections unused for a while are closed, and so is the least recently
+ * used one if too many connections are open.
+ *
+ * @note Calls on a given manager must be serialized.
+ *
  * @param mgr HTTP connection manager
  * @param https whether to use HTTPS (true) or unencrypted HTTP (false)
  * @param host name of authoritative HTTP server to send the request to
@@ -0,0 +1,259 @@
+/*****************************************************************************
+ * connmgr_test.c: HTTP connection manager tests
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include "conn.h"
+#include "connmgr.h"
+#include "message.h"
+
+#define MAX_CLIENTS 8
+
+/* HTTP/1.1 origin server with persistent connections. The response body is
+ * the server name. */
+struct server
+{
+    int lfd;
+    unsigned port;
+    char name;
+    atomic_uint connections;
+    vlc_thread_t thread;
+};
+
+struct client
+{
+    int fd;
+    char buf[1024];
+    size_t len;
+};
+
+static void client_process(const struct server *srv, struct client *c)
+{
+    ssize_t val = recv(c->fd, c->buf + c->len, sizeof (c->buf) - c->len - 1,
+                       0);
+    if (val <= 0)
+    {   /* connection closed by the manager */
+        vlc_close(c->fd);
+        c->fd = -1;
+        return;
+    }
+    c->len += val;
+    c->buf[c->len] = '\0';
+
+    char *end;
+
+    while ((end = strstr(c->buf, "\r\n\r\n")) != NULL)
+    {
+        char resp[64];
+        int len;
+
+        assert(!strncmp(c->buf, "GET / HTTP/1.1\r\n", 16));
+        len = snprintf(resp, sizeof (resp), "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: 1\r\n\r\n%c", srv->name);
+        assert(write(c->fd, resp, len) == len);
+
+        end += 4;
+        c->len -= end - c->buf;
+        memmove(c->buf, end, c->len + 1);
+    }
+}
+
+static void *server_thread(void *data)
+{
+    struct server *srv = data;
+    struct client clients[MAX_CLIENTS];
+    struct pollfd ufd[1 + MAX_CLIENTS];
+
+    for (unsigned i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+
+    for (;;)
+    {
+        ufd[0].fd = srv->lfd;
+        ufd[0].events = POLLIN;
+        for (unsigned i = 0; i < MAX_CLIENTS; i++)
+        {
+            ufd[1 + i].fd = clients[i].fd;
+            ufd[1 + i].events = POLLIN;
+        }
+
+        while (poll(ufd, 1 + MAX_CLIENTS, -1) < 0);
+
+        int canc = vlc_savecancel();
+
+        for (unsigned i = 0; i < MAX_CLIENTS; i++)
+            if (clients[i].fd != -1 && ufd[1 + i].revents)
+                client_process(srv, &clients[i]);
+
+        if (ufd[0].revents)
+        {
+            int fd = accept(srv->lfd, NULL, NULL);
+            unsigned i = 0;
+
+            assert(fd != -1);
+            while (clients[i].fd != -1)
+                assert(++i < MAX_CLIENTS);
+            clients[i].fd = fd;
+            clients[i].len = 0;
+            atomic_fetch_add(&srv->connections, 1);
+        }
+        vlc_restorecancel(canc);
+    }
+    vlc_assert_unreachable();
+}
+
+static int server_start(struct server *srv, char name)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    srv->lfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (srv->lfd == -1)
+        return -1;
+
+    if (bind(srv->lfd, (struct sockaddr *)&addr, addrlen)
+     || getsockname(srv->lfd, (struct sockaddr *)&addr, &addrlen)
+     || listen(srv->lfd, 16))
+    {
+        vlc_close(srv->lfd);
+        return -1;
+    }
+
+    srv->port = ntohs(addr.sin_port);
+    srv->name = name;
+    atomic_init(&srv->connections, 0);
+
+    if (vlc_clone(&srv->thread, server_thread, srv, VLC_THREAD_PRIORITY_LOW))
+        assert(!"Thread error");
+    return 0;
+}
+
+static void server_stop(struct server *srv)
+{
+    vlc_cancel(srv->thread);
+    vlc_join(srv->thread, NULL);
+    vlc_close(srv->lfd);
+}
+
+static struct vlc_http_msg *request(struct vlc_http_mgr *mgr,
+                                    const struct server *srv)
+{
+    char authority[32];
+
+    snprintf(authority, sizeof (authority), "127.0.0.1:%u", srv->port);
+
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "http", authority,
+                                                   "/");
+    assert(req != NULL);
+
+    struct vlc_http_msg *resp = vlc_http_mgr_request(mgr, false, "127.0.0.1",
+                                                     srv->port, req);
+    vlc_http_msg_destroy(req);
+    assert(resp != NULL);
+    assert(vlc_http_msg_get_status(resp) == 200);
+    return resp;
+}
+
+/* Reads the whole response and closes it */
+static void response_check(struct vlc_http_msg *resp,
+                           const struct server *srv)
+{
+    block_t *block = vlc_http_msg_read(resp);
+
+    assert(block != NULL && block != vlc_http_error);
+    assert(block->i_buffer == 1 && block->p_buffer[0] == srv->name);
+    block_Release(block);
+    assert(vlc_http_msg_read(resp) == NULL);
+    vlc_http_msg_destroy(resp);
+}
+
+int main(void)
+{
+    struct server a, b;
+    struct vlc_http_msg *r1, *r2;
+
+    unsetenv("http_proxy");
+
+    if (server_start(&a, 'A'))
+        return 77;
+    if (server_start(&b, 'B'))
+    {
+        server_stop(&a);
+        return 77;
+    }
+
+    struct vlc_http_mgr *mgr = vlc_http_mgr_create(NULL, NULL);
+    assert(mgr != NULL);
+
+    /* Sequential requests share a connection */
+    response_check(request(mgr, &a), &a);
+    response_check(request(mgr, &a), &a);
+    assert(atomic_load(&a.connections) == 1);
+
+    /* Concurrent requests need one HTTP/1 connection each */
+    r1 = request(mgr, &a);
+    r2 = request(mgr, &a);
+    assert(atomic_load(&a.connections) == 2);
+    response_check(r2, &a);
+    response_check(r1, &a);
+
+    /* Other origin, other connection */
+    r1 = request(mgr, &b);
+    response_check(r1, &b);
+    assert(atomic_load(&b.connections) == 1);
+
+    /* Both first origin connections are still available */
+    r1 = request(mgr, &a);
+    r2 = request(mgr, &a);
+    response_check(r1, &a);
+    response_check(r2, &a);
+    response_check(request(mgr, &b), &b);
+    assert(atomic_load(&a.connections) == 2);
+    assert(atomic_load(&b.connections) == 1);
+
+    vlc_http_mgr_destroy(mgr);
+    server_stop(&b);
+    server_stop(&a);
+    return 0;
+}
@@ -147,7 +147,12 @@ static struct vlc_http_stream *vlc_h1_stream_open(struct vlc_http_conn *c,
     size_t len;
     ssize_t val;
 
-    if (conn->active || conn->conn.tls == NULL)
+    if (conn->active)
+    {   /* no pipelining: the connection is busy until the stream closes */
+        errno = EBUSY;
+        return NULL;
+    }
+    if (conn->conn.tls == NULL)
         return NULL;
 
     char *payload = vlc_http_msg_format(req, &len, conn->proxy);
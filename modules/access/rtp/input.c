@@ -30,6 +30,7 @@
 #include <vlc_network.h>
 
 #include <limits.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
 #ifdef HAVE_POLL
@@ -46,6 +47,8 @@
 
 #define DEFAULT_MRU (1500u - (20 + 8))
 
+struct rtp_ring;
+
 /**
  * Processes a packet received from the RTP socket.
  */
@@ -100,12 +103,131 @@ static int rtp_timeout (mtime_t deadline)
     return t;
 }
 
+#ifdef HAVE_RECVMMSG
 /**
- * RTP/RTCP session thread for datagram sockets
+ * Ring of preallocated blocks for batched datagram reception
  */
-void *rtp_dgram_thread (void *opaque)
+struct rtp_ring
+{
+    unsigned        size;
+    size_t          mru;
+    struct mmsghdr *msgs;
+    struct iovec   *iovecs;
+    block_t       **blocks;
+};
+
+static bool rtp_ring_init (struct rtp_ring *ring, unsigned size)
+{
+    ring->mru = DEFAULT_MRU;
+    ring->msgs = calloc (size, sizeof (*ring->msgs));
+    ring->iovecs = calloc (size, sizeof (*ring->iovecs));
+    ring->blocks = calloc (size, sizeof (*ring->blocks));
+    if (unlikely(ring->msgs == NULL || ring->iovecs == NULL
+              || ring->blocks == NULL))
+    {
+        free (ring->blocks);
+        free (ring->iovecs);
+        free (ring->msgs);
+        ring->size = 0;
+        return false;
+    }
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        ring->msgs[i].msg_hdr.msg_iov = &ring->iovecs[i];
+        ring->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    ring->size = size;
+    return true;
+}
+
+static void rtp_ring_cleanup (void *data)
+{
+    struct rtp_ring *ring = data;
+
+    if (ring->size == 0)
+        return;
+
+    for (unsigned i = 0; i < ring->size; i++)
+        if (ring->blocks[i] != NULL)
+            block_Release (ring->blocks[i]);
+    free (ring->blocks);
+    free (ring->iovecs);
+    free (ring->msgs);
+    ring->size = 0;
+}
+
+/**
+ * Receives all pending packets (up to the ring size) with a single call.
+ * @return false if no buffers could be allocated at all
+ */
+static bool rtp_ring_recv (demux_t *demux, struct rtp_ring *ring, int fd)
+{
+    demux_sys_t *sys = demux->p_sys;
+#ifdef __linux__
+    const int trunc_flag = MSG_TRUNC;
+#else
+    const int trunc_flag = 0;
+#endif
+    unsigned vlen;
+
+    /* Replace the blocks handed over by the previous call */
+    for (vlen = 0; vlen < ring->size; vlen++)
+    {
+        if (ring->blocks[vlen] == NULL)
+        {
+            block_t *block = block_Alloc (ring->mru);
+            if (unlikely(block == NULL))
+            {
+                ring->mru = DEFAULT_MRU;
+                break;
+            }
+            ring->blocks[vlen] = block;
+        }
+        ring->iovecs[vlen].iov_base = ring->blocks[vlen]->p_buffer;
+        ring->iovecs[vlen].iov_len = ring->blocks[vlen]->i_buffer;
+        ring->msgs[vlen].msg_hdr.msg_flags = 0;
+    }
+    if (vlen == 0)
+        return false; /* we are totallly screwed */
+
+    int n = recvmmsg (fd, ring->msgs, vlen, MSG_DONTWAIT | trunc_flag, NULL);
+    if (n == -1)
+    {
+        if (errno != EAGAIN)
+            msg_Warn (demux, "RTP network error: %s", vlc_strerror_c(errno));
+        return true;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        block_t *block = ring->blocks[i];
+        size_t len = ring->msgs[i].msg_len;
+
+        ring->blocks[i] = NULL;
+        if (ring->msgs[i].msg_hdr.msg_flags & trunc_flag)
+        {
+            msg_Err(demux, "%zu bytes packet truncated (MRU was %zu)",
+                    len, block->i_buffer);
+            block->i_flags |= BLOCK_FLAG_CORRUPTED;
+            ring->mru = len;
+        }
+        else
+            block->i_buffer = len;
+
+        rtp_process (demux, block);
+    }
+
+    sys->recv_stats.calls++;
+    sys->recv_stats.packets += n;
+    if ((unsigned)n == ring->size)
+        sys->recv_stats.full++;
+    return true;
+}
+#endif
+
+static void rtp_dgram_loop (demux_t *demux, struct rtp_ring *ring)
 {
-    demux_t *demux = opaque;
     demux_sys_t *sys = demux->p_sys;
     mtime_t deadline = VLC_TS_INVALID;
     int rtp_fd = sys->fd;
@@ -145,6 +267,15 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
+#ifdef HAVE_RECVMMSG
+            if (ring != NULL)
+            {
+                if (!rtp_ring_recv (demux, ring, rtp_fd))
+                    break;
+                goto dequeue;
+            }
+#endif
+
             block_t *block = block_Alloc (iov.iov_len);
             if (unlikely(block == NULL))
             {
@@ -185,6 +316,31 @@ void *rtp_dgram_thread (void *opaque)
             deadline = VLC_TS_INVALID;
         vlc_restorecancel (canc);
     }
+#ifndef HAVE_RECVMMSG
+    (void) ring;
+#endif
+}
+
+/**
+ * RTP/RTCP session thread for datagram sockets
+ */
+void *rtp_dgram_thread (void *opaque)
+{
+    demux_t *demux = opaque;
+#ifdef HAVE_RECVMMSG
+    demux_sys_t *sys = demux->p_sys;
+    struct rtp_ring ring = { .size = 0 };
+
+    if (sys->batch > 1 && rtp_ring_init (&ring, sys->batch))
+    {
+        vlc_cleanup_push (rtp_ring_cleanup, &ring);
+        rtp_dgram_loop (demux, &ring);
+        vlc_cleanup_pop ();
+        rtp_ring_cleanup (&ring);
+        return NULL;
+    }
+#endif
+    rtp_dgram_loop (demux, NULL);
     return NULL;
 }
 
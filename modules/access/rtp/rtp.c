@@ -75,6 +75,11 @@
     "RTP packets will be discarded if they are too far behind (i.e. in the " \
     "past) by this many packets from the last received packet." )
 
+#define RTP_BATCH_TEXT N_("Packets per receive call")
+#define RTP_BATCH_LONGTEXT N_( \
+    "Maximum number of RTP packets received with a single system call " \
+    "(only supported on Linux)." )
+
 #define RTP_DYNAMIC_PT_TEXT N_("RTP payload format assumed for dynamic " \
                                "payloads")
 #define RTP_DYNAMIC_PT_LONGTEXT N_( \
@@ -122,6 +127,9 @@ vlc_module_begin ()
     add_integer ("rtp-max-misorder", 100, RTP_MAX_MISORDER_TEXT,
                  RTP_MAX_MISORDER_LONGTEXT, true)
         change_integer_range (0, 32767)
+    add_integer ("rtp-batch", 1, RTP_BATCH_TEXT,
+                 RTP_BATCH_LONGTEXT, true)
+        change_integer_range (1, 1024)
     add_string ("rtp-dynamic-pt", NULL, RTP_DYNAMIC_PT_TEXT,
                 RTP_DYNAMIC_PT_LONGTEXT, true)
         change_string_list (dynamic_pt_list, dynamic_pt_list_text)
@@ -267,6 +275,10 @@ static int Open (vlc_object_t *obj)
                         * CLOCK_FREQ;
     p_sys->max_dropout  = var_CreateGetInteger (obj, "rtp-max-dropout");
     p_sys->max_misorder = var_CreateGetInteger (obj, "rtp-max-misorder");
+    p_sys->batch        = var_InheritInteger (obj, "rtp-batch");
+    p_sys->recv_stats.calls = 0;
+    p_sys->recv_stats.packets = 0;
+    p_sys->recv_stats.full = 0;
     p_sys->thread_ready = false;
     p_sys->autodetect   = true;
 
@@ -331,6 +343,13 @@ static void Close (vlc_object_t *obj)
         vlc_join (p_sys->thread, NULL);
     }
 
+    if (p_sys->recv_stats.calls > 0)
+        msg_Dbg (obj, "received %"PRIu64" packets in %"PRIu64" calls "
+                 "(%.1f per call, batch of %u filled %"PRIu64" times)",
+                 p_sys->recv_stats.packets, p_sys->recv_stats.calls,
+                 (double)p_sys->recv_stats.packets / p_sys->recv_stats.calls,
+                 p_sys->batch, p_sys->recv_stats.full);
+
 #ifdef HAVE_SRTP
     if (p_sys->srtp)
         srtp_destroy (p_sys->srtp);
@@ -77,6 +77,13 @@ struct demux_sys_t
     uint16_t      max_dropout; /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
     uint8_t       max_src; /**< Max simultaneous RTP sources */
+    unsigned      batch; /**< Max packets per receive call */
+    struct
+    {
+        uint64_t  calls;
+        uint64_t  packets;
+        uint64_t  full; /**< Calls filling the whole batch */
+    } recv_stats;
     bool          thread_ready;
     bool          autodetect; /**< Payload type autodetection pending */
 };
@@ -49,7 +49,11 @@ rtp_source_create (demux_t *, const rtp_session_t *, uint32_t, uint16_t);
 static void
 rtp_source_destroy (demux_t *, const rtp_session_t *, rtp_source_t *);
 
-static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
+static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *,
+                        block_t *);
+
+/* Shortest wait for a missing packet */
+#define RTP_MIN_DELAY (CLOCK_FREQ / 500)
 
 /**
  * Creates a new RTP session.
@@ -148,11 +152,57 @@ struct rtp_source_t
     uint16_t bad_seq; /* tentatively next expected sequence for resync */
     uint16_t max_seq; /* next expected sequence */
 
-    uint16_t last_seq; /* sequence of the next dequeued packet */
-    block_t *blocks; /* re-ordered blocks queue */
+    uint16_t last_seq; /* sequence of the last dequeued packet */
+    uint16_t pending; /* number of queued blocks */
+    uint16_t ring_mask; /* ring size minus one (power of two) */
+    mtime_t  reorder; /* observed reordering delay estimate */
+    uint16_t skip_seq; /* first packet of the last given up gap */
+    uint16_t skip_count; /* number of packets in the last given up gap */
+    mtime_t  skip_rx; /* reception time of the packet after the gap */
+    block_t **ring; /* re-ordered blocks, indexed by sequence number */
     void    *opaque[]; /* Per-source private payload data */
 };
 
+static inline block_t **rtp_slot (rtp_source_t *src, uint16_t seq)
+{
+    return &src->ring[seq & src->ring_mask];
+}
+
+/**
+ * Removes the first queued block, after any missing packets.
+ * The ring must not be empty.
+ */
+static block_t *rtp_source_first (rtp_source_t *src)
+{
+    uint16_t seq = src->last_seq + 1;
+    block_t *block;
+
+    assert (src->pending > 0);
+    while ((block = *rtp_slot (src, seq)) == NULL)
+        seq++;
+
+    *rtp_slot (src, seq) = NULL;
+    src->pending--;
+    return block;
+}
+
+/**
+ * Discards all queued blocks.
+ */
+static void rtp_source_flush (rtp_source_t *src)
+{
+    for (unsigned i = 0; src->pending > 0; i++)
+    {
+        assert (i <= src->ring_mask);
+        if (src->ring[i] != NULL)
+        {
+            block_Release (src->ring[i]);
+            src->ring[i] = NULL;
+            src->pending--;
+        }
+    }
+}
+
 /**
  * Initializes a new RTP source within an RTP session.
  */
@@ -160,12 +210,27 @@ static rtp_source_t *
 rtp_source_create (demux_t *demux, const rtp_session_t *session,
                    uint32_t ssrc, uint16_t init_seq)
 {
+    demux_sys_t *p_sys = demux->p_sys;
     rtp_source_t *source;
 
     source = malloc (sizeof (*source) + (sizeof (void *) * session->ptc));
     if (source == NULL)
         return NULL;
 
+    /* Packets more than max_misorder behind are discarded anyway, so the
+     * reordering window need not be larger. */
+    unsigned size = 32;
+    while (size <= p_sys->max_misorder)
+        size <<= 1;
+
+    source->ring = calloc (size, sizeof (*source->ring));
+    if (source->ring == NULL)
+    {
+        free (source);
+        return NULL;
+    }
+    source->ring_mask = size - 1;
+
     source->ssrc = ssrc;
     source->jitter = 0;
     source->ref_rtp = 0;
@@ -173,7 +238,9 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
     source->ref_ntp = UINT64_C (1) << 62;
     source->max_seq = source->bad_seq = init_seq;
     source->last_seq = init_seq - 1;
-    source->blocks = NULL;
+    source->pending = 0;
+    source->reorder = 0;
+    source->skip_count = 0;
 
     /* Initializes all payload */
     for (unsigned i = 0; i < session->ptc; i++)
@@ -195,7 +262,8 @@ rtp_source_destroy (demux_t *demux, const rtp_session_t *session,
 
     for (unsigned i = 0; i < session->ptc; i++)
         session->ptv[i].destroy (demux, source->opaque[i]);
-    block_ChainRelease (source->blocks);
+    rtp_source_flush (source);
+    free (source->ring);
     free (source);
 }
 
@@ -336,10 +404,10 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         if (seq == src->bad_seq)
         {
             src->max_seq = src->bad_seq = seq + 1;
-            src->last_seq = seq - 0x7fffe; /* hack for rtp_decode() */
+            src->last_seq = seq - 1;
             msg_Warn (demux, "sequence resynchronized");
-            block_ChainRelease (src->blocks);
-            src->blocks = NULL;
+            rtp_source_flush (src);
+            block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
         }
         else
         {
@@ -353,21 +421,47 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
 
     /* Queues the block in sequence order,
      * hence there is a single queue for all payload types. */
-    block_t **pp = &src->blocks;
-    for (block_t *prev = *pp; prev != NULL; prev = *pp)
-    {
-        delta_seq = seq - rtp_seq (prev);
-        if (delta_seq < 0)
-            break;
-        if (delta_seq == 0)
+    uint16_t offset = seq - (uint16_t)(src->last_seq + 1);
+    if (offset >= 0x8000)
+    {   /* Trash too late packets (and PIM Assert duplicates) */
+        msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")", seq);
+        /* If we gave up waiting for it, wait long enough next time */
+        if ((uint16_t)(seq - src->skip_seq) < src->skip_count
+         && now - src->skip_rx > src->reorder)
+            src->reorder = now - src->skip_rx;
+        goto drop;
+    }
+
+    if (offset > src->ring_mask)
+    {   /* Out of the reordering window: give up on the oldest packets */
+        while (src->pending > 0 && offset > src->ring_mask)
         {
-            msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
-            goto drop; /* duplicate */
+            block_t *first = rtp_source_first (src);
+
+            rtp_decode (demux, session, src, first);
+            offset = seq - (uint16_t)(src->last_seq + 1);
         }
-        pp = &prev->p_next;
+        if (offset > src->ring_mask)
+            src->last_seq = seq - 1 - src->ring_mask;
+    }
+
+    block_t **slot = rtp_slot (src, seq);
+    if (*slot != NULL)
+    {
+        msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
+        goto drop; /* duplicate */
     }
-    block->p_next = *pp;
-    *pp = block;
+
+    /* A packet received after its successor was delayed by reordering.
+     * Track the largest delay, so as to wait long enough for missing
+     * packets in the future. */
+    const block_t *next = *rtp_slot (src, seq + 1);
+    if ((uint16_t)(seq + 1) != src->max_seq && next != NULL
+     && now - next->i_pts > src->reorder)
+        src->reorder = now - next->i_pts;
+
+    *slot = block;
+    src->pending++;
 
     /*rtp_decode (demux, session, src);*/
     return;
@@ -377,7 +471,41 @@ drop:
 }
 
 
-static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
+/**
+ * Computes how long to wait for a missing packet.
+ *
+ * Because of IP packet delay variation (IPDV), we need to guesstimate
+ * how long to wait for a missing packet in the RTP sequence
+ * (see RFC3393 for background on IPDV).
+ *
+ * This situation occurs if a packet got lost, or if the network has
+ * re-ordered packets. Unfortunately, the MSL is 2 minutes, orders of
+ * magnitude too long for multimedia. We need a trade-off.
+ * If we underestimated IPDV, we may have to discard valid but late
+ * packets. If we overestimate it, we will either cause too much
+ * delay, or worse, underflow our downstream buffers, as we wait for
+ * definitely a lost packets.
+ *
+ * The delay follows the interarrival jitter estimate and the reordering
+ * delays actually observed, rather than a worst case constant.
+ */
+static mtime_t rtp_playout_delay (const rtp_source_t *src,
+                                  const rtp_pt_t *pt)
+{
+    mtime_t delay = 0;
+
+    /* Wait for 3 times the inter-arrival delay variance (about 99.7%
+     * match for random gaussian jitter). */
+    if (pt != NULL)
+        delay = CLOCK_FREQ * 3 * (mtime_t)src->jitter / pt->frequency;
+    /* else no jitter estimate with no frequency :( */
+
+    if (delay < src->reorder)
+        delay = src->reorder;
+    if (delay < RTP_MIN_DELAY)
+        delay = RTP_MIN_DELAY;
+    return delay;
+}
 
 /**
  * Dequeues RTP packets and pass them to decoder. Not cancellation-safe(?).
@@ -402,55 +530,42 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
     for (unsigned i = 0, max = session->srcc; i < max; i++)
     {
         rtp_source_t *src = session->srcv[i];
-        block_t *block;
-
-        /* Because of IP packet delay variation (IPDV), we need to guesstimate
-         * how long to wait for a missing packet in the RTP sequence
-         * (see RFC3393 for background on IPDV).
-         *
-         * This situation occurs if a packet got lost, or if the network has
-         * re-ordered packets. Unfortunately, the MSL is 2 minutes, orders of
-         * magnitude too long for multimedia. We need a trade-off.
-         * If we underestimated IPDV, we may have to discard valid but late
-         * packets. If we overestimate it, we will either cause too much
-         * delay, or worse, underflow our downstream buffers, as we wait for
-         * definitely a lost packets.
-         *
-         * The rest of the "de-jitter buffer" work is done by the internal
+
+        /* The rest of the "de-jitter buffer" work is done by the internal
          * LibVLC E/S-out clock synchronization. Here, we need to bother about
          * re-ordering packets, as decoders can't cope with mis-ordered data.
          */
-        while (((block = src->blocks)) != NULL)
+        while (src->pending > 0)
         {
-            if ((int16_t)(rtp_seq (block) - (src->last_seq + 1)) <= 0)
-            {   /* Next (or earlier) block ready, no need to wait */
-                rtp_decode (demux, session, src);
-                continue;
-            }
+            block_t **slot = rtp_slot (src, src->last_seq + 1);
 
-            /* Wait for 3 times the inter-arrival delay variance (about 99.7%
-             * match for random gaussian jitter).
-             */
-            mtime_t deadline;
-            const rtp_pt_t *pt = rtp_find_ptype (session, src, block, NULL);
-            if (pt)
-                deadline = CLOCK_FREQ * 3 * src->jitter / pt->frequency;
-            else
-                deadline = 0; /* no jitter estimate with no frequency :( */
+            if (*slot != NULL)
+            {   /* Next block ready, no need to wait */
+                block_t *block = *slot;
 
-            /* Make sure we wait at least for 25 msec */
-            if (deadline < (CLOCK_FREQ / 40))
-                deadline = CLOCK_FREQ / 40;
+                *slot = NULL;
+                src->pending--;
+                rtp_decode (demux, session, src, block);
+                continue;
+            }
 
             /* Additionnaly, we implicitly wait for the packetization time
              * multiplied by the number of missing packets. block is the first
              * non-missing packet (lowest sequence number). We have no better
              * estimated time of arrival, as we do not know the RTP timestamp
              * of not yet received packets. */
-            deadline += block->i_pts;
+            uint16_t seq = src->last_seq + 2;
+            const block_t *block;
+
+            while ((block = *rtp_slot (src, seq)) == NULL)
+                seq++;
+
+            const rtp_pt_t *pt = rtp_find_ptype (session, src, block, NULL);
+            mtime_t deadline = block->i_pts + rtp_playout_delay (src, pt);
+
             if (now >= deadline)
             {
-                rtp_decode (demux, session, src);
+                rtp_decode (demux, session, src, rtp_source_first (src));
                 continue;
             }
             if (*deadlinep > deadline)
@@ -471,10 +586,9 @@ void rtp_dequeue_force (demux_t *demux, const rtp_session_t *session)
     for (unsigned i = 0, max = session->srcc; i < max; i++)
     {
         rtp_source_t *src = session->srcv[i];
-        block_t *block;
 
-        while (((block = src->blocks)) != NULL)
-            rtp_decode (demux, session, src);
+        while (src->pending > 0)
+            rtp_decode (demux, session, src, rtp_source_first (src));
     }
 }
 
@@ -482,28 +596,23 @@ void rtp_dequeue_force (demux_t *demux, const rtp_session_t *session)
  * Decodes one RTP packet.
  */
 static void
-rtp_decode (demux_t *demux, const rtp_session_t *session, rtp_source_t *src)
+rtp_decode (demux_t *demux, const rtp_session_t *session, rtp_source_t *src,
+            block_t *block)
 {
-    block_t *block = src->blocks;
-
-    assert (block);
-    src->blocks = block->p_next;
-    block->p_next = NULL;
-
     /* Discontinuity detection */
     uint16_t delta_seq = rtp_seq (block) - (src->last_seq + 1);
     if (delta_seq != 0)
     {
-        if (delta_seq >= 0x8000)
-        {   /* Trash too late packets (and PIM Assert duplicates) */
-            msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")",
-                      rtp_seq (block));
-            goto drop;
-        }
+        assert (delta_seq < 0x8000); /* late packets are not queued */
         msg_Warn (demux, "%"PRIu16" packet(s) lost", delta_seq);
         block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+        src->skip_seq = src->last_seq + 1;
+        src->skip_count = delta_seq;
+        src->skip_rx = block->i_pts; /* still the reception time */
     }
     src->last_seq = rtp_seq (block);
+    /* Forget old reordering events progressively */
+    src->reorder -= src->reorder >> 8;
 
     /* Match the payload type */
     void *pt_data;
@@ -59,6 +59,9 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Datagrams per receive call")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams received at once " \
+    "into a single block (only supported on Linux).")
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -69,6 +72,8 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+    add_integer_with_range( "udp-batch", 1, 1, 1024,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -81,12 +86,26 @@ struct access_sys_t
     int fd;
     int timeout;
     size_t mtu;
+#ifdef HAVE_RECVMMSG
+    unsigned batch;
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+    struct
+    {
+        uint64_t calls;
+        uint64_t datagrams;
+        uint64_t full; /* calls that filled the whole batch */
+    } stats;
+#endif
 };
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static block_t *BlockUDP( stream_t *, bool * );
+#ifdef HAVE_RECVMMSG
+static block_t *BlockUDPBatch( stream_t *, bool * );
+#endif
 static int Control( stream_t *, int, va_list );
 
 /*****************************************************************************
@@ -174,6 +193,30 @@ static int Open( vlc_object_t *p_this )
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    sys->msgs = NULL;
+    sys->iovecs = NULL;
+    if( sys->batch > 1 )
+    {
+        sys->msgs = vlc_obj_calloc( p_this, sys->batch, sizeof( *sys->msgs ) );
+        sys->iovecs = vlc_obj_calloc( p_this, sys->batch,
+                                      sizeof( *sys->iovecs ) );
+        if( unlikely(sys->msgs == NULL || sys->iovecs == NULL) )
+            sys->batch = 1;
+        else
+        {
+            for( unsigned i = 0; i < sys->batch; i++ )
+            {
+                sys->msgs[i].msg_hdr.msg_iov = &sys->iovecs[i];
+                sys->msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            p_access->pf_block = BlockUDPBatch;
+        }
+    }
+    sys->stats.calls = sys->stats.datagrams = sys->stats.full = 0;
+#endif
+
     return VLC_SUCCESS;
 }
 
@@ -185,6 +228,14 @@ static void Close( vlc_object_t *p_this )
     stream_t     *p_access = (stream_t*)p_this;
     access_sys_t *sys = p_access->p_sys;
 
+#ifdef HAVE_RECVMMSG
+    if( sys->stats.calls > 0 )
+        msg_Dbg( p_access, "received %"PRIu64" datagrams in %"PRIu64" calls "
+                 "(%.1f per call, batch of %u filled %"PRIu64" times)",
+                 sys->stats.datagrams, sys->stats.calls,
+                 (double)sys->stats.datagrams / sys->stats.calls,
+                 sys->batch, sys->stats.full );
+#endif
     net_Close( sys->fd );
 }
 
@@ -285,3 +336,90 @@ skip:
 
     return pkt;
 }
+
+#ifdef HAVE_RECVMMSG
+/*****************************************************************************
+ * BlockUDPBatch: receives up to sys->batch datagrams with a single call
+ *****************************************************************************/
+static block_t *BlockUDPBatch(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+    const size_t mtu = sys->mtu;
+
+    block_t *pkt = block_Alloc(sys->batch * mtu);
+    if (unlikely(pkt == NULL))
+        return BlockUDP(access, eof);
+
+    for (unsigned i = 0; i < sys->batch; i++)
+    {
+        sys->iovecs[i].iov_base = pkt->p_buffer + i * mtu;
+        sys->iovecs[i].iov_len = mtu;
+        sys->msgs[i].msg_hdr.msg_flags = 0;
+    }
+
+    struct pollfd ufd[1];
+
+    ufd[0].fd = sys->fd;
+    ufd[0].events = POLLIN;
+
+    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    {
+        case 0:
+            msg_Err(access, "receive time-out");
+            *eof = true;
+            /* fall through */
+        case -1:
+            goto skip;
+     }
+
+    int count = recvmmsg(sys->fd, sys->msgs, sys->batch,
+                         MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (count <= 0)
+    {
+skip:
+        block_Release(pkt);
+        return NULL;
+    }
+
+    /* Pack the datagrams at the head of the block */
+    size_t offset = 0;
+    for (int i = 0; i < count; i++)
+    {
+        size_t len = sys->msgs[i].msg_len;
+
+        if (sys->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                    len, mtu);
+            pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+            if (len > sys->mtu)
+                sys->mtu = len;
+            len = mtu;
+        }
+
+        if (offset != i * mtu)
+            memmove(pkt->p_buffer + offset, pkt->p_buffer + i * mtu, len);
+        offset += len;
+    }
+    pkt->i_buffer = offset;
+
+    /* Do not queue a mostly unused batch buffer downstream. Shrinking with
+     * block_Realloc() would keep the whole allocation, so copy instead. */
+    if (offset < pkt->i_size / 2)
+    {
+        block_t *dup = block_Duplicate(pkt);
+        if (likely(dup != NULL))
+        {
+            block_Release(pkt);
+            pkt = dup;
+        }
+    }
+
+    sys->stats.calls++;
+    sys->stats.datagrams += count;
+    if ((unsigned)count == sys->batch)
+        sys->stats.full++;
+
+    return pkt;
+}
+#endif
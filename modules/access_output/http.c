@@ -441,7 +441,12 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
             memcpy( p_buffer->p_buffer, &hdr, sizeof( hdr ) );
         }
 
-        /* send data */
+        /* send data, the stream keeping a reference rather than a copy */
+        p_buffer = block_Shareable( p_buffer );
+        if( unlikely(p_buffer == NULL) ) {
+            block_ChainRelease( p_next );
+            return VLC_ENOMEM;
+        }
         i_err = httpd_StreamSend( p_sys->p_httpd_stream, p_buffer );
 
         block_Release( p_buffer );
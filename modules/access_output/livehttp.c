@@ -102,6 +102,11 @@ static void Close( vlc_object_t * );
 #define RANDOMIV_TEXT N_("Use randomized IV for encryption")
 #define RANDOMIV_LONGTEXT N_("Generate IV instead using segment-number as IV")
 
+#define PARTLEN_TEXT N_("Partial segment length (ms)")
+#define PARTLEN_LONGTEXT N_("Publish segments in parts of at most this "\
+                            "duration while they are being written, "\
+                            "as per low-latency HLS. 0 disables parts.")
+
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
@@ -115,6 +120,7 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "seglen", 10, SEGLEN_TEXT, SEGLEN_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "numsegs", 0, NUMSEGS_TEXT, NUMSEGS_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "initial-segment-number", 1, INTITIAL_SEG_TEXT, INITIAL_SEG_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "partlen", 0, PARTLEN_TEXT, PARTLEN_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "splitanywhere", false,
               SPLITANYWHERE_TEXT, SPLITANYWHERE_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "delsegs", true,
@@ -156,12 +162,22 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "partlen",
     NULL
 };
 
 static ssize_t Write( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
 
+/* Partial segment: byte range of its segment file */
+typedef struct output_part
+{
+    mtime_t i_length;
+    uint64_t i_offset;
+    uint64_t i_size;
+    bool b_independent;
+} output_part_t;
+
 typedef struct output_segment
 {
     char *psz_filename;
@@ -171,6 +187,8 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+    output_part_t *parts;
+    unsigned i_parts;
 } output_segment_t;
 
 struct sout_access_out_sys_t
@@ -183,7 +201,13 @@ struct sout_access_out_sys_t
     mtime_t i_opendts;
     mtime_t i_dts_offset;
     mtime_t  i_seglenm;
+    mtime_t  i_partlenm;
+    mtime_t  i_partdts;
+    uint64_t i_segment_size;
+    uint64_t i_part_offset;
     uint32_t i_segment;
+    uint32_t i_index_firstseg;
+    unsigned i_index_offset;
     size_t  i_seglen;
     float   f_seglen;
     block_t *full_segments;
@@ -199,6 +223,7 @@ struct sout_access_out_sys_t
     bool b_caching;
     bool b_generate_iv;
     bool b_segment_has_data;
+    bool b_part_independent;
     uint8_t aes_ivs[16];
     gcry_cipher_hd_t aes_ctx;
     char *key_uri;
@@ -210,6 +235,7 @@ struct sout_access_out_sys_t
 static int LoadCryptFile( sout_access_out_t *p_access);
 static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
+static ssize_t CheckPartChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
 /*****************************************************************************
@@ -236,6 +262,12 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_seglen = var_GetInteger( p_access, SOUT_CFG_PREFIX "seglen" );
 
     p_sys->i_seglenm = CLOCK_FREQ * p_sys->i_seglen;
+    p_sys->i_partlenm = INT64_C(1000) * var_GetInteger( p_access, SOUT_CFG_PREFIX "partlen" );
+    if( p_sys->i_partlenm < 0 || p_sys->i_partlenm >= p_sys->i_seglenm )
+    {
+        msg_Warn( p_access, "ignoring invalid partial segment length" );
+        p_sys->i_partlenm = 0;
+    }
     p_sys->full_segments = NULL;
     p_sys->full_segments_end = &p_sys->full_segments;
 
@@ -299,6 +331,8 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_handle = -1;
     p_sys->i_segment = p_sys->i_initial_segment-1;
+    p_sys->i_index_firstseg = p_sys->i_initial_segment;
+    p_sys->i_index_offset = 0;
     p_sys->psz_cursegPath = NULL;
 
     p_access->pf_write = Write;
@@ -510,6 +544,7 @@ static void destroySegment( output_segment_t *segment )
     free( segment->psz_duration );
     free( segment->psz_uri );
     free( segment->psz_key_uri );
+    free( segment->parts );
     free( segment );
 }
 
@@ -555,132 +590,209 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
     return duration >= (first->f_seglength + (float)(p_sys->i_numsegs * p_sys->i_seglen));
 }
 
+/* Durations in playlist attributes, independently of the locale */
+#define DURATION_FMT "%"PRId64".%03"PRId64
+#define DURATION_ARGS(d) (d) / CLOCK_FREQ, ((d) % CLOCK_FREQ) / 1000
+
 /************************************************************************
- * updateIndexAndDel: If necessary, update index file & delete old segments
+ * writeKey: Write EXT-X-KEY line if segment key differs from previous one
  ************************************************************************/
-static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+static int writeKey( FILE *fp, sout_access_out_sys_t *p_sys,
+                     output_segment_t *segment, char **ppsz_current_uri )
 {
+    if( !p_sys->key_uri ||
+        ( *ppsz_current_uri && !strcmp( *ppsz_current_uri, segment->psz_key_uri ) ) )
+        return 0;
 
-    uint32_t i_firstseg;
-    unsigned i_index_offset = 0;
+    int ret = 0;
+    free( *ppsz_current_uri );
+    *ppsz_current_uri = strdup( segment->psz_key_uri );
+    if( p_sys->b_generate_iv )
+    {
+        unsigned long long iv_hi = segment->aes_ivs[0];
+        unsigned long long iv_lo = segment->aes_ivs[8];
+        for( unsigned short j = 1; j < 8; j++ )
+        {
+            iv_hi <<= 8;
+            iv_hi |= segment->aes_ivs[j] & 0xff;
+            iv_lo <<= 8;
+            iv_lo |= segment->aes_ivs[8+j] & 0xff;
+        }
+        ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                       segment->psz_key_uri, iv_hi, iv_lo );
 
-    if ( p_sys->i_numsegs == 0 ||
-         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+    } else {
+        ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
+    }
+    return ret;
+}
+
+/************************************************************************
+ * writeParts: Write EXT-X-PART lines of a segment
+ ************************************************************************/
+static int writeParts( FILE *fp, const output_segment_t *segment )
+{
+    for( unsigned i = 0; i < segment->i_parts; i++ )
     {
-        i_firstseg = p_sys->i_initial_segment;
+        const output_part_t *part = &segment->parts[i];
+
+        if( fprintf( fp, "#EXT-X-PART:DURATION="DURATION_FMT",URI=\"%s\","
+                         "BYTERANGE=\"%"PRIu64"@%"PRIu64"\"%s\n",
+                     DURATION_ARGS(part->i_length), segment->psz_uri,
+                     part->i_size, part->i_offset,
+                     part->b_independent ? ",INDEPENDENT=YES" : "" ) < 0 )
+            return -1;
     }
-    else
+    return 0;
+}
+
+/************************************************************************
+ * writeIndex: Write index file atomically
+ * Segments from p_sys->i_index_firstseg up to the last complete one are
+ * listed. In low-latency mode, the parts of the segment being written and
+ * a hint for its next part follow.
+ ************************************************************************/
+static int writeIndex( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
+    uint32_t i_firstseg = p_sys->i_index_firstseg;
+    unsigned i_index_offset = p_sys->i_index_offset;
+    unsigned i_end = vlc_array_count( &p_sys->segments_t );
+    bool b_lowlatency = p_sys->i_partlenm > 0;
+    char *psz_current_uri = NULL;
+    int val;
+    FILE *fp;
+    char *psz_idxTmp;
+
+    if ( p_sys->i_handle >= 0 )
+        i_end--; /* not complete yet */
+
+    unsigned i_partindex = i_end;
+
+    if ( b_lowlatency )
     {
-        unsigned numsegs = segmentAmountNeeded( p_sys );
-        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
-        i_index_offset = vlc_array_count( &p_sys->segments_t ) - numsegs;
+        /* Parts older than 3 target durations are dropped from the index */
+        float duration = .0f;
+        while ( i_partindex > i_index_offset && duration < (float)( 3 * p_sys->i_seglen ) )
+        {
+            i_partindex--;
+            output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, i_partindex );
+            duration += segment->f_seglength;
+        }
     }
 
-    // First update index
-    if ( p_sys->psz_indexPath )
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+        return -1;
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
     {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        return -1;
+    }
 
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
+    if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s"
+                      "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
+                      b_lowlatency ? 6 : 3, p_sys->b_caching ? "YES" : "NO",
+                      p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
+                      i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
+                      ) < 0 )
+        goto error;
+
+    if ( b_lowlatency &&
+         fprintf( fp, "#EXT-X-PART-INF:PART-TARGET="DURATION_FMT"\n"
+                      "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK="DURATION_FMT"\n",
+                  DURATION_ARGS(p_sys->i_partlenm),
+                  DURATION_ARGS(3 * p_sys->i_partlenm) ) < 0 )
+        goto error;
+
+    for ( unsigned index = i_index_offset; index < i_end; index++ )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, index );
+        if( writeKey( fp, p_sys, segment, &psz_current_uri ) < 0 ||
+            ( index >= i_partindex && writeParts( fp, segment ) < 0 ) )
         {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
-            return -1;
+            free( psz_current_uri );
+            goto error;
         }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
-                          p_sys->b_caching ? "YES" : "NO",
-                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
-                          i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
-                          ) < 0 )
+        val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
+        if ( val < 0 )
         {
-            free( psz_idxTmp );
-            fclose( fp );
-            return -1;
+            free( psz_current_uri );
+            goto error;
         }
-        char *psz_current_uri=NULL;
+    }
 
+    if ( b_lowlatency && p_sys->i_handle >= 0 )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
 
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+        if( writeKey( fp, p_sys, segment, &psz_current_uri ) < 0 ||
+            writeParts( fp, segment ) < 0 ||
+            fprintf( fp, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\",BYTERANGE-START=%"PRIu64"\n",
+                     segment->psz_uri, p_sys->i_part_offset ) < 0 )
         {
-            //scale to i_index_offset..numsegs + i_index_offset
-            uint32_t index = i - i_firstseg + i_index_offset;
+            free( psz_current_uri );
+            goto error;
+        }
+    }
+    free( psz_current_uri );
 
-            output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, index );
-            if( p_sys->key_uri &&
-                ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
-              )
-            {
-                int ret = 0;
-                free( psz_current_uri );
-                psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
-                {
-                    unsigned long long iv_hi = segment->aes_ivs[0];
-                    unsigned long long iv_lo = segment->aes_ivs[8];
-                    for( unsigned short j = 1; j < 8; j++ )
-                    {
-                        iv_hi <<= 8;
-                        iv_hi |= segment->aes_ivs[j] & 0xff;
-                        iv_lo <<= 8;
-                        iv_lo |= segment->aes_ivs[8+j] & 0xff;
-                    }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
-
-                } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
-                }
-                if( ret < 0 )
-                {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
-                }
-            }
+    if ( b_isend )
+    {
+        if ( fputs ( STR_ENDLIST, fp ) < 0)
+            goto error;
+    }
+    fclose( fp );
 
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
-            {
-                free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
-        }
-        free( psz_current_uri );
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
 
-        if ( b_isend )
-        {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    else
+        msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
 
-        }
-        fclose( fp );
+    free( psz_idxTmp );
+    return 0;
 
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+error:
+    fclose( fp );
+    vlc_unlink( psz_idxTmp );
+    free( psz_idxTmp );
+    return -1;
+}
 
-        if ( val < 0 )
-        {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
-        }
-        else
-            msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+/************************************************************************
+ * updateIndexAndDel: If necessary, update index file & delete old segments
+ ************************************************************************/
+static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
 
-        free( psz_idxTmp );
+    uint32_t i_firstseg;
+    unsigned i_index_offset = 0;
+
+    if ( p_sys->i_numsegs == 0 ||
+         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+    {
+        i_firstseg = p_sys->i_initial_segment;
     }
+    else
+    {
+        unsigned numsegs = segmentAmountNeeded( p_sys );
+        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
+        i_index_offset = vlc_array_count( &p_sys->segments_t ) - numsegs;
+    }
+
+    p_sys->i_index_firstseg = i_firstseg;
+    p_sys->i_index_offset = i_index_offset;
+
+    // First update index
+    if ( p_sys->psz_indexPath && writeIndex( p_access, p_sys, b_isend ) < 0 )
+        return -1;
 
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
@@ -700,11 +812,36 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          destroySegment( segment );
          i_index_offset -=1;
     }
+    p_sys->i_index_offset = i_index_offset;
 
 
     return 0;
 }
 
+/*****************************************************************************
+ * addPart: Add the data written since the previous part to segment parts
+ *****************************************************************************/
+static void addPart( sout_access_out_sys_t *p_sys, output_segment_t *segment,
+                     mtime_t i_length )
+{
+    if( p_sys->i_segment_size == p_sys->i_part_offset )
+        return; /* nothing written */
+
+    output_part_t *parts = realloc( segment->parts,
+                                    ( segment->i_parts + 1 ) * sizeof( *parts ) );
+    if( unlikely( !parts ) )
+        return; /* the data is still in the segment */
+
+    output_part_t *part = &parts[segment->i_parts++];
+    part->i_length = i_length;
+    part->i_offset = p_sys->i_part_offset;
+    part->i_size = p_sys->i_segment_size - p_sys->i_part_offset;
+    part->b_independent = p_sys->b_part_independent;
+
+    segment->parts = parts;
+    p_sys->i_part_offset = p_sys->i_segment_size;
+}
+
 /*****************************************************************************
  * closeCurrentSegment: Close the segment file
  *****************************************************************************/
@@ -727,6 +864,8 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
             int ret = vlc_write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
                 msg_Err( p_access, "Couldn't write 16 bytes" );
+            else
+                p_sys->i_segment_size += 16;
             }
             p_sys->stuffing_size = 0;
         }
@@ -744,6 +883,13 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
         segment->i_segment_number = p_sys->i_segment;
 
+        if( p_sys->i_partlenm > 0 )
+        {   /* Last part runs until the end of the segment */
+            mtime_t i_length = (mtime_t)( p_sys->f_seglen * CLOCK_FREQ )
+                             - ( p_sys->i_partdts - p_sys->i_opendts );
+            addPart( p_sys, segment, __MAX( i_length, 0 ) );
+        }
+
         if ( p_sys->psz_cursegPath )
         {
             msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
@@ -900,6 +1046,10 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
     p_sys->b_segment_has_data = false;
+    p_sys->i_segment_size = 0;
+    p_sys->i_part_offset = 0;
+    p_sys->i_partdts = p_sys->i_opendts;
+    p_sys->b_part_independent = true;
     return fd;
 }
 /*****************************************************************************
@@ -910,7 +1060,10 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     ssize_t writevalue = 0;
 
+    /* With parts, data since the last keyframe is already in the segment */
     if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+       ( p_sys->i_partlenm == 0 || p_sys->b_splitanywhere ||
+         ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) ) &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm ) )
     {
         writevalue = writeSegment( p_access );
@@ -1015,10 +1168,47 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            output->i_buffer -= val;
         }
         i_write += val;
+        p_sys->i_segment_size += val;
     }
     return i_write;
 }
 
+/*****************************************************************************
+ * CheckPartChange: Write out a part if the block would make it too long
+ *****************************************************************************/
+static ssize_t CheckPartChange( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->i_partlenm == 0 || p_sys->i_handle < 0 ||
+        ( p_buffer->i_length + p_buffer->i_dts - p_sys->i_partdts ) <= p_sys->i_partlenm )
+        return 0;
+
+    if( p_sys->ongoing_segment )
+    {
+        block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
+        p_sys->ongoing_segment = NULL;
+        p_sys->ongoing_segment_end = &p_sys->ongoing_segment;
+    }
+
+    ssize_t writevalue = writeSegment( p_access );
+    if( unlikely( writevalue < 0 ) )
+    {
+        block_ChainRelease( p_buffer );
+        return -1;
+    }
+
+    output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
+    addPart( p_sys, segment, p_buffer->i_dts - p_sys->i_partdts );
+    p_sys->i_partdts = p_buffer->i_dts;
+    p_sys->b_part_independent = p_sys->b_splitanywhere ||
+                                ( p_buffer->i_flags & BLOCK_FLAG_HEADER );
+
+    if( p_sys->psz_indexPath )
+        writeIndex( p_access, p_sys, false );
+    return writevalue;
+}
+
 /*****************************************************************************
  * Write: standard write on a file descriptor.
  *****************************************************************************/
@@ -1048,6 +1238,14 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         }
         i_write += ret;
 
+        ret = CheckPartChange( p_access, p_buffer );
+        if( ret < 0 )
+        {
+            msg_Err( p_access, "Error in write loop");
+            return ret;
+        }
+        i_write += ret;
+
         block_t *p_temp = p_buffer->p_next;
         p_buffer->p_next = NULL;
         block_ChainLastAppend( &p_sys->ongoing_segment_end, p_buffer );
@@ -39,6 +39,7 @@
 
 #include <vlc_sout.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 
 #ifdef _WIN32
 #   include <winsock2.h>
@@ -49,7 +50,9 @@
 
 #include <vlc_network.h>
 
-#define MAX_EMPTY_BLOCKS 200
+#define MAX_EMPTY_BLOCKS 256
+#define MAX_QUEUED_PACKETS 65536 /* memory cap, see QueueUDPPacket() */
+#define MAX_BATCH_PACKETS 64
 
 /*****************************************************************************
  * Module descriptor
@@ -62,7 +65,8 @@ static void Close( vlc_object_t * );
 #define CACHING_TEXT N_("Caching value (ms)")
 #define CACHING_LONGTEXT N_( \
     "Default caching value for outbound UDP streams. This " \
-    "value should be set in milliseconds." )
+    "value should be set in milliseconds. Packets are dropped if " \
+    "sending falls behind by more than twice this value plus one second." )
 
 #define GROUP_TEXT N_("Group packets")
 #define GROUP_LONGTEXT N_("Packets can be sent one by one at the right time " \
@@ -71,6 +75,13 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define WINDOW_TEXT N_("Send window (ms)")
+#define WINDOW_LONGTEXT N_("When non-zero, each packet is sent at its own " \
+                           "deadline, and all packets due within this many " \
+                           "milliseconds are sent together with a single " \
+                           "system call (only supported on Linux). " \
+                           "The group option is then ignored." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +90,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer_with_range( SOUT_CFG_PREFIX "window", 0, 0, 100,
+                            WINDOW_TEXT, WINDOW_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +105,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "window",
     NULL
 };
 
@@ -107,7 +121,14 @@ static ssize_t Write   ( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
 
 static void* ThreadWrite( void * );
+#ifdef HAVE_SENDMMSG
+static void* ThreadWriteBatched( void * );
+#endif
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
+static void QueueUDPPacket( sout_access_out_t *, block_t * );
+#ifdef HAVE_SENDMMSG
+static void JitterReport( sout_access_out_t * );
+#endif
 
 struct sout_access_out_sys_t
 {
@@ -116,11 +137,29 @@ struct sout_access_out_sys_t
     bool          b_mtu_warning;
     size_t        i_mtu;
 
-    block_fifo_t *p_fifo;
-    block_fifo_t *p_empty_blocks;
+    block_ring_t *p_fifo;         /* Write -> sender thread */
+    block_ring_t *p_empty_blocks; /* sender thread -> Write, for reuse */
     block_t      *p_buffer;
+    mtime_t       i_queue_span;   /* maximum DTS span of the queued packets */
+    atomic_int_least64_t i_sending_dts; /* DTS of the packet being sent */
+    unsigned      i_full_drops;   /* packets dropped since the last warning */
+    mtime_t       i_drop_warning; /* date of the last warning about drops */
 
     vlc_thread_t  thread;
+
+#ifdef HAVE_SENDMMSG
+    mtime_t       i_window;
+
+    /* Send time minus deadline, by order of magnitude */
+    struct
+    {
+        uint64_t  i_packets;
+        uint64_t  pi_early[5];
+        uint64_t  pi_late[5];
+        mtime_t   i_max_late;
+        mtime_t   i_last_report;
+    } jitter;
+#endif
 };
 
 #define DEFAULT_PORT 1234
@@ -209,16 +248,39 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
+    p_sys->p_fifo = block_RingNew( MAX_QUEUED_PACKETS );
+    p_sys->p_empty_blocks = block_RingNew( MAX_EMPTY_BLOCKS );
     p_sys->p_buffer = NULL;
+    p_sys->i_queue_span = 2 * p_sys->i_caching + CLOCK_FREQ;
+    atomic_init( &p_sys->i_sending_dts, VLC_TS_INVALID );
+    p_sys->i_full_drops = 0;
+    p_sys->i_drop_warning = 0;
+    if( unlikely(p_sys->p_fifo == NULL || p_sys->p_empty_blocks == NULL) )
+    {
+        if( p_sys->p_fifo )
+            block_RingRelease( p_sys->p_fifo );
+        if( p_sys->p_empty_blocks )
+            block_RingRelease( p_sys->p_empty_blocks );
+        net_Close (i_handle);
+        free (p_sys);
+        return VLC_ENOMEM;
+    }
 
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
+    void *(*pf_thread)( void * ) = ThreadWrite;
+#ifdef HAVE_SENDMMSG
+    p_sys->i_window = INT64_C(1000)
+                    * var_GetInteger( p_access, SOUT_CFG_PREFIX "window" );
+    memset( &p_sys->jitter, 0, sizeof( p_sys->jitter ) );
+    if( p_sys->i_window > 0 )
+        pf_thread = ThreadWriteBatched;
+#endif
+
+    if( vlc_clone( &p_sys->thread, pf_thread, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
-        block_FifoRelease( p_sys->p_fifo );
-        block_FifoRelease( p_sys->p_empty_blocks );
+        block_RingRelease( p_sys->p_fifo );
+        block_RingRelease( p_sys->p_empty_blocks );
         net_Close (i_handle);
         free (p_sys);
         return VLC_EGENERIC;
@@ -240,8 +302,12 @@ static void Close( vlc_object_t * p_this )
 
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
-    block_FifoRelease( p_sys->p_fifo );
-    block_FifoRelease( p_sys->p_empty_blocks );
+#ifdef HAVE_SENDMMSG
+    if( p_sys->jitter.i_packets > 0 )
+        JitterReport( p_access );
+#endif
+    block_RingRelease( p_sys->p_fifo );
+    block_RingRelease( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
 
@@ -296,7 +362,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                          now - p_sys->p_buffer->i_dts
                           - p_sys->i_caching );
             }
-            block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+            QueueUDPPacket( p_access, p_sys->p_buffer );
             p_sys->p_buffer = NULL;
         }
 
@@ -336,7 +402,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                              mdate() - p_sys->p_buffer->i_dts
                               - p_sys->i_caching );
                 }
-                block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+                QueueUDPPacket( p_access, p_sys->p_buffer );
                 p_sys->p_buffer = NULL;
             }
         }
@@ -355,24 +421,19 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 {
     sout_access_out_sys_t *p_sys = p_access->p_sys;
-    block_t *p_buffer;
+    block_t *p_buffer = block_RingDequeue( p_sys->p_empty_blocks );
 
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
-    {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
-        block_Release( p_buffer );
-    }
-
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
+    if( p_buffer == NULL )
     {
         p_buffer = block_Alloc( p_sys->i_mtu );
     }
     else
     {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
         p_buffer->i_flags = 0;
         p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
     }
+    if( unlikely(p_buffer == NULL) )
+        return NULL;
 
     p_buffer->i_dts = i_dts;
     p_buffer->i_buffer = 0;
@@ -380,6 +441,50 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+/*****************************************************************************
+ * QueueUDPPacket: hand a packet over to the sender thread
+ *****************************************************************************
+ * Packets wait for the caching delay in the queue. If the sender thread lags
+ * further behind, the packet is dropped rather than stalling the whole stream
+ * output chain. Drops are reported at most once per second.
+ *****************************************************************************/
+static void QueueUDPPacket( sout_access_out_t *p_access, block_t *p_pk )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    mtime_t i_sending = atomic_load_explicit( &p_sys->i_sending_dts,
+                                              memory_order_relaxed );
+
+    if( ( i_sending != VLC_TS_INVALID
+       && p_pk->i_dts - i_sending > p_sys->i_queue_span )
+     || !block_RingQueue( p_sys->p_fifo, p_pk ) )
+    {
+        block_Release( p_pk );
+        p_sys->i_full_drops++;
+    }
+
+    if( unlikely(p_sys->i_full_drops > 0) )
+    {
+        mtime_t now = mdate();
+
+        if( now - p_sys->i_drop_warning >= CLOCK_FREQ )
+        {
+            msg_Warn( p_access, "dropped %u packets: sending too slow",
+                      p_sys->i_full_drops );
+            p_sys->i_full_drops = 0;
+            p_sys->i_drop_warning = now;
+        }
+    }
+}
+
+/*****************************************************************************
+ * RecycleUDPPacket: hand a sent packet back to NewUDPPacket
+ *****************************************************************************/
+static void RecycleUDPPacket( sout_access_out_sys_t *p_sys, block_t *p_pk )
+{
+    if( !block_RingQueue( p_sys->p_empty_blocks, p_pk ) )
+        block_Release( p_pk );
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -395,9 +500,11 @@ static void* ThreadWrite( void *data )
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+        block_t *p_pk = block_RingGet( p_sys->p_fifo );
         mtime_t       i_date, i_sent;
 
+        atomic_store_explicit( &p_sys->i_sending_dts, p_pk->i_dts,
+                               memory_order_relaxed );
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
         {
@@ -407,7 +514,7 @@ static void* ThreadWrite( void *data )
                     msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
                              i_date - i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                RecycleUDPPacket( p_sys, p_pk );
 
                 i_date_last = i_date;
                 i_dropped_packets++;
@@ -447,9 +554,196 @@ static void* ThreadWrite( void *data )
         }
 #endif
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
+        RecycleUDPPacket( p_sys, p_pk );
+
+        i_date_last = i_date;
+    }
+    return NULL;
+}
+
+#ifdef HAVE_SENDMMSG
+/*****************************************************************************
+ * Send jitter statistics
+ *****************************************************************************
+ * The input sout counters (sent packets, sent bytes, send bitrate) only hold
+ * totals and rates, and are updated by the core through the private
+ * input_UpdateStatistic(). They have no room for a timing distribution, so
+ * the histograms are reported as debug messages.
+ *****************************************************************************/
+static const mtime_t jitter_bounds[4] = { 100, 1000, 5000, 20000 };
+
+static void JitterRecord( sout_access_out_sys_t *p_sys, mtime_t i_offset )
+{
+    uint64_t *pi_hist = p_sys->jitter.pi_late;
+    unsigned i;
+
+    if( i_offset < 0 )
+    {
+        pi_hist = p_sys->jitter.pi_early;
+        i_offset = -i_offset;
+    }
+    else if( i_offset > p_sys->jitter.i_max_late )
+        p_sys->jitter.i_max_late = i_offset;
+
+    for( i = 0; i < ARRAY_SIZE(jitter_bounds); i++ )
+        if( i_offset < jitter_bounds[i] )
+            break;
+    pi_hist[i]++;
+    p_sys->jitter.i_packets++;
+}
+
+static void JitterReport( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    const uint64_t *e = p_sys->jitter.pi_early, *l = p_sys->jitter.pi_late;
+
+    msg_Dbg( p_access, "sent %"PRIu64" packets, max late %"PRId64" us",
+             p_sys->jitter.i_packets, p_sys->jitter.i_max_late );
+    msg_Dbg( p_access, "early: <0.1ms %"PRIu64" <1ms %"PRIu64" <5ms %"PRIu64
+             " <20ms %"PRIu64" >=20ms %"PRIu64, e[0], e[1], e[2], e[3], e[4] );
+    msg_Dbg( p_access, "late: <0.1ms %"PRIu64" <1ms %"PRIu64" <5ms %"PRIu64
+             " <20ms %"PRIu64" >=20ms %"PRIu64, l[0], l[1], l[2], l[3], l[4] );
+}
+
+/*****************************************************************************
+ * ThreadWriteBatched: Send the packets due within the window at once.
+ *****************************************************************************/
+struct udp_batch
+{
+    block_t *pp_pkts[MAX_BATCH_PACKETS];
+    unsigned i_count;
+    block_t *p_pending; /* dequeued, but not due yet */
+};
+
+static void BatchCleanup( void *data )
+{
+    struct udp_batch *batch = data;
+
+    for( unsigned i = 0; i < batch->i_count; i++ )
+        block_Release( batch->pp_pkts[i] );
+    if( batch->p_pending )
+        block_Release( batch->p_pending );
+}
+
+/* Waits for the first packet deadline, then sends it along with all
+ * the packets due within the window */
+static void BatchSend( sout_access_out_t *p_access, struct udp_batch *batch,
+                       mtime_t i_date, struct mmsghdr *msgs )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    vlc_cleanup_push( BatchCleanup, batch );
+    mwait( i_date );
+    vlc_cleanup_pop();
+
+    int canc = vlc_savecancel();
+
+    /* A packet carrying a PCR always starts a new batch so that it leaves
+     * on time. */
+    const mtime_t i_limit = mdate() + p_sys->i_window;
+    while( batch->i_count < MAX_BATCH_PACKETS )
+    {
+        block_t *p_next = block_RingDequeue( p_sys->p_fifo );
+
+        if( p_next == NULL )
+            break;
+        if( p_sys->i_caching + p_next->i_dts > i_limit
+         || (p_next->i_flags & BLOCK_FLAG_CLOCK) )
+        {
+            batch->p_pending = p_next;
+            break;
+        }
+        batch->pp_pkts[batch->i_count++] = p_next;
+    }
+
+    for( unsigned i = 0; i < batch->i_count; i++ )
+    {
+        msgs[i].msg_hdr.msg_iov->iov_base = batch->pp_pkts[i]->p_buffer;
+        msgs[i].msg_hdr.msg_iov->iov_len = batch->pp_pkts[i]->i_buffer;
+    }
+
+    unsigned i_sent = 0;
+    while( i_sent < batch->i_count )
+    {
+        int val = sendmmsg( p_sys->i_handle, &msgs[i_sent],
+                            batch->i_count - i_sent, 0 );
+        if( val <= 0 )
+        {
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            break;
+        }
+        i_sent += val;
+    }
+    vlc_restorecancel( canc );
+}
+
+static void* ThreadWriteBatched( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct udp_batch batch = { .i_count = 0, .p_pending = NULL };
+    struct mmsghdr msgs[MAX_BATCH_PACKETS];
+    struct iovec iovecs[MAX_BATCH_PACKETS];
+    mtime_t i_date_last = -1;
+    unsigned i_dropped_packets = 0;
+
+    memset( msgs, 0, sizeof( msgs ) );
+    for( unsigned i = 0; i < MAX_BATCH_PACKETS; i++ )
+    {
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (;;)
+    {
+        block_t *p_pk = batch.p_pending;
+        batch.p_pending = NULL;
+        if( p_pk == NULL )
+            p_pk = block_RingGet( p_sys->p_fifo );
+        atomic_store_explicit( &p_sys->i_sending_dts, p_pk->i_dts,
+                               memory_order_relaxed );
+
+        mtime_t i_date = p_sys->i_caching + p_pk->i_dts;
+        if( i_date_last > 0 && i_date - i_date_last > 2000000 )
+        {
+            if( !i_dropped_packets )
+                msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                         i_date - i_date_last );
+
+            RecycleUDPPacket( p_sys, p_pk );
 
+            i_date_last = i_date;
+            i_dropped_packets++;
+            continue;
+        }
+
+        batch.pp_pkts[0] = p_pk;
+        batch.i_count = 1;
+        BatchSend( p_access, &batch, i_date, msgs );
+
+        const mtime_t now = mdate();
+        for( unsigned i = 0; i < batch.i_count; i++ )
+        {
+            p_pk = batch.pp_pkts[i];
+            i_date = p_sys->i_caching + p_pk->i_dts;
+            JitterRecord( p_sys, now - i_date );
+            RecycleUDPPacket( p_sys, p_pk );
+        }
+        batch.i_count = 0;
         i_date_last = i_date;
+
+        if( i_dropped_packets )
+        {
+            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
+            i_dropped_packets = 0;
+        }
+
+        if( now - p_sys->jitter.i_last_report > INT64_C(10000000) )
+        {
+            JitterReport( p_access );
+            p_sys->jitter.i_last_report = now;
+        }
     }
     return NULL;
 }
+#endif
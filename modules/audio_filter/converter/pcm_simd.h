@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * pcm_simd.h : vectorized PCM sample conversion and scaling
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_PCM_SIMD_H
+#define VLC_PCM_SIMD_H 1
+
+#include <string.h>
+#include <vlc_cpu.h>
+
+/* The scalar kernels are the reference: the vector kernels perform the very
+ * same IEEE operations lane by lane, so that both give identical results.
+ * Conversions may be done in place, with dst == src. */
+
+static inline void pcm_S16toFl32_c(float *dst, const int16_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {   /* This is Walken's trick based on IEEE float format. */
+        union { float f; int32_t i; } u;
+        u.i = src[i] + 0x43c00000;
+        dst[i] = u.f - 384.f;
+    }
+}
+
+static inline void pcm_Fl32toS16_c(int16_t *dst, const float *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {   /* This is Walken's trick based on IEEE float format. */
+        union { float f; int32_t i; } u;
+        u.f = src[i] + 384.f;
+        if (u.i > 0x43c07fff)
+            dst[i] = 32767;
+        else if (u.i < 0x43bf8000)
+            dst[i] = -32768;
+        else
+            dst[i] = u.i - 0x43c00000;
+    }
+}
+
+static inline void pcm_S32toFl32_c(float *dst, const int32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = (float)src[i] / 2147483648.f;
+}
+
+static inline void pcm_AmplifyFl32_c(float *buf, size_t n, float mult)
+{
+    for (size_t i = 0; i < n; i++)
+        buf[i] *= mult;
+}
+
+static inline void pcm_AmplifyFl64_c(double *buf, size_t n, double mult)
+{
+    for (size_t i = 0; i < n; i++)
+        buf[i] *= mult;
+}
+
+/* Vector kernels use the compiler generic vectors, so that the same code
+ * maps onto SSE2, AVX2 or NEON. */
+#if (defined(__clang__) || __GNUC__ >= 9) \
+ && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define PCM_SIMD 1
+# ifdef __clang__
+#  define PCM_SIMD_SHUFFLE(type, a, b, ...) \
+    __builtin_shufflevector(a, b, __VA_ARGS__)
+# else
+#  define PCM_SIMD_SHUFFLE(type, a, b, ...) \
+    __builtin_shuffle(a, b, (type){ __VA_ARGS__ })
+# endif
+#endif
+
+#ifdef PCM_SIMD
+# if defined(__i386__) || defined(__x86_64__)
+#  define PCM_SIMD_NAME(name) name##_sse2
+#  define PCM_SIMD_SIZE 16
+#  define PCM_SIMD_TARGET __attribute__ ((__target__ ("sse2")))
+#  include "pcm_simd_kernels.h"
+
+#  define PCM_SIMD_NAME(name) name##_avx2
+#  define PCM_SIMD_SIZE 32
+#  define PCM_SIMD_TARGET __attribute__ ((__target__ ("avx2")))
+#  include "pcm_simd_kernels.h"
+
+#  define PCM_SIMD_SELECT(name, ...) \
+    do { \
+        if (vlc_CPU_AVX2()) { name##_avx2(__VA_ARGS__); return; } \
+        if (vlc_CPU_SSE2()) { name##_sse2(__VA_ARGS__); return; } \
+    } while (0)
+# else
+#  define PCM_SIMD_NAME(name) name##_vec
+#  define PCM_SIMD_SIZE 16
+#  define PCM_SIMD_TARGET
+#  include "pcm_simd_kernels.h"
+
+#  define PCM_SIMD_SELECT(name, ...) \
+    do { name##_vec(__VA_ARGS__); return; } while (0)
+# endif
+#else
+# define PCM_SIMD_SELECT(name, ...) do { } while (0)
+#endif
+
+/* Dispatchers: use the best kernel for the CPU */
+
+static inline void pcm_S16toFl32(float *dst, const int16_t *src, size_t n)
+{
+    PCM_SIMD_SELECT(pcm_S16toFl32, dst, src, n);
+    pcm_S16toFl32_c(dst, src, n);
+}
+
+static inline void pcm_Fl32toS16(int16_t *dst, const float *src, size_t n)
+{
+    PCM_SIMD_SELECT(pcm_Fl32toS16, dst, src, n);
+    pcm_Fl32toS16_c(dst, src, n);
+}
+
+static inline void pcm_S32toFl32(float *dst, const int32_t *src, size_t n)
+{
+    PCM_SIMD_SELECT(pcm_S32toFl32, dst, src, n);
+    pcm_S32toFl32_c(dst, src, n);
+}
+
+static inline void pcm_AmplifyFl32(float *buf, size_t n, float mult)
+{
+    PCM_SIMD_SELECT(pcm_AmplifyFl32, buf, n, mult);
+    pcm_AmplifyFl32_c(buf, n, mult);
+}
+
+static inline void pcm_AmplifyFl64(double *buf, size_t n, double mult)
+{
+    PCM_SIMD_SELECT(pcm_AmplifyFl64, buf, n, mult);
+    pcm_AmplifyFl64_c(buf, n, mult);
+}
+
+#endif
@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * pcm_simd_kernels.h : generic vector PCM kernels
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by pcm_simd.h once per instruction set, with:
+ *  - PCM_SIMD_NAME(name): the kernel names,
+ *  - PCM_SIMD_SIZE: the vector size in bytes,
+ *  - PCM_SIMD_TARGET: the function attributes selecting the instruction set.
+ * Loads and stores go through memcpy(), as buffers need not be aligned. */
+
+/* Sign extension of 16-bits samples to 32-bits lanes, and back (the values
+ * being in range). With 16-bytes vectors, shuffles are the fastest. With
+ * wider vectors, shuffles cross lanes, so half vectors are converted. */
+#if PCM_SIMD_SIZE == 16
+# define PCM_SIMD_WIDEN(lo, hi, src) \
+    do { \
+        typedef int16_t vs16 __attribute__ ((vector_size (16))); \
+        vs16 s_, sign_; \
+        memcpy(&s_, src, sizeof (s_)); \
+        sign_ = s_ >> 15; \
+        lo = (vs32)PCM_SIMD_SHUFFLE(vs16, s_, sign_, \
+                                    0, 8, 1, 9, 2, 10, 3, 11); \
+        hi = (vs32)PCM_SIMD_SHUFFLE(vs16, s_, sign_, \
+                                    4, 12, 5, 13, 6, 14, 7, 15); \
+    } while (0)
+# define PCM_SIMD_NARROW(dst, lo, hi) \
+    do { \
+        typedef int16_t vs16 __attribute__ ((vector_size (16))); \
+        vs16 s_ = PCM_SIMD_SHUFFLE(vs16, (vs16)(lo), (vs16)(hi), \
+                                   0, 2, 4, 6, 8, 10, 12, 14); \
+        memcpy(dst, &s_, sizeof (s_)); \
+    } while (0)
+#else
+# define PCM_SIMD_WIDEN(lo, hi, src) \
+    do { \
+        typedef int16_t vh16 __attribute__ ((vector_size (PCM_SIMD_SIZE / 2))); \
+        vh16 l_, h_; \
+        memcpy(&l_, src, sizeof (l_)); \
+        memcpy(&h_, (src) + PCM_SIMD_SIZE / 4, sizeof (h_)); \
+        lo = __builtin_convertvector(l_, vs32); \
+        hi = __builtin_convertvector(h_, vs32); \
+    } while (0)
+# define PCM_SIMD_NARROW(dst, lo, hi) \
+    do { \
+        typedef int16_t vh16 __attribute__ ((vector_size (PCM_SIMD_SIZE / 2))); \
+        vh16 l_ = __builtin_convertvector(lo, vh16); \
+        vh16 h_ = __builtin_convertvector(hi, vh16); \
+        memcpy(dst, &l_, sizeof (l_)); \
+        memcpy((dst) + PCM_SIMD_SIZE / 4, &h_, sizeof (h_)); \
+    } while (0)
+#endif
+
+PCM_SIMD_TARGET
+static inline void PCM_SIMD_NAME(pcm_S16toFl32)(float *dst,
+                                                const int16_t *src, size_t n)
+{
+    typedef int32_t vs32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    typedef float vf32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    const size_t lanes = PCM_SIMD_SIZE / 2;
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes)
+    {
+        vs32 lo, hi;
+        PCM_SIMD_WIDEN(lo, hi, src + i);
+
+        vf32 flo = (vf32)(lo + 0x43c00000) - 384.f;
+        vf32 fhi = (vf32)(hi + 0x43c00000) - 384.f;
+        memcpy(dst + i, &flo, sizeof (flo));
+        memcpy(dst + i + lanes / 2, &fhi, sizeof (fhi));
+    }
+    pcm_S16toFl32_c(dst + i, src + i, n - i);
+}
+
+PCM_SIMD_TARGET
+static inline void PCM_SIMD_NAME(pcm_Fl32toS16)(int16_t *dst,
+                                                const float *src, size_t n)
+{
+    typedef int32_t vs32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    typedef float vf32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    const size_t lanes = PCM_SIMD_SIZE / 2;
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes)
+    {
+        vf32 f[2];
+        vs32 v[2];
+        memcpy(&f[0], src + i, sizeof (f[0]));
+        memcpy(&f[1], src + i + lanes / 2, sizeof (f[1]));
+
+        for (unsigned j = 0; j < 2; j++)
+        {
+            vs32 u = (vs32)(f[j] + 384.f);
+            vs32 high = u > 0x43c07fff, low = u < 0x43bf8000;
+
+            v[j] = ((u - 0x43c00000) & ~(high | low))
+                 | (high & 32767) | (low & -32768);
+        }
+        PCM_SIMD_NARROW(dst + i, v[0], v[1]);
+    }
+    pcm_Fl32toS16_c(dst + i, src + i, n - i);
+}
+
+PCM_SIMD_TARGET
+static inline void PCM_SIMD_NAME(pcm_S32toFl32)(float *dst,
+                                                const int32_t *src, size_t n)
+{
+    typedef int32_t vs32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    typedef float vf32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    const size_t lanes = PCM_SIMD_SIZE / 4;
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes)
+    {
+        vs32 s;
+        memcpy(&s, src + i, sizeof (s));
+
+        /* Scaling by a power of two is exact either way */
+        vf32 f = __builtin_convertvector(s, vf32) * (1.f / 2147483648.f);
+        memcpy(dst + i, &f, sizeof (f));
+    }
+    pcm_S32toFl32_c(dst + i, src + i, n - i);
+}
+
+PCM_SIMD_TARGET
+static inline void PCM_SIMD_NAME(pcm_AmplifyFl32)(float *buf, size_t n,
+                                                  float mult)
+{
+    typedef float vf32 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    const size_t lanes = PCM_SIMD_SIZE / 4;
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes)
+    {
+        vf32 f;
+        memcpy(&f, buf + i, sizeof (f));
+        f *= mult;
+        memcpy(buf + i, &f, sizeof (f));
+    }
+    pcm_AmplifyFl32_c(buf + i, n - i, mult);
+}
+
+PCM_SIMD_TARGET
+static inline void PCM_SIMD_NAME(pcm_AmplifyFl64)(double *buf, size_t n,
+                                                  double mult)
+{
+    typedef double vf64 __attribute__ ((vector_size (PCM_SIMD_SIZE)));
+    const size_t lanes = PCM_SIMD_SIZE / 8;
+    size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes)
+    {
+        vf64 f;
+        memcpy(&f, buf + i, sizeof (f));
+        f *= mult;
+        memcpy(buf + i, &f, sizeof (f));
+    }
+    pcm_AmplifyFl64_c(buf + i, n - i, mult);
+}
+
+#undef PCM_SIMD_NARROW
+#undef PCM_SIMD_WIDEN
+#undef PCM_SIMD_TARGET
+#undef PCM_SIMD_SIZE
+#undef PCM_SIMD_NAME
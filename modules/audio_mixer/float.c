@@ -35,6 +35,8 @@
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
 
+#include "../audio_filter/converter/pcm_simd.h"
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -61,8 +63,7 @@ static void FilterFL32( audio_volume_t *p_volume, block_t *p_buffer,
         return; /* nothing to do */
 
     float *p = (float *)p_buffer->p_buffer;
-    for( size_t i = p_buffer->i_buffer / sizeof(*p); i > 0; i-- )
-        *(p++) *= f_multiplier;
+    pcm_AmplifyFl32( p, p_buffer->i_buffer / sizeof(*p), f_multiplier );
 
     (void) p_volume;
 }
@@ -75,8 +76,7 @@ static void FilterFL64( audio_volume_t *p_volume, block_t *p_buffer,
     if( mult == 1. )
         return; /* nothing to do */
 
-    for( size_t i = p_buffer->i_buffer / sizeof(*p); i > 0; i-- )
-        *(p++) *= mult;
+    pcm_AmplifyFl64( p, p_buffer->i_buffer / sizeof(*p), mult );
 
     (void) p_volume;
 }
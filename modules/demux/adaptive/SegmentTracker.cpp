@@ -28,6 +28,8 @@
 #include "playlist/BaseAdaptationSet.h"
 #include "playlist/Segment.h"
 #include "playlist/SegmentChunk.hpp"
+#include "http/HTTPConnectionManager.h"
+#include "SharedResources.hpp"
 #include "logic/AbstractAdaptationLogic.h"
 #include "logic/BufferingLogic.hpp"
 
@@ -96,6 +98,7 @@ SegmentTracker::SegmentTracker(SharedResources *res,
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNKNOWN;
+    bufferingCurrent = bufferingTarget = 0;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -164,6 +167,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    cancelPrefetch();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -287,13 +291,12 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     }
 
     SegmentChunk *chunk = segment->toChunk(resources, connManager, next, rep);
+    const mtime_t duration = rep->inheritTimescale().ToTime(segment->duration.Get());
 
     /* Notify new segment length for stats / logic */
     if(chunk)
     {
-        const Timescale timescale = rep->inheritTimescale();
-        notify(SegmentTrackerEvent(rep->getAdaptationSet()->getID(),
-                                   timescale.ToTime(segment->duration.Get())));
+        notify(SegmentTrackerEvent(rep->getAdaptationSet()->getID(), duration));
     }
 
     /* We need to check segment/chunk format changes, as we can't rely on representation's (HLS)*/
@@ -313,11 +316,39 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+        prefetchNextSegments(connManager, rep, duration);
     }
 
     return chunk;
 }
 
+void SegmentTracker::prefetchNextSegments(AbstractConnectionManager *connManager,
+                                          BaseRepresentation *rep, mtime_t duration)
+{
+    /* Segments still missing to fill the buffer, after the current one */
+    const mtime_t missing = bufferingTarget - bufferingCurrent - duration;
+    if(missing <= 0 || duration <= 0)
+        return;
+
+    uint64_t number = next;
+    for(mtime_t ahead = 0; ahead < missing; ahead += duration)
+    {
+        uint64_t found;
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &found, &b_gap);
+        if(!segment || !segment->prefetch(connManager, found, rep))
+            break;
+        number = found + 1;
+    }
+}
+
+void SegmentTracker::cancelPrefetch()
+{
+    if(adaptationSet && resources && resources->getConnManager())
+        resources->getConnManager()->cancelPrefetch(adaptationSet->getID());
+}
+
 bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segnumber;
@@ -351,6 +382,8 @@ void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
         index_sent = false;
         init_sent = false;
     }
+    if(segnumber != next)
+        cancelPrefetch();
     curNumber = next = segnumber;
 }
 
@@ -405,6 +438,8 @@ void SegmentTracker::notifyBufferingState(bool enabled) const
 
 void SegmentTracker::notifyBufferingLevel(mtime_t min, mtime_t current, mtime_t target) const
 {
+    bufferingCurrent = current;
+    bufferingTarget = target;
     notify(SegmentTrackerEvent(adaptationSet->getID(), min, current, target));
 }
 
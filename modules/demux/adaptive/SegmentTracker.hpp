@@ -144,6 +144,9 @@ namespace adaptive
         private:
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            void prefetchNextSegments(AbstractConnectionManager *,
+                                      BaseRepresentation *, mtime_t);
+            void cancelPrefetch();
             bool first;
             bool initializing;
             bool index_sent;
@@ -157,6 +160,9 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+            /* last buffering levels, for prefetching */
+            mutable mtime_t bufferingCurrent;
+            mutable mtime_t bufferingTarget;
     };
 }
 
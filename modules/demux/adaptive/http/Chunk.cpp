@@ -303,7 +303,7 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     done = false;
     eof = false;
     held = false;
-    downloadstart = 0;
+    downloadtime = 0;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -347,8 +347,10 @@ void HTTPChunkBufferedSource::release()
     vlc_cond_signal(&avail);
 }
 
-void HTTPChunkBufferedSource::bufferize(size_t readsize)
+void HTTPChunkBufferedSource::bufferize(size_t readsize, unsigned shares)
 {
+    const mtime_t start = mdate();
+
     vlc_mutex_lock(&lock);
     if(!prepare())
     {
@@ -381,30 +383,42 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     } rate = {0,0};
 
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
+
+    vlc_mutex_lock(&lock);
+    /* When several sources are downloaded at once, each one only gets a
+     * share of the bandwidth: count that share of the time, so that the
+     * rates of parallel downloads still estimate the link rate */
+    downloadtime += (mdate() - start) / (shares ? shares : 1);
     if(ret <= 0)
     {
         block_Release(p_block);
         p_block = NULL;
-        vlc_mutex_locker locker( &lock );
         done = true;
-        rate.size = buffered + consumed;
-        rate.time = mdate() - downloadstart;
-        downloadstart = 0;
     }
     else
     {
         p_block->i_buffer = (size_t) ret;
-        vlc_mutex_locker locker( &lock );
         buffered += p_block->i_buffer;
         block_ChainLastAppend(&pp_tail, p_block);
         if((size_t) ret < readsize)
-        {
             done = true;
-            rate.size = buffered + consumed;
-            rate.time = mdate() - downloadstart;
-            downloadstart = 0;
+    }
+
+    if(done)
+    {
+        rate.size = buffered + consumed;
+        rate.time = downloadtime;
+        downloadtime = 0;
+        /* The connection can serve the next requests while the data
+         * is waiting to be read */
+        if(connection)
+        {
+            contentType = connection->getContentType();
+            connection->setUsed(false);
+            connection = NULL;
         }
     }
+    vlc_mutex_unlock(&lock);
 
     if(rate.size && rate.time)
     {
@@ -414,14 +428,12 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     vlc_cond_signal(&avail);
 }
 
-bool HTTPChunkBufferedSource::prepare()
+std::string HTTPChunkBufferedSource::getContentType() const
 {
-    if(!prepared)
-    {
-        downloadstart = mdate();
-        return HTTPChunkSource::prepare();
-    }
-    return true;
+    vlc_mutex_locker locker( &lock );
+    if(connection)
+        return connection->getContentType();
+    return contentType;
 }
 
 bool HTTPChunkBufferedSource::hasMoreData() const
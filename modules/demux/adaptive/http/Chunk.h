@@ -126,12 +126,12 @@ namespace adaptive
                 virtual block_t *  readBlock       (); /* reimpl */
                 virtual block_t *  read            (size_t); /* reimpl */
                 virtual bool       hasMoreData     () const; /* impl */
+                virtual std::string getContentType () const; /* reimpl */
                 void               hold();
                 void               release();
 
             protected:
-                virtual bool       prepare(); /* reimpl */
-                void               bufferize(size_t);
+                void               bufferize(size_t, unsigned = 1);
                 bool               isDone() const;
 
             private:
@@ -140,7 +140,8 @@ namespace adaptive
                 size_t              buffered; /* read cache size */
                 bool                done;
                 bool                eof;
-                mtime_t             downloadstart;
+                mtime_t             downloadtime;
+                std::string         contentType; /* once the connection is released */
                 vlc_cond_t          avail;
                 bool                held;
         };
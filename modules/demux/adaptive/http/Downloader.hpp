@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <vector>
 
 namespace adaptive
 {
@@ -34,7 +35,7 @@ namespace adaptive
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1);
                 ~Downloader();
                 bool start();
                 void schedule(HTTPChunkBufferedSource *);
@@ -43,13 +44,19 @@ namespace adaptive
             private:
                 static void * downloaderThread(void *);
                 void Run();
-                void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                void DownloadSource(HTTPChunkBufferedSource *, unsigned);
+                HTTPChunkBufferedSource * getNextSource() const;
+                bool isCurrent(const HTTPChunkBufferedSource *) const;
+                std::vector<vlc_thread_t> threads;
+                unsigned     workers;
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                bool         thread_handle_valid;
+                vlc_cond_t   updatedcond;
                 bool         killed;
+                /* queued sources, by priority */
                 std::list<HTTPChunkBufferedSource *> chunks;
+                /* sources currently read by a worker */
+                std::list<HTTPChunkBufferedSource *> current;
         };
 
     }
@@ -64,16 +64,26 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, AuthSt
       localAllowed(false)
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
+    vlc_mutex_init(&prefetchLock);
+    int64_t val = var_InheritInteger(p_object, "adaptive-prefetch");
+    maxPrefetch = (val > 0) ? val : 0;
+    val = var_InheritInteger(p_object, "adaptive-downloads");
+    downloader = new (std::nothrow) Downloader((val > 0) ? val : 1);
     downloader->start();
     factory = new ConnectionFactory(storage);
 }
 
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
+    /* prefetched sources need the downloader to be cancelled */
+    std::list<PrefetchedSource>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        delete (*it).source;
+    prefetched.clear();
     delete downloader;
     delete factory;
     this->closeAllConnections();
+    vlc_mutex_destroy(&prefetchLock);
     vlc_mutex_destroy(&lock);
 }
 
@@ -156,6 +166,125 @@ void HTTPConnectionManager::cancel(AbstractChunkSource *source)
         downloader->cancel(src);
 }
 
+static bool sameRange(const BytesRange &a, const BytesRange &b)
+{
+    if(!a.isValid() || !b.isValid())
+        return a.isValid() == b.isValid();
+    return a.getStartByte() == b.getStartByte() &&
+           a.getEndByte() == b.getEndByte();
+}
+
+HTTPChunkBufferedSource * HTTPConnectionManager::createSource(const std::string &url,
+                                                              const ID &id,
+                                                              const BytesRange &range)
+{
+    HTTPChunkBufferedSource *source = new (std::nothrow) HTTPChunkBufferedSource(url, this, id);
+    if(source && range.isValid())
+        source->setBytesRange(range);
+    return source;
+}
+
+AbstractChunkSource * HTTPConnectionManager::makeSource(const std::string &url,
+                                                        const ID &id,
+                                                        const BytesRange &range)
+{
+    HTTPChunkBufferedSource *source = NULL;
+    std::list<PrefetchedSource> dropped;
+
+    /* Prefetches are made in segments order: the ones of that stream which
+     * come before the requested source were skipped, and all of them are
+     * useless on a miss (representation switch) */
+    vlc_mutex_lock(&prefetchLock);
+    std::list<PrefetchedSource>::iterator it = prefetched.begin();
+    while(it != prefetched.end())
+    {
+        std::list<PrefetchedSource>::iterator next = it;
+        ++next;
+        if((*it).id == id)
+        {
+            if((*it).url == url && sameRange((*it).range, range))
+            {
+                source = (*it).source;
+                prefetched.erase(it);
+                break;
+            }
+            dropped.splice(dropped.end(), prefetched, it);
+        }
+        it = next;
+    }
+    vlc_mutex_unlock(&prefetchLock);
+
+    for(it = dropped.begin(); it != dropped.end(); ++it)
+        delete (*it).source;
+
+    if(!source)
+    {
+        source = createSource(url, id, range);
+        if(source)
+            start(source);
+    }
+    return source;
+}
+
+bool HTTPConnectionManager::prefetch(const std::string &url, const ID &id,
+                                     const BytesRange &range)
+{
+    if(maxPrefetch == 0)
+        return false;
+
+    vlc_mutex_lock(&prefetchLock);
+    unsigned count = 0;
+    std::list<PrefetchedSource>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        if(!((*it).id == id))
+            continue;
+        if((*it).url == url && sameRange((*it).range, range))
+        {
+            vlc_mutex_unlock(&prefetchLock);
+            return true;
+        }
+        count++;
+    }
+
+    PrefetchedSource entry;
+    if(count >= maxPrefetch ||
+       !(entry.source = createSource(url, id, range)))
+    {
+        vlc_mutex_unlock(&prefetchLock);
+        return false;
+    }
+    entry.url = url;
+    entry.id = id;
+    entry.range = range;
+    prefetched.push_back(entry);
+    /* started with the lock, as it can be cancelled right after */
+    start(entry.source);
+    vlc_mutex_unlock(&prefetchLock);
+    return true;
+}
+
+void HTTPConnectionManager::cancelPrefetch(const ID &id)
+{
+    std::list<PrefetchedSource> dropped;
+
+    vlc_mutex_lock(&prefetchLock);
+    std::list<PrefetchedSource>::iterator it = prefetched.begin();
+    while(it != prefetched.end())
+    {
+        std::list<PrefetchedSource>::iterator next = it;
+        ++next;
+        if((*it).id == id)
+            dropped.splice(dropped.end(), prefetched, it);
+        it = next;
+    }
+    vlc_mutex_unlock(&prefetchLock);
+
+    /* outside of the lock, as deleting waits for the download step */
+    for(it = dropped.begin(); it != dropped.end(); ++it)
+        delete (*it).source;
+}
+
 void HTTPConnectionManager::setLocalConnectionsAllowed()
 {
     localAllowed = true;
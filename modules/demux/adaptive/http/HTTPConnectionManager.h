@@ -26,10 +26,13 @@
 #define HTTPCONNECTIONMANAGER_H_
 
 #include "../logic/IDownloadRateObserver.h"
+#include "BytesRange.hpp"
+#include "../ID.hpp"
 
 #include <vlc_common.h>
 
 #include <vector>
+#include <list>
 #include <string>
 
 namespace adaptive
@@ -42,6 +45,7 @@ namespace adaptive
         class AuthStorage;
         class Downloader;
         class AbstractChunkSource;
+        class HTTPChunkBufferedSource;
 
         class AbstractConnectionManager : public IDownloadRateObserver
         {
@@ -52,6 +56,11 @@ namespace adaptive
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
+                /* Downloaded sources, possibly started by prefetch() */
+                virtual AbstractChunkSource * makeSource(const std::string &, const ID &,
+                                                         const BytesRange &) = 0;
+                virtual bool prefetch(const std::string &, const ID &, const BytesRange &) = 0;
+                virtual void cancelPrefetch(const ID &) = 0;
 
                 virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
@@ -74,12 +83,31 @@ namespace adaptive
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
+                virtual AbstractChunkSource * makeSource(const std::string &, const ID &,
+                                                         const BytesRange &) /* impl */;
+                virtual bool prefetch(const std::string &, const ID &,
+                                      const BytesRange &) /* impl */;
+                virtual void cancelPrefetch(const ID &) /* impl */;
                 void         setLocalConnectionsAllowed();
 
             private:
+                class PrefetchedSource
+                {
+                    public:
+                        std::string url;
+                        ID id;
+                        BytesRange range;
+                        HTTPChunkBufferedSource *source;
+                };
+
                 void    releaseAllConnections ();
+                HTTPChunkBufferedSource * createSource(const std::string &, const ID &,
+                                                       const BytesRange &);
                 Downloader                                         *downloader;
                 vlc_mutex_t                                         lock;
+                vlc_mutex_t                                         prefetchLock;
+                std::list<PrefetchedSource>                         prefetched;
+                unsigned                                            maxPrefetch;
                 std::vector<AbstractConnection *>                   connectionPool;
                 AbstractConnectionFactory                          *factory;
                 bool                                                localAllowed;
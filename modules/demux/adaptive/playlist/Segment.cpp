@@ -82,13 +82,11 @@ SegmentChunk* ISegment::toChunk(SharedResources *res, AbstractConnectionManager
                                 size_t index, BaseRepresentation *rep)
 {
     const std::string url = getUrlSegment().toString(index, rep);
-    HTTPChunkBufferedSource *source = new (std::nothrow) HTTPChunkBufferedSource(url, connManager,
-                                                                                 rep->getAdaptationSet()->getID());
+    AbstractChunkSource *source = connManager->makeSource(url,
+                                                          rep->getAdaptationSet()->getID(),
+                                                          getSourceRange());
     if( source )
     {
-        if(startByte != endByte)
-            source->setBytesRange(BytesRange(startByte, endByte));
-
         SegmentChunk *chunk = createChunk(source, rep);
         if(chunk)
         {
@@ -98,7 +96,6 @@ SegmentChunk* ISegment::toChunk(SharedResources *res, AbstractConnectionManager
                 delete chunk;
                 return NULL;
             }
-            connManager->start(source);
             return chunk;
         }
         else
@@ -109,6 +106,21 @@ SegmentChunk* ISegment::toChunk(SharedResources *res, AbstractConnectionManager
     return NULL;
 }
 
+bool ISegment::prefetch(AbstractConnectionManager *connManager,
+                        size_t index, BaseRepresentation *rep)
+{
+    const std::string url = getUrlSegment().toString(index, rep);
+    return connManager->prefetch(url, rep->getAdaptationSet()->getID(),
+                                 getSourceRange());
+}
+
+BytesRange ISegment::getSourceRange() const
+{
+    if(startByte != endByte)
+        return BytesRange(startByte, endByte);
+    return BytesRange();
+}
+
 bool ISegment::isTemplate() const
 {
     return templated;
@@ -65,6 +65,9 @@ namespace adaptive
                 virtual SegmentChunk*                   toChunk         (SharedResources *, AbstractConnectionManager *,
                                                                          size_t, BaseRepresentation *);
                 virtual SegmentChunk*                   createChunk     (AbstractChunkSource *, BaseRepresentation *) = 0;
+                /* Starts downloading in advance, for a later toChunk() */
+                virtual bool                            prefetch        (AbstractConnectionManager *,
+                                                                         size_t, BaseRepresentation *);
                 virtual void                            setByteRange    (size_t start, size_t end);
                 virtual void                            setSequenceNumber(uint64_t);
                 virtual uint64_t                        getSequenceNumber() const;
@@ -87,6 +90,7 @@ namespace adaptive
                 virtual bool                            prepareChunk    (SharedResources *,
                                                                          SegmentChunk *,
                                                                          BaseRepresentation *);
+                BytesRange                              getSourceRange  () const;
                 CommonEncryption        encryption;
                 size_t                  startByte;
                 size_t                  endByte;
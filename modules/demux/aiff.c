@@ -50,6 +50,7 @@ vlc_module_begin ()
     set_description( N_("AIFF demuxer" ) )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "8:41494646" ) /* "AIFF" */
     add_shortcut( "aiff" )
 vlc_module_end ()
 
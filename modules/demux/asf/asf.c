@@ -62,6 +62,7 @@ vlc_module_begin ()
     set_description( N_("ASF/WMV demuxer") )
     set_capability( "demux", 200 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:3026b2758e66cf11a6d900aa0062ce6c" )
     add_shortcut( "asf", "wmv" )
 vlc_module_end ()
 
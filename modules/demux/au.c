@@ -51,6 +51,7 @@ vlc_module_begin ()
     set_description( N_("AU demuxer") )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:2e736e64" ) /* ".snd" */
     add_shortcut( "au" )
 vlc_module_end ()
 
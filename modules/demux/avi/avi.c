@@ -73,6 +73,7 @@ vlc_module_begin ()
     set_description( N_("AVI demuxer") )
     set_capability( "demux", 212 )
     set_category( CAT_INPUT )
+    set_probe_signatures( "*:41564920 *:4f4e3266" ) /* "AVI ", "ON2f" */
     set_subcategory( SUBCAT_INPUT_DEMUX )
 
     add_bool( "avi-interleaved", false,
@@ -51,6 +51,8 @@ vlc_module_begin ()
     set_description( N_("FLAC demuxer") )
     set_capability( "demux", 155 )
     set_category( CAT_INPUT )
+    set_probe_signatures( "0:664c6143" ) /* "fLaC" */
+    set_probe_mime_types( "audio/flac" )
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_callbacks( Open, Close )
     add_shortcut( "flac" )
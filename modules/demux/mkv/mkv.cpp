@@ -53,6 +53,7 @@ vlc_module_begin ()
     set_description( N_("Matroska stream demuxer" ) )
     set_capability( "demux", 50 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:1a45dfa3" ) /* EBML */
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
 
@@ -30,6 +30,14 @@
 #include "fragments.h"
 #include "../asf/asfpacket.h"
 
+/* Position in a stts or ctts table: entry, and samples of that entry
+ * before the position */
+typedef struct
+{
+    uint32_t     i_index;
+    uint32_t     i_skip;
+} mp4_tts_cursor_t;
+
 /* Contain all information about a chunk */
 typedef struct
 {
@@ -47,17 +55,11 @@ typedef struct
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
-    uint32_t     i_entries_dts;
-    uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
-
-    uint32_t     i_entries_pts;
-    uint32_t     *p_sample_count_pts;
-    int32_t      *p_sample_offset_pts;  /* pts-dts */
-
-    uint32_t     *p_sample_size;
-    /* TODO if needed add pts
-        but quickly *add* support for edts and seeking */
+    /* first sample of the chunk in the stts and ctts tables: timestamps
+     * are decoded from the tables when needed, instead of being expanded
+     * per chunk */
+    mp4_tts_cursor_t dts;
+    mp4_tts_cursor_t pts;
 
 } mp4_chunk_t;
 
@@ -120,8 +122,12 @@ typedef struct
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-//                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* stsz table, not copied */
+
+    /* timing tables, not copied (p_ctts may be NULL) */
+    const MP4_Box_data_stts_t *p_stts;
+    const MP4_Box_data_ctts_t *p_ctts;
+    int64_t          i_cts_shift;    /* from cslg */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
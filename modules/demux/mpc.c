@@ -64,6 +64,8 @@ vlc_module_begin ()
     set_capability( "demux", 145 )
 
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:4d502b 0:4d50434b" ) /* "MP+", "MPCK" */
+    set_probe_extensions( "mpc,mp+,mpp" )
     add_shortcut( "mpc" )
 vlc_module_end ()
 
@@ -46,6 +46,7 @@
 #include "ts_hotfixes.h"
 #include "ts_sl.h"
 #include "ts_metadata.h"
+#include "ts_index.h"
 #include "sections.h"
 #include "pes.h"
 #include "timestamps.h"
@@ -115,6 +116,29 @@ static void Close ( vlc_object_t * );
 #define CC_CHECK_LONGTEXT   "Detect discontinuities and drop packet duplicates. " \
                             "(bluRay sources are known broken and have false positives). "
 
+#define BATCH_TEXT N_("Packets parsed per read")
+#define BATCH_LONGTEXT N_( \
+    "Number of TS packets read at once and parsed in place. Only the " \
+    "packets reaching elementary stream reassembly are copied. " \
+    "0 reads packets one at a time. Large values add input latency " \
+    "on low bitrate live streams." )
+
+#define INDEX_TEXT N_("Index seek points")
+#define INDEX_LONGTEXT N_( \
+    "Remember the position of timestamps and random access points while " \
+    "playing, so that seeking to an already indexed time does not need " \
+    "to search the file." )
+
+#define INDEX_SCAN_TEXT N_("Build the seek index in the background")
+#define INDEX_SCAN_LONGTEXT N_( \
+    "Sample timestamps across the whole file from a background thread. " \
+    "This reads the file a second time." )
+
+#define INDEX_CACHE_TEXT N_("Save the seek index")
+#define INDEX_CACHE_LONGTEXT N_( \
+    "Keep the seek index of files in the cache directory, and reuse it " \
+    "when opening the same file again." )
+
 #define TS_PATFIX_TEXT      "Try to generate PAT/PMT if missing"
 #define TS_SKIP_GHOST_PROGRAM_TEXT "Only create ES on program sending data"
 #define TS_OFFSETFIX_TEXT   "Try to fix too early PCR (or late DTS)"
@@ -157,6 +181,11 @@ vlc_module_begin ()
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
     add_bool( "ts-cc-check", true, CC_CHECK_TEXT, CC_CHECK_LONGTEXT, true )
+    add_integer_with_range( "ts-batch-packets", 0, 0, 4096,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+    add_bool( "ts-seek-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
+    add_bool( "ts-index-scan", false, INDEX_SCAN_TEXT, INDEX_SCAN_LONGTEXT, true )
+    add_bool( "ts-index-cache", false, INDEX_CACHE_TEXT, INDEX_CACHE_LONGTEXT, true )
     add_bool( "ts-pmtfix-waitdata", true, TS_SKIP_GHOST_PROGRAM_TEXT, NULL, true )
     add_bool( "ts-patfix", true, TS_PATFIX_TEXT, NULL, true )
     add_bool( "ts-pcr-offsetfix", true, TS_OFFSETFIX_TEXT, NULL, true )
@@ -193,9 +222,15 @@ static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static block_t* ReadTSPacketBatched( demux_t *p_demux, block_t *p_view );
+static void ReadTSBatchFlush( demux_t *p_demux );
+static uint64_t TSStreamTell( demux_sys_t *p_sys );
+static block_t* TSPacketMaterialize( block_t *p_pkt );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
+static void IndexPCR( demux_t *, const ts_pmt_t *, mtime_t );
+static void IndexRandomAccess( demux_t *, const ts_pid_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 
 #define TS_PACKET_SIZE_188 188
@@ -401,6 +436,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->batch.i_packets = var_InheritInteger( p_demux, "ts-batch-packets" );
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -527,6 +563,20 @@ static int Open( vlc_object_t *p_this )
     vlc_stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK,
                         &p_sys->b_canfastseek );
 
+    p_sys->index.p_index = NULL;
+    p_sys->index.i_pcr = -1;
+    if( p_sys->b_canfastseek && var_InheritBool( p_demux, "ts-seek-index" ) )
+    {
+        int64_t i_size = stream_Size( p_sys->stream );
+        if( i_size > 0 )
+            p_sys->index.p_index = ts_index_New( VLC_OBJECT(p_demux),
+                                                 p_demux->s->psz_url, i_size,
+                                                 p_sys->i_packet_size,
+                                                 p_sys->i_packet_header_size,
+                                                 var_InheritBool( p_demux, "ts-index-scan" ),
+                                                 var_InheritBool( p_demux, "ts-index-cache" ) );
+    }
+
     if( !p_sys->b_access_control && var_CreateGetBool( p_demux, "ts-pmtfix-waitdata" ) )
         p_sys->es_creation = DELAY_ES;
     else
@@ -559,6 +609,9 @@ static void Close( vlc_object_t *p_this )
 
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
+    if( p_sys->index.p_index )
+        ts_index_Delete( p_sys->index.p_index );
+
     vlc_mutex_lock( &p_sys->csa_lock );
     if( p_sys->csa )
     {
@@ -636,14 +689,25 @@ static int Demux( demux_t *p_demux )
         bool         b_frame = false;
         int          i_header = 0;
         block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        block_t      pkt_view;
+
+        if( p_sys->batch.i_packets )
+            p_pkt = ReadTSPacketBatched( p_demux, &pkt_view );
+        else
+            p_pkt = ReadTSPacket( p_demux );
+        if( !p_pkt )
         {
+            ReadTSBatchFlush( p_demux );
             return VLC_DEMUXER_EOF;
         }
 
         if( p_sys->b_start_record )
         {
-            /* Enable recording once synchronized */
+            /* Enable recording once synchronized, after the packets parsed
+             * in place */
+            if( !(p_pkt = TSPacketMaterialize( p_pkt )) )
+                continue;
+            ReadTSBatchFlush( p_demux );
             vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true,
                                 "ts" );
             p_sys->b_start_record = false;
@@ -676,6 +740,11 @@ static int Demux( demux_t *p_demux )
                 p_sys->b_valid_scrambling = true;
         }
 
+        /* Descrambling is done in place, so don't alter the peeked window */
+        if( (p_pkt->p_buffer[3] & 0xc0) && p_sys->csa &&
+            !(p_pkt = TSPacketMaterialize( p_pkt )) )
+            continue;
+
         /* Drop duplicates and invalid (DOES NOT drop corrupted) */
         p_pkt = ProcessTSPacket( p_demux, p_pid, p_pkt, &i_header );
         if( !p_pkt )
@@ -705,6 +774,10 @@ static int Demux( demux_t *p_demux )
         {
         case TYPE_PAT:
         case TYPE_PMT:
+            /* PMT handling can probe the stream boundaries, which moves
+             * the stream and invalidates the batch window */
+            if( !(p_pkt = TSPacketMaterialize( p_pkt )) )
+                break;
             /* PAT and PMT are not allowed to be scrambled */
             ts_psi_Packet_Push( p_pid, p_pkt->p_buffer );
             block_Release( p_pkt );
@@ -713,6 +786,11 @@ static int Demux( demux_t *p_demux )
         case TYPE_STREAM:
             p_sys->b_end_preparse = true;
 
+            if( p_sys->index.p_index && p_sys->index.i_pcr > -1 &&
+                (p_pkt->p_buffer[3] & 0x20) && p_pkt->p_buffer[4] > 0 &&
+                (p_pkt->p_buffer[5] & 0x40) ) /* random access indicator */
+                IndexRandomAccess( p_demux, p_pid );
+
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
             {
                 msg_Dbg( p_demux, "Creating delayed ES" );
@@ -730,11 +808,13 @@ static int Demux( demux_t *p_demux )
 
             if( p_pid->u.p_stream->transport == TS_TRANSPORT_PES )
             {
-                b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
+                if( (p_pkt = TSPacketMaterialize( p_pkt )) )
+                    b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
             }
             else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
             {
-                b_frame = GatherSectionsData( p_demux, p_pid, p_pkt, i_header );
+                if( (p_pkt = TSPacketMaterialize( p_pkt )) )
+                    b_frame = GatherSectionsData( p_demux, p_pid, p_pkt, i_header );
             }
             else // pid->u.p_pes->transport == TS_TRANSPORT_IGNORE
             {
@@ -905,6 +985,21 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
     }
 
+    /* The batch window is kept across Demux() calls: skip the packets
+     * parsed in place before moving or recording the stream */
+    switch( i_query )
+    {
+    case DEMUX_SET_POSITION:
+    case DEMUX_SET_TIME:
+    case DEMUX_SET_TITLE:
+    case DEMUX_SET_SEEKPOINT:
+    case DEMUX_SET_RECORD_STATE:
+        ReadTSBatchFlush( p_demux );
+        break;
+    default:
+        break;
+    }
+
     switch( i_query )
     {
     case DEMUX_CAN_SEEK:
@@ -944,7 +1039,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = TSStreamTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1784,6 +1879,90 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+static void TSPacketViewRelease( block_t *p_pkt )
+{
+    /* Packet views point inside the peeked window, nothing to free */
+    VLC_UNUSED(p_pkt);
+}
+
+static void ReadTSBatchFlush( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Skip what has been parsed in place. That invalidates the window. */
+    if( p_sys->batch.i_pos > 0 )
+        vlc_stream_Read( p_sys->batch.stream, NULL, p_sys->batch.i_pos );
+
+    p_sys->batch.stream = NULL;
+    p_sys->batch.p_data = NULL;
+    p_sys->batch.i_data = 0;
+    p_sys->batch.i_pos = 0;
+}
+
+/* Stream position, including the packets parsed in place */
+static uint64_t TSStreamTell( demux_sys_t *p_sys )
+{
+    uint64_t i_pos = vlc_stream_Tell( p_sys->stream );
+    if( p_sys->batch.stream == p_sys->stream )
+        i_pos += p_sys->batch.i_pos;
+    return i_pos;
+}
+
+static block_t* ReadTSPacketBatched( demux_t *p_demux, block_t *p_view )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+
+    /* A stream filter may have been inserted while parsing PSI (ARIB) */
+    if( p_sys->batch.stream != p_sys->stream ||
+        p_sys->batch.i_pos + i_size > p_sys->batch.i_data )
+    {
+        ReadTSBatchFlush( p_demux );
+
+        ssize_t i_peek = vlc_stream_Peek( p_sys->stream, &p_sys->batch.p_data,
+                                          i_size * p_sys->batch.i_packets );
+        if( i_peek < 0 || (size_t)i_peek < i_size )
+        {
+            p_sys->batch.p_data = NULL;
+            /* Let the regular path handle truncated packets and EOF */
+            return ReadTSPacket( p_demux );
+        }
+        p_sys->batch.stream = p_sys->stream;
+        p_sys->batch.i_data = i_peek;
+    }
+
+    const uint8_t *p = &p_sys->batch.p_data[p_sys->batch.i_pos];
+    if( p[p_sys->i_packet_header_size] != 0x47 )
+    {
+        /* Lost synchro, the regular path will resync */
+        ReadTSBatchFlush( p_demux );
+        return ReadTSPacket( p_demux );
+    }
+    p_sys->batch.i_pos += i_size;
+
+    /* Skip header (BluRay streams), see ReadTSPacket */
+    block_Init( p_view, (uint8_t *) &p[p_sys->i_packet_header_size],
+                i_size - p_sys->i_packet_header_size );
+    p_view->pf_release = TSPacketViewRelease;
+    return p_view;
+}
+
+/* Returns a packet that can be kept and modified: views of the batch
+ * window are copied, regular packets are returned as is */
+static block_t* TSPacketMaterialize( block_t *p_pkt )
+{
+    if( p_pkt->pf_release != TSPacketViewRelease )
+        return p_pkt;
+
+    block_t *p_copy = block_Alloc( p_pkt->i_buffer );
+    if( likely(p_copy) )
+    {
+        memcpy( p_copy->p_buffer, p_pkt->p_buffer, p_pkt->i_buffer );
+        block_CopyProperties( p_copy, p_pkt );
+    }
+    return p_copy;
+}
+
 static mtime_t GetPCR( const block_t *p_pkt )
 {
     const uint8_t *p = p_pkt->p_buffer;
@@ -1851,6 +2030,8 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    p_sys->index.i_pcr = -1;
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -1904,6 +2085,16 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
+    /* Use or narrow down the search with the seek index */
+    if( p_sys->index.p_index )
+    {
+        uint64_t i_offset;
+        if( ts_index_Lookup( p_sys->index.p_index, p_pmt->i_pid_pcr, i_scaledtime,
+                             &i_offset, &i_head_pos, &i_tail_pos ) &&
+            vlc_stream_Seek( p_sys->stream, i_offset ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -2092,6 +2283,10 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Skip the packets parsed in place before moving the stream */
+    ReadTSBatchFlush( p_demux );
+
     const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
@@ -2124,6 +2319,10 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Skip the packets parsed in place before moving the stream */
+    ReadTSBatchFlush( p_demux );
+
     const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
@@ -2198,14 +2397,14 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
         es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR, p_pmt->i_number, FROM_SCALE(i_pcr) );
         /* growing files/named fifo handling */
         if( p_sys->b_access_control == false &&
-            vlc_stream_Tell( p_sys->stream ) > p_pmt->i_last_dts_byte )
+            TSStreamTell( p_sys ) > p_pmt->i_last_dts_byte )
         {
             if( p_pmt->i_last_dts_byte == 0 ) /* first run */
                 p_pmt->i_last_dts_byte = stream_Size( p_sys->stream );
             else
             {
                 p_pmt->i_last_dts = i_pcr;
-                p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+                p_pmt->i_last_dts_byte = TSStreamTell( p_sys );
             }
         }
     }
@@ -2296,6 +2495,91 @@ static void PCRCheckDTS( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr)
     }
 }
 
+/* Offset of the last packet read */
+static uint64_t TSPacketOffset( demux_sys_t *p_sys )
+{
+    return TSStreamTell( p_sys ) - p_sys->i_packet_size;
+}
+
+/* Only the first selected program is indexed, as in Control() */
+static const ts_pmt_t * IndexedProgram( demux_sys_t *p_sys )
+{
+    const ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
+    for( int i=0; i<p_pat->programs.i_size; i++ )
+    {
+        if( p_pat->programs.p_elems[i]->u.p_pmt->b_selected )
+            return p_pat->programs.p_elems[i]->u.p_pmt;
+    }
+    return NULL;
+}
+
+static void IndexSetProgram( demux_sys_t *p_sys, const ts_pmt_t *p_pmt )
+{
+    uint16_t rap_pids[TS_INDEX_MAX_RAP_PIDS];
+    size_t i_rap_pids = 0;
+
+    for( int i=0; i<p_pmt->e_streams.i_size && i_rap_pids < TS_INDEX_MAX_RAP_PIDS; i++ )
+    {
+        const ts_pid_t *p_pid = p_pmt->e_streams.p_elems[i];
+        if( p_pid->type == TYPE_STREAM &&
+            p_pid->u.p_stream->p_es->fmt.i_cat == VIDEO_ES )
+            rap_pids[i_rap_pids++] = p_pid->i_pid;
+    }
+
+    ts_index_SetProgram( p_sys->index.p_index, p_pmt->i_pid_pcr,
+                         p_pmt->pcr.i_first, rap_pids, i_rap_pids );
+}
+
+static void IndexPCR( demux_t *p_demux, const ts_pmt_t *p_pmt, mtime_t i_pcr )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_pmt->pcr.i_first == -1 || IndexedProgram( p_sys ) != p_pmt )
+        return;
+
+    IndexSetProgram( p_sys, p_pmt );
+    ts_index_Add( p_sys->index.p_index, p_pmt->i_pid_pcr,
+                  TSPacketOffset( p_sys ), i_pcr, false );
+    p_sys->index.i_pcr = i_pcr;
+}
+
+/* Indexes a packet flagged as random access point, with the last PCR */
+static void IndexRandomAccess( demux_t *p_demux, const ts_pid_t *p_pid )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const ts_es_t *p_es = p_pid->u.p_stream->p_es;
+
+    if( p_es->fmt.i_cat != VIDEO_ES || p_es->p_program == NULL ||
+        IndexedProgram( p_sys ) != p_es->p_program )
+        return;
+
+    ts_index_Add( p_sys->index.p_index, p_es->p_program->i_pid_pcr,
+                  TSPacketOffset( p_sys ), p_sys->index.i_pcr, true );
+}
+
+bool ProbeEndFromIndex( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    int64_t i_pcr;
+    uint64_t i_offset;
+
+    if( !p_sys->index.p_index || p_pmt->pcr.i_first == -1 ||
+        p_pmt->i_pid_pcr == 0x1FFF )
+        return false;
+
+    /* Programs are not selected yet: index the first one for now */
+    if( ts_index_GetPCRPID( p_sys->index.p_index ) == 0x1FFF )
+        IndexSetProgram( p_sys, p_pmt );
+
+    if( !ts_index_GetEnd( p_sys->index.p_index, p_pmt->i_pid_pcr,
+                          p_pmt->pcr.i_first, &i_pcr, &i_offset ) )
+        return false;
+
+    p_pmt->i_last_dts = i_pcr;
+    p_pmt->i_last_dts_byte = i_offset;
+    return true;
+}
+
 static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
@@ -2333,6 +2617,8 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
                 /* We've found a target group for update */
                 PCRCheckDTS( p_demux, p_pmt, i_pcr );
                 ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                if( p_sys->index.p_index )
+                    IndexPCR( p_demux, p_pmt, i_program_pcr );
             }
         }
 
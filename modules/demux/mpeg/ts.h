@@ -60,6 +60,24 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Batched ingest: packets are parsed in place from a peeked window,
+     * and only copied once they reach PES/sections gathering */
+    struct
+    {
+        unsigned       i_packets; /* window size in packets, 0 if disabled */
+        stream_t      *stream;    /* stream the window was peeked from */
+        const uint8_t *p_data;
+        size_t         i_data;
+        size_t         i_pos;     /* consumed bytes, skipped on flush */
+    } batch;
+
+    /* Seek index of the first selected program */
+    struct
+    {
+        struct ts_index_t *p_index; /* NULL if disabled */
+        int64_t     i_pcr;          /* last indexed PCR, -1 after seeking */
+    } index;
+
     bool        b_cc_check;
     bool        b_ignore_time_for_positions;
 
@@ -140,6 +158,7 @@ void UpdatePESFilters( demux_t *p_demux, bool b_all );
 
 int ProbeStart( demux_t *p_demux, int i_program );
 int ProbeEnd( demux_t *p_demux, int i_program );
+bool ProbeEndFromIndex( demux_t *p_demux, ts_pmt_t *p_pmt );
 
 void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool b_create_delayed );
 int FindPCRCandidate( ts_pmt_t *p_pmt );
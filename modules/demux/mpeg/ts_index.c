@@ -0,0 +1,648 @@
+/*****************************************************************************
+ * ts_index.c : MPEG-TS PCR/random access point seek index
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_interrupt.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+
+#include <errno.h>
+#include <assert.h>
+
+#include "timestamps.h"
+#include "ts_index.h"
+
+/* All in 90kHz units */
+#define INDEX_SPACING     90000  /* between two non random access entries */
+#define INDEX_TOLERANCE   45000  /* max distance of a non random access hit */
+#define INDEX_RAP_WINDOW 450000  /* max distance of a random access hit */
+
+#define INDEX_MAX_ENTRIES (1 << 20)
+
+#define SCAN_PROBES      8192
+#define SCAN_MIN_STEP    (1 << 20)
+#define SCAN_MAX_READ    (1 << 20)
+
+#define CACHE_MAGIC       "VLCTSIX1"
+#define CACHE_HEADER_SIZE 56
+#define CACHE_ENTRY_SIZE  16
+
+typedef struct
+{
+    uint64_t i_offset;
+    int64_t  i_pcr;
+    bool     b_rap;
+} ts_index_entry_t;
+
+struct ts_index_t
+{
+    vlc_object_t *p_obj;
+    vlc_mutex_t   lock;
+
+    char         *psz_url;
+    uint64_t      i_size;
+    unsigned      i_packet_size;
+    unsigned      i_header_size;
+    bool          b_cache;
+
+    /* Indexed program */
+    uint16_t      i_pcr_pid;
+    int64_t       i_first_pcr;
+    uint16_t      rap_pids[TS_INDEX_MAX_RAP_PIDS];
+    size_t        i_rap_pids;
+
+    ts_index_entry_t *p_entries;
+    size_t        i_entries;
+    size_t        i_alloc;
+    bool          b_dirty;
+
+    /* Set once the whole file has been scanned */
+    bool          b_complete;
+    int64_t       i_end_pcr;
+    uint64_t      i_end_offset;
+
+    struct
+    {
+        bool             b_enabled;
+        bool             b_started;
+        vlc_thread_t     thread;
+        vlc_interrupt_t *interrupt;
+    } scan;
+};
+
+/* Returns the index of the first entry at or after that offset */
+static size_t FindOffset( const ts_index_t *p_index, uint64_t i_offset )
+{
+    size_t lo = 0, hi = p_index->i_entries;
+    while( lo < hi )
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if( p_index->p_entries[mid].i_offset < i_offset )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Returns the index of the first entry after that PCR */
+static size_t FindPCR( const ts_index_t *p_index, int64_t i_pcr )
+{
+    size_t lo = 0, hi = p_index->i_entries;
+    while( lo < hi )
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if( p_index->p_entries[mid].i_pcr <= i_pcr )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void Insert( ts_index_t *p_index, uint64_t i_offset,
+                    int64_t i_pcr, bool b_rap )
+{
+    size_t i_pos = FindOffset( p_index, i_offset );
+    ts_index_entry_t *p_next = ( i_pos < p_index->i_entries ) ?
+                               &p_index->p_entries[i_pos] : NULL;
+    ts_index_entry_t *p_prev = ( i_pos > 0 ) ?
+                               &p_index->p_entries[i_pos - 1] : NULL;
+
+    if( p_next && p_next->i_offset == i_offset )
+    {
+        if( b_rap && !p_next->b_rap && p_next->i_pcr == i_pcr )
+        {
+            p_next->b_rap = true;
+            p_index->b_dirty = true;
+        }
+        return;
+    }
+
+    /* Timestamps must increase with offsets, or lookups are meaningless
+     * (discontinuities, or more than one wrap around) */
+    if( (p_prev && p_prev->i_pcr > i_pcr) || (p_next && p_next->i_pcr < i_pcr) )
+        return;
+
+    if( !b_rap && p_prev && i_pcr - p_prev->i_pcr < INDEX_SPACING )
+        return;
+
+    if( p_index->i_entries == p_index->i_alloc )
+    {
+        if( p_index->i_alloc >= INDEX_MAX_ENTRIES )
+            return;
+        size_t i_alloc = p_index->i_alloc ? p_index->i_alloc * 2 : 256;
+        ts_index_entry_t *p_realloc = realloc( p_index->p_entries,
+                                               i_alloc * sizeof(*p_realloc) );
+        if( unlikely(!p_realloc) )
+            return;
+        p_index->p_entries = p_realloc;
+        p_index->i_alloc = i_alloc;
+    }
+
+    memmove( &p_index->p_entries[i_pos + 1], &p_index->p_entries[i_pos],
+             (p_index->i_entries - i_pos) * sizeof(*p_index->p_entries) );
+    p_index->p_entries[i_pos].i_offset = i_offset;
+    p_index->p_entries[i_pos].i_pcr = i_pcr;
+    p_index->p_entries[i_pos].b_rap = b_rap;
+    p_index->i_entries++;
+    p_index->b_dirty = true;
+}
+
+/*****************************************************************************
+ * Cache
+ *****************************************************************************/
+static char *CacheDir( void )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cachedir == NULL )
+        return NULL;
+
+    char *psz_dir;
+    if( asprintf( &psz_dir, "%s"DIR_SEP"ts-index", psz_cachedir ) == -1 )
+        psz_dir = NULL;
+    free( psz_cachedir );
+    return psz_dir;
+}
+
+static char *CachePath( const ts_index_t *p_index, const char *psz_dir )
+{
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, p_index->psz_url, strlen( p_index->psz_url ) );
+    EndMD5( &md5 );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    if( psz_hash == NULL )
+        return NULL;
+
+    char *psz_path;
+    if( asprintf( &psz_path, "%s"DIR_SEP"%s.idx", psz_dir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_hash );
+    return psz_path;
+}
+
+static void CacheLoad( ts_index_t *p_index )
+{
+    char *psz_dir = CacheDir();
+    char *psz_path = psz_dir ? CachePath( p_index, psz_dir ) : NULL;
+    free( psz_dir );
+    if( psz_path == NULL )
+        return;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( p_file == NULL )
+    {
+        free( psz_path );
+        return;
+    }
+
+    uint8_t header[CACHE_HEADER_SIZE];
+    if( fread( header, 1, sizeof(header), p_file ) != sizeof(header) ||
+        memcmp( header, CACHE_MAGIC, 8 ) ||
+        GetQWBE( &header[8] ) != p_index->i_size ||
+        (int64_t) GetQWBE( &header[16] ) != p_index->i_first_pcr ||
+        GetWBE( &header[40] ) != p_index->i_pcr_pid ||
+        GetWBE( &header[42] ) != p_index->i_packet_size )
+        goto end;
+
+    uint32_t i_count = GetDWBE( &header[48] );
+    if( i_count > INDEX_MAX_ENTRIES )
+        goto end;
+
+    ts_index_entry_t *p_entries = malloc( i_count * sizeof(*p_entries) );
+    if( i_count && unlikely(p_entries == NULL) )
+        goto end;
+
+    for( uint32_t i = 0; i < i_count; i++ )
+    {
+        uint8_t entry[CACHE_ENTRY_SIZE];
+        if( fread( entry, 1, sizeof(entry), p_file ) != sizeof(entry) )
+        {
+            free( p_entries );
+            goto end;
+        }
+        uint64_t i_pcr = GetQWBE( &entry[8] );
+        p_entries[i].i_offset = GetQWBE( entry );
+        p_entries[i].i_pcr = i_pcr & ~(UINT64_C(1) << 63);
+        p_entries[i].b_rap = i_pcr >> 63;
+    }
+
+    free( p_index->p_entries );
+    p_index->p_entries = p_entries;
+    p_index->i_entries = p_index->i_alloc = i_count;
+    p_index->b_dirty = false;
+    p_index->b_complete = GetDWBE( &header[44] ) & 1;
+    p_index->i_end_pcr = GetQWBE( &header[24] );
+    p_index->i_end_offset = GetQWBE( &header[32] );
+
+    msg_Dbg( p_index->p_obj, "loaded %"PRIu32" index entries from %s",
+             i_count, psz_path );
+end:
+    fclose( p_file );
+    free( psz_path );
+}
+
+static void CacheSave( ts_index_t *p_index )
+{
+    char *psz_dir = CacheDir();
+    if( psz_dir == NULL )
+        return;
+
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cachedir )
+    {
+        vlc_mkdir( psz_cachedir, 0700 );
+        free( psz_cachedir );
+    }
+    if( vlc_mkdir( psz_dir, 0700 ) && errno != EEXIST )
+    {
+        free( psz_dir );
+        return;
+    }
+
+    char *psz_path = CachePath( p_index, psz_dir );
+    free( psz_dir );
+    if( psz_path == NULL )
+        return;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", psz_path ) == -1 )
+    {
+        free( psz_path );
+        return;
+    }
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( p_file == NULL )
+        goto error;
+
+    uint8_t header[CACHE_HEADER_SIZE] = { 0 };
+    memcpy( header, CACHE_MAGIC, 8 );
+    SetQWBE( &header[8], p_index->i_size );
+    SetQWBE( &header[16], p_index->i_first_pcr );
+    SetQWBE( &header[24], p_index->i_end_pcr );
+    SetQWBE( &header[32], p_index->i_end_offset );
+    SetWBE( &header[40], p_index->i_pcr_pid );
+    SetWBE( &header[42], p_index->i_packet_size );
+    SetDWBE( &header[44], p_index->b_complete ? 1 : 0 );
+    SetDWBE( &header[48], p_index->i_entries );
+
+    bool b_error = fwrite( header, 1, sizeof(header), p_file ) != sizeof(header);
+    for( size_t i = 0; i < p_index->i_entries && !b_error; i++ )
+    {
+        const ts_index_entry_t *p_entry = &p_index->p_entries[i];
+        uint8_t entry[CACHE_ENTRY_SIZE];
+
+        SetQWBE( entry, p_entry->i_offset );
+        SetQWBE( &entry[8], p_entry->i_pcr |
+                 ((uint64_t) p_entry->b_rap << 63) );
+        b_error = fwrite( entry, 1, sizeof(entry), p_file ) != sizeof(entry);
+    }
+
+    if( fclose( p_file ) || b_error || vlc_rename( psz_tmp, psz_path ) )
+    {
+        vlc_unlink( psz_tmp );
+        goto error;
+    }
+
+    msg_Dbg( p_index->p_obj, "saved %zu index entries to %s",
+             p_index->i_entries, psz_path );
+error:
+    free( psz_tmp );
+    free( psz_path );
+}
+
+/*****************************************************************************
+ * Background scan
+ *****************************************************************************/
+static bool ScanSync( stream_t *s, unsigned i_size, unsigned i_header )
+{
+    const uint8_t *p_peek;
+    if( vlc_stream_Peek( s, &p_peek, i_size * 3 ) < (ssize_t) i_size * 3 )
+        return false;
+
+    for( unsigned i = 0; i < i_size; i++ )
+    {
+        if( p_peek[i + i_header] == 0x47 &&
+            p_peek[i + i_header + i_size] == 0x47 &&
+            p_peek[i + i_header + 2 * i_size] == 0x47 )
+            return vlc_stream_Read( s, NULL, i ) == i;
+    }
+    return false;
+}
+
+/* Reads packets from the current position, until a PCR and a random access
+ * point have been indexed, or until the end if b_to_end is set */
+static void ScanProbe( ts_index_t *p_index, stream_t *s, uint16_t i_pcr_pid,
+                       int64_t i_first_pcr, const uint16_t *pi_rap_pids,
+                       size_t i_rap_pids, bool b_to_end )
+{
+    const unsigned i_size = p_index->i_packet_size;
+    const unsigned i_header = p_index->i_header_size;
+    uint64_t i_start = vlc_stream_Tell( s );
+    int64_t i_pcr = -1;
+    uint64_t i_pcr_offset = 0;
+    bool b_rap = i_rap_pids == 0;
+
+    if( !ScanSync( s, i_size, i_header ) )
+        return;
+
+    for( ;; )
+    {
+        uint64_t i_offset = vlc_stream_Tell( s );
+        const uint8_t *p;
+
+        if( !b_to_end && i_offset - i_start > SCAN_MAX_READ )
+            break;
+        if( vlc_stream_Peek( s, &p, i_size ) < (ssize_t) i_size )
+            break;
+        p += i_header;
+
+        if( p[0] != 0x47 )
+        {
+            if( !ScanSync( s, i_size, i_header ) )
+                break;
+            continue;
+        }
+
+        const uint16_t i_pid = ((p[1] & 0x1f) << 8) | p[2];
+        const bool b_adaptation = (p[3] & 0x20) && p[4] > 0;
+
+        if( (p[1] & 0x80) == 0 && b_adaptation )
+        {
+            if( i_pid == i_pcr_pid && p[4] >= 7 && (p[5] & 0x10) )
+            {
+                i_pcr = ((int64_t)p[6] << 25) | (p[7] << 17) | (p[8] << 9) |
+                        (p[9] << 1) | (p[10] >> 7);
+                i_pcr = TimeStampWrapAround( i_first_pcr, i_pcr );
+                i_pcr_offset = i_offset;
+                ts_index_Add( p_index, i_pcr_pid, i_offset, i_pcr, false );
+            }
+
+            if( (p[5] & 0x40) && i_pcr > -1 )
+            {
+                for( size_t i = 0; i < i_rap_pids; i++ )
+                {
+                    if( pi_rap_pids[i] == i_pid )
+                    {
+                        ts_index_Add( p_index, i_pcr_pid, i_offset, i_pcr, true );
+                        b_rap = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        vlc_stream_Read( s, NULL, i_size );
+
+        if( !b_to_end && i_pcr > -1 && b_rap )
+            break;
+    }
+
+    if( b_to_end && i_pcr > -1 )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        if( p_index->i_pcr_pid == i_pcr_pid )
+        {
+            p_index->b_complete = true;
+            p_index->i_end_pcr = i_pcr;
+            p_index->i_end_offset = i_pcr_offset;
+            p_index->b_dirty = true;
+        }
+        vlc_mutex_unlock( &p_index->lock );
+    }
+}
+
+static void *ScanThread( void *data )
+{
+    ts_index_t *p_index = data;
+    uint16_t rap_pids[TS_INDEX_MAX_RAP_PIDS];
+
+    vlc_interrupt_set( p_index->scan.interrupt );
+
+    vlc_mutex_lock( &p_index->lock );
+    const uint16_t i_pcr_pid = p_index->i_pcr_pid;
+    const int64_t i_first_pcr = p_index->i_first_pcr;
+    const size_t i_rap_pids = p_index->i_rap_pids;
+    const bool b_complete = p_index->b_complete;
+    memcpy( rap_pids, p_index->rap_pids, sizeof(rap_pids) );
+    vlc_mutex_unlock( &p_index->lock );
+
+    if( b_complete )
+        return NULL;
+
+    stream_t *s = vlc_stream_NewURL( p_index->p_obj, p_index->psz_url );
+    if( s == NULL )
+        return NULL;
+
+    const mtime_t i_start = mdate();
+    uint64_t i_step = p_index->i_size / SCAN_PROBES;
+    if( i_step < SCAN_MIN_STEP )
+        i_step = SCAN_MIN_STEP;
+    i_step -= i_step % p_index->i_packet_size;
+
+    const uint64_t i_last = ( p_index->i_size > SCAN_MAX_READ ) ?
+                            p_index->i_size - SCAN_MAX_READ : 0;
+    uint64_t i_pos;
+    for( i_pos = 0; i_pos < i_last && !vlc_killed(); i_pos += i_step )
+    {
+        if( vlc_stream_Seek( s, i_pos ) )
+            break;
+        ScanProbe( p_index, s, i_pcr_pid, i_first_pcr,
+                   rap_pids, i_rap_pids, false );
+    }
+
+    if( i_pos >= i_last && !vlc_killed() &&
+        vlc_stream_Seek( s, i_last - i_last % p_index->i_packet_size ) == 0 )
+    {
+        ScanProbe( p_index, s, i_pcr_pid, i_first_pcr,
+                   rap_pids, i_rap_pids, true );
+        msg_Dbg( p_index->p_obj, "index scan done in %"PRId64" ms",
+                 (mdate() - i_start) / 1000 );
+    }
+
+    vlc_stream_Delete( s );
+    return NULL;
+}
+
+/*****************************************************************************
+ *
+ *****************************************************************************/
+ts_index_t *ts_index_New( vlc_object_t *p_obj, const char *psz_url, uint64_t i_size,
+                          unsigned i_packet_size, unsigned i_header_size,
+                          bool b_scan, bool b_cache )
+{
+    ts_index_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return NULL;
+
+    p_index->psz_url = psz_url ? strdup( psz_url ) : NULL;
+    p_index->p_obj = p_obj;
+    p_index->i_size = i_size;
+    p_index->i_packet_size = i_packet_size;
+    p_index->i_header_size = i_header_size;
+    p_index->b_cache = b_cache && p_index->psz_url;
+    p_index->i_pcr_pid = 0x1FFF;
+    p_index->i_first_pcr = -1;
+    p_index->scan.b_enabled = b_scan && p_index->psz_url;
+    vlc_mutex_init( &p_index->lock );
+    return p_index;
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    if( p_index->scan.b_started )
+    {
+        vlc_interrupt_kill( p_index->scan.interrupt );
+        vlc_join( p_index->scan.thread, NULL );
+    }
+    if( p_index->scan.interrupt )
+        vlc_interrupt_destroy( p_index->scan.interrupt );
+
+    if( p_index->b_cache && p_index->b_dirty && p_index->i_entries > 1 )
+        CacheSave( p_index );
+
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index->p_entries );
+    free( p_index->psz_url );
+    free( p_index );
+}
+
+void ts_index_SetProgram( ts_index_t *p_index, uint16_t i_pcr_pid, int64_t i_first_pcr,
+                          const uint16_t *pi_rap_pids, size_t i_rap_pids )
+{
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->i_pcr_pid == i_pcr_pid && p_index->i_first_pcr == i_first_pcr )
+    {
+        vlc_mutex_unlock( &p_index->lock );
+        return;
+    }
+
+    p_index->i_pcr_pid = i_pcr_pid;
+    p_index->i_first_pcr = i_first_pcr;
+    p_index->i_rap_pids = __MIN( i_rap_pids, TS_INDEX_MAX_RAP_PIDS );
+    for( size_t i = 0; i < p_index->i_rap_pids; i++ )
+        p_index->rap_pids[i] = pi_rap_pids[i];
+    p_index->i_entries = 0;
+    p_index->b_dirty = false;
+    p_index->b_complete = false;
+
+    if( p_index->b_cache )
+        CacheLoad( p_index );
+    vlc_mutex_unlock( &p_index->lock );
+
+    /* Only the first indexed program is scanned */
+    if( p_index->scan.b_enabled && !p_index->scan.b_started )
+    {
+        p_index->scan.interrupt = vlc_interrupt_create();
+        if( p_index->scan.interrupt &&
+            !vlc_clone( &p_index->scan.thread, ScanThread, p_index,
+                        VLC_THREAD_PRIORITY_LOW ) )
+            p_index->scan.b_started = true;
+        p_index->scan.b_enabled = false;
+    }
+}
+
+uint16_t ts_index_GetPCRPID( ts_index_t *p_index )
+{
+    vlc_mutex_lock( &p_index->lock );
+    uint16_t i_pcr_pid = p_index->i_pcr_pid;
+    vlc_mutex_unlock( &p_index->lock );
+    return i_pcr_pid;
+}
+
+void ts_index_Add( ts_index_t *p_index, uint16_t i_pcr_pid, uint64_t i_offset,
+                   int64_t i_pcr, bool b_rap )
+{
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->i_pcr_pid == i_pcr_pid && i_offset < p_index->i_size )
+        Insert( p_index, i_offset, i_pcr, b_rap );
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+bool ts_index_Lookup( ts_index_t *p_index, uint16_t i_pcr_pid, int64_t i_pcr,
+                      uint64_t *pi_offset, uint64_t *pi_head, uint64_t *pi_tail )
+{
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->i_pcr_pid != i_pcr_pid || p_index->i_entries == 0 )
+        goto end;
+
+    const ts_index_entry_t *p_entries = p_index->p_entries;
+    size_t i_next = FindPCR( p_index, i_pcr );
+
+    if( i_next > 0 )
+    {
+        const ts_index_entry_t *p_prev = &p_entries[i_next - 1];
+
+        /* Prefer starting from a random access point */
+        for( size_t i = i_next; i > 0; i-- )
+        {
+            if( i_pcr - p_entries[i - 1].i_pcr > INDEX_RAP_WINDOW )
+                break;
+            if( p_entries[i - 1].b_rap )
+            {
+                *pi_offset = p_entries[i - 1].i_offset;
+                b_found = true;
+                goto end;
+            }
+        }
+
+        if( i_pcr - p_prev->i_pcr <= INDEX_TOLERANCE )
+        {
+            *pi_offset = p_prev->i_offset;
+            b_found = true;
+            goto end;
+        }
+
+        if( p_prev->i_offset > *pi_head )
+            *pi_head = p_prev->i_offset;
+    }
+
+    if( i_next < p_index->i_entries && p_entries[i_next].i_offset < *pi_tail )
+        *pi_tail = p_entries[i_next].i_offset;
+end:
+    vlc_mutex_unlock( &p_index->lock );
+    return b_found;
+}
+
+bool ts_index_GetEnd( ts_index_t *p_index, uint16_t i_pcr_pid, int64_t i_first_pcr,
+                      int64_t *pi_pcr, uint64_t *pi_offset )
+{
+    bool b_complete;
+
+    vlc_mutex_lock( &p_index->lock );
+    b_complete = p_index->b_complete && p_index->i_pcr_pid == i_pcr_pid &&
+                 p_index->i_first_pcr == i_first_pcr;
+    if( b_complete )
+    {
+        *pi_pcr = p_index->i_end_pcr;
+        *pi_offset = p_index->i_end_offset;
+    }
+    vlc_mutex_unlock( &p_index->lock );
+    return b_complete;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * ts_index.h : MPEG-TS PCR/random access point seek index
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Entries map a byte offset to the (wrapped around) PCR of the indexed
+ * program, in 90kHz units. Random access points are the packets flagged
+ * with random_access_indicator on a video ES. */
+
+#define TS_INDEX_MAX_RAP_PIDS 8
+
+typedef struct ts_index_t ts_index_t;
+
+ts_index_t *ts_index_New( vlc_object_t *, const char *psz_url, uint64_t i_size,
+                          unsigned i_packet_size, unsigned i_header_size,
+                          bool b_scan, bool b_cache );
+void ts_index_Delete( ts_index_t * );
+
+/* Selects the indexed program. Entries of any other program are dropped,
+ * and matching entries are loaded from the cache. */
+void ts_index_SetProgram( ts_index_t *, uint16_t i_pcr_pid, int64_t i_first_pcr,
+                          const uint16_t *pi_rap_pids, size_t i_rap_pids );
+
+/* Returns the PCR PID of the indexed program, 0x1FFF if none */
+uint16_t ts_index_GetPCRPID( ts_index_t * );
+
+void ts_index_Add( ts_index_t *, uint16_t i_pcr_pid, uint64_t i_offset,
+                   int64_t i_pcr, bool b_rap );
+
+/* Returns true and the offset to seek to if the index covers that time.
+ * Otherwise, narrows down the [head, tail] range of the binary search. */
+bool ts_index_Lookup( ts_index_t *, uint16_t i_pcr_pid, int64_t i_pcr,
+                      uint64_t *pi_offset, uint64_t *pi_head, uint64_t *pi_tail );
+
+/* Returns the last PCR and its offset, if the whole file has been indexed */
+bool ts_index_GetEnd( ts_index_t *, uint16_t i_pcr_pid, int64_t i_first_pcr,
+                      int64_t *pi_pcr, uint64_t *pi_offset );
+
+#endif
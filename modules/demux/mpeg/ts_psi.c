@@ -2025,7 +2025,8 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     {
         p_pmt->i_last_dts = 0;
         ProbeStart( p_demux, p_pmt->i_number );
-        ProbeEnd( p_demux, p_pmt->i_number );
+        if( !ProbeEndFromIndex( p_demux, p_pmt ) )
+            ProbeEnd( p_demux, p_pmt->i_number );
     }
 
     dvbpsi_pmt_delete( p_dvbpsipmt );
@@ -49,6 +49,7 @@ vlc_module_begin ()
     set_description( N_("NullSoft demuxer" ) )
     set_capability( "demux", 10 )
     set_category( CAT_INPUT )
+    set_probe_signatures( "0:4e535666 0:4e535673" ) /* "NSVf", "NSVs" */
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_callbacks( Open, Close )
     add_shortcut( "nsv" )
@@ -50,6 +50,7 @@ vlc_module_begin ()
     set_description( N_("Nuv demuxer") )
     set_capability( "demux", 145 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:4d7974685456566964656f 0:4e757070656c566964656f" )
     add_shortcut( "nuv" )
 vlc_module_end ()
 
@@ -59,6 +59,8 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 50 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:4f676753" ) /* "OggS" */
+    set_probe_mime_types( "application/ogg,video/ogg,audio/ogg" )
     add_shortcut( "ogg" )
 vlc_module_end ()
 
@@ -43,6 +43,7 @@ vlc_module_begin ()
     set_description( N_("PVA demuxer" ) )
     set_capability( "demux", 10 )
     set_category( CAT_INPUT )
+    set_probe_signatures( "0:4156" ) /* "AV" */
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_callbacks( Open, Close )
     add_shortcut( "pva" )
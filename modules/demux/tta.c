@@ -49,6 +49,7 @@ vlc_module_begin ()
     set_capability( "demux", 145 )
 
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:54544131" ) /* "TTA1" */
     add_shortcut( "tta" )
 vlc_module_end ()
 
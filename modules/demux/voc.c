@@ -45,6 +45,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "0:437265617469766520566f6963652046696c651a" )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -54,6 +54,7 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_DEMUX )
     set_capability( "demux", 142 )
     set_callbacks( Open, Close )
+    set_probe_signatures( "8:57415645" ) /* "WAVE" */
 vlc_module_end ()
 
 /*****************************************************************************
@@ -52,6 +52,12 @@
     "Create \"Fast Start\" files. " \
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
+#define MOOVRESERVE_TEXT N_("Reserved header space (KiB)")
+#define MOOVRESERVE_LONGTEXT N_(\
+    "Space to reserve at the start of \"Fast Start\" files for the index, " \
+    "so that the media data need not be moved when the file is closed. " \
+    "The index takes about 10 to 20 bytes per audio or video frame. " \
+    "If it does not fit, the media data is moved as without reservation.")
 
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
@@ -69,6 +75,9 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer(SOUT_CFG_PREFIX "moov-reserve", 0,
+                MOOVRESERVE_TEXT, MOOVRESERVE_LONGTEXT, true)
+        change_integer_range(0, 1 << 20)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -88,7 +97,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "moov-reserve", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -163,6 +172,7 @@ struct sout_mux_sys_t
 
     uint64_t i_mdat_pos;
     uint64_t i_pos;
+    uint64_t i_moov_reserve; /* space before mdat for the moov box */
     mtime_t  i_read_duration;
     mtime_t  i_start_dts;
 
@@ -209,6 +219,21 @@ static int WriteSlowStartHeader(sout_mux_t *p_mux)
         box_send(p_mux, box);
     }
 
+    if (p_sys->i_moov_reserve > 0) {
+        /* Placeholder, overwritten by the moov box on close */
+        block_t *p_free = block_Alloc(p_sys->i_moov_reserve);
+        if (!p_free)
+            return VLC_ENOMEM;
+
+        memset(p_free->p_buffer, 0, p_free->i_buffer);
+        SetDWBE(p_free->p_buffer, p_free->i_buffer);
+        memcpy(p_free->p_buffer + 4, "free", 4);
+
+        p_sys->i_pos += p_free->i_buffer;
+        p_sys->i_mdat_pos = p_sys->i_pos;
+        sout_AccessOutWrite(p_mux->p_access, p_free);
+    }
+
     /* Now add mdat header */
     box = box_new("mdat");
     if(!box)
@@ -252,6 +277,10 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->b_fragmented = false;
     p_sys->b_header_sent = false;
+    p_sys->i_moov_reserve = 0;
+    if (var_GetBool(p_this, SOUT_CFG_PREFIX "faststart"))
+        p_sys->i_moov_reserve =
+            1024 * var_GetInteger(p_this, SOUT_CFG_PREFIX "moov-reserve");
 
     /* FIXME FIXME
      * Quicktime actually doesn't like the 64 bits extensions !!! */
@@ -260,6 +289,32 @@ static int Open(vlc_object_t *p_this)
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * MoveData: move a range of the output further, from its end, in large chunks
+ *****************************************************************************/
+#define MOVE_CHUNK_SIZE (4 << 20)
+
+static int MoveData(sout_mux_t *p_mux, uint64_t i_pos, uint64_t i_size,
+                    uint64_t i_shift)
+{
+    while (i_size > 0) {
+        size_t i_chunk = __MIN(MOVE_CHUNK_SIZE, i_size);
+        block_t *p_buf = block_Alloc(i_chunk);
+        if (!p_buf)
+            return VLC_ENOMEM;
+
+        sout_AccessOutSeek(p_mux->p_access, i_pos + i_size - i_chunk);
+        if (sout_AccessOutRead(p_mux->p_access, p_buf) < (ssize_t)i_chunk) {
+            block_Release(p_buf);
+            return VLC_EGENERIC;
+        }
+        sout_AccessOutSeek(p_mux->p_access, i_pos + i_size + i_shift - i_chunk);
+        sout_AccessOutWrite(p_mux->p_access, p_buf);
+        i_size -= i_chunk;
+    }
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * Close:
  *****************************************************************************/
@@ -296,47 +351,51 @@ static void Close(vlc_object_t *p_this)
 
     /* Check we need to create "fast start" files */
     p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    uint64_t i_free_size = 0;
     while (p_sys->b_fast_start && moov && moov->b) {
+        const uint64_t i_reserve = p_sys->i_moov_reserve;
+        const uint64_t i_moov_size = moov->b->i_buffer;
+        uint64_t i_shift;
+
+        /* The moov box takes the reserved space. Any slack left must be
+         * large enough for a free box. */
+        if (i_moov_size == i_reserve || i_moov_size + 8 <= i_reserve)
+            i_shift = 0;
+        else if (i_moov_size > i_reserve)
+            i_shift = i_moov_size - i_reserve;
+        else
+            i_shift = i_moov_size + 8 - i_reserve;
+
+        if (i_reserve > 0 && i_shift > 0)
+            msg_Warn(p_this, "moov box (%"PRIu64" bytes) exceeds reserved "
+                     "space (%"PRIu64" bytes)", i_moov_size, i_reserve);
+
         /* Move data to the end of the file so we can fit the moov header
          * at the start */
-        int64_t i_size = p_sys->i_pos - p_sys->i_mdat_pos;
-        int i_moov_size = moov->b->i_buffer;
-
-        while (i_size > 0) {
-            int64_t i_chunk = __MIN(32768, i_size);
-            block_t *p_buf = block_Alloc(i_chunk);
-            sout_AccessOutSeek(p_mux->p_access,
-                                p_sys->i_mdat_pos + i_size - i_chunk);
-            if (sout_AccessOutRead(p_mux->p_access, p_buf) < i_chunk) {
-                msg_Warn(p_this, "read() not supported by access output, "
-                          "won't create a fast start file");
-                p_sys->b_fast_start = false;
-                block_Release(p_buf);
-                break;
-            }
-            sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_size +
-                                i_moov_size - i_chunk);
-            sout_AccessOutWrite(p_mux->p_access, p_buf);
-            i_size -= i_chunk;
-        }
-
-        if (!p_sys->b_fast_start)
+        if (i_shift > 0 &&
+            MoveData(p_mux, p_sys->i_mdat_pos,
+                     p_sys->i_pos - p_sys->i_mdat_pos, i_shift)) {
+            msg_Warn(p_this, "read() not supported by access output, "
+                      "won't create a fast start file");
+            p_sys->b_fast_start = false;
             break;
+        }
 
         /* Update pos pointers */
-        i_moov_pos = p_sys->i_mdat_pos;
-        p_sys->i_mdat_pos += moov->b->i_buffer;
+        i_moov_pos = p_sys->i_mdat_pos - i_reserve;
+        p_sys->i_mdat_pos += i_shift;
+        i_free_size = i_reserve + i_shift - i_moov_size;
 
         /* Fix-up samples to chunks table in MOOV header */
-        for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        for (unsigned int i_trak = 0; i_shift > 0 && i_trak < p_sys->i_nb_streams; i_trak++) {
             mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
             unsigned i_written = 0;
             for (unsigned i = 0; i < p_stream->mux.i_entry_count; ) {
                 mp4mux_entry_t *entry = p_stream->mux.entry;
                 if (b_stco64)
-                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + i_shift);
                 else
-                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + i_shift);
 
                 for (; i < p_stream->mux.i_entry_count; i++)
                     if (i >= p_stream->mux.i_entry_count - 1 ||
@@ -355,6 +414,16 @@ static void Close(vlc_object_t *p_this)
     if (moov != NULL)
         box_send(p_mux, moov);
 
+    /* Mark the unused reserved space as free (its payload is zeroes) */
+    if (i_free_size > 0) {
+        block_t *p_free = block_Alloc(8);
+        if (p_free) {
+            SetDWBE(p_free->p_buffer, i_free_size);
+            memcpy(p_free->p_buffer + 4, "free", 4);
+            sout_AccessOutWrite(p_mux->p_access, p_free);
+        }
+    }
+
 cleanup:
     /* Clean-up */
     for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
@@ -27,9 +27,27 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+/* Largest number of packets scrambled at once, and keystream bytes needed
+ * by a packet at most: the first of its 23 blocks seeds the stream cypher */
+#define CSA_BATCH_MAX 256
+#define CSA_KS_SIZE   176
+
+/* Smaller groups of packets go through the scalar code, which is then
+ * faster than a bitsliced pass */
+#define CSA_BATCH_MIN 8
+
+typedef struct
+{
+    uint8_t *pkt;
+    int      i_hdr;
+    int      n;
+    int      i_residue;
+} csa_lane_t;
+
 struct csa_t
 {
     /* odd and even keys */
@@ -47,6 +65,13 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* batch scratch */
+    csa_lane_t lanes[CSA_BATCH_MAX];
+    uint8_t    sb[CSA_BATCH_MAX][8];
+    uint8_t    ks[CSA_BATCH_MAX][CSA_KS_SIZE];
+    uint8_t    ib[CSA_BATCH_MAX][184/8+2][8];
+    uint64_t   blk[CSA_BATCH_MAX];
 };
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
@@ -56,6 +81,15 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static unsigned csa_BatchLanes( void );
+static void csa_StreamBatch( const uint8_t ck[8], unsigned count,
+                             const uint8_t (*sb)[8],
+                             uint8_t (*ks)[CSA_KS_SIZE], unsigned blocks );
+static void csa_BlockDecypherBatch( const uint8_t kk[57], uint64_t *blk,
+                                    unsigned count );
+static void csa_BlockCypherBatch( const uint8_t kk[57], uint64_t *blk,
+                                  unsigned count );
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
@@ -307,6 +341,228 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
 }
 
+/*****************************************************************************
+ * Batches: packets sharing a control word are (de)scrambled together, the
+ * stream cypher being bitsliced over up to 256 packets and the block cypher
+ * interleaved over all of them. Both give the same result as the functions
+ * above, which still handle unscrambled, short and straggling packets.
+ *****************************************************************************/
+static bool csa_LaneInit( csa_lane_t *lane, uint8_t *pkt, int i_pkt_size )
+{
+    if( i_pkt_size > 188 )
+        return false;
+
+    lane->pkt = pkt;
+    lane->i_hdr = 4;
+    if( pkt[3]&0x20 )
+    {
+        /* skip adaption field */
+        lane->i_hdr += pkt[4] + 1;
+    }
+    lane->n = (i_pkt_size - lane->i_hdr) / 8;
+    lane->i_residue = (i_pkt_size - lane->i_hdr) % 8;
+    return lane->n > 0;
+}
+
+static void csa_DecryptLanes( csa_t *c, bool odd, unsigned count,
+                              int i_pkt_size )
+{
+    const uint8_t *ck = odd ? c->o_ck : c->e_ck;
+    const uint8_t *kk = odd ? c->o_kk : c->e_kk;
+    unsigned blocks = 0;
+    int n_max = 0;
+
+    if( count < CSA_BATCH_MIN )
+    {
+        for( unsigned i = 0; i < count; i++ )
+            csa_Decrypt( c, c->lanes[i].pkt, i_pkt_size );
+        return;
+    }
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        const csa_lane_t *lane = &c->lanes[i];
+
+        /* clear transport scrambling control */
+        lane->pkt[3] &= 0x3f;
+        memcpy( c->sb[i], &lane->pkt[lane->i_hdr], 8 );
+        blocks = __MAX( blocks, (unsigned)(lane->n - 1 + (lane->i_residue > 0)) );
+        n_max = __MAX( n_max, lane->n );
+    }
+    csa_StreamBatch( ck, count, (const uint8_t (*)[8])c->sb, c->ks, blocks );
+
+    /* ib[0] is the first block, ib[i] the next ones xored with the stream */
+    for( unsigned i = 0; i < count; i++ )
+    {
+        const csa_lane_t *lane = &c->lanes[i];
+        const uint8_t *p = &lane->pkt[lane->i_hdr];
+
+        memcpy( c->ib[i][0], p, 8 );
+        for( int j = 1; j < lane->n; j++ )
+            for( int k = 0; k < 8; k++ )
+                c->ib[i][j][k] = p[8*j+k] ^ c->ks[i][8*(j-1)+k];
+        memset( c->ib[i][lane->n], 0, 8 );
+    }
+
+    for( int j = 1; j <= n_max; j++ )
+    {
+        unsigned k = 0;
+
+        for( unsigned i = 0; i < count; i++ )
+            if( c->lanes[i].n >= j )
+                c->blk[k++] = GetQWLE( c->ib[i][j-1] );
+
+        csa_BlockDecypherBatch( kk, c->blk, k );
+
+        k = 0;
+        for( unsigned i = 0; i < count; i++ )
+        {
+            const csa_lane_t *lane = &c->lanes[i];
+
+            if( lane->n >= j )
+                SetQWLE( &lane->pkt[lane->i_hdr+8*(j-1)],
+                         c->blk[k++] ^ GetQWLE( c->ib[i][j] ) );
+        }
+    }
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        const csa_lane_t *lane = &c->lanes[i];
+
+        for( int k = 0; k < lane->i_residue; k++ )
+            lane->pkt[i_pkt_size - lane->i_residue + k] ^=
+                c->ks[i][8*(lane->n-1)+k];
+    }
+}
+
+static void csa_EncryptLanes( csa_t *c, unsigned count, int i_pkt_size )
+{
+    const uint8_t *ck = c->use_odd ? c->o_ck : c->e_ck;
+    const uint8_t *kk = c->use_odd ? c->o_kk : c->e_kk;
+    unsigned blocks = 0;
+    int n_max = 0;
+
+    if( count < CSA_BATCH_MIN )
+    {
+        for( unsigned i = 0; i < count; i++ )
+            csa_Encrypt( c, c->lanes[i].pkt, i_pkt_size );
+        return;
+    }
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        const csa_lane_t *lane = &c->lanes[i];
+
+        /* set transport scrambling control */
+        lane->pkt[3] |= c->use_odd ? 0xc0 : 0x80;
+        memset( c->ib[i][lane->n+1], 0, 8 );
+        blocks = __MAX( blocks, (unsigned)(lane->n - 1 + (lane->i_residue > 0)) );
+        n_max = __MAX( n_max, lane->n );
+    }
+
+    /* the block cypher is chained from the last block */
+    for( int j = n_max; j > 0; j-- )
+    {
+        unsigned k = 0;
+
+        for( unsigned i = 0; i < count; i++ )
+        {
+            const csa_lane_t *lane = &c->lanes[i];
+
+            if( lane->n >= j )
+                c->blk[k++] = GetQWLE( &lane->pkt[lane->i_hdr+8*(j-1)] )
+                            ^ GetQWLE( c->ib[i][j+1] );
+        }
+
+        csa_BlockCypherBatch( kk, c->blk, k );
+
+        k = 0;
+        for( unsigned i = 0; i < count; i++ )
+            if( c->lanes[i].n >= j )
+                SetQWLE( c->ib[i][j], c->blk[k++] );
+    }
+
+    for( unsigned i = 0; i < count; i++ )
+        memcpy( c->sb[i], c->ib[i][1], 8 );
+    csa_StreamBatch( ck, count, (const uint8_t (*)[8])c->sb, c->ks, blocks );
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        const csa_lane_t *lane = &c->lanes[i];
+        uint8_t *p = &lane->pkt[lane->i_hdr];
+
+        memcpy( p, c->ib[i][1], 8 );
+        for( int j = 2; j <= lane->n; j++ )
+            for( int k = 0; k < 8; k++ )
+                p[8*(j-1)+k] = c->ib[i][j][k] ^ c->ks[i][8*(j-2)+k];
+        for( int k = 0; k < lane->i_residue; k++ )
+            lane->pkt[i_pkt_size - lane->i_residue + k] ^=
+                c->ks[i][8*(lane->n-1)+k];
+    }
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t **pkts, unsigned count,
+                       int i_pkt_size )
+{
+    const unsigned max = csa_BatchLanes();
+
+    /* one batch per key */
+    for( int odd = 0; odd < 2; odd++ )
+    {
+        unsigned n = 0;
+
+        for( unsigned i = 0; i < count; i++ )
+        {
+            uint8_t *pkt = pkts[i];
+
+            if( (pkt[3]&0xc0) != (odd ? 0xc0 : 0x80) )
+                continue;
+
+            csa_lane_t *lane = &c->lanes[n];
+            if( !csa_LaneInit( lane, pkt, i_pkt_size ) ||
+                188 - lane->i_hdr < 8 )
+            {
+                csa_Decrypt( c, pkt, i_pkt_size );
+                continue;
+            }
+            if( ++n == max )
+            {
+                csa_DecryptLanes( c, odd, n, i_pkt_size );
+                n = 0;
+            }
+        }
+        csa_DecryptLanes( c, odd, n, i_pkt_size );
+    }
+}
+
+/*****************************************************************************
+ * csa_EncryptBatch:
+ *****************************************************************************/
+void csa_EncryptBatch( csa_t *c, uint8_t **pkts, unsigned count,
+                       int i_pkt_size )
+{
+    const unsigned max = csa_BatchLanes();
+    unsigned n = 0;
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        if( !csa_LaneInit( &c->lanes[n], pkts[i], i_pkt_size ) )
+        {
+            csa_Encrypt( c, pkts[i], i_pkt_size );
+            continue;
+        }
+        if( ++n == max )
+        {
+            csa_EncryptLanes( c, n, i_pkt_size );
+            n = 0;
+        }
+    }
+    csa_EncryptLanes( c, n, i_pkt_size );
+}
+
 /*****************************************************************************
  * Divers
  *****************************************************************************/
@@ -610,3 +866,157 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/* Same rounds as csa_BlockDecypher() and csa_BlockCypher(), with R[1..8] in
+ * the bytes of a 64-bits word, interleaving independent blocks */
+#define CSA_BLOCK_WAYS 8
+
+static inline uint64_t csa_BlockDecypherRound( uint8_t k, uint64_t R )
+{
+    const int sbox_out = block_sbox[ k^((R >> 48)&0xff) ];
+    const uint64_t t = (R >> 56) ^ sbox_out;
+
+    /* R[1] = R[8]^sbox_out, also xored into R[3], R[4] and R[5] */
+    return (R << 8) ^ (t * UINT64_C(0x0000000101010001))
+         ^ ((uint64_t)block_perm[sbox_out] << 48);
+}
+
+static inline uint64_t csa_BlockCypherRound( uint8_t k, uint64_t R )
+{
+    const int sbox_out = block_sbox[ k^(R >> 56) ];
+    const uint64_t r1 = R & 0xff;
+
+    /* R[1] is xored into R[2], R[3] and R[4] */
+    return (R >> 8) ^ (r1 * UINT64_C(0x01010100))
+         ^ ((uint64_t)block_perm[sbox_out] << 40)
+         ^ ((r1 ^ sbox_out) << 56);
+}
+
+static void csa_BlockDecypherBatch( const uint8_t kk[57], uint64_t *blk,
+                                    unsigned count )
+{
+    unsigned j = 0;
+
+    for( ; j + CSA_BLOCK_WAYS <= count; j += CSA_BLOCK_WAYS )
+    {
+        uint64_t R[CSA_BLOCK_WAYS];
+
+        memcpy( R, &blk[j], sizeof (R) );
+        for( int i = 56; i > 0; i-- )
+            for( unsigned w = 0; w < CSA_BLOCK_WAYS; w++ )
+                R[w] = csa_BlockDecypherRound( kk[i], R[w] );
+        memcpy( &blk[j], R, sizeof (R) );
+    }
+    for( ; j < count; j++ )
+        for( int i = 56; i > 0; i-- )
+            blk[j] = csa_BlockDecypherRound( kk[i], blk[j] );
+}
+
+static void csa_BlockCypherBatch( const uint8_t kk[57], uint64_t *blk,
+                                  unsigned count )
+{
+    unsigned j = 0;
+
+    for( ; j + CSA_BLOCK_WAYS <= count; j += CSA_BLOCK_WAYS )
+    {
+        uint64_t R[CSA_BLOCK_WAYS];
+
+        memcpy( R, &blk[j], sizeof (R) );
+        for( int i = 1; i <= 56; i++ )
+            for( unsigned w = 0; w < CSA_BLOCK_WAYS; w++ )
+                R[w] = csa_BlockCypherRound( kk[i], R[w] );
+        memcpy( &blk[j], R, sizeof (R) );
+    }
+    for( ; j < count; j++ )
+        for( int i = 1; i <= 56; i++ )
+            blk[j] = csa_BlockCypherRound( kk[i], blk[j] );
+}
+
+/* Truth tables of the low and high output bits of sbox1..sbox7 */
+static const uint32_t csa_sbox_bits[7][2] =
+{
+    { 0x78c6b16c, 0x4b368771 },
+    { 0xe41b4b63, 0x58b98679 },
+    { 0xe41b1be4, 0x69d25879 },
+    { 0x92ad994b, 0x66b492ad },
+    { 0x35e29e58, 0x9c274cf1 },
+    { 0x66d2e61a, 0x691bb46c },
+    { 0x266d9d92, 0xb38c691e },
+};
+
+/* Transposes a 64x64 bits matrix, bit j of m[i] being its element (i, j) */
+static inline void csa_Transpose64( uint64_t m[64] )
+{
+    uint64_t mask = UINT64_C(0x00000000ffffffff);
+
+    for( unsigned j = 32; j != 0; j >>= 1, mask ^= mask << j )
+        for( unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j )
+        {
+            const uint64_t t = ((m[k] >> j) ^ m[k | j]) & mask;
+
+            m[k] ^= t << j;
+            m[k | j] ^= t;
+        }
+}
+
+#define CSA_BS_NAME(name) name##_64
+#define CSA_BS_WORDS 1
+#define CSA_BS_TARGET
+#include "csa_bitslice.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define CSA_BS_X86 1
+# define CSA_BS_NAME(name) name##_sse2
+# define CSA_BS_WORDS 2
+# define CSA_BS_TARGET __attribute__ ((__target__ ("sse2")))
+# include "csa_bitslice.h"
+
+# define CSA_BS_NAME(name) name##_avx2
+# define CSA_BS_WORDS 4
+# define CSA_BS_TARGET __attribute__ ((__target__ ("avx2")))
+# include "csa_bitslice.h"
+#elif defined(__GNUC__)
+# define CSA_BS_VEC 1
+# define CSA_BS_NAME(name) name##_vec
+# define CSA_BS_WORDS 2
+# define CSA_BS_TARGET
+# include "csa_bitslice.h"
+#endif
+
+static unsigned csa_BatchLanes( void )
+{
+#if defined(CSA_BS_X86)
+    if( vlc_CPU_AVX2() )
+        return 256;
+    if( vlc_CPU_SSE2() )
+        return 128;
+#elif defined(CSA_BS_VEC)
+    return 128;
+#endif
+    return 64;
+}
+
+static void csa_StreamBatch( const uint8_t ck[8], unsigned count,
+                             const uint8_t (*sb)[8],
+                             uint8_t (*ks)[CSA_KS_SIZE], unsigned blocks )
+{
+    /* the narrowest engine is used, as a pass costs as much as a full one */
+#if defined(CSA_BS_X86)
+    if( count > 128 && vlc_CPU_AVX2() )
+    {
+        csa_BitsliceStream_avx2( ck, count, sb, ks, blocks );
+        return;
+    }
+    if( count > 64 && vlc_CPU_SSE2() )
+    {
+        csa_BitsliceStream_sse2( ck, count, sb, ks, blocks );
+        return;
+    }
+#elif defined(CSA_BS_VEC)
+    if( count > 64 )
+    {
+        csa_BitsliceStream_vec( ck, count, sb, ks, blocks );
+        return;
+    }
+#endif
+    csa_BitsliceStream_64( ck, count, sb, ks, blocks );
+}
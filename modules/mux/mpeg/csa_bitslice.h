@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * csa_bitslice.h: bitsliced CSA stream cypher
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by csa.c once per lane width, with:
+ *  - CSA_BS_NAME(name): the function and type names,
+ *  - CSA_BS_WORDS: the number of 64-bits words per slice,
+ *  - CSA_BS_TARGET: the function attributes selecting the instruction set.
+ *
+ * Each slice holds one bit of the cypher state for 64 * CSA_BS_WORDS
+ * packets, one packet per bit, so that the s-boxes become boolean functions
+ * and every operation of csa_StreamCypher() runs on all packets at once. */
+
+#if CSA_BS_WORDS == 1
+typedef uint64_t CSA_BS_NAME(bs_t);
+#else
+typedef uint64_t CSA_BS_NAME(bs_t)
+    __attribute__ ((vector_size (8 * CSA_BS_WORDS)));
+#endif
+#define bs_t CSA_BS_NAME(bs_t)
+
+typedef struct
+{
+    /* A[1..10] and B[1..10] are rings: register k is at (pos + k) % 16 */
+    bs_t A[16][4];
+    bs_t B[16][4];
+    bs_t X[4], Y[4], Z[4];
+    bs_t D[4], E[4], F[4];
+    bs_t p, q, r;
+    unsigned pos;
+} CSA_BS_NAME(csa_bs_state_t);
+
+/* The 16 minterms of the 4 lowest s-box input bits */
+CSA_BS_TARGET
+static inline void CSA_BS_NAME(csa_BsMinterms)( bs_t m[16], bs_t x3, bs_t x2,
+                                                bs_t x1, bs_t x0 )
+{
+    const bs_t lo[4] = { ~x1 & ~x0, ~x1 & x0, x1 & ~x0, x1 & x0 };
+    const bs_t hi[4] = { ~x3 & ~x2, ~x3 & x2, x3 & ~x2, x3 & x2 };
+
+    for( int i = 0; i < 4; i++ )
+        for( int j = 0; j < 4; j++ )
+            m[4*i+j] = hi[i] & lo[j];
+}
+
+/* One output bit of a 5 to 2 bits s-box, from its truth table */
+CSA_BS_TARGET
+static inline bs_t CSA_BS_NAME(csa_BsSbox)( const bs_t m[16], bs_t x4,
+                                            uint32_t table )
+{
+    bs_t lo = { 0 }, hi = { 0 };
+
+    for( int i = 0; i < 16; i++ )
+    {
+        if( table & (UINT32_C(1) << i) )
+            lo |= m[i];
+        if( table & (UINT32_C(1) << (16 + i)) )
+            hi |= m[i];
+    }
+    return lo ^ (x4 & (lo ^ hi));
+}
+
+/* One iteration of the inner loop of csa_StreamCypher(), the D register
+ * holding the output bits. in_a and in_b are the nibbles fed into T1 and T2
+ * during initialisation. */
+CSA_BS_TARGET
+static inline void CSA_BS_NAME(csa_BsStep)( CSA_BS_NAME(csa_bs_state_t) *st,
+                                            bool b_init,
+                                            const bs_t *in_a, const bs_t *in_b )
+{
+#define A(k, b) st->A[(st->pos + (k)) & 15][b]
+#define B(k, b) st->B[(st->pos + (k)) & 15][b]
+#define SBOX(i, x4, x3, x2, x1, x0, s) \
+    do { \
+        bs_t m_[16]; \
+        CSA_BS_NAME(csa_BsMinterms)( m_, x3, x2, x1, x0 ); \
+        s[0] = CSA_BS_NAME(csa_BsSbox)( m_, x4, csa_sbox_bits[i][0] ); \
+        s[1] = CSA_BS_NAME(csa_BsSbox)( m_, x4, csa_sbox_bits[i][1] ); \
+    } while( 0 )
+
+    bs_t s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+
+    SBOX( 0, A(4,0), A(1,2), A(6,1), A(7,3), A(9,0), s1 );
+    SBOX( 1, A(2,1), A(3,2), A(6,3), A(7,0), A(9,1), s2 );
+    SBOX( 2, A(1,3), A(2,0), A(5,1), A(5,3), A(6,2), s3 );
+    SBOX( 3, A(3,3), A(1,1), A(2,3), A(4,2), A(8,0), s4 );
+    SBOX( 4, A(5,2), A(4,3), A(6,0), A(8,1), A(9,2), s5 );
+    SBOX( 5, A(3,1), A(4,1), A(5,0), A(7,2), A(9,3), s6 );
+    SBOX( 6, A(2,2), A(3,0), A(7,1), A(8,2), A(8,3), s7 );
+
+    const bs_t extra_B[4] = {
+        B(9,2) ^ B(6,3) ^ B(3,1) ^ B(8,0),
+        B(5,3) ^ B(8,2) ^ B(4,0) ^ B(5,1),
+        B(6,0) ^ B(8,1) ^ B(3,3) ^ B(4,2),
+        B(3,0) ^ B(6,1) ^ B(7,2) ^ B(9,3),
+    };
+
+    bs_t next_A1[4], next_B1[4], next_F[4];
+    bs_t carry = st->r;
+
+    for( int b = 0; b < 4; b++ )
+    {
+        next_A1[b] = A(10,b) ^ st->X[b];
+        next_B1[b] = B(7,b) ^ B(10,b) ^ st->Y[b];
+        if( b_init )
+        {
+            next_A1[b] ^= st->D[b] ^ in_a[b];
+            next_B1[b] ^= in_b[b];
+        }
+
+        /* T4 = sum, carry of Z + E + r if q, else E */
+        const bs_t z = st->Z[b], e = st->E[b];
+        next_F[b] = e ^ (st->q & (z ^ carry));
+        carry = (z & e) | (carry & (z ^ e));
+    }
+    st->r ^= st->q & (carry ^ st->r);
+
+    /* if p=1, rotate next_B1 left */
+    const bs_t rot_B1[4] = {
+        next_B1[0] ^ (st->p & (next_B1[0] ^ next_B1[3])),
+        next_B1[1] ^ (st->p & (next_B1[1] ^ next_B1[0])),
+        next_B1[2] ^ (st->p & (next_B1[2] ^ next_B1[1])),
+        next_B1[3] ^ (st->p & (next_B1[3] ^ next_B1[2])),
+    };
+
+    for( int b = 0; b < 4; b++ )
+    {
+        st->D[b] = st->E[b] ^ st->Z[b] ^ extra_B[b];
+        st->E[b] = st->F[b];
+        st->F[b] = next_F[b];
+    }
+
+    st->pos = (st->pos - 1) & 15;
+    for( int b = 0; b < 4; b++ )
+    {
+        A(1,b) = next_A1[b];
+        B(1,b) = rot_B1[b];
+    }
+
+    st->X[3] = s4[0]; st->X[2] = s3[0]; st->X[1] = s2[1]; st->X[0] = s1[1];
+    st->Y[3] = s6[0]; st->Y[2] = s5[0]; st->Y[1] = s4[1]; st->Y[0] = s3[1];
+    st->Z[3] = s2[0]; st->Z[2] = s1[0]; st->Z[1] = s6[1]; st->Z[0] = s5[1];
+    st->p = s7[1];
+    st->q = s7[0];
+#undef SBOX
+#undef B
+#undef A
+}
+
+/* Moves the 64 slices of a block between one bit per packet and 8 bytes per
+ * packet, 64 packets at a time */
+CSA_BS_TARGET
+static void CSA_BS_NAME(csa_BsLoad)( bs_t slices[64], unsigned count,
+                                     const uint8_t (*blocks)[8] )
+{
+    for( unsigned w = 0; w < CSA_BS_WORDS; w++ )
+    {
+        uint64_t m[64];
+
+        for( unsigned i = 0; i < 64; i++ )
+            m[i] = 64 * w + i < count ? GetQWLE( blocks[64 * w + i] ) : 0;
+        csa_Transpose64( m );
+        for( unsigned i = 0; i < 64; i++ )
+            memcpy( (uint64_t *)&slices[i] + w, &m[i], sizeof (m[i]) );
+    }
+}
+
+CSA_BS_TARGET
+static void CSA_BS_NAME(csa_BsStore)( const bs_t slices[64], unsigned count,
+                                      uint8_t (*out)[CSA_KS_SIZE],
+                                      unsigned offset )
+{
+    for( unsigned w = 0; w < CSA_BS_WORDS && 64 * w < count; w++ )
+    {
+        uint64_t m[64];
+
+        for( unsigned i = 0; i < 64; i++ )
+            memcpy( &m[i], (const uint64_t *)&slices[i] + w, sizeof (m[i]) );
+        csa_Transpose64( m );
+        for( unsigned i = 0; i < 64 && 64 * w + i < count; i++ )
+            SetQWLE( &out[64 * w + i][offset], m[i] );
+    }
+}
+
+/* Equivalent to one csa_StreamCypher() initialisation with sb[i], followed
+ * by the given number of generation calls writing out[i], for each of the
+ * count packets */
+CSA_BS_TARGET
+static void CSA_BS_NAME(csa_BitsliceStream)( const uint8_t ck[8],
+                                             unsigned count,
+                                             const uint8_t (*sb)[8],
+                                             uint8_t (*out)[CSA_KS_SIZE],
+                                             unsigned blocks )
+{
+    CSA_BS_NAME(csa_bs_state_t) st;
+    const bs_t zero = { 0 };
+    bs_t slices[64];
+
+    memset( &st, 0, sizeof (st) );
+    for( int i = 0; i < 4; i++ )
+        for( int b = 0; b < 4; b++ )
+        {
+            st.A[1+2*i][b] = (ck[i] >> (4 + b)) & 1 ? ~zero : zero;
+            st.A[2+2*i][b] = (ck[i] >> b) & 1 ? ~zero : zero;
+            st.B[1+2*i][b] = (ck[4+i] >> (4 + b)) & 1 ? ~zero : zero;
+            st.B[2+2*i][b] = (ck[4+i] >> b) & 1 ? ~zero : zero;
+        }
+
+    /* init: in1 (high nibble) and in2 (low nibble) alternate */
+    CSA_BS_NAME(csa_BsLoad)( slices, count, sb );
+    for( int i = 0; i < 8; i++ )
+        for( int j = 0; j < 4; j++ )
+        {
+            const bs_t *in1 = &slices[8*i+4], *in2 = &slices[8*i];
+
+            CSA_BS_NAME(csa_BsStep)( &st, true, (j % 2) ? in2 : in1,
+                                     (j % 2) ? in1 : in2 );
+        }
+
+    for( unsigned k = 0; k < blocks; k++ )
+    {
+        for( int i = 0; i < 8; i++ )
+            for( int j = 0; j < 4; j++ )
+            {
+                CSA_BS_NAME(csa_BsStep)( &st, false, NULL, NULL );
+                slices[8*i+7-2*j] = st.D[2] ^ st.D[3];
+                slices[8*i+6-2*j] = st.D[0] ^ st.D[1];
+            }
+        CSA_BS_NAME(csa_BsStore)( slices, count, out, 8 * k );
+    }
+}
+
+#undef bs_t
+#undef CSA_BS_TARGET
+#undef CSA_BS_WORDS
+#undef CSA_BS_NAME
@@ -1157,6 +1157,11 @@ static block_t *Encap_J2K( block_t *p_data, const es_format_t *p_fmt )
     {
         p_data->p_buffer += (i_offset - 38);
         p_data->i_buffer -= (i_offset - 38);
+
+        /* The header is rewritten in place: copy shared payloads */
+        p_data = block_Realloc( p_data, 0, p_data->i_buffer );
+        if( unlikely(!p_data) )
+            return NULL;
     }
 
     const int profile = j2k_get_profile( p_fmt->video.i_visible_width,
@@ -1787,6 +1792,12 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
         i_pcr_length = i_packet_count;
     }
 
+    /* Packets are written by batches, so that the scrambled ones are
+     * encrypted together */
+    block_t *pp_ts[256];
+    uint8_t *pp_scrambled[256];
+    unsigned i_ts = 0, i_scrambled = 0;
+
     /* msg_Dbg( p_mux, "real pck=%d", i_packet_count ); */
     for (int i = 0; i < i_packet_count; i++ )
     {
@@ -1802,16 +1813,25 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
             TSSetPCR( p_ts, p_ts->i_dts - p_sys->first_dts );
         }
         if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
-        {
-            vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_sys->csa_lock );
-        }
+            pp_scrambled[i_scrambled++] = p_ts->p_buffer;
 
         /* latency */
         p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
 
-        sout_AccessOutWrite( p_mux->p_access, p_ts );
+        pp_ts[i_ts++] = p_ts;
+        if( i_ts < ARRAY_SIZE(pp_ts) && i + 1 < i_packet_count )
+            continue;
+
+        if( i_scrambled > 0 )
+        {
+            vlc_mutex_lock( &p_sys->csa_lock );
+            csa_EncryptBatch( p_sys->csa, pp_scrambled, i_scrambled,
+                              p_sys->i_csa_pkt_size );
+            vlc_mutex_unlock( &p_sys->csa_lock );
+        }
+        for( unsigned j = 0; j < i_ts; j++ )
+            sout_AccessOutWrite( p_mux->p_access, pp_ts[j] );
+        i_ts = i_scrambled = 0;
     }
 }
 
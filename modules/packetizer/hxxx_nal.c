@@ -135,6 +135,15 @@ block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
     }
     else
     {
+        /* Shared payloads are read-only: convert a private copy then */
+        const uint8_t *p_orig = p_block->p_buffer;
+        block_t *p_newblock = block_TryRealloc( p_block, 0, p_block->i_buffer );
+        if( unlikely(!p_newblock) )
+            goto error;
+        p_block = p_newblock;
+        for( unsigned i = 0; i < i_nalcount; i++ )
+            p_list[i].p = &p_block->p_buffer[p_list[i].p - p_orig];
+
         p_source = p_dest = p_block->p_buffer;
         p_sourceend = &p_block->p_buffer[p_block->i_buffer];
     }
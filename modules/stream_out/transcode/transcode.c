@@ -594,6 +594,11 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             goto error;
     }
 
+    /* Decoders may write into their input: copy shared payloads */
+    p_buffer = block_Realloc( p_buffer, 0, p_buffer->i_buffer );
+    if( unlikely(p_buffer == NULL) )
+        return VLC_ENOMEM;
+
     switch( id->p_decoder->fmt_in.i_cat )
     {
     case AUDIO_ES:
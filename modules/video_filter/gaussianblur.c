@@ -186,112 +186,193 @@ static void Destroy( vlc_object_t *p_this )
     free( p_filter->p_sys );
 }
 
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+/* Offset of the intermediate rows of a plane in the buffer */
+static size_t BufferOffset( const picture_t *p_pic, int i_plane )
+{
+    size_t i_offset = 0;
+
+    for( int i = 0; i < i_plane; i++ )
+        i_offset += p_pic->p[i].i_visible_lines * p_pic->p[i].i_pitch;
+    return i_offset;
+}
+
+struct blur_ctx
 {
+    const filter_sys_t *p_sys;
+    const picture_t *p_pic;
     picture_t *p_outpic;
-    filter_sys_t *p_sys = p_filter->p_sys;
+};
+
+static void ScaleSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                        void *opaque )
+{
+    const struct blur_ctx *ctx = opaque;
+    const filter_sys_t *p_sys = ctx->p_sys;
     const int i_dim = p_sys->i_dim;
-    type_t *pt_buffer;
-    type_t *pt_scale;
     const type_t *pt_distribution = p_sys->pt_distribution;
+    type_t *pt_scale = p_sys->pt_scale;
 
-    if( !p_pic ) return NULL;
+    const int i_visible_lines = ctx->p_pic->p[Y_PLANE].i_visible_lines;
+    const int i_visible_pitch = ctx->p_pic->p[Y_PLANE].i_visible_pitch;
+    const int i_pitch = ctx->p_pic->p[Y_PLANE].i_pitch;
 
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-    if( !p_sys->pt_buffer )
-    {
-        p_sys->pt_buffer = realloc_or_free( p_sys->pt_buffer,
-                               p_pic->p[Y_PLANE].i_visible_lines *
-                               p_pic->p[Y_PLANE].i_pitch * sizeof( type_t ) );
-    }
+    VLC_UNUSED(p_filter);
 
-    pt_buffer = p_sys->pt_buffer;
-    if( !p_sys->pt_scale )
+    for( int i_line = p_slice->y_start; i_line < p_slice->y_end; i_line++ )
     {
-        const int i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
-        const int i_visible_pitch = p_pic->p[Y_PLANE].i_visible_pitch;
-        const int i_pitch = p_pic->p[Y_PLANE].i_pitch;
-
-        p_sys->pt_scale = xmalloc( i_visible_lines * i_pitch * sizeof( type_t ) );
-        pt_scale = p_sys->pt_scale;
-
-        for( int i_line = 0; i_line < i_visible_lines; i_line++ )
+        for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
         {
-            for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
-            {
-                type_t t_value = 0;
+            type_t t_value = 0;
 
-                for( int y = __MAX( -i_dim, -i_line );
-                     y <= __MIN( i_dim, i_visible_lines - i_line - 1 );
-                     y++ )
+            for( int y = __MAX( -i_dim, -i_line );
+                 y <= __MIN( i_dim, i_visible_lines - i_line - 1 );
+                 y++ )
+            {
+                for( int x = __MAX( -i_dim, -i_col );
+                     x <= __MIN( i_dim, i_visible_pitch - i_col + 1 );
+                     x++ )
                 {
-                    for( int x = __MAX( -i_dim, -i_col );
-                         x <= __MIN( i_dim, i_visible_pitch - i_col + 1 );
-                         x++ )
-                    {
-                        t_value += pt_distribution[y+i_dim] *
-                                   pt_distribution[x+i_dim];
-                    }
+                    t_value += pt_distribution[y+i_dim] *
+                               pt_distribution[x+i_dim];
                 }
-                pt_scale[i_line*i_pitch+i_col] = t_value;
             }
+            pt_scale[i_line*i_pitch+i_col] = t_value;
         }
     }
+}
 
-    pt_scale = p_sys->pt_scale;
-    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
-    {
+/* Horizontal pass, from the input picture to the buffer */
+static void BlurRowsSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                           void *opaque )
+{
+    const struct blur_ctx *ctx = opaque;
+    const filter_sys_t *p_sys = ctx->p_sys;
+    const int i_dim = p_sys->i_dim;
+    const type_t *pt_distribution = p_sys->pt_distribution;
+    const picture_t *p_pic = ctx->p_pic;
+    const int i_plane = p_slice->plane;
+
+    const uint8_t *p_in = p_pic->p[i_plane].p_pixels;
+    type_t *pt_buffer = p_sys->pt_buffer + BufferOffset( p_pic, i_plane );
 
-        uint8_t *p_in = p_pic->p[i_plane].p_pixels;
-        uint8_t *p_out = p_outpic->p[i_plane].p_pixels;
+    const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
+    const int i_in_pitch = p_pic->p[i_plane].i_pitch;
 
-        const int i_visible_lines = p_pic->p[i_plane].i_visible_lines;
-        const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
-        const int i_in_pitch = p_pic->p[i_plane].i_pitch;
+    const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
 
-        const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
-        const int y_factor = p_pic->p[Y_PLANE].i_visible_lines/i_visible_lines-1;
+    VLC_UNUSED(p_filter);
 
-        for( int i_line = 0; i_line < i_visible_lines; i_line++ )
+    for( int i_line = p_slice->y_start; i_line < p_slice->y_end; i_line++ )
+    {
+        for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
         {
-            for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
+            type_t t_value = 0;
+            const int c = i_line*i_in_pitch+i_col;
+            for( int x = __MAX( -i_dim, -i_col*(x_factor+1) );
+                 x <= __MIN( i_dim, (i_visible_pitch - i_col)*(x_factor+1) + 1 );
+                 x++ )
             {
-                type_t t_value = 0;
-                const int c = i_line*i_in_pitch+i_col;
-                for( int x = __MAX( -i_dim, -i_col*(x_factor+1) );
-                     x <= __MIN( i_dim, (i_visible_pitch - i_col)*(x_factor+1) + 1 );
-                     x++ )
-                {
-                    t_value += pt_distribution[x+i_dim] *
-                               p_in[c+(x>>x_factor)];
-                }
-                pt_buffer[c] = t_value;
+                t_value += pt_distribution[x+i_dim] *
+                           p_in[c+(x>>x_factor)];
             }
+            pt_buffer[c] = t_value;
         }
-        for( int i_line = 0; i_line < i_visible_lines; i_line++ )
+    }
+}
+
+/* Vertical pass, from the buffer to the output picture */
+static void BlurColumnsSlice( filter_t *p_filter,
+                              const filter_slice_t *p_slice, void *opaque )
+{
+    const struct blur_ctx *ctx = opaque;
+    const filter_sys_t *p_sys = ctx->p_sys;
+    const int i_dim = p_sys->i_dim;
+    const type_t *pt_distribution = p_sys->pt_distribution;
+    const type_t *pt_scale = p_sys->pt_scale;
+    const picture_t *p_pic = ctx->p_pic;
+    const int i_plane = p_slice->plane;
+
+    const type_t *pt_buffer = p_sys->pt_buffer + BufferOffset( p_pic, i_plane );
+    uint8_t *p_out = ctx->p_outpic->p[i_plane].p_pixels;
+    const int i_out_pitch = ctx->p_outpic->p[i_plane].i_pitch;
+
+    const int i_visible_lines = p_pic->p[i_plane].i_visible_lines;
+    const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
+    const int i_in_pitch = p_pic->p[i_plane].i_pitch;
+
+    const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
+    const int y_factor = p_pic->p[Y_PLANE].i_visible_lines/i_visible_lines-1;
+
+    VLC_UNUSED(p_filter);
+
+    for( int i_line = p_slice->y_start; i_line < p_slice->y_end; i_line++ )
+    {
+        for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
         {
-            for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
+            type_t t_value = 0;
+            const int c = i_line*i_in_pitch+i_col;
+            for( int y = __MAX( -i_dim, (-i_line)*(y_factor+1) );
+                 y <= __MIN( i_dim, (i_visible_lines - i_line)*(y_factor+1) - 1 );
+                 y++ )
             {
-                type_t t_value = 0;
-                const int c = i_line*i_in_pitch+i_col;
-                for( int y = __MAX( -i_dim, (-i_line)*(y_factor+1) );
-                     y <= __MIN( i_dim, (i_visible_lines - i_line)*(y_factor+1) - 1 );
-                     y++ )
-                {
-                    t_value += pt_distribution[y+i_dim] *
-                               pt_buffer[c+(y>>y_factor)*i_in_pitch];
-                }
-
-                const type_t t_scale = pt_scale[(i_line<<y_factor)*(i_in_pitch<<x_factor)+(i_col<<x_factor)];
-                p_out[i_line * p_outpic->p[i_plane].i_pitch + i_col] = (uint8_t)(t_value / t_scale); // FIXME wouldn't it be better to round instead of trunc ?
+                t_value += pt_distribution[y+i_dim] *
+                           pt_buffer[c+(y>>y_factor)*i_in_pitch];
             }
+
+            const type_t t_scale = pt_scale[(i_line<<y_factor)*(i_in_pitch<<x_factor)+(i_col<<x_factor)];
+            p_out[i_line * i_out_pitch + i_col] = (uint8_t)(t_value / t_scale); // FIXME wouldn't it be better to round instead of trunc ?
+        }
+    }
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( !p_pic ) return NULL;
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    struct blur_ctx ctx = {
+        .p_sys = p_sys,
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+    };
+
+    if( !p_sys->pt_buffer )
+    {
+        /* Planes are blurred concurrently: each has its own rows */
+        p_sys->pt_buffer = realloc_or_free( p_sys->pt_buffer,
+                               BufferOffset( p_pic, p_pic->i_planes ) *
+                               sizeof( type_t ) );
+        if( !p_sys->pt_buffer )
+        {
+            picture_Release( p_outpic );
+            picture_Release( p_pic );
+            return NULL;
         }
     }
 
+    if( !p_sys->pt_scale )
+    {
+        p_sys->pt_scale = xmalloc( p_pic->p[Y_PLANE].i_visible_lines *
+                                   p_pic->p[Y_PLANE].i_pitch *
+                                   sizeof( type_t ) );
+        filter_RunSlices( p_filter, p_pic, 1, 0, ScaleSlice, &ctx );
+    }
+
+    /* The vertical pass reads rows from other slices of the horizontal pass:
+     * the passes are separated by the end of the first run. */
+    filter_RunSlices( p_filter, p_pic, p_pic->i_planes, 0,
+                      BlurRowsSlice, &ctx );
+    filter_RunSlices( p_filter, p_pic, p_pic->i_planes, 0,
+                      BlurColumnsSlice, &ctx );
+
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -168,11 +168,13 @@ static void Destroy( vlc_object_t *p_this )
         const unsigned data_sz = sizeof(data_t);                        \
         const int i_src_line_len = p_outpic->p[Y_PLANE].i_pitch / data_sz; \
         const int i_out_line_len = p_pic->p[Y_PLANE].i_pitch / data_sz; \
-        const int sigma = atomic_load(&p_filter->p_sys->sigma);         \
+        const unsigned i_first = __MAX(i_start, 1);                     \
+        const unsigned i_last = __MIN(i_end, i_visible_lines - 1);      \
                                                                         \
-        memcpy(p_out, p_src, i_visible_pitch);                          \
+        if (i_start == 0)                                               \
+            memcpy(p_out, p_src, i_visible_pitch);                      \
                                                                         \
-        for( unsigned i = 1; i < i_visible_lines - 1; i++ )             \
+        for( unsigned i = i_first; i < i_last; i++ )                    \
         {                                                               \
             p_out[i * i_out_line_len] = p_src[i * i_src_line_len];      \
                                                                         \
@@ -199,18 +201,58 @@ static void Destroy( vlc_object_t *p_this )
             p_out[i * i_out_line_len + i_visible_pitch / data_sz - 1] = \
                 p_src[i * i_src_line_len + i_visible_pitch / data_sz - 1];  \
         }                                                               \
-        memcpy(&p_out[(i_visible_lines - 1) * i_out_line_len],          \
-               &p_src[(i_visible_lines - 1) * i_src_line_len],          \
-               i_visible_pitch);                                        \
+        if (i_end == i_visible_lines)                                   \
+            memcpy(&p_out[(i_visible_lines - 1) * i_out_line_len],      \
+                   &p_src[(i_visible_lines - 1) * i_src_line_len],      \
+                   i_visible_pitch);                                    \
     } while (0)
 
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+struct sharpen_ctx
 {
+    const picture_t *p_pic;
     picture_t *p_outpic;
+    int sigma;
+};
+
+static void SharpenSlice( filter_t *p_filter, const filter_slice_t *slice,
+                          void *opaque )
+{
+    const struct sharpen_ctx *ctx = opaque;
+    const picture_t *p_pic = ctx->p_pic;
+    picture_t *p_outpic = ctx->p_outpic;
+    const unsigned i_start = slice->y_start;
+    const unsigned i_end = slice->y_end;
+
+    VLC_UNUSED(p_filter);
+
+    if( slice->plane != Y_PLANE )
+    {   /* Chroma is copied as is */
+        const plane_t *in = &p_pic->p[slice->plane];
+        plane_t *out = &p_outpic->p[slice->plane];
+        const unsigned i_width = __MIN( in->i_visible_pitch,
+                                        out->i_visible_pitch );
+
+        for( unsigned i = i_start; i < i_end; i++ )
+            memcpy( &out->p_pixels[i * out->i_pitch],
+                    &in->p_pixels[i * in->i_pitch], i_width );
+        return;
+    }
+
     const int v1 = -1;
     const int v2 = 3; /* 2^3 = 8 */
     const unsigned i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
     const unsigned i_visible_pitch = p_pic->p[Y_PLANE].i_visible_pitch;
+    const int sigma = ctx->sigma;
+
+    if (!IS_YUV_420_10BITS(p_pic->format.i_chroma))
+        SHARPEN_FRAME(255, uint8_t);
+    else
+        SHARPEN_FRAME(1023, uint16_t);
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
 
     p_outpic = filter_NewPicture( p_filter );
     if( !p_outpic )
@@ -219,13 +261,13 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         return NULL;
     }
 
-    if (!IS_YUV_420_10BITS(p_pic->format.i_chroma))
-        SHARPEN_FRAME(255, uint8_t);
-    else
-        SHARPEN_FRAME(1023, uint16_t);
+    struct sharpen_ctx ctx = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .sigma = atomic_load(&p_filter->p_sys->sigma),
+    };
 
-    plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
-    plane_CopyPixels( &p_outpic->p[V_PLANE], &p_pic->p[V_PLANE] );
+    filter_RunSlices( p_filter, p_pic, 3, 0, SharpenSlice, &ctx );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
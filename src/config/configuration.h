@@ -21,6 +21,8 @@
 #ifndef LIBVLC_CONFIGURATION_H
 # define LIBVLC_CONFIGURATION_H 1
 
+# include <vlc_atomic.h>
+
 # ifdef __cplusplus
 extern "C" {
 # endif
@@ -52,6 +54,8 @@ void config_UnsortConfig (void);
 
 extern vlc_rwlock_t config_lock;
 extern bool config_dirty;
+/* Incremented, with config_lock held, whenever a value changes */
+extern atomic_uint config_generation;
 
 bool config_IsSafe (const char *);
 
@@ -40,6 +40,7 @@
 
 vlc_rwlock_t config_lock = VLC_STATIC_RWLOCK;
 bool config_dirty = false;
+atomic_uint config_generation = ATOMIC_VAR_INIT(0);
 
 static inline char *strdupnull (const char *src)
 {
@@ -209,6 +210,7 @@ void config_PutPsz( vlc_object_t *p_this,
     oldstr = (char *)p_config->value.psz;
     p_config->value.psz = str;
     config_dirty = true;
+    atomic_fetch_add_explicit (&config_generation, 1, memory_order_release);
     vlc_rwlock_unlock (&config_lock);
 
     free (oldstr);
@@ -244,6 +246,7 @@ void config_PutInt( vlc_object_t *p_this, const char *psz_name,
     vlc_rwlock_wrlock (&config_lock);
     p_config->value.i = i_value;
     config_dirty = true;
+    atomic_fetch_add_explicit (&config_generation, 1, memory_order_release);
     vlc_rwlock_unlock (&config_lock);
 }
 
@@ -279,6 +282,7 @@ void config_PutFloat( vlc_object_t *p_this,
     vlc_rwlock_wrlock (&config_lock);
     p_config->value.f = f_value;
     config_dirty = true;
+    atomic_fetch_add_explicit (&config_generation, 1, memory_order_release);
     vlc_rwlock_unlock (&config_lock);
 }
 
@@ -581,6 +585,7 @@ void config_ResetAll( vlc_object_t *p_this )
             }
         }
     }
+    atomic_fetch_add_explicit (&config_generation, 1, memory_order_release);
     vlc_rwlock_unlock (&config_lock);
 
     VLC_UNUSED(p_this);
@@ -241,6 +241,7 @@ int config_LoadConfigFile( vlc_object_t *p_this )
                 break;
         }
     }
+    atomic_fetch_add_explicit (&config_generation, 1, memory_order_release);
     vlc_rwlock_unlock (&config_lock);
     free (line);
 
@@ -291,7 +291,12 @@ stream_t *stream_AccessNew(vlc_object_t *parent, input_thread_t *input,
     if (access->pf_block != NULL)
     {
         s->pf_block = AStreamReadBlock;
-        cachename = "prefetch,cache_block";
+        /* Blocks mapping the storage (memory-mapped files) are handed over
+         * as is, rather than copied into the cache. */
+        if (vlc_stream_Control(access, STREAM_IS_MAPPED) == VLC_SUCCESS)
+            cachename = NULL;
+        else
+            cachename = "prefetch,cache_block";
     }
     else
     if (access->pf_read != NULL)
@@ -53,6 +53,7 @@
 #include "resource.h"
 
 #include "../video_output/vout_control.h"
+#include "../misc/frame_trace.h"
 
 /*
  * Possibles values set in p_owner->reload atomic
@@ -1046,9 +1047,13 @@ static int DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
     }
 
     const bool b_dated = p_picture->date > VLC_TS_INVALID;
+    const mtime_t i_pts = p_picture->date;
     int i_rate = INPUT_RATE_DEFAULT;
     DecoderFixTs( p_dec, &p_picture->date, NULL, NULL,
                   &i_rate, DECODER_BOGUS_VIDEO_DELAY );
+    /* The picture is identified by its rendering date from now on */
+    vlc_frame_Trace( VLC_FRAME_DECODED, p_dec->fmt_in.i_id, i_pts,
+                     p_picture->date );
 
     vlc_mutex_unlock( &p_owner->lock );
 
@@ -1337,6 +1342,10 @@ static void DecoderDecode( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_block != NULL && p_dec->fmt_in.i_cat == VIDEO_ES )
+        vlc_frame_Trace( VLC_FRAME_DECODE, p_dec->fmt_in.i_id,
+                         p_block->i_pts, VLC_TS_INVALID );
+
     int ret = p_dec->pf_decode( p_dec, p_block );
     switch( ret )
     {
@@ -1396,6 +1405,12 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
         if( p_block->i_buffer <= 0 )
             goto error;
 
+        /* Packetizers and decoders may write into their input: give them
+         * their own copy of shared payloads (see block_Shareable()) */
+        p_block = block_Realloc( p_block, 0, p_block->i_buffer );
+        if( unlikely(p_block == NULL) )
+            return;
+
         vlc_mutex_lock( &p_owner->lock );
         DecoderUpdatePreroll( &p_owner->i_preroll_end, p_block );
         vlc_mutex_unlock( &p_owner->lock );
@@ -2036,6 +2051,10 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_dec->fmt_in.i_cat == VIDEO_ES )
+        vlc_frame_Trace( VLC_FRAME_DEMUX, p_dec->fmt_in.i_id,
+                         p_block->i_pts, VLC_TS_INVALID );
+
     vlc_fifo_Lock( p_owner->p_fifo );
     if( !b_do_pace )
     {
@@ -30,6 +30,7 @@
 
 #include "demux.h"
 #include <libvlc.h>
+#include "../modules/modules.h"
 #include <vlc_codec.h>
 #include <vlc_meta.h>
 #include <vlc_url.h>
@@ -206,15 +207,13 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
         return NULL;
 
     demux_t *p_demux = &priv->demux;
+    char *psz_mime = NULL;
 
     if( s != NULL && (!strcasecmp( psz_demux, "any" ) || !psz_demux[0]) )
     {   /* Look up demux by mime-type for hard to detect formats */
-        char *type = stream_MimeType( s );
-        if( type != NULL )
-        {
-            psz_demux = demux_NameFromMimeType( type );
-            free( type );
-        }
+        psz_mime = stream_MimeType( s );
+        if( psz_mime != NULL )
+            psz_demux = demux_NameFromMimeType( psz_mime );
     }
 
     p_demux->p_input = p_parent_input;
@@ -249,20 +248,42 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
     if( s != NULL )
     {
         const char *psz_module = NULL;
+        char const *psz_ext = NULL;
 
-        if( !strcmp( p_demux->psz_demux, "any" ) && p_demux->psz_file )
+        if( p_demux->psz_file )
         {
-            char const* psz_ext = strrchr( p_demux->psz_file, '.' );
-
-            if( psz_ext )
-                psz_module = DemuxNameFromExtension( psz_ext + 1, b_preparsing );
+            psz_ext = strrchr( p_demux->psz_file, '.' );
+            if( psz_ext && strchr( psz_ext, '/' ) )
+                psz_ext = NULL;
         }
 
+        if( !strcmp( p_demux->psz_demux, "any" ) && psz_ext )
+            psz_module = DemuxNameFromExtension( psz_ext + 1, b_preparsing );
+
         if( psz_module == NULL )
             psz_module = p_demux->psz_demux;
 
-        p_demux->p_module = vlc_module_load(p_demux, "demux", psz_module,
-             !strcmp(psz_module, p_demux->psz_demux), demux_Probe, p_demux);
+        /* Peek once, so that unforced candidates that cannot possibly
+         * accept the stream are not even loaded */
+        struct vlc_probe_hints hints = {
+            .extension = psz_ext ? psz_ext + 1 : NULL,
+            .mime_type = psz_mime,
+        };
+
+        if( vlc_stream_Tell( s ) == 0 )
+        {
+            ssize_t i_peek = vlc_stream_Peek( s, &hints.peek,
+                                              VLC_PROBE_HINTS_PEEK );
+            if( i_peek > 0 )
+                hints.peek_size = i_peek;
+            else
+                hints.peek = NULL;
+        }
+
+        p_demux->p_module = vlc_module_load_hinted(VLC_OBJECT(p_demux),
+             "demux", psz_module, !strcmp(psz_module, p_demux->psz_demux),
+             var_InheritBool(p_demux, "demux-probe-hints") ? &hints : NULL,
+             demux_Probe, p_demux);
     }
     else
     {
@@ -273,8 +294,10 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
     if( p_demux->p_module == NULL )
         goto error;
 
+    free( psz_mime );
     return p_demux;
 error:
+    free( psz_mime );
     free( p_demux->psz_file );
     free( p_demux->psz_location );
     free( p_demux->psz_demux );
@@ -1490,6 +1490,13 @@ static void EsOutMeta( es_out_t *p_out, const vlc_meta_t *p_meta, const vlc_meta
         vlc_meta_Merge( p_item->p_meta, p_meta );
     vlc_mutex_unlock( &p_item->lock );
 
+    /* Notify the merged meta-data, as input_item_SetMeta() does */
+    for( int i = 0; p_meta && i < VLC_META_TYPE_COUNT; i++ )
+        if( vlc_meta_Get( p_meta, i ) != NULL )
+            vlc_event_send( &p_item->event_manager, &(vlc_event_t) {
+                .type = vlc_InputItemMetaChanged,
+                .u.input_item_meta_changed.meta_type = i } );
+
     /* Check program meta to not override GROUP_META values */
     if( p_meta && (!p_program_meta || vlc_meta_Get( p_program_meta, vlc_meta_Title ) == NULL) &&
          vlc_meta_Get( p_meta, vlc_meta_Title ) != NULL )
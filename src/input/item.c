@@ -316,6 +316,10 @@ void input_item_SetName( input_item_t *p_item, const char *psz_name )
     p_item->psz_name = strdup( psz_name );
 
     vlc_mutex_unlock( &p_item->lock );
+
+    vlc_event_send( &p_item->event_manager, &(vlc_event_t) {
+        .type = vlc_InputItemNameChanged,
+        .u.input_item_name_changed.new_name = psz_name } );
 }
 
 char *input_item_GetURI( input_item_t *p_i )
@@ -337,12 +341,16 @@ void input_item_SetURI( input_item_t *p_i, const char *psz_uri )
         fprintf( stderr, "Warning: %s(\"%s\"): file path instead of URL.\n",
                  __func__, psz_uri );
 #endif
+    char *psz_name = NULL;
+
     vlc_mutex_lock( &p_i->lock );
     free( p_i->psz_uri );
     p_i->psz_uri = strdup( psz_uri );
 
     p_i->i_type = GuessType( p_i, &p_i->b_net );
 
+    bool b_name = p_i->psz_name == NULL;
+
     if( p_i->psz_name )
         ;
     else
@@ -393,7 +401,19 @@ void input_item_SetURI( input_item_t *p_i, const char *psz_uri )
             p_i->psz_name=NULL; /* recover from undefined value */
     }
 
+    /* The name was derived from the URI: copy it for the event */
+    if( b_name && p_i->psz_name != NULL )
+        psz_name = strdup( p_i->psz_name );
+
     vlc_mutex_unlock( &p_i->lock );
+
+    if( psz_name != NULL )
+    {
+        vlc_event_send( &p_i->event_manager, &(vlc_event_t) {
+            .type = vlc_InputItemNameChanged,
+            .u.input_item_name_changed.new_name = psz_name } );
+        free( psz_name );
+    }
 }
 
 mtime_t input_item_GetDuration( input_item_t *p_i )
@@ -1068,6 +1088,7 @@ input_item_NewExt( const char *psz_uri, const char *psz_name,
     vlc_event_manager_t * p_em = &p_input->event_manager;
 
     vlc_mutex_init( &p_input->lock );
+    vlc_event_manager_init( p_em, p_input );
 
     p_input->psz_name = NULL;
     if( psz_name )
@@ -1095,8 +1116,6 @@ input_item_NewExt( const char *psz_uri, const char *psz_name,
     TAB_INIT( p_input->i_epg, p_input->pp_epg );
     TAB_INIT( p_input->i_slaves, p_input->pp_slaves );
 
-    vlc_event_manager_init( p_em, p_input );
-
     if( type != ITEM_TYPE_UNKNOWN )
         p_input->i_type = type;
     p_input->b_error_when_reading = false;
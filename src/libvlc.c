@@ -60,12 +60,14 @@
 #include <vlc_keystore.h>
 #include <vlc_fs.h>
 #include <vlc_cpu.h>
+#include <vlc_block.h>
 #include <vlc_url.h>
 #include <vlc_modules.h>
 
 #include "libvlc.h"
 #include "playlist/playlist_internal.h"
 #include "misc/variables.h"
+#include "misc/frame_trace.h"
 
 #include <vlc_vlm.h>
 
@@ -93,6 +95,8 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv = libvlc_priv (p_libvlc);
     priv->playlist = NULL;
     priv->p_vlm = NULL;
+    priv->slices = NULL;
+    priv->slices_init = false;
 
     vlc_ExitInit( &priv->exit );
 
@@ -231,6 +235,17 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
 
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
 
+    if( var_InheritBool( p_libvlc, "block-pool" ) )
+        block_PoolSetEnabled( true );
+
+    char *psz_trace = var_InheritString( p_libvlc, "frame-trace" );
+    if( psz_trace != NULL )
+    {
+        if( vlc_frame_trace_Start() )
+            msg_Err( p_libvlc, "cannot start frame tracing" );
+        free( psz_trace );
+    }
+
     /*
      * Initialize hotkey handling
      */
@@ -416,8 +431,28 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if (priv->parser != NULL)
         playlist_preparser_Delete(priv->parser);
 
+    if (priv->slices != NULL)
+        vlc_SlicePoolDestroy(priv->slices);
+
     libvlc_InternalActionsClean( p_libvlc );
 
+    if( var_InheritBool( p_libvlc, "block-pool" ) )
+    {
+        block_pool_stats_t stats;
+
+        block_PoolGetStats( &stats );
+        msg_Dbg( p_libvlc, "block pool: %"PRIu64" hits, %"PRIu64" misses, "
+                 "%zu bytes retained", stats.hits, stats.misses,
+                 stats.retained );
+    }
+
+    char *psz_trace = var_InheritString( p_libvlc, "frame-trace" );
+    if( psz_trace != NULL )
+    {
+        vlc_frame_trace_Stop( VLC_OBJECT(p_libvlc), psz_trace );
+        free( psz_trace );
+    }
+
     /* Save the configuration */
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
@@ -501,7 +536,10 @@ int vlc_MetadataRequest(libvlc_int_t *libvlc, input_item_t *item,
         item->b_preparse_interact = true;
         vlc_mutex_unlock( &item->lock );
     }
-    playlist_preparser_Push( priv->parser, item, i_options, timeout, id );
+    playlist_preparser_Push( priv->parser, item, i_options, timeout, id,
+                             i_options & META_REQUEST_OPTION_DO_INTERACT
+                                 ? PREPARSER_PRIORITY_USER
+                                 : PREPARSER_PRIORITY_BACKGROUND );
     return VLC_SUCCESS;
 
 }
@@ -526,7 +564,8 @@ int libvlc_MetadataRequest(libvlc_int_t *libvlc, input_item_t *item,
     if( i_options & META_REQUEST_OPTION_DO_INTERACT )
         item->b_preparse_interact = true;
     vlc_mutex_unlock( &item->lock );
-    playlist_preparser_Push( priv->parser, item, i_options, timeout, id );
+    playlist_preparser_Push( priv->parser, item, i_options, timeout, id,
+                             PREPARSER_PRIORITY_USER );
     return VLC_SUCCESS;
 }
 
@@ -191,6 +191,8 @@ typedef struct libvlc_priv_t
     struct playlist_t *playlist; ///< Playlist for interfaces
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     vlc_actions_t *actions; ///< Hotkeys handler
+    struct vlc_slice_pool *slices; ///< Video filter threads (or NULL)
+    bool slices_init; ///< Whether the video filter threads were set up
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -207,6 +209,8 @@ void intf_DestroyAll( libvlc_int_t * );
 
 #define libvlc_stats( o ) (libvlc_priv((VLC_OBJECT(o))->obj.libvlc)->b_stats)
 
+void vlc_SlicePoolDestroy(struct vlc_slice_pool *);
+
 int vlc_MetadataRequest(libvlc_int_t *libvlc, input_item_t *item,
                         input_item_meta_request_option_t i_options,
                         int timeout, void *id);
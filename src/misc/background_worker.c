@@ -15,7 +15,6 @@
  * along with this program; if not, write to the Free Software Foundation,
  * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
  *****************************************************************************/
-
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
 #endif
@@ -32,6 +31,17 @@ struct bg_queued_item {
     void* id; /**< id associated with entity */
     void* entity; /**< the entity to process */
     int timeout; /**< timeout duration in microseconds */
+    int priority; /**< higher values are processed first */
+    uint64_t seq; /**< push order, to keep equal priorities FIFO */
+};
+
+struct bg_thread {
+    struct background_worker* owner;
+    vlc_cond_t wait; /**< wait for probe request or cancelation */
+    struct bg_queued_item* item; /**< current task, NULL if idle */
+    mtime_t deadline; /**< deadline of the current task */
+    bool probe_request; /**< true if a probe is requested */
+    bool cancel; /**< true if the current task shall be stopped */
 };
 
 struct background_worker {
@@ -39,144 +49,277 @@ struct background_worker {
     struct background_worker_config conf;
 
     vlc_mutex_t lock; /**< acquire to inspect members that follow */
-    struct {
-        bool probe_request; /**< true if a probe is requested */
-        vlc_cond_t wait; /**< wait for update in terms of head */
-        vlc_cond_t worker_wait; /**< wait for probe request or cancelation */
-        mtime_t deadline; /**< deadline of the current task */
-        void* id; /**< id of the current task */
-        bool active; /**< true if there is an active thread */
-    } head;
-
-    struct {
-        vlc_cond_t wait; /**< wait for update in terms of tail */
-        vlc_array_t data; /**< queue of pending entities to process */
-    } tail;
+    vlc_cond_t head_wait; /**< wait for a task to end or a thread to exit */
+    vlc_cond_t tail_wait; /**< wait for new entities to process */
+
+    vlc_array_t threads; /**< running threads (struct bg_thread) */
+    unsigned idle; /**< number of threads waiting for entities */
+    bool closing; /**< true if the threads shall exit as soon as possible */
+
+    vlc_array_t queue; /**< binary heap of pending entities */
+    uint64_t seq; /**< sequence number of the next pushed entity */
 };
 
-static void* Thread( void* data )
+/* Returns true if a shall be processed before b */
+static bool QueueBefore( const struct bg_queued_item* a,
+                         const struct bg_queued_item* b )
+{
+    if( a->priority != b->priority )
+        return a->priority > b->priority;
+    return a->seq < b->seq;
+}
+
+static void QueueSiftUp( vlc_array_t* queue, size_t i )
+{
+    void** heap = queue->pp_elems;
+
+    while( i > 0 )
+    {
+        size_t parent = ( i - 1 ) / 2;
+
+        if( !QueueBefore( heap[i], heap[parent] ) )
+            break;
+
+        void* tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void QueueSiftDown( vlc_array_t* queue, size_t i )
 {
-    struct background_worker* worker = data;
+    void** heap = queue->pp_elems;
+    size_t count = vlc_array_count( queue );
 
     for( ;; )
     {
-        struct bg_queued_item* item = NULL;
-        void* handle;
+        size_t first = i;
+        size_t left = 2 * i + 1, right = left + 1;
+
+        if( left < count && QueueBefore( heap[left], heap[first] ) )
+            first = left;
+        if( right < count && QueueBefore( heap[right], heap[first] ) )
+            first = right;
+        if( first == i )
+            break;
 
-        vlc_mutex_lock( &worker->lock );
-        for( ;; )
+        void* tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+static int QueuePush( vlc_array_t* queue, struct bg_queued_item* item )
+{
+    if( vlc_array_append( queue, item ) )
+        return VLC_ENOMEM;
+
+    QueueSiftUp( queue, vlc_array_count( queue ) - 1 );
+    return VLC_SUCCESS;
+}
+
+static struct bg_queued_item* QueuePop( vlc_array_t* queue )
+{
+    size_t count = vlc_array_count( queue );
+
+    if( count == 0 )
+        return NULL;
+
+    struct bg_queued_item* item = vlc_array_item_at_index( queue, 0 );
+
+    queue->pp_elems[0] = queue->pp_elems[count - 1];
+    vlc_array_remove( queue, count - 1 );
+    QueueSiftDown( queue, 0 );
+    return item;
+}
+
+static void QueueRemove( struct background_worker* worker, void* id )
+{
+    vlc_array_t* queue = &worker->queue;
+    size_t count = vlc_array_count( queue );
+    size_t kept = 0;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        struct bg_queued_item* item = vlc_array_item_at_index( queue, i );
+
+        if( id == NULL || item->id == id )
         {
-            if( vlc_array_count( &worker->tail.data ) )
-            {
-                item = vlc_array_item_at_index( &worker->tail.data, 0 );
-                handle = NULL;
+            worker->conf.pf_release( item->entity );
+            free( item );
+        }
+        else
+            queue->pp_elems[kept++] = item;
+    }
 
-                vlc_array_remove( &worker->tail.data, 0 );
-            }
+    if( kept == count )
+        return;
 
-            if( worker->head.deadline == VLC_TS_0 && item == NULL )
-                worker->head.active = false;
-            worker->head.id = item ? item->id : NULL;
-            vlc_cond_broadcast( &worker->head.wait );
+    /* Shrink the array, then restore the heap property bottom-up */
+    while( vlc_array_count( queue ) > kept )
+        vlc_array_remove( queue, vlc_array_count( queue ) - 1 );
+    for( size_t i = kept / 2; i-- > 0; )
+        QueueSiftDown( queue, i );
+}
 
-            if( item )
-            {
-                if( item->timeout > 0 )
-                    worker->head.deadline = mdate() + item->timeout * 1000;
-                else
-                    worker->head.deadline = INT64_MAX;
-            }
-            else if( worker->head.deadline != VLC_TS_0 )
-            {
-                /* Wait 1 seconds for new inputs before terminating */
-                mtime_t deadline = mdate() + INT64_C(1000000);
-                int ret = vlc_cond_timedwait( &worker->tail.wait,
-                                              &worker->lock, deadline );
-                if( ret != 0 )
-                {
-                    /* Timeout: if there is still no items, the thread will be
-                     * terminated at next loop iteration (active = false). */
-                    worker->head.deadline = VLC_TS_0;
-                }
-                continue;
-            }
+static void RunTask( struct bg_thread* thread, struct bg_queued_item* item )
+{
+    struct background_worker* worker = thread->owner;
+    void* handle;
+
+    if( worker->conf.pf_start( worker->owner, item->entity, &handle ) )
+        return;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &worker->lock );
+
+        bool const b_timeout = thread->deadline <= mdate();
+        bool const b_cancel = thread->cancel;
+        thread->probe_request = false;
+
+        vlc_mutex_unlock( &worker->lock );
+
+        if( b_timeout || b_cancel ||
+            worker->conf.pf_probe( worker->owner, handle ) )
+        {
+            worker->conf.pf_stop( worker->owner, handle );
             break;
         }
 
-        if( !worker->head.active )
+        vlc_mutex_lock( &worker->lock );
+        if( thread->probe_request == false && thread->cancel == false &&
+            thread->deadline > mdate() )
         {
-            vlc_mutex_unlock( &worker->lock );
-            break;
+            vlc_cond_timedwait( &thread->wait, &worker->lock,
+                                thread->deadline );
         }
         vlc_mutex_unlock( &worker->lock );
+    }
+}
 
-        assert( item != NULL );
+static void* Thread( void* data )
+{
+    struct bg_thread* thread = data;
+    struct background_worker* worker = thread->owner;
 
-        if( worker->conf.pf_start( worker->owner, item->entity, &handle ) )
-        {
-            worker->conf.pf_release( item->entity );
-            free( item );
-            continue;
-        }
+    vlc_mutex_lock( &worker->lock );
+    for( ;; )
+    {
+        struct bg_queued_item* item = QueuePop( &worker->queue );
 
-        for( ;; )
+        if( item == NULL )
         {
-            vlc_mutex_lock( &worker->lock );
+            if( worker->closing )
+                break;
 
-            bool const b_timeout = worker->head.deadline <= mdate();
-            worker->head.probe_request = false;
+            /* Wait 1 seconds for new inputs before terminating */
+            mtime_t deadline = mdate() + INT64_C(1000000);
+            int ret;
 
-            vlc_mutex_unlock( &worker->lock );
+            worker->idle++;
+            ret = vlc_cond_timedwait( &worker->tail_wait, &worker->lock,
+                                      deadline );
+            worker->idle--;
 
-            if( b_timeout ||
-                worker->conf.pf_probe( worker->owner, handle ) )
-            {
-                worker->conf.pf_stop( worker->owner, handle );
-                worker->conf.pf_release( item->entity );
-                free( item );
+            if( ret != 0 && vlc_array_count( &worker->queue ) == 0 )
                 break;
-            }
-
-            vlc_mutex_lock( &worker->lock );
-            if( worker->head.probe_request == false &&
-                worker->head.deadline > mdate() )
-            {
-                vlc_cond_timedwait( &worker->head.worker_wait, &worker->lock,
-                                     worker->head.deadline );
-            }
-            vlc_mutex_unlock( &worker->lock );
+            continue;
         }
+
+        thread->item = item;
+        thread->probe_request = false;
+        thread->cancel = false;
+        if( item->timeout > 0 )
+            thread->deadline = mdate() + item->timeout * 1000;
+        else
+            thread->deadline = INT64_MAX;
+        vlc_mutex_unlock( &worker->lock );
+
+        RunTask( thread, item );
+        worker->conf.pf_release( item->entity );
+        free( item );
+
+        vlc_mutex_lock( &worker->lock );
+        thread->item = NULL;
+        vlc_cond_broadcast( &worker->head_wait );
     }
 
+    vlc_array_remove( &worker->threads,
+        vlc_array_index_of_item( &worker->threads, thread ) );
+    vlc_cond_broadcast( &worker->head_wait );
+    vlc_mutex_unlock( &worker->lock );
+
+    vlc_cond_destroy( &thread->wait );
+    free( thread );
     return NULL;
 }
 
+/* Spawns a new thread unless enough idle threads are left for the queued
+ * entities and the one about to be queued. Returns false if no thread can
+ * process the queue. The new thread will not pick any entity before the lock
+ * is released. */
+static bool SpawnThread( struct background_worker* worker )
+{
+    size_t count = vlc_array_count( &worker->threads );
+
+    /* Woken idle threads remain counted until they get the lock back */
+    if( vlc_array_count( &worker->queue ) < worker->idle ||
+        count >= worker->conf.max_threads )
+        return count > 0;
+
+    struct bg_thread* thread = malloc( sizeof( *thread ) );
+    if( unlikely( !thread ) )
+        return count > 0;
+
+    thread->owner = worker;
+    thread->item = NULL;
+    vlc_cond_init( &thread->wait );
+
+    if( vlc_array_append( &worker->threads, thread ) )
+        goto error;
+
+    if( vlc_clone_detach( NULL, Thread, thread, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_array_remove( &worker->threads, count );
+        goto error;
+    }
+    return true;
+
+error:
+    vlc_cond_destroy( &thread->wait );
+    free( thread );
+    return count > 0;
+}
+
 static void BackgroundWorkerCancel( struct background_worker* worker, void* id)
 {
     vlc_mutex_lock( &worker->lock );
-    for( size_t i = 0; i < vlc_array_count( &worker->tail.data ); )
+    QueueRemove( worker, id );
+
+    for( ;; )
     {
-        struct bg_queued_item* item =
-            vlc_array_item_at_index( &worker->tail.data, i );
+        bool running = false;
 
-        if( id == NULL || item->id == id )
+        for( size_t i = 0; i < vlc_array_count( &worker->threads ); ++i )
         {
-            vlc_array_remove( &worker->tail.data, i );
-            worker->conf.pf_release( item->entity );
-            free( item );
-            continue;
-        }
+            struct bg_thread* thread =
+                vlc_array_item_at_index( &worker->threads, i );
 
-        ++i;
-    }
+            if( thread->item != NULL &&
+                ( id == NULL || thread->item->id == id ) )
+            {
+                thread->cancel = true;
+                vlc_cond_signal( &thread->wait );
+                running = true;
+            }
+        }
 
-    while( ( id == NULL && worker->head.active )
-        || ( id != NULL && worker->head.id == id ) )
-    {
-        worker->head.deadline = VLC_TS_0;
-        vlc_cond_signal( &worker->head.worker_wait );
-        vlc_cond_signal( &worker->tail.wait );
-        vlc_cond_wait( &worker->head.wait, &worker->lock );
+        if( !running )
+            break;
+        vlc_cond_wait( &worker->head_wait, &worker->lock );
     }
     vlc_mutex_unlock( &worker->lock );
 }
@@ -190,23 +333,25 @@ struct background_worker* background_worker_New( void* owner,
         return NULL;
 
     worker->conf = *conf;
+    if( worker->conf.max_threads == 0 )
+        worker->conf.max_threads = 1;
     worker->owner = owner;
-    worker->head.id = NULL;
-    worker->head.active = false;
-    worker->head.deadline = VLC_TS_INVALID;
+    worker->idle = 0;
+    worker->closing = false;
+    worker->seq = 0;
 
     vlc_mutex_init( &worker->lock );
-    vlc_cond_init( &worker->head.wait );
-    vlc_cond_init( &worker->head.worker_wait );
+    vlc_cond_init( &worker->head_wait );
+    vlc_cond_init( &worker->tail_wait );
 
-    vlc_array_init( &worker->tail.data );
-    vlc_cond_init( &worker->tail.wait );
+    vlc_array_init( &worker->threads );
+    vlc_array_init( &worker->queue );
 
     return worker;
 }
 
 int background_worker_Push( struct background_worker* worker, void* entity,
-                        void* id, int timeout )
+                        void* id, int timeout, int priority )
 {
     struct bg_queued_item* item = malloc( sizeof( *item ) );
 
@@ -216,30 +361,23 @@ int background_worker_Push( struct background_worker* worker, void* entity,
     item->id = id;
     item->entity = entity;
     item->timeout = timeout < 0 ? worker->conf.default_timeout : timeout;
+    item->priority = priority;
 
     vlc_mutex_lock( &worker->lock );
-    int i_ret = vlc_array_append( &worker->tail.data, item );
-    vlc_cond_signal( &worker->tail.wait );
-    if( i_ret != 0 )
+    item->seq = worker->seq++;
+
+    if( !SpawnThread( worker ) || QueuePush( &worker->queue, item ) )
     {
+        vlc_mutex_unlock( &worker->lock );
         free( item );
         return VLC_EGENERIC;
     }
 
-    if( worker->head.active == false )
-    {
-        worker->head.probe_request = false;
-        worker->head.active =
-            !vlc_clone_detach( NULL, Thread, worker, VLC_THREAD_PRIORITY_LOW );
-    }
-
-    if( worker->head.active )
-        worker->conf.pf_hold( item->entity );
-
-    int ret = worker->head.active ? VLC_SUCCESS : VLC_EGENERIC;
+    worker->conf.pf_hold( item->entity );
+    vlc_cond_signal( &worker->tail_wait );
     vlc_mutex_unlock( &worker->lock );
 
-    return ret;
+    return VLC_SUCCESS;
 }
 
 void background_worker_Cancel( struct background_worker* worker, void* id )
@@ -250,18 +388,33 @@ void background_worker_Cancel( struct background_worker* worker, void* id )
 void background_worker_RequestProbe( struct background_worker* worker )
 {
     vlc_mutex_lock( &worker->lock );
-    worker->head.probe_request = true;
-    vlc_cond_signal( &worker->head.worker_wait );
+    for( size_t i = 0; i < vlc_array_count( &worker->threads ); ++i )
+    {
+        struct bg_thread* thread =
+            vlc_array_item_at_index( &worker->threads, i );
+
+        thread->probe_request = true;
+        vlc_cond_signal( &thread->wait );
+    }
     vlc_mutex_unlock( &worker->lock );
 }
 
 void background_worker_Delete( struct background_worker* worker )
 {
     BackgroundWorkerCancel( worker, NULL );
-    vlc_array_clear( &worker->tail.data );
+
+    /* Wait for the idle threads to exit, as they refer to the worker */
+    vlc_mutex_lock( &worker->lock );
+    worker->closing = true;
+    vlc_cond_broadcast( &worker->tail_wait );
+    while( vlc_array_count( &worker->threads ) > 0 )
+        vlc_cond_wait( &worker->head_wait, &worker->lock );
+    vlc_mutex_unlock( &worker->lock );
+
+    vlc_array_clear( &worker->threads );
+    vlc_array_clear( &worker->queue );
     vlc_mutex_destroy( &worker->lock );
-    vlc_cond_destroy( &worker->head.wait );
-    vlc_cond_destroy( &worker->head.worker_wait );
-    vlc_cond_destroy( &worker->tail.wait );
+    vlc_cond_destroy( &worker->head_wait );
+    vlc_cond_destroy( &worker->tail_wait );
     free( worker );
 }
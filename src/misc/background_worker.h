@@ -29,6 +29,15 @@ struct background_worker_config {
      **/
     mtime_t default_timeout;
 
+    /**
+     * Maximum number of tasks running concurrently
+     *
+     * Each running task is driven by its own thread. Threads are spawned on
+     * demand, up to this limit, and terminate after being idle for a second.
+     * `0` is treated as `1`.
+     **/
+    unsigned max_threads;
+
     /**
      * Release an entity
      *
@@ -119,10 +128,10 @@ struct background_worker* background_worker_New( void* owner,
     struct background_worker_config* config );
 
 /**
- * Request the background-worker to probe the current task
+ * Request the background-worker to probe the running tasks
  *
  * This function is used to signal the background-worker that it should do
- * another probe to see whether the current task is still alive.
+ * another probe to see whether the running tasks are still alive.
  *
  * \warning Note that the function will not wait for the probing to finish, it
  *          will simply ask the background worker to recheck it as soon as
@@ -136,8 +145,9 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * Push an entity into the background-worker
  *
  * This function is used to push an entity into the queue of pending work. The
- * entities will be processed in the order in which they are received (in terms
- * of the order of invocations in a single-threaded environment).
+ * entities with the highest priority are processed first; entities of equal
+ * priority will be processed in the order in which they are received (in
+ * terms of the order of invocations in a single-threaded environment).
  *
  * \param worker the background-worker
  * \param entity the entity which is to be queued
@@ -145,11 +155,13 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * \param timeout the timeout of the entity in milliseconds, `0` denotes no
  *                timeout, a negative value will use the default timeout
  *                associated with the background-worker.
+ * \param priority the priority of the entity, higher values jump ahead of
+ *                 lower ones in the queue of pending entities
  * \return VLC_SUCCESS if the entity was successfully queued, an error-code on
  *         failure.
  **/
 int background_worker_Push( struct background_worker* worker, void* entity,
-    void* id, int timeout );
+    void* id, int timeout, int priority );
 
 /**
  * Remove entities from the background-worker
@@ -158,12 +170,13 @@ int background_worker_Push( struct background_worker* worker, void* entity,
  * associated id, or to remove all queued (including currently running)
  * entities.
  *
- * \warning if the `id` passed refers to an entity that is currently being
- *          processed, the call will block until the task has been terminated.
+ * \warning if the `id` passed refers to entities that are currently being
+ *          processed, the call will block until their tasks have been
+ *          terminated.
  *
  * \param worker the background-worker
  * \param id NULL if every entity shall be removed, and the currently running
- *        task (if any) shall be cancelled.
+ *        tasks (if any) shall be cancelled.
  **/
 void background_worker_Cancel( struct background_worker* worker, void* id );
 
@@ -171,11 +184,11 @@ void background_worker_Cancel( struct background_worker* worker, void* id );
  * Delete a background-worker
  *
  * This function will destroy a background-worker created through \ref
- * background_worker_New. It will effectively stop the currently running task,
+ * background_worker_New. It will effectively stop the currently running tasks,
  * if any, and empty the queue of pending entities.
  *
- * \warning If there is a currently running task, the function will block until
- *          it has been stopped.
+ * \warning If there are currently running tasks, the function will block until
+ *          they have been stopped, and until every thread has terminated.
  *
  * \param worker the background-worker
  **/
@@ -34,6 +34,7 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
 
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
@@ -117,6 +118,307 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/*** Block pool ***/
+
+/** Payload sizes of the pooled blocks */
+static const size_t block_pool_sizes[] = {
+    188,   /* MPEG-TS packet */
+    1316,  /* 7 MPEG-TS packets, as in a typical UDP/RTP datagram */
+    1500,  /* Ethernet MTU */
+    4608,  /* 1152 stereo 16-bits samples (MPEG audio) */
+    8192,  /* 1024 stereo float samples (AAC) */
+    16384,
+    65536,
+};
+
+#define BLOCK_POOL_CLASSES ARRAY_SIZE(block_pool_sizes)
+
+/** Overhead of a block allocated by block_Alloc(). */
+#define BLOCK_OVERHEAD (sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING))
+
+/** Maximum bytes of free blocks per thread and per size class. */
+#define BLOCK_POOL_CACHE_BYTES (1 << 20)
+/** Maximum count of free blocks per thread and per size class. */
+#define BLOCK_POOL_CACHE_MAX   64
+/** Maximum count of batches in the depot per size class. */
+#define BLOCK_POOL_DEPOT_MAX   8
+
+struct block_pool_cache
+{
+    struct
+    {
+        block_t *head;
+        unsigned count;
+    } classes[BLOCK_POOL_CLASSES];
+    /* Not yet published statistics */
+    uint64_t hits;
+    uint64_t misses;
+    ssize_t retained;
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    struct
+    {
+        block_t *head;
+        unsigned count;
+    } depot[BLOCK_POOL_CLASSES];
+    vlc_threadvar_t key;
+    bool has_key;
+    atomic_bool enabled;
+
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_size_t retained;
+} block_pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .has_key = false,
+    .enabled = ATOMIC_VAR_INIT(false),
+    .hits = ATOMIC_VAR_INIT(0),
+    .misses = ATOMIC_VAR_INIT(0),
+    .retained = ATOMIC_VAR_INIT(0),
+};
+
+static size_t block_pool_Alloc(unsigned c)
+{
+    return BLOCK_OVERHEAD + block_pool_sizes[c];
+}
+
+/** Maximum count of free blocks in a thread cache */
+static unsigned block_pool_CacheMax(unsigned c)
+{
+    unsigned max = BLOCK_POOL_CACHE_BYTES / block_pool_Alloc(c);
+
+    if (max > BLOCK_POOL_CACHE_MAX)
+        max = BLOCK_POOL_CACHE_MAX;
+    if (max < 4)
+        max = 4;
+    return max;
+}
+
+/** Returns the size class for a payload size, or -1 if none */
+static int block_pool_Class(size_t size)
+{
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+        if (size <= block_pool_sizes[c])
+            return c;
+    return -1;
+}
+
+/** Publishes the statistics of a thread cache (with the pool lock held) */
+static void block_pool_Publish(struct block_pool_cache *cache)
+{
+    atomic_fetch_add_explicit(&block_pool.hits, cache->hits,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&block_pool.misses, cache->misses,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&block_pool.retained, cache->retained,
+                              memory_order_relaxed);
+    cache->hits = cache->misses = 0;
+    cache->retained = 0;
+}
+
+/**
+ * Moves a chain of free blocks to the depot (with the pool lock held).
+ * The blocks are freed if the depot is full or the pool is disabled.
+ */
+static void block_pool_Deposit(unsigned c, block_t *head, unsigned count)
+{
+    const unsigned max = BLOCK_POOL_DEPOT_MAX * block_pool_CacheMax(c) / 2;
+    const size_t size = block_pool_Alloc(c);
+
+    while (head != NULL)
+    {
+        block_t *next = head->p_next;
+
+        if (block_pool.depot[c].count < max
+         && atomic_load_explicit(&block_pool.enabled, memory_order_relaxed))
+        {
+            head->p_next = block_pool.depot[c].head;
+            block_pool.depot[c].head = head;
+            block_pool.depot[c].count++;
+        }
+        else
+        {
+            atomic_fetch_sub_explicit(&block_pool.retained, size,
+                                      memory_order_relaxed);
+            free(head);
+        }
+        head = next;
+        count--;
+    }
+    assert(count == 0);
+}
+
+static void block_pool_CacheDestroy(void *data)
+{
+    struct block_pool_cache *cache = data;
+
+    vlc_mutex_lock(&block_pool.lock);
+    block_pool_Publish(cache);
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+        block_pool_Deposit(c, cache->classes[c].head,
+                           cache->classes[c].count);
+    vlc_mutex_unlock(&block_pool.lock);
+    free(cache);
+}
+
+/** Gets the cache of the calling thread, or NULL if pooling is disabled */
+static struct block_pool_cache *block_pool_GetCache(void)
+{
+    if (!atomic_load_explicit(&block_pool.enabled, memory_order_acquire))
+        return NULL;
+
+    struct block_pool_cache *cache = vlc_threadvar_get(block_pool.key);
+    if (likely(cache != NULL))
+        return cache;
+
+    cache = calloc(1, sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+    if (unlikely(vlc_threadvar_set(block_pool.key, cache)))
+    {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+static void block_pool_Release(block_t *block)
+{
+    assert(block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate(block);
+
+    int c = block_pool_Class(block->i_size + sizeof (block_t)
+                             - BLOCK_OVERHEAD);
+    assert(c >= 0 && block_pool_Alloc(c) == block->i_size + sizeof (block_t));
+
+    struct block_pool_cache *cache = block_pool_GetCache();
+    if (cache == NULL)
+    {   /* Pool disabled in the mean time */
+        free(block);
+        return;
+    }
+
+    block->p_next = cache->classes[c].head;
+    cache->classes[c].head = block;
+    cache->retained += block_pool_Alloc(c);
+
+    const unsigned max = block_pool_CacheMax(c);
+    if (++cache->classes[c].count <= max)
+        return;
+
+    /* Keep the most recently used half, return the rest to the depot */
+    block_t **pp = &cache->classes[c].head;
+    for (unsigned i = 0; i < max / 2; i++)
+        pp = &(*pp)->p_next;
+
+    block_t *batch = *pp;
+    unsigned count = cache->classes[c].count - max / 2;
+
+    *pp = NULL;
+    cache->classes[c].count = max / 2;
+
+    vlc_mutex_lock(&block_pool.lock);
+    block_pool_Publish(cache);
+    block_pool_Deposit(c, batch, count);
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
+/** Allocates a block of the given size class */
+static block_t *block_pool_Get(unsigned c)
+{
+    struct block_pool_cache *cache = block_pool_GetCache();
+    if (cache == NULL)
+        return malloc(block_pool_Alloc(c));
+
+    if (cache->classes[c].head == NULL)
+    {   /* Refill half of the cache from the depot */
+        const unsigned want = block_pool_CacheMax(c) / 2;
+
+        vlc_mutex_lock(&block_pool.lock);
+        block_pool_Publish(cache);
+        while (cache->classes[c].count < want
+            && block_pool.depot[c].head != NULL)
+        {
+            block_t *block = block_pool.depot[c].head;
+
+            block_pool.depot[c].head = block->p_next;
+            block_pool.depot[c].count--;
+            block->p_next = cache->classes[c].head;
+            cache->classes[c].head = block;
+            cache->classes[c].count++;
+        }
+        vlc_mutex_unlock(&block_pool.lock);
+    }
+
+    block_t *block = cache->classes[c].head;
+    if (block != NULL)
+    {
+        cache->classes[c].head = block->p_next;
+        cache->classes[c].count--;
+        cache->retained -= block_pool_Alloc(c);
+        cache->hits++;
+        return block;
+    }
+
+    cache->misses++;
+    return malloc(block_pool_Alloc(c));
+}
+
+void block_PoolSetEnabled(bool enabled)
+{
+    vlc_mutex_lock(&block_pool.lock);
+    if (enabled && !block_pool.has_key)
+    {
+        if (vlc_threadvar_create(&block_pool.key, block_pool_CacheDestroy))
+            enabled = false;
+        else
+            block_pool.has_key = true;
+    }
+
+    atomic_store_explicit(&block_pool.enabled, enabled, memory_order_release);
+
+    if (!enabled)
+    {   /* Free the depot */
+        for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+        {
+            block_t *head = block_pool.depot[c].head;
+
+            block_pool.depot[c].head = NULL;
+            block_pool.depot[c].count = 0;
+            while (head != NULL)
+            {
+                block_t *next = head->p_next;
+
+                atomic_fetch_sub_explicit(&block_pool.retained,
+                                          block_pool_Alloc(c),
+                                          memory_order_relaxed);
+                free(head);
+                head = next;
+            }
+        }
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
+void block_PoolGetStats(block_pool_stats_t *stats)
+{
+    struct block_pool_cache *cache = block_pool_GetCache();
+
+    vlc_mutex_lock(&block_pool.lock);
+    if (cache != NULL)
+        block_pool_Publish(cache);
+    stats->hits = atomic_load_explicit(&block_pool.hits,
+                                       memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&block_pool.misses,
+                                         memory_order_relaxed);
+    stats->retained = atomic_load_explicit(&block_pool.retained,
+                                           memory_order_relaxed);
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
 block_t *block_Alloc (size_t size)
 {
     if (unlikely(size >> 27))
@@ -126,12 +428,28 @@ block_t *block_Alloc (size_t size)
     }
 
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = BLOCK_OVERHEAD + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b;
+    block_free_t release;
+    int c = -1;
+
+    if (atomic_load_explicit(&block_pool.enabled, memory_order_relaxed))
+        c = block_pool_Class(size);
+
+    if (c >= 0)
+    {
+        alloc = block_pool_Alloc(c);
+        b = block_pool_Get(c);
+        release = block_pool_Release;
+    }
+    else
+    {
+        b = malloc (alloc);
+        release = block_generic_Release;
+    }
     if (unlikely(b == NULL))
         return NULL;
 
@@ -141,10 +459,110 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
+/*** Shared blocks ***/
+
+/** Payload referenced by shared blocks */
+typedef struct
+{
+    atomic_uint refs;
+    block_t *origin; /**< Block owning the payload memory */
+} block_payload_t;
+
+typedef struct
+{
+    block_t self;
+    block_payload_t *payload;
+} block_shared_t;
+
+static void block_shared_Release(block_t *block)
+{
+    block_shared_t *sh = container_of(block, block_shared_t, self);
+    block_payload_t *payload = sh->payload;
+
+    block_Invalidate(block);
+    free(sh);
+
+    if (atomic_fetch_sub_explicit(&payload->refs, 1,
+                                  memory_order_acq_rel) == 1)
+    {
+        block_Release(payload->origin);
+        free(payload);
+    }
+}
+
+/** Whether the payload of a block is also referenced by other blocks */
+static bool block_IsShared(const block_t *block)
+{
+    if (block->pf_release != block_shared_Release)
+        return false;
+
+    const block_shared_t *sh = container_of(block, block_shared_t, self);
+    return atomic_load_explicit(&sh->payload->refs,
+                                memory_order_acquire) > 1;
+}
+
+block_t *block_Shareable(block_t *block)
+{
+    block_Check(block);
+
+    if (block->pf_release == block_shared_Release)
+        return block;
+
+    block_shared_t *sh = malloc(sizeof (*sh));
+    block_payload_t *payload = malloc(sizeof (*payload));
+    if (unlikely(sh == NULL || payload == NULL))
+    {
+        free(payload);
+        free(sh);
+        block_Release(block);
+        return NULL;
+    }
+
+    atomic_init(&payload->refs, 1);
+    payload->origin = block;
+
+    block_Init(&sh->self, block->p_start, block->i_size);
+    sh->self.p_buffer = block->p_buffer;
+    sh->self.i_buffer = block->i_buffer;
+    BlockMetaCopy(&sh->self, block);
+    sh->self.pf_release = block_shared_Release;
+    sh->payload = payload;
+    block->p_next = NULL;
+    return &sh->self;
+}
+
+block_t *block_Share(const block_t *block)
+{
+    block_Check((block_t *)block);
+
+    if (block->pf_release != block_shared_Release)
+    {
+        block_t *dup = block_Alloc(block->i_buffer);
+        if (unlikely(dup == NULL))
+            return NULL;
+
+        memcpy(dup->p_buffer, block->p_buffer, block->i_buffer);
+        BlockMetaCopy(dup, block);
+        dup->p_next = NULL;
+        return dup;
+    }
+
+    const block_shared_t *sh = container_of(block, block_shared_t, self);
+    block_shared_t *dup = malloc(sizeof (*dup));
+    if (unlikely(dup == NULL))
+        return NULL;
+
+    dup->self = sh->self;
+    dup->self.p_next = NULL;
+    dup->payload = sh->payload;
+    atomic_fetch_add_explicit(&dup->payload->refs, 1, memory_order_relaxed);
+    return &dup->self;
+}
+
 block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 {
     block_Check( p_block );
@@ -179,6 +597,19 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 
     size_t requested = i_prebody + i_body;
 
+    if( block_IsShared( p_block ) )
+    {   /* Copy on write: the other blocks keep the current payload */
+        block_t *p_rea = block_Alloc( requested );
+        if( p_rea == NULL )
+            return NULL;
+
+        memcpy( p_rea->p_buffer + i_prebody, p_block->p_buffer,
+                p_block->i_buffer );
+        BlockMetaCopy( p_rea, p_block );
+        block_Release( p_block );
+        return p_rea;
+    }
+
     if( p_block->i_buffer == 0 )
     {   /* Corner case: nothing to preserve */
         if( requested <= p_block->i_size )
@@ -282,7 +713,7 @@ block_t *block_mmap_Alloc (void *addr, size_t length)
 
     long page_mask = sysconf(_SC_PAGESIZE) - 1;
     size_t left = ((uintptr_t)addr) & page_mask;
-    size_t right = (-length) & page_mask;
+    size_t right = (-(left + length)) & page_mask;
 
     block_t *block = malloc (sizeof (*block));
     if (block == NULL)
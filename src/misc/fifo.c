@@ -26,10 +26,12 @@
 #endif
 
 #include <assert.h>
+#include <stdalign.h>
 #include <stdlib.h>
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +235,213 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/**
+ * Internal state for single producer single consumer block queues
+ */
+struct block_ring_t
+{
+    /* Consumer side */
+    alignas (64) atomic_size_t head;
+    size_t              cached_tail; /**< Last tail seen by the consumer */
+    atomic_bool         consumer_sleeping;
+
+    /* Producer side */
+    alignas (64) atomic_size_t tail;
+    size_t              cached_head; /**< Last head seen by the producer */
+    atomic_bool         producer_sleeping;
+
+    alignas (64) vlc_mutex_t lock; /**< Only used for sleeping */
+    vlc_cond_t          wait;
+    size_t              mask;
+    block_t            *blocks[];
+};
+
+block_ring_t *block_RingNew(size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+    {
+        size <<= 1;
+        if (unlikely(size == 0))
+            return NULL;
+    }
+
+    size_t alloc = (sizeof (block_ring_t) + size * sizeof (block_t *) + 63)
+                 & ~(size_t)63;
+    block_ring_t *ring = aligned_alloc(64, alloc);
+    if (unlikely(ring == NULL))
+        return NULL;
+
+    atomic_init(&ring->head, 0);
+    ring->cached_tail = 0;
+    atomic_init(&ring->consumer_sleeping, false);
+    atomic_init(&ring->tail, 0);
+    ring->cached_head = 0;
+    atomic_init(&ring->producer_sleeping, false);
+    vlc_mutex_init(&ring->lock);
+    vlc_cond_init(&ring->wait);
+    ring->mask = size - 1;
+    return ring;
+}
+
+void block_RingRelease(block_ring_t *ring)
+{
+    block_t *block;
+
+    while ((block = block_RingDequeue(ring)) != NULL)
+        block_Release(block);
+
+    vlc_cond_destroy(&ring->wait);
+    vlc_mutex_destroy(&ring->lock);
+    aligned_free(ring);
+}
+
+static bool block_RingPush(block_ring_t *ring, block_t *block)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail - ring->cached_head > ring->mask)
+    {   /* Only touch the consumer cache line when the ring looks full */
+        ring->cached_head = atomic_load_explicit(&ring->head,
+                                                 memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask)
+            return false; /* Full */
+    }
+
+    ring->blocks[tail & ring->mask] = block;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static block_t *block_RingPop(block_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head == ring->cached_tail)
+    {   /* Only touch the producer cache line when the ring looks empty */
+        ring->cached_tail = atomic_load_explicit(&ring->tail,
+                                                 memory_order_acquire);
+        if (head == ring->cached_tail)
+            return NULL; /* Empty */
+    }
+
+    block_t *block = ring->blocks[head & ring->mask];
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return block;
+}
+
+/**
+ * Wakes the other side up if it sleeps.
+ *
+ * The fence pairs with the one in block_RingSleep(): either the sleeper sees
+ * the index update, or we see its flag.
+ */
+static void block_RingWake(block_ring_t *ring, atomic_bool *sleeping)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(sleeping, memory_order_relaxed))
+    {
+        vlc_mutex_lock(&ring->lock);
+        vlc_cond_broadcast(&ring->wait);
+        vlc_mutex_unlock(&ring->lock);
+    }
+}
+
+static void block_RingSleep(block_ring_t *ring, atomic_bool *sleeping)
+{
+    vlc_assert_locked(&ring->lock);
+    atomic_store_explicit(sleeping, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+bool block_RingQueue(block_ring_t *ring, block_t *block)
+{
+    assert(block->p_next == NULL);
+
+    if (!block_RingPush(ring, block))
+        return false;
+
+    block_RingWake(ring, &ring->consumer_sleeping);
+    return true;
+}
+
+block_t *block_RingDequeue(block_ring_t *ring)
+{
+    block_t *block = block_RingPop(ring);
+
+    if (block != NULL)
+        block_RingWake(ring, &ring->producer_sleeping);
+    return block;
+}
+
+static void block_RingPutCleanup(void *data)
+{
+    block_Release(data);
+}
+
+void block_RingPut(block_ring_t *ring, block_t *block)
+{
+    /* The block is not queued if the thread is cancelled */
+    vlc_cleanup_push(block_RingPutCleanup, block);
+    vlc_testcancel();
+
+    if (!block_RingQueue(ring, block))
+    {
+        vlc_mutex_lock(&ring->lock);
+        mutex_cleanup_push(&ring->lock);
+        for (;;)
+        {
+            block_RingSleep(ring, &ring->producer_sleeping);
+            if (block_RingPush(ring, block))
+                break;
+            vlc_cond_wait(&ring->wait, &ring->lock);
+        }
+        atomic_store_explicit(&ring->producer_sleeping, false,
+                              memory_order_relaxed);
+        vlc_cleanup_pop();
+        vlc_mutex_unlock(&ring->lock);
+
+        block_RingWake(ring, &ring->consumer_sleeping);
+    }
+    vlc_cleanup_pop();
+}
+
+block_t *block_RingGet(block_ring_t *ring)
+{
+    block_t *block;
+
+    vlc_testcancel();
+
+    block = block_RingDequeue(ring);
+    if (block != NULL)
+        return block;
+
+    vlc_mutex_lock(&ring->lock);
+    mutex_cleanup_push(&ring->lock);
+    for (;;)
+    {
+        block_RingSleep(ring, &ring->consumer_sleeping);
+        block = block_RingPop(ring);
+        if (block != NULL)
+            break;
+        vlc_cond_wait(&ring->wait, &ring->lock);
+    }
+    atomic_store_explicit(&ring->consumer_sleeping, false,
+                          memory_order_relaxed);
+    vlc_cleanup_pop();
+    vlc_mutex_unlock(&ring->lock);
+
+    block_RingWake(ring, &ring->producer_sleeping);
+    return block;
+}
+
+size_t block_RingGetCount(block_ring_t *ring)
+{
+    size_t head = atomic_load(&ring->head);
+    size_t tail = atomic_load(&ring->tail);
+
+    return tail - head;
+}
@@ -0,0 +1,416 @@
+/*****************************************************************************
+ * frame_trace.c: per-frame pipeline latency tracing
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+#include "frame_trace.h"
+
+/* Events are recorded into a buffer of the calling thread, and moved to the
+ * process-wide event list when the buffer is full or the thread exits. */
+#define FRAME_TRACE_BUFFER 256
+/* Events kept overall (32 bytes each) */
+#define FRAME_TRACE_MAX (1 << 20)
+
+struct vlc_frame_event
+{
+    mtime_t time; /**< When the stage was reached */
+    mtime_t pts;
+    mtime_t date;
+    int es_id;
+    uint8_t stage;
+};
+
+struct frame_trace_buffer
+{
+    unsigned count;
+    struct vlc_frame_event events[FRAME_TRACE_BUFFER];
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    vlc_threadvar_t key;
+    bool has_key;
+    bool running;
+
+    struct vlc_frame_event *events;
+    size_t count;
+    size_t size;
+    uint64_t dropped;
+} frame_trace = {
+    .lock = VLC_STATIC_MUTEX,
+    .has_key = false,
+    .running = false,
+};
+
+atomic_bool vlc_frame_trace_enabled = ATOMIC_VAR_INIT(false);
+
+/** Moves the events of a thread buffer to the list (with the lock held) */
+static void frame_trace_Flush(struct frame_trace_buffer *buf)
+{
+    unsigned count = buf->count;
+
+    buf->count = 0;
+    if (!frame_trace.running)
+        return; /* tracing stopped in the mean time */
+
+    if (frame_trace.size - frame_trace.count < count)
+    {
+        size_t size = frame_trace.size ? 2 * frame_trace.size : 4096;
+        if (size > FRAME_TRACE_MAX)
+            size = FRAME_TRACE_MAX;
+
+        struct vlc_frame_event *events = NULL;
+        if (size > frame_trace.size)
+            events = realloc(frame_trace.events, size * sizeof (*events));
+        if (events != NULL)
+        {
+            frame_trace.events = events;
+            frame_trace.size = size;
+        }
+    }
+
+    if (frame_trace.size - frame_trace.count < count)
+    {
+        unsigned room = frame_trace.size - frame_trace.count;
+
+        frame_trace.dropped += count - room;
+        count = room;
+    }
+
+    if (count > 0)
+        memcpy(frame_trace.events + frame_trace.count, buf->events,
+               count * sizeof (*buf->events));
+    frame_trace.count += count;
+}
+
+static void frame_trace_BufferDestroy(void *data)
+{
+    struct frame_trace_buffer *buf = data;
+
+    vlc_mutex_lock(&frame_trace.lock);
+    frame_trace_Flush(buf);
+    vlc_mutex_unlock(&frame_trace.lock);
+    free(buf);
+}
+
+void vlc_frame_trace_Record(enum vlc_frame_stage stage, int es_id,
+                            mtime_t pts, mtime_t date)
+{
+    mtime_t now = mdate();
+    struct frame_trace_buffer *buf = vlc_threadvar_get(frame_trace.key);
+
+    if (unlikely(buf == NULL))
+    {
+        buf = malloc(sizeof (*buf));
+        if (unlikely(buf == NULL))
+            return;
+        if (unlikely(vlc_threadvar_set(frame_trace.key, buf)))
+        {
+            free(buf);
+            return;
+        }
+        buf->count = 0;
+    }
+
+    struct vlc_frame_event *ev = &buf->events[buf->count++];
+
+    ev->time = now;
+    ev->pts = pts;
+    ev->date = date;
+    ev->es_id = es_id;
+    ev->stage = stage;
+
+    if (buf->count == FRAME_TRACE_BUFFER)
+    {
+        vlc_mutex_lock(&frame_trace.lock);
+        frame_trace_Flush(buf);
+        vlc_mutex_unlock(&frame_trace.lock);
+    }
+}
+
+int vlc_frame_trace_Start(void)
+{
+    int ret = VLC_SUCCESS;
+
+    vlc_mutex_lock(&frame_trace.lock);
+    if (!frame_trace.has_key)
+    {
+        if (vlc_threadvar_create(&frame_trace.key, frame_trace_BufferDestroy))
+            ret = VLC_ENOMEM;
+        else
+            frame_trace.has_key = true;
+    }
+
+    if (ret == VLC_SUCCESS && !frame_trace.running)
+    {
+        frame_trace.running = true;
+        frame_trace.count = 0;
+        frame_trace.dropped = 0;
+        atomic_store_explicit(&vlc_frame_trace_enabled, true,
+                              memory_order_release);
+    }
+    vlc_mutex_unlock(&frame_trace.lock);
+    return ret;
+}
+
+/*** Timeline reconstruction ***/
+
+/** Latency between two stages */
+static const struct
+{
+    const char *name;
+    enum vlc_frame_stage from, to;
+} frame_spans[] = {
+    { "queue",   VLC_FRAME_DEMUX,   VLC_FRAME_DECODE },
+    { "decode",  VLC_FRAME_DECODE,  VLC_FRAME_DECODED },
+    { "render",  VLC_FRAME_DECODED, VLC_FRAME_DISPLAY },
+    { "total",   VLC_FRAME_DEMUX,   VLC_FRAME_DISPLAY },
+};
+
+static int frame_event_CmpDate(const void *a, const void *b)
+{
+    const struct vlc_frame_event *const *x = a, *const *y = b;
+
+    return ((*x)->date > (*y)->date) - ((*x)->date < (*y)->date);
+}
+
+static int frame_event_CmpFrame(const void *a, const void *b)
+{
+    const struct vlc_frame_event *x = a, *y = b;
+
+    if (x->es_id != y->es_id)
+        return (x->es_id > y->es_id) - (x->es_id < y->es_id);
+    if (x->pts != y->pts)
+        return (x->pts > y->pts) - (x->pts < y->pts);
+    if (x->stage != y->stage)
+        return x->stage - y->stage;
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+static int mtime_Cmp(const void *a, const void *b)
+{
+    const mtime_t *x = a, *y = b;
+
+    return (*x > *y) - (*x < *y);
+}
+
+/**
+ * Identifies the frame of display events from the rendering date recorded at
+ * the decoder output. Unmatched events are marked with an invalid stage.
+ */
+static void frame_trace_MatchDisplay(struct vlc_frame_event *events,
+                                     size_t count)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++)
+        if (events[i].stage == VLC_FRAME_DECODED)
+            n++;
+
+    const struct vlc_frame_event **decoded = vlc_alloc(n, sizeof (*decoded));
+
+    n = 0;
+    for (size_t i = 0; i < count && decoded != NULL; i++)
+        if (events[i].stage == VLC_FRAME_DECODED)
+            decoded[n++] = &events[i];
+    qsort(decoded, n, sizeof (*decoded), frame_event_CmpDate);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        struct vlc_frame_event *ev = &events[i];
+
+        if (ev->stage != VLC_FRAME_DISPLAY)
+            continue;
+
+        const struct vlc_frame_event *key = ev, **match = NULL;
+        if (n > 0)
+            match = bsearch(&key, decoded, n, sizeof (*decoded),
+                            frame_event_CmpDate);
+        if (match != NULL)
+        {
+            ev->es_id = (*match)->es_id;
+            ev->pts = (*match)->pts;
+        }
+        else
+            ev->stage = UINT8_MAX;
+    }
+    free(decoded);
+}
+
+static void frame_trace_LogSpan(vlc_object_t *obj, const char *name,
+                                mtime_t *delays, size_t n)
+{
+    if (n == 0)
+        return;
+
+    qsort(delays, n, sizeof (*delays), mtime_Cmp);
+    msg_Info(obj, "frame trace: %-6s %6zu frames, min %"PRId64" us, "
+             "median %"PRId64" us, 90%% %"PRId64" us, 99%% %"PRId64" us, "
+             "max %"PRId64" us", name, n, delays[0], delays[n / 2],
+             delays[n * 9 / 10], delays[n * 99 / 100], delays[n - 1]);
+}
+
+static void frame_trace_Export(vlc_object_t *obj, const char *path,
+                               struct vlc_frame_event *events, size_t count)
+{
+    FILE *stream = NULL;
+
+    if (path != NULL)
+    {
+        stream = vlc_fopen(path, "wt");
+        if (stream == NULL)
+            msg_Err(obj, "cannot write frame trace %s: %s", path,
+                    vlc_strerror_c(errno));
+        else
+            fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", stream);
+    }
+
+    frame_trace_MatchDisplay(events, count);
+    qsort(events, count, sizeof (*events), frame_event_CmpFrame);
+
+    mtime_t *delays[ARRAY_SIZE(frame_spans)];
+    size_t delay_count[ARRAY_SIZE(frame_spans)];
+
+    for (size_t k = 0; k < ARRAY_SIZE(frame_spans); k++)
+    {
+        delays[k] = vlc_alloc(count, sizeof (mtime_t));
+        delay_count[k] = 0;
+    }
+
+    const char *sep = "";
+    int last_es = -1;
+
+    for (size_t i = 0; i < count;)
+    {
+        const struct vlc_frame_event *frame = &events[i];
+        mtime_t times[VLC_FRAME_STAGES];
+
+        for (unsigned s = 0; s < VLC_FRAME_STAGES; s++)
+            times[s] = VLC_TS_INVALID;
+
+        /* Gather the first occurence of each stage of the frame */
+        for (; i < count && events[i].es_id == frame->es_id
+                         && events[i].pts == frame->pts; i++)
+        {
+            const struct vlc_frame_event *ev = &events[i];
+
+            if (ev->stage < VLC_FRAME_STAGES
+             && times[ev->stage] == VLC_TS_INVALID)
+                times[ev->stage] = ev->time;
+        }
+
+        if (frame->pts <= VLC_TS_INVALID)
+            continue; /* no frame identity */
+
+        if (stream != NULL && frame->es_id != last_es)
+        {
+            fprintf(stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"ES %d\"}}",
+                    sep, frame->es_id, frame->es_id);
+            sep = ",\n";
+            last_es = frame->es_id;
+        }
+
+        for (size_t k = 0; k < ARRAY_SIZE(frame_spans); k++)
+        {
+            mtime_t from = times[frame_spans[k].from];
+            mtime_t to = times[frame_spans[k].to];
+
+            if (from == VLC_TS_INVALID || to == VLC_TS_INVALID || to < from)
+                continue;
+
+            if (delays[k] != NULL)
+                delays[k][delay_count[k]++] = to - from;
+
+            /* The total is implied by the other spans on the timeline */
+            if (stream != NULL && frame_spans[k].to - frame_spans[k].from == 1)
+            {
+                fprintf(stream, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                        "\"tid\":%d,\"ts\":%"PRId64",\"dur\":%"PRId64","
+                        "\"args\":{\"pts\":%"PRId64"}}", sep,
+                        frame_spans[k].name, frame->es_id, from, to - from,
+                        frame->pts);
+                sep = ",\n";
+            }
+        }
+    }
+
+    if (stream != NULL)
+    {
+        fputs("\n]}\n", stream);
+        if (fclose(stream))
+            msg_Err(obj, "cannot write frame trace %s: %s", path,
+                    vlc_strerror_c(errno));
+        else
+            msg_Info(obj, "frame trace written to %s", path);
+    }
+
+    for (size_t k = 0; k < ARRAY_SIZE(frame_spans); k++)
+    {
+        frame_trace_LogSpan(obj, frame_spans[k].name, delays[k],
+                            delay_count[k]);
+        free(delays[k]);
+    }
+}
+
+void vlc_frame_trace_Stop(vlc_object_t *obj, const char *path)
+{
+    atomic_store_explicit(&vlc_frame_trace_enabled, false,
+                          memory_order_relaxed);
+
+    vlc_mutex_lock(&frame_trace.lock);
+    if (!frame_trace.running)
+    {
+        vlc_mutex_unlock(&frame_trace.lock);
+        return;
+    }
+
+    /* Buffers of the threads which are still running are not collected.
+     * The pipeline threads have normally all exited by now. */
+    struct frame_trace_buffer *buf = vlc_threadvar_get(frame_trace.key);
+    if (buf != NULL)
+        frame_trace_Flush(buf);
+
+    struct vlc_frame_event *events = frame_trace.events;
+    size_t count = frame_trace.count;
+    uint64_t dropped = frame_trace.dropped;
+
+    frame_trace.running = false;
+    frame_trace.events = NULL;
+    frame_trace.count = frame_trace.size = 0;
+    vlc_mutex_unlock(&frame_trace.lock);
+
+    if (dropped > 0)
+        msg_Warn(obj, "frame trace: %"PRIu64" events dropped", dropped);
+
+    frame_trace_Export(obj, path, events, count);
+    free(events);
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * frame_trace.h: per-frame pipeline latency tracing
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_FRAME_TRACE_H
+# define LIBVLC_FRAME_TRACE_H 1
+
+# include <vlc_atomic.h>
+
+/**
+ * Stages of a video frame through the pipeline.
+ *
+ * Frames are identified by their elementary stream ID and their stream
+ * timestamp (PTS) up to the decoder output. From there on, pictures carry
+ * their rendering date (system time) instead, and the decoder output event
+ * records both so that the display event can be matched to its frame.
+ */
+enum vlc_frame_stage
+{
+    VLC_FRAME_DEMUX, /**< block sent to the decoder by the demuxer */
+    VLC_FRAME_DECODE, /**< block passed to the decoder module */
+    VLC_FRAME_DECODED, /**< picture queued to the video output */
+    VLC_FRAME_DISPLAY, /**< picture displayed */
+    VLC_FRAME_STAGES
+};
+
+extern atomic_bool vlc_frame_trace_enabled;
+
+void vlc_frame_trace_Record(enum vlc_frame_stage, int es_id,
+                            mtime_t pts, mtime_t date);
+
+/**
+ * Records that a frame reached a stage, if tracing is enabled.
+ *
+ * \param es_id elementary stream ID (ignored for VLC_FRAME_DISPLAY)
+ * \param pts stream timestamp (ignored for VLC_FRAME_DISPLAY)
+ * \param date rendering date (only for VLC_FRAME_DECODED and
+ *             VLC_FRAME_DISPLAY)
+ */
+static inline void vlc_frame_Trace(enum vlc_frame_stage stage, int es_id,
+                                   mtime_t pts, mtime_t date)
+{
+    if (unlikely(atomic_load_explicit(&vlc_frame_trace_enabled,
+                                      memory_order_acquire)))
+        vlc_frame_trace_Record(stage, es_id, pts, date);
+}
+
+/**
+ * Starts collecting frame events (process-wide).
+ */
+int vlc_frame_trace_Start(void);
+
+/**
+ * Stops collecting frame events, logs the latency distribution of each stage
+ * and writes the timeline to a file in Chrome trace event JSON format.
+ *
+ * \param path trace file path (or NULL not to write the timeline)
+ */
+void vlc_frame_trace_Stop(vlc_object_t *obj, const char *path);
+
+#endif
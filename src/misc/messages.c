@@ -34,6 +34,9 @@
 
 #include <stdlib.h>
 #include <stdarg.h>                                       /* va_list for BSD */
+#include <stdalign.h>
+#include <stddef.h>
+#include <limits.h>
 #include <unistd.h>
 #include <assert.h>
 
@@ -41,8 +44,12 @@
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
+#include <vlc_memstream.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
+typedef struct vlc_log_async_t vlc_log_async_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,6 +57,7 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+    vlc_log_async_t *async; /**< Queue in front of the module, if any */
 };
 
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
@@ -292,6 +300,589 @@ static void vlc_vaLogDiscard(void *d, int type, const vlc_log_t *item,
     (void) d; (void) type; (void) item; (void) format; (void) ap;
 }
 
+/*
+ * Asynchronous logging
+ *
+ * The calling thread only captures the message in a slot of a bounded
+ * multiple producers queue: the metadata, the format string and a copy of
+ * the arguments. A dedicated thread formats the messages and passes them to
+ * the logger module, so that slow outputs (files, syslog...) do not stall
+ * the calling threads. If the queue is full, messages are dropped and
+ * counted.
+ */
+
+#define VLC_LOG_ASYNC_SLOTS 1024
+#define VLC_LOG_ASYNC_DATA  896 /**< Captured data per message, in bytes */
+#define VLC_LOG_SPEC_MAX    32
+
+enum vlc_log_arg
+{
+    VLC_LOG_ARG_NONE, /**< %% */
+    VLC_LOG_ARG_INT,
+    VLC_LOG_ARG_LONG,
+    VLC_LOG_ARG_LLONG,
+    VLC_LOG_ARG_INTMAX,
+    VLC_LOG_ARG_SIZE,
+    VLC_LOG_ARG_PTRDIFF,
+    VLC_LOG_ARG_DOUBLE,
+    VLC_LOG_ARG_LDOUBLE,
+    VLC_LOG_ARG_PTR,
+    VLC_LOG_ARG_STR,
+};
+
+typedef struct
+{
+    enum vlc_log_arg type;
+    unsigned stars; /**< Number of int arguments for the width and precision */
+    int precision; /**< Precision, -1 if none or -2 if given as an argument */
+    size_t length; /**< Length of the conversion specification */
+} vlc_log_conv_t;
+
+/**
+ * Parses the conversion specification starting at the given '%'.
+ * \return false if the conversion cannot be deferred (positional or wide
+ * characters arguments, %n, %m or any extension), true otherwise
+ */
+static bool vlc_LogConversion(const char *spec, vlc_log_conv_t *conv)
+{
+    const char *p = spec + 1;
+    int longs = 0;
+    enum vlc_log_arg type = VLC_LOG_ARG_INT;
+
+    conv->stars = 0;
+    conv->precision = -1;
+    p += strspn(p, "-+ #0'");
+    if (*p == '*')
+    {
+        conv->stars++;
+        p++;
+    }
+    else
+        p += strspn(p, "0123456789");
+    if (*p == '$')
+        return false;
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            conv->stars++;
+            conv->precision = -2;
+            p++;
+        }
+        else
+        {
+            conv->precision = 0;
+            for (; *p >= '0' && *p <= '9'; p++)
+                if (conv->precision < INT_MAX / 10)
+                    conv->precision = conv->precision * 10 + (*p - '0');
+        }
+    }
+
+    for (;; p++)
+    {
+        switch (*p)
+        {
+            case 'h':
+                continue; /* promoted to int */
+            case 'l':
+                longs++;
+                type = (longs == 1) ? VLC_LOG_ARG_LONG : VLC_LOG_ARG_LLONG;
+                continue;
+            case 'j':
+                type = VLC_LOG_ARG_INTMAX;
+                continue;
+            case 'z':
+                type = VLC_LOG_ARG_SIZE;
+                continue;
+            case 't':
+                type = VLC_LOG_ARG_PTRDIFF;
+                continue;
+            case 'L':
+                longs = -1;
+                continue;
+        }
+        break;
+    }
+
+    switch (*p)
+    {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            if (longs < 0)
+                return false;
+            break;
+        case 'c':
+            if (type != VLC_LOG_ARG_INT)
+                return false; /* wint_t */
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+        case 'a': case 'A':
+            type = (longs < 0) ? VLC_LOG_ARG_LDOUBLE : VLC_LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            if (type != VLC_LOG_ARG_INT)
+                return false; /* wchar_t * */
+            type = VLC_LOG_ARG_STR;
+            break;
+        case 'p':
+            type = VLC_LOG_ARG_PTR;
+            break;
+        case '%':
+            if (p != spec + 1)
+                return false;
+            type = VLC_LOG_ARG_NONE;
+            break;
+        default:
+            return false;
+    }
+
+    conv->type = type;
+    conv->length = p + 1 - spec;
+    return conv->length < VLC_LOG_SPEC_MAX;
+}
+
+typedef struct
+{
+    atomic_size_t seq;
+    int type;
+    bool deferred; /**< Whether the arguments were captured */
+    vlc_log_t meta;
+    char *text; /**< Formatted message, if the arguments were not captured */
+    size_t format; /**< Offset of the format string in the data */
+    size_t size; /**< Size of the data, in bytes */
+    unsigned char data[VLC_LOG_ASYNC_DATA]; /**< Strings and arguments */
+} vlc_log_slot_t;
+
+struct vlc_log_async_t
+{
+    /* Producers side */
+    alignas (64) atomic_size_t enqueue;
+    atomic_uint dropped;
+
+    /* Consumer side */
+    alignas (64) size_t dequeue;
+    atomic_bool sleeping;
+    atomic_bool stop;
+    vlc_sem_t wait;
+    vlc_thread_t thread;
+
+    vlc_log_cb cb;
+    void *sys;
+    vlc_log_slot_t slots[VLC_LOG_ASYNC_SLOTS];
+};
+
+static bool vlc_LogPutString(vlc_log_slot_t *slot, const char *str,
+                             size_t len)
+{
+    if (len >= VLC_LOG_ASYNC_DATA - slot->size)
+        return false;
+
+    memcpy(slot->data + slot->size, str, len);
+    slot->data[slot->size + len] = '\0';
+    slot->size += len + 1;
+    return true;
+}
+
+#define VLC_LOG_PUT(slot, ap, type) \
+    do { \
+        type val_ = va_arg(ap, type); \
+        if (sizeof (val_) > VLC_LOG_ASYNC_DATA - (slot)->size) \
+            return false; \
+        memcpy((slot)->data + (slot)->size, &val_, sizeof (val_)); \
+        (slot)->size += sizeof (val_); \
+    } while (0)
+
+/**
+ * Copies the format string and the arguments into the record.
+ * \return false if they do not fit or cannot be deferred
+ */
+static bool vlc_LogCapture(vlc_log_slot_t *slot, const char *format,
+                           va_list ap)
+{
+    if (!vlc_LogPutString(slot, format, strlen(format)))
+        return false;
+
+    for (const char *p = strchr(format, '%'); p != NULL;
+         p = strchr(p, '%'))
+    {
+        vlc_log_conv_t conv;
+
+        if (!vlc_LogConversion(p, &conv))
+            return false;
+        p += conv.length;
+
+        int star[2], precision = conv.precision;
+
+        for (unsigned i = 0; i < conv.stars; i++)
+        {
+            star[i] = va_arg(ap, int);
+            if (sizeof (star[i]) > VLC_LOG_ASYNC_DATA - slot->size)
+                return false;
+            memcpy(slot->data + slot->size, &star[i], sizeof (star[i]));
+            slot->size += sizeof (star[i]);
+        }
+        if (precision == -2)
+            precision = star[conv.stars - 1]; /* negative means none */
+
+        switch (conv.type)
+        {
+            case VLC_LOG_ARG_NONE:
+                break;
+            case VLC_LOG_ARG_INT:
+                VLC_LOG_PUT(slot, ap, int);
+                break;
+            case VLC_LOG_ARG_LONG:
+                VLC_LOG_PUT(slot, ap, long);
+                break;
+            case VLC_LOG_ARG_LLONG:
+                VLC_LOG_PUT(slot, ap, long long);
+                break;
+            case VLC_LOG_ARG_INTMAX:
+                VLC_LOG_PUT(slot, ap, intmax_t);
+                break;
+            case VLC_LOG_ARG_SIZE:
+                VLC_LOG_PUT(slot, ap, size_t);
+                break;
+            case VLC_LOG_ARG_PTRDIFF:
+                VLC_LOG_PUT(slot, ap, ptrdiff_t);
+                break;
+            case VLC_LOG_ARG_DOUBLE:
+                VLC_LOG_PUT(slot, ap, double);
+                break;
+            case VLC_LOG_ARG_LDOUBLE:
+                VLC_LOG_PUT(slot, ap, long double);
+                break;
+            case VLC_LOG_ARG_PTR:
+                VLC_LOG_PUT(slot, ap, void *);
+                break;
+            case VLC_LOG_ARG_STR:
+            {   /* Only the characters within the precision may be read: the
+                 * string need not be nul-terminated then. */
+                const char *str = va_arg(ap, const char *);
+                if (str == NULL)
+                    str = "(null)";
+
+                size_t len = (precision >= 0) ? strnlen(str, precision)
+                                              : strlen(str);
+
+                if (sizeof (len) > VLC_LOG_ASYNC_DATA - slot->size)
+                    return false;
+                memcpy(slot->data + slot->size, &len, sizeof (len));
+                slot->size += sizeof (len);
+                if (!vlc_LogPutString(slot, str, len))
+                    return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+#define VLC_LOG_GET(ms, spec, data, type, stars) \
+    do { \
+        type val_; \
+        memcpy(&val_, data, sizeof (val_)); \
+        data += sizeof (val_); \
+        switch (stars) \
+        { \
+            case 0: vlc_memstream_printf(ms, spec, val_); break; \
+            case 1: vlc_memstream_printf(ms, spec, star[0], val_); break; \
+            default: vlc_memstream_printf(ms, spec, star[0], star[1], val_); \
+        } \
+    } while (0)
+
+/**
+ * Formats a message from its captured format string and arguments.
+ */
+static char *vlc_LogFormat(const vlc_log_slot_t *slot)
+{
+    const char *format = (const char *)slot->data + slot->format;
+    const unsigned char *data = slot->data + slot->format
+                              + strlen(format) + 1;
+    struct vlc_memstream ms;
+
+    vlc_memstream_open(&ms);
+
+    for (const char *p = format, *next; *p != '\0'; p = next)
+    {
+        next = strchr(p, '%');
+        if (next == NULL)
+        {
+            vlc_memstream_puts(&ms, p);
+            break;
+        }
+        vlc_memstream_write(&ms, p, next - p);
+
+        vlc_log_conv_t conv;
+        char spec[VLC_LOG_SPEC_MAX];
+        int star[2];
+
+        if (!vlc_LogConversion(next, &conv))
+            vlc_assert_unreachable(); /* checked by vlc_LogCapture() */
+        memcpy(spec, next, conv.length);
+        spec[conv.length] = '\0';
+        next += conv.length;
+
+        for (unsigned i = 0; i < conv.stars; i++)
+        {
+            memcpy(&star[i], data, sizeof (star[i]));
+            data += sizeof (star[i]);
+        }
+
+        switch (conv.type)
+        {
+            case VLC_LOG_ARG_NONE:
+                vlc_memstream_putc(&ms, '%');
+                break;
+            case VLC_LOG_ARG_INT:
+                VLC_LOG_GET(&ms, spec, data, int, conv.stars);
+                break;
+            case VLC_LOG_ARG_LONG:
+                VLC_LOG_GET(&ms, spec, data, long, conv.stars);
+                break;
+            case VLC_LOG_ARG_LLONG:
+                VLC_LOG_GET(&ms, spec, data, long long, conv.stars);
+                break;
+            case VLC_LOG_ARG_INTMAX:
+                VLC_LOG_GET(&ms, spec, data, intmax_t, conv.stars);
+                break;
+            case VLC_LOG_ARG_SIZE:
+                VLC_LOG_GET(&ms, spec, data, size_t, conv.stars);
+                break;
+            case VLC_LOG_ARG_PTRDIFF:
+                VLC_LOG_GET(&ms, spec, data, ptrdiff_t, conv.stars);
+                break;
+            case VLC_LOG_ARG_DOUBLE:
+                VLC_LOG_GET(&ms, spec, data, double, conv.stars);
+                break;
+            case VLC_LOG_ARG_LDOUBLE:
+                VLC_LOG_GET(&ms, spec, data, long double, conv.stars);
+                break;
+            case VLC_LOG_ARG_PTR:
+                VLC_LOG_GET(&ms, spec, data, void *, conv.stars);
+                break;
+            case VLC_LOG_ARG_STR:
+            {
+                const char *str;
+                size_t len;
+
+                memcpy(&len, data, sizeof (len));
+                str = (const char *)data + sizeof (len);
+                data += sizeof (len) + len + 1;
+                switch (conv.stars)
+                {
+                    case 0: vlc_memstream_printf(&ms, spec, str); break;
+                    case 1: vlc_memstream_printf(&ms, spec, star[0], str);
+                            break;
+                    default: vlc_memstream_printf(&ms, spec, star[0], star[1],
+                                                  str);
+                }
+                break;
+            }
+        }
+    }
+
+    if (vlc_memstream_close(&ms))
+        return NULL;
+    return ms.ptr;
+}
+
+static void vlc_vaLogAsync(void *d, int type, const vlc_log_t *item,
+                           const char *format, va_list ap)
+{
+    vlc_log_async_t *async = d;
+    size_t pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    vlc_log_slot_t *slot;
+
+    for (;;)
+    {
+        slot = &async->slots[pos % VLC_LOG_ASYNC_SLOTS];
+
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = seq - pos;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&async->enqueue, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {   /* Full */
+            atomic_fetch_add_explicit(&async->dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        }
+        else
+            pos = atomic_load_explicit(&async->enqueue,
+                                       memory_order_relaxed);
+    }
+
+    const char *module = item->psz_module;
+    const char *header = item->psz_header;
+
+    slot->type = type;
+    slot->meta = *item;
+    slot->text = NULL;
+    slot->size = 0;
+
+    /* The module name and header may not outlive the call */
+    slot->meta.psz_module = (const char *)slot->data;
+    if (!vlc_LogPutString(slot, module, strlen(module)))
+        slot->meta.psz_module = "?";
+    slot->meta.psz_header = NULL;
+    if (header != NULL)
+    {
+        slot->meta.psz_header = (const char *)slot->data + slot->size;
+        if (!vlc_LogPutString(slot, header, strlen(header)))
+            slot->meta.psz_header = NULL;
+    }
+
+    va_list aq;
+
+    slot->format = slot->size;
+    va_copy(aq, ap);
+    slot->deferred = vlc_LogCapture(slot, format, aq);
+    va_end(aq);
+    if (!slot->deferred && vasprintf(&slot->text, format, ap) == -1)
+        slot->text = NULL;
+
+    atomic_store(&slot->seq, pos + 1);
+    if (atomic_load(&async->sleeping)
+     && atomic_exchange(&async->sleeping, false))
+        vlc_sem_post(&async->wait);
+}
+
+static void vlc_LogAsyncOutput(vlc_log_async_t *async, int type,
+                               const vlc_log_t *item, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    async->cb(async->sys, type, item, format, ap);
+    va_end(ap);
+}
+
+/**
+ * Formats and outputs all the queued messages.
+ */
+static void vlc_LogAsyncDrain(vlc_log_async_t *async)
+{
+    for (;;)
+    {
+        vlc_log_slot_t *slot = &async->slots[async->dequeue
+                                             % VLC_LOG_ASYNC_SLOTS];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire)
+         != async->dequeue + 1)
+            break;
+
+        char *text = slot->deferred ? vlc_LogFormat(slot) : slot->text;
+
+        vlc_LogAsyncOutput(async, slot->type, &slot->meta, "%s",
+                           (text != NULL) ? text : "message lost");
+        free(text);
+
+        atomic_store_explicit(&slot->seq,
+                              async->dequeue + VLC_LOG_ASYNC_SLOTS,
+                              memory_order_release);
+        async->dequeue++;
+    }
+
+    unsigned dropped = atomic_exchange_explicit(&async->dropped, 0,
+                                                memory_order_relaxed);
+    if (dropped > 0)
+    {
+        const vlc_log_t meta = {
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .file = __FILE__,
+            .line = __LINE__,
+            .func = __func__,
+            .tid = vlc_thread_id(),
+        };
+
+        vlc_LogAsyncOutput(async, VLC_MSG_WARN, &meta,
+                           "%u log message(s) dropped", dropped);
+    }
+}
+
+static bool vlc_LogAsyncEmpty(vlc_log_async_t *async)
+{
+    const vlc_log_slot_t *slot = &async->slots[async->dequeue
+                                               % VLC_LOG_ASYNC_SLOTS];
+
+    return atomic_load(&slot->seq) != async->dequeue + 1
+        && atomic_load_explicit(&async->dropped, memory_order_relaxed) == 0;
+}
+
+static void *vlc_LogAsyncThread(void *data)
+{
+    vlc_log_async_t *async = data;
+
+    for (;;)
+    {
+        vlc_LogAsyncDrain(async);
+        if (atomic_load(&async->stop))
+            break;
+
+        /* Sleep until a producer sees the flag and posts the semaphore */
+        atomic_store(&async->sleeping, true);
+        if (vlc_LogAsyncEmpty(async) && !atomic_load(&async->stop))
+            vlc_sem_wait(&async->wait);
+        else
+            atomic_store(&async->sleeping, false);
+    }
+    vlc_LogAsyncDrain(async);
+    return NULL;
+}
+
+static vlc_log_async_t *vlc_LogAsyncNew(vlc_log_cb cb, void *sys)
+{
+    vlc_log_async_t *async = aligned_alloc(64, (sizeof (*async) + 63)
+                                               & ~(size_t)63);
+    if (unlikely(async == NULL))
+        return NULL;
+
+    atomic_init(&async->enqueue, 0);
+    atomic_init(&async->dropped, 0);
+    async->dequeue = 0;
+    atomic_init(&async->sleeping, false);
+    atomic_init(&async->stop, false);
+    vlc_sem_init(&async->wait, 0);
+    async->cb = cb;
+    async->sys = sys;
+    for (size_t i = 0; i < VLC_LOG_ASYNC_SLOTS; i++)
+        atomic_init(&async->slots[i].seq, i);
+
+    if (vlc_clone(&async->thread, vlc_LogAsyncThread, async,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_sem_destroy(&async->wait);
+        aligned_free(async);
+        return NULL;
+    }
+    return async;
+}
+
+/**
+ * Outputs the pending messages and stops the logging thread.
+ * \return the data of the logger module
+ */
+static void *vlc_LogAsyncDelete(vlc_log_async_t *async)
+{
+    void *sys = async->sys;
+
+    atomic_store(&async->stop, true);
+    vlc_sem_post(&async->wait);
+    vlc_join(async->thread, NULL);
+    vlc_sem_destroy(&async->wait);
+    aligned_free(async);
+    return sys;
+}
+
 static int vlc_logger_load(void *func, va_list ap)
 {
     vlc_log_cb (*activate)(vlc_object_t *, void **) = func;
@@ -330,6 +921,7 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    logger->async = NULL;
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -366,14 +958,24 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (module == NULL)
         cb = vlc_vaLogDiscard;
 
+    vlc_log_async_t *async = NULL;
+    if (module != NULL && var_InheritBool(vlc, "log-async"))
+        async = vlc_LogAsyncNew(cb, sys);
+
     vlc_rwlock_wrlock(&logger->lock);
     if (logger->log == vlc_vaLogEarly)
         early_sys = logger->sys;
 
+    if (async != NULL)
+    {
+        cb = vlc_vaLogAsync;
+        sys = async;
+    }
     logger->log = cb;
     logger->sys = sys;
     assert(logger->module == NULL); /* Only one call to vlc_LogInit()! */
     logger->module = module;
+    logger->async = async;
     vlc_rwlock_unlock(&logger->lock);
 
     if (early_sys != NULL)
@@ -395,6 +997,7 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
         return;
 
     module_t *module;
+    vlc_log_async_t *async;
     void *sys;
 
     if (cb == NULL)
@@ -403,12 +1006,17 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     vlc_rwlock_wrlock(&logger->lock);
     sys = logger->sys;
     module = logger->module;
+    async = logger->async;
 
     logger->log = cb;
     logger->sys = opaque;
     logger->module = NULL;
+    logger->async = NULL;
     vlc_rwlock_unlock(&logger->lock);
 
+    if (async != NULL)
+        sys = vlc_LogAsyncDelete(async);
+
     if (module != NULL)
         vlc_module_unload(vlc, module, vlc_logger_unload, sys);
 
@@ -427,7 +1035,13 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
         return;
 
     if (logger->module != NULL)
-        vlc_module_unload(vlc, logger->module, vlc_logger_unload, logger->sys);
+    {
+        void *sys = logger->sys;
+
+        if (logger->async != NULL)
+            sys = vlc_LogAsyncDelete(logger->async);
+        vlc_module_unload(vlc, logger->module, vlc_logger_unload, sys);
+    }
     else
     /* Flush early log messages (corner case: no call to vlc_LogInit()) */
     if (logger->log == vlc_vaLogEarly)
@@ -192,6 +192,7 @@ void *vlc_custom_create (vlc_object_t *parent, size_t length,
         return NULL;
     priv->psz_name = NULL;
     priv->var_root = NULL;
+    priv->var_cache = NULL;
     vlc_mutex_init (&priv->var_lock);
     vlc_cond_init (&priv->var_wait);
     atomic_init (&priv->refs, 1);
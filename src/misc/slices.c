@@ -0,0 +1,279 @@
+/*****************************************************************************
+ * slices.c: slice-parallel execution of video filter kernels
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_cpu.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include "libvlc.h"
+
+/* Slices smaller than this are not worth a thread wake-up */
+#define SLICE_MIN_LINES 16
+/* Slices per thread, to even out the load between threads */
+#define SLICES_PER_THREAD 2
+#define SLICES_MAX 256
+
+/** Set of slices submitted by one filter call */
+struct vlc_slice_job
+{
+    filter_t *filter;
+    filter_slice_cb kernel;
+    void *opaque;
+
+    const filter_slice_t *slices;
+    unsigned count;
+    atomic_uint next; /**< Index of the next slice to process */
+
+    /* Protected by the pool lock */
+    unsigned done; /**< Number of processed slices */
+    unsigned users; /**< Number of worker threads using the job */
+    struct vlc_slice_job *next_job;
+};
+
+struct vlc_slice_pool
+{
+    vlc_mutex_t lock;
+    vlc_cond_t work_wait; /**< wait for a job */
+    vlc_cond_t done_wait; /**< wait for a job to complete */
+    struct vlc_slice_job *jobs; /**< Queue of jobs with unclaimed slices */
+    struct vlc_slice_job **jobs_tail;
+    bool closing;
+
+    unsigned threads; /**< Number of worker threads */
+    vlc_thread_t thread[];
+};
+
+static vlc_mutex_t pool_lock = VLC_STATIC_MUTEX;
+
+/* Processes slices of a job until there are none left. Returns the number of
+ * processed slices. */
+static unsigned SliceJobRun(struct vlc_slice_job *job)
+{
+    unsigned count = 0, i;
+
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count)
+    {
+        job->kernel(job->filter, &job->slices[i], job->opaque);
+        count++;
+    }
+    return count;
+}
+
+/* Removes a job from the queue, if it is still there. */
+static void SliceJobDequeue(struct vlc_slice_pool *pool,
+                            struct vlc_slice_job *job)
+{
+    for (struct vlc_slice_job **pp = &pool->jobs; *pp != NULL;
+         pp = &(*pp)->next_job)
+        if (*pp == job)
+        {
+            *pp = job->next_job;
+            if (pool->jobs_tail == &job->next_job)
+                pool->jobs_tail = pp;
+            return;
+        }
+}
+
+static void *SliceThread(void *data)
+{
+    struct vlc_slice_pool *pool = data;
+
+    vlc_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->jobs == NULL && !pool->closing)
+            vlc_cond_wait(&pool->work_wait, &pool->lock);
+        if (pool->closing)
+            break;
+
+        struct vlc_slice_job *job = pool->jobs;
+
+        job->users++;
+        vlc_mutex_unlock(&pool->lock);
+
+        unsigned count = SliceJobRun(job);
+
+        vlc_mutex_lock(&pool->lock);
+        /* All slices are claimed: other threads need not look at it */
+        SliceJobDequeue(pool, job);
+        job->users--;
+        job->done += count;
+        if (job->done == job->count && job->users == 0)
+            vlc_cond_broadcast(&pool->done_wait);
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static struct vlc_slice_pool *SlicePoolNew(vlc_object_t *obj)
+{
+    int threads = var_InheritInteger(obj, "filter-threads");
+    if (threads <= 0)
+        threads = vlc_GetCPUCount();
+
+    /* The calling thread takes its share of the slices */
+    threads--;
+    if (threads <= 0)
+        return NULL;
+
+    struct vlc_slice_pool *pool = malloc(sizeof (*pool)
+                                         + threads * sizeof (vlc_thread_t));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->work_wait);
+    vlc_cond_init(&pool->done_wait);
+    pool->jobs = NULL;
+    pool->jobs_tail = &pool->jobs;
+    pool->closing = false;
+    pool->threads = 0;
+
+    while (pool->threads < (unsigned)threads)
+    {
+        if (vlc_clone(&pool->thread[pool->threads], SliceThread, pool,
+                      VLC_THREAD_PRIORITY_VIDEO))
+            break;
+        pool->threads++;
+    }
+
+    if (pool->threads == 0)
+    {
+        vlc_SlicePoolDestroy(pool);
+        return NULL;
+    }
+
+    msg_Dbg(obj, "using %u video filter threads", pool->threads + 1);
+    return pool;
+}
+
+void vlc_SlicePoolDestroy(struct vlc_slice_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(pool->jobs == NULL);
+    pool->closing = true;
+    vlc_cond_broadcast(&pool->work_wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->threads; i++)
+        vlc_join(pool->thread[i], NULL);
+
+    vlc_cond_destroy(&pool->done_wait);
+    vlc_cond_destroy(&pool->work_wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static struct vlc_slice_pool *SlicePoolGet(filter_t *filter)
+{
+    libvlc_priv_t *priv = libvlc_priv(filter->obj.libvlc);
+    struct vlc_slice_pool *pool;
+
+    vlc_mutex_lock(&pool_lock);
+    if (!priv->slices_init)
+    {
+        priv->slices = SlicePoolNew(VLC_OBJECT(filter->obj.libvlc));
+        priv->slices_init = true;
+    }
+    pool = priv->slices;
+    vlc_mutex_unlock(&pool_lock);
+    return pool;
+}
+
+void filter_RunSlices(filter_t *filter, const picture_t *pic,
+                      unsigned planes, unsigned overlap,
+                      filter_slice_cb kernel, void *opaque)
+{
+    struct vlc_slice_pool *pool = SlicePoolGet(filter);
+    unsigned threads = (pool != NULL) ? pool->threads + 1 : 1;
+    filter_slice_t slices[SLICES_MAX];
+    unsigned count = 0;
+
+    assert(planes <= (unsigned)pic->i_planes);
+
+    /* Overlapping rows are processed twice: keep them a minor share */
+    unsigned min_lines = __MAX(SLICE_MIN_LINES, 4 * overlap);
+    unsigned per_plane = __MIN(threads * SLICES_PER_THREAD,
+                               SLICES_MAX / __MAX(planes, 1));
+
+    for (unsigned i = 0; i < planes; i++)
+    {
+        int lines = pic->p[i].i_visible_lines;
+        unsigned n = __MIN(per_plane, __MAX(lines / min_lines, 1));
+
+        for (unsigned k = 0; k < n; k++)
+        {
+            filter_slice_t *slice = &slices[count++];
+
+            slice->plane = i;
+            slice->y_start = lines * k / n;
+            slice->y_end = lines * (k + 1) / n;
+            slice->y_context_start = __MAX(slice->y_start - (int)overlap, 0);
+            slice->y_context_end = __MIN(slice->y_end + (int)overlap, lines);
+        }
+    }
+
+    if (pool == NULL || count <= 1)
+    {
+        for (unsigned i = 0; i < count; i++)
+            kernel(filter, &slices[i], opaque);
+        return;
+    }
+
+    struct vlc_slice_job job = {
+        .filter = filter,
+        .kernel = kernel,
+        .opaque = opaque,
+        .slices = slices,
+        .count = count,
+        .done = 0,
+        .users = 0,
+        .next_job = NULL,
+    };
+
+    atomic_init(&job.next, 0);
+
+    vlc_mutex_lock(&pool->lock);
+    *pool->jobs_tail = &job;
+    pool->jobs_tail = &job.next_job;
+    if (count - 1 >= pool->threads)
+        vlc_cond_broadcast(&pool->work_wait);
+    else
+        for (unsigned i = 0; i < count - 1; i++)
+            vlc_cond_signal(&pool->work_wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    unsigned done = SliceJobRun(&job);
+
+    vlc_mutex_lock(&pool->lock);
+    SliceJobDequeue(pool, &job);
+    job.done += done;
+    while (job.done < job.count || job.users > 0)
+        vlc_cond_wait(&pool->done_wait, &pool->lock);
+    vlc_mutex_unlock(&pool->lock);
+}
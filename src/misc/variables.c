@@ -67,6 +67,18 @@ typedef struct callback_table_t
     callback_entry_t * p_entries;
 } callback_table_t;
 
+/**
+ * Interned variable name.
+ * The generation changes whenever a variable of that name is created, set or
+ * destroyed, on any object. Atoms are never freed: there is a bounded set of
+ * variable names.
+ */
+typedef struct var_atom_t
+{
+    char *       psz_name; /**< (must be first) */
+    atomic_uint  gen;
+} var_atom_t;
+
 /**
  * The structure describing a variable.
  * \note vlc_value_t is the common union for variable values
@@ -74,6 +86,7 @@ typedef struct callback_table_t
 struct variable_t
 {
     char *       psz_name; /**< The variable unique name (must be first) */
+    var_atom_t * atom; /**< The interned name */
 
     /** The variable's exported value */
     vlc_value_t  val;
@@ -150,6 +163,48 @@ static int varcmp( const void *a, const void *b )
     return strcmp( va->psz_name, vb->psz_name );
 }
 
+static vlc_mutex_t atoms_lock = VLC_STATIC_MUTEX;
+static void *atoms_root = NULL;
+
+/**
+ * Finds or creates the atom for a variable name.
+ */
+static var_atom_t *Intern( const char *psz_name )
+{
+    var_atom_t *atom = NULL, **pp_atom;
+
+    vlc_mutex_lock( &atoms_lock );
+    pp_atom = tfind( &psz_name, &atoms_root, varcmp );
+    if( pp_atom != NULL )
+        atom = *pp_atom;
+    else
+    {
+        atom = malloc( sizeof( *atom ) );
+        if( likely(atom != NULL) )
+        {
+            atom->psz_name = strdup( psz_name );
+            atomic_init( &atom->gen, 0 );
+            if( unlikely(atom->psz_name == NULL)
+             || unlikely(tsearch( atom, &atoms_root, varcmp ) == NULL) )
+            {
+                free( atom->psz_name );
+                free( atom );
+                atom = NULL;
+            }
+        }
+    }
+    vlc_mutex_unlock( &atoms_lock );
+    return atom;
+}
+
+/**
+ * Invalidates the inherited values of a variable, on all objects.
+ */
+static void Touch( variable_t *p_var )
+{
+    atomic_fetch_add_explicit( &p_var->atom->gen, 1, memory_order_release );
+}
+
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
@@ -305,6 +360,13 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 
     p_var->psz_name = strdup( psz_name );
     p_var->psz_text = NULL;
+    p_var->atom = Intern( psz_name );
+    if( unlikely(p_var->psz_name == NULL || p_var->atom == NULL) )
+    {
+        free( p_var->psz_name );
+        free( p_var );
+        return VLC_ENOMEM;
+    }
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
 
@@ -371,7 +433,10 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
     if( unlikely(pp_var == NULL) )
         ret = VLC_ENOMEM;
     else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
+    {
+        Touch( p_var );
         p_var = NULL; /* Variable created */
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -411,6 +476,7 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     {
         assert(!p_var->b_incallback);
         tdelete( p_var, &p_priv->var_root, varcmp );
+        Touch( p_var );
     }
     else
     {
@@ -425,15 +491,23 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
 
 static void CleanupVar( void *var )
 {
+    Touch( var );
     Destroy( var );
 }
 
+static void CacheDestroy( struct var_cache *cache );
+
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
 
     tdestroy( priv->var_root, CleanupVar );
     priv->var_root = NULL;
+    if( priv->var_cache != NULL )
+    {
+        CacheDestroy( priv->var_cache );
+        priv->var_cache = NULL;
+    }
 }
 
 #undef var_Change
@@ -482,6 +556,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             assert(p_var->ops->pf_free == FreeDummy);
             p_var->step = *p_val;
             CheckValue( p_var, &p_var->val );
+            Touch( p_var );
             break;
         case VLC_VAR_GETSTEP:
             switch (p_var->i_type & VLC_VAR_TYPE)
@@ -569,6 +644,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             CheckValue( p_var, &newval );
             /* Set the variable */
             p_var->val = newval;
+            Touch( p_var );
             /* Free data if needed */
             p_var->ops->pf_free( &oldval );
             break;
@@ -680,6 +756,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
 
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
+    Touch( p_var );
     *p_val = p_var->val;
 
     /* Deal with callbacks.*/
@@ -753,6 +830,7 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
 
     /* Set the variable */
     p_var->val = val;
+    Touch( p_var );
 
     /* Deal with callbacks */
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -1164,20 +1242,153 @@ int var_LocationParse (vlc_object_t *obj, const char *mrl, const char *pref)
     return ret;
 }
 
+#define VAR_CACHE_SIZE 16
+
+/**
+ * Inherited values of an object, indexed by the address of the name given by
+ * the caller, which is normally a string literal.
+ */
+typedef struct var_cache_entry_t
+{
+    const char  *key; /**< The name given by the caller */
+    var_atom_t  *atom;
+    unsigned     gen; /**< Generation of the atom for the value */
+    unsigned     config_gen; /**< Generation of the configuration */
+    int          i_type;
+    vlc_value_t  val;
+} var_cache_entry_t;
+
+struct var_cache
+{
+    var_cache_entry_t entries[VAR_CACHE_SIZE];
+};
+
+static void CacheDestroy( struct var_cache *cache )
+{
+    for( unsigned i = 0; i < VAR_CACHE_SIZE; i++ )
+        if( cache->entries[i].i_type == VLC_VAR_STRING )
+            free( cache->entries[i].val.psz_string );
+    free( cache );
+}
+
+static unsigned CacheIndex( const char *psz_name )
+{
+    uintptr_t h = (uintptr_t)psz_name;
+
+    return (h ^ (h >> 5) ^ (h >> 10)) % VAR_CACHE_SIZE;
+}
+
+/**
+ * Finds a valid inherited value in the cache of an object.
+ */
+static bool CacheGet( vlc_object_t *obj, const char *psz_name, int i_type,
+                      vlc_value_t *p_val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    bool found = false;
+
+    vlc_mutex_lock( &priv->var_lock );
+    if( priv->var_cache != NULL )
+    {
+        const var_cache_entry_t *e =
+            &priv->var_cache->entries[CacheIndex( psz_name )];
+
+        if( e->key == psz_name && e->i_type == i_type
+         && e->gen == atomic_load_explicit( &e->atom->gen,
+                                            memory_order_acquire )
+         && e->config_gen == atomic_load_explicit( &config_generation,
+                                                   memory_order_acquire )
+         && strcmp( e->atom->psz_name, psz_name ) == 0 )
+        {
+            *p_val = e->val;
+            if( i_type == VLC_VAR_STRING )
+                p_val->psz_string = strdup( p_val->psz_string );
+            found = true;
+        }
+    }
+    vlc_mutex_unlock( &priv->var_lock );
+    return found;
+}
+
+/**
+ * Stores an inherited value in the cache of an object. The generations must
+ * have been read before the value, so that concurrent changes invalidate the
+ * entry.
+ */
+static void CachePut( vlc_object_t *obj, const char *psz_name,
+                      var_atom_t *atom, unsigned gen, unsigned config_gen,
+                      int i_type, vlc_value_t val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+
+    if( i_type == VLC_VAR_STRING )
+    {
+        val.psz_string = strdup( val.psz_string );
+        if( unlikely(val.psz_string == NULL) )
+            return;
+    }
+
+    vlc_mutex_lock( &priv->var_lock );
+    if( priv->var_cache == NULL )
+        priv->var_cache = calloc( 1, sizeof( *priv->var_cache ) );
+    if( likely(priv->var_cache != NULL) )
+    {
+        var_cache_entry_t *e =
+            &priv->var_cache->entries[CacheIndex( psz_name )];
+
+        if( e->i_type == VLC_VAR_STRING )
+            free( e->val.psz_string );
+        e->key = psz_name;
+        e->atom = atom;
+        e->gen = gen;
+        e->config_gen = config_gen;
+        e->i_type = i_type;
+        e->val = val;
+        val.psz_string = NULL;
+    }
+    vlc_mutex_unlock( &priv->var_lock );
+
+    if( i_type == VLC_VAR_STRING )
+        free( val.psz_string );
+}
+
 /**
  * Finds the value of a variable. If the specified object does not hold a
  * variable with the specified name, try the parent object, and iterate until
  * the top of the tree. If no match is found, the value is read from the
  * configuration.
+ *
+ * The values are cached per object, until a variable of the same name is
+ * created, set or destroyed, or the configuration changes.
  */
 int var_Inherit( vlc_object_t *p_this, const char *psz_name, int i_type,
                  vlc_value_t *p_val )
 {
     i_type &= VLC_VAR_CLASS;
+
+    if( i_type == VLC_VAR_ADDRESS )
+    {   /* Not cached: there is no configuration fallback */
+        for( vlc_object_t *obj = p_this; obj != NULL; obj = obj->obj.parent )
+            if( var_GetChecked( obj, psz_name, i_type, p_val ) == VLC_SUCCESS )
+                return VLC_SUCCESS;
+        return VLC_ENOOBJ;
+    }
+
+    if( CacheGet( p_this, psz_name, i_type, p_val ) )
+        return VLC_SUCCESS;
+
+    var_atom_t *atom = Intern( psz_name );
+    unsigned gen = 0, config_gen;
+
+    if( likely(atom != NULL) )
+        gen = atomic_load_explicit( &atom->gen, memory_order_acquire );
+    config_gen = atomic_load_explicit( &config_generation,
+                                       memory_order_acquire );
+
     for( vlc_object_t *obj = p_this; obj != NULL; obj = obj->obj.parent )
     {
         if( var_GetChecked( obj, psz_name, i_type, p_val ) == VLC_SUCCESS )
-            return VLC_SUCCESS;
+            goto out;
     }
 
     /* else take value from config */
@@ -1198,9 +1409,11 @@ int var_Inherit( vlc_object_t *p_this, const char *psz_name, int i_type,
             break;
         default:
             vlc_assert_unreachable();
-        case VLC_VAR_ADDRESS:
-            return VLC_ENOOBJ;
     }
+out:
+    if( likely(atom != NULL)
+     && (i_type != VLC_VAR_STRING || p_val->psz_string != NULL) )
+        CachePut( p_this, psz_name, atom, gen, config_gen, i_type, *p_val );
     return VLC_SUCCESS;
 }
 
@@ -42,6 +42,7 @@ struct vlc_object_internals
     void           *var_root;
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
+    struct var_cache *var_cache; /* inherited values */
 
     /* Objects management */
     atomic_uint     refs;
@@ -102,14 +102,13 @@ static struct
 vlc_plugin_t *vlc_plugins = NULL;
 
 /**
- * Adds a module to the bank
+ * Finds or adds a capability to the bank
  */
-static int vlc_module_store(module_t *mod)
+static vlc_modcap_t *vlc_modcap_get(const char *name)
 {
-    const char *name = module_get_capability(mod);
     vlc_modcap_t *cap = malloc(sizeof (*cap));
     if (unlikely(cap == NULL))
-        return -1;
+        return NULL;
 
     cap->name = strdup(name);
     cap->modv = NULL;
@@ -127,6 +126,20 @@ static int vlc_module_store(module_t *mod)
         vlc_modcap_free(cap);
         cap = *cp;
     }
+    return cap;
+error:
+    vlc_modcap_free(cap);
+    return NULL;
+}
+
+/**
+ * Adds a module to the bank
+ */
+static int vlc_module_store(module_t *mod)
+{
+    vlc_modcap_t *cap = vlc_modcap_get(module_get_capability(mod));
+    if (unlikely(cap == NULL))
+        return -1;
 
     module_t **modv = realloc(cap->modv, sizeof (*modv) * (cap->modc + 1));
     if (unlikely(modv == NULL))
@@ -136,9 +149,6 @@ static int vlc_module_store(module_t *mod)
     cap->modv[cap->modc] = mod;
     cap->modc++;
     return 0;
-error:
-    vlc_modcap_free(cap);
-    return -1;
 }
 
 /**
@@ -151,6 +161,10 @@ static void vlc_plugin_store(vlc_plugin_t *lib)
     lib->next = vlc_plugins;
     vlc_plugins = lib;
 
+#ifdef HAVE_DYNAMIC_PLUGINS
+    if (lib->mapped)
+        return; /* see vlc_cache_caps_store() */
+#endif
     for (module_t *m = lib->module; m != NULL; m = m->next)
         vlc_module_store(m);
 }
@@ -248,6 +262,7 @@ typedef enum
     CACHE_READ_FILE  = 0x1,
     CACHE_SCAN_DIR   = 0x2,
     CACHE_WRITE_FILE = 0x4,
+    CACHE_MAP_FILE   = 0x8,
 } cache_mode_t;
 
 typedef struct module_bank
@@ -391,6 +406,46 @@ static void AllocatePluginDir (module_bank_t *bank, unsigned maxdepth,
     closedir (dh);
 }
 
+/**
+ * Adds the modules of the stored mapped plugins to the bank.
+ *
+ * The capability table of the cache is already sorted, so this takes one
+ * allocation per capability rather than per module.
+ */
+static void vlc_cache_caps_store(const vlc_cache_caps_t *caps)
+{
+    bool *stored = calloc(caps->plugin_count, sizeof (*stored));
+    if (unlikely(stored == NULL))
+        return;
+
+    for (vlc_plugin_t *lib = vlc_plugins; lib != NULL; lib = lib->next)
+        if (lib->mapped && lib >= caps->plugins
+         && lib < caps->plugins + caps->plugin_count)
+            stored[lib - caps->plugins] = true;
+
+    for (size_t i = 0; i < caps->count; i++)
+    {
+        vlc_modcap_t *cap = vlc_modcap_get(caps->caps[i].name);
+        if (unlikely(cap == NULL))
+            continue;
+
+        module_t **modv = realloc(cap->modv, sizeof (*modv)
+                                  * (cap->modc + caps->caps[i].modc));
+        if (unlikely(modv == NULL))
+            continue;
+
+        cap->modv = modv;
+        for (size_t j = 0; j < caps->caps[i].modc; j++)
+        {
+            module_t *mod = caps->caps[i].modv[j];
+
+            if (stored[mod->plugin - caps->plugins])
+                cap->modv[cap->modc++] = mod;
+        }
+    }
+    free(stored);
+}
+
 /**
  * Scans for plug-ins within a file system hierarchy.
  * \param path base directory to browse
@@ -405,9 +460,13 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
         .mode = mode,
     };
 
-    if (mode & CACHE_READ_FILE)
+    vlc_cache_caps_t *caps = NULL;
+
+    if (mode & CACHE_MAP_FILE)
+        bank.cache = vlc_cache_map(obj, path, &modules.caches, &caps);
+    if ((mode & CACHE_READ_FILE) && caps == NULL)
         bank.cache = vlc_cache_load(obj, path, &modules.caches);
-    else
+    else if (!(mode & CACHE_READ_FILE))
         msg_Dbg(bank.obj, "ignoring plugins cache file");
 
     if (mode & CACHE_SCAN_DIR)
@@ -430,6 +489,9 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
             vlc_plugin_store(plugin);
     }
 
+    if (caps != NULL)
+        vlc_cache_caps_store(caps);
+
     if (mode & CACHE_WRITE_FILE)
         CacheSave(obj, path, bank.plugins, bank.size);
 
@@ -451,10 +513,14 @@ static void AllocateAllPlugins (vlc_object_t *p_this)
 
     if (var_InheritBool(p_this, "plugins-cache"))
         mode |= CACHE_READ_FILE;
+    if (var_InheritBool(p_this, "plugins-cache-mmap"))
+        mode |= CACHE_MAP_FILE;
     if (var_InheritBool(p_this, "plugins-scan"))
         mode |= CACHE_SCAN_DIR;
     if (var_InheritBool(p_this, "reset-plugins-cache"))
         mode = (mode | CACHE_WRITE_FILE) & ~CACHE_READ_FILE;
+    if (!(mode & CACHE_READ_FILE))
+        mode &= ~CACHE_MAP_FILE;
 
 #if VLC_WINSTORE_APP
     /* Windows Store Apps can not load external plugins with absolute paths. */
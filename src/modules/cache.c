@@ -57,7 +57,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 35
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -313,6 +313,9 @@ static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
     LOAD_STRING(module->deactivate_name);
     LOAD_STRING(module->psz_capability);
     LOAD_IMMEDIATE(module->i_score);
+    LOAD_STRING(module->psz_signatures);
+    LOAD_STRING(module->psz_extensions);
+    LOAD_STRING(module->psz_mime_types);
     return 0;
 error:
     return -1;
@@ -470,6 +473,517 @@ error:
     return NULL;
 }
 
+/*****************************************************************************
+ * Memory-mapped cache
+ *****************************************************************************
+ * The plugins.map file is used in place: strings, tables and integer lists
+ * are referred to by their offset from the start of the file (0 is NULL), so
+ * loading it only takes one allocation for the plugin, module and
+ * configuration descriptors of all plugins. It also carries the modules
+ * sorted by capability and decreasing score.
+ *
+ * The file is only valid for the host that wrote it (native byte order).
+ *****************************************************************************/
+#define CACHE_MAP_NAME "plugins.map"
+#define CACHE_MAP_MAGIC "VLCPMAP"
+#define CACHE_MAP_BYTE_ORDER 0x01020304
+
+#ifdef DISTRO_VERSION
+# define CACHE_MAP_TAG CACHE_STRING DISTRO_VERSION
+#else
+# define CACHE_MAP_TAG CACHE_STRING
+#endif
+
+struct vlc_cache_map_header
+{
+    char magic[8];
+    uint32_t version; /**< CACHE_SUBVERSION_NUM */
+    uint32_t byte_order; /**< CACHE_MAP_BYTE_ORDER */
+    uint32_t size; /**< File size */
+    uint32_t tag; /**< CACHE_MAP_TAG string */
+    uint32_t plugins, plugin_count;
+    uint32_t modules, module_count;
+    uint32_t configs, config_count;
+    uint32_t caps, cap_count;
+    uint32_t refs, ref_count; /**< Module indices of each capability */
+    uint32_t strtab, strtab_count; /**< Tables of strings */
+    uint32_t ints; /**< Integer lists */
+    uint32_t strings; /**< String pool, up to the end of the file */
+};
+
+struct vlc_cache_map_plugin
+{
+    int64_t mtime;
+    uint64_t size;
+    uint32_t path;
+    uint32_t textdomain;
+    uint32_t module_first, module_count;
+    uint32_t config_first, config_count;
+    uint32_t unloadable;
+};
+
+struct vlc_cache_map_module
+{
+    uint32_t shortname;
+    uint32_t longname;
+    uint32_t help;
+    uint32_t shortcuts; /**< Index in the tables of strings */
+    uint32_t shortcut_count;
+    uint32_t activate;
+    uint32_t deactivate;
+    uint32_t capability;
+    int32_t score;
+    uint32_t signatures;
+    uint32_t extensions;
+    uint32_t mime_types;
+};
+
+#define CACHE_MAP_ADVANCED  0x01
+#define CACHE_MAP_INTERNAL  0x02
+#define CACHE_MAP_UNSAVEABLE 0x04
+#define CACHE_MAP_SAFE      0x08
+#define CACHE_MAP_REMOVED   0x10
+
+struct vlc_cache_map_config
+{
+    uint64_t orig, min, max; /**< Value bits, or string offset */
+    uint32_t type;
+    uint32_t name;
+    uint32_t text;
+    uint32_t longtext;
+    uint32_t list_cb_name;
+    uint32_t list; /**< Integer list offset or index in the tables */
+    uint32_t list_text; /**< Index in the tables of strings */
+    uint16_t list_count;
+    uint8_t i_type;
+    uint8_t flags;
+    char i_short;
+};
+
+struct vlc_cache_map_cap
+{
+    uint32_t name;
+    uint32_t first; /**< Index of the first module index */
+    uint32_t count;
+};
+
+static_assert(sizeof (module_value_t) == sizeof (uint64_t),
+              "Unexpected configuration value size");
+
+struct vlc_cache_map_file
+{
+    const uint8_t *base;
+    struct vlc_cache_map_header hdr;
+};
+
+static const void *vlc_cache_map_table(const struct vlc_cache_map_file *map,
+                                       uint32_t offset, uint32_t count,
+                                       size_t size, size_t align)
+{
+    if (offset % align != 0
+     || offset + (uint64_t)count * size > map->hdr.strings)
+        return NULL;
+    return map->base + offset;
+}
+
+static int vlc_cache_map_string(const struct vlc_cache_map_file *map,
+                                uint32_t offset, const char **restrict p)
+{
+    if (offset == 0)
+    {
+        *p = NULL;
+        return 0;
+    }
+    /* The file ends with a nul byte: every string is terminated */
+    if (offset < map->hdr.strings || offset >= map->hdr.size)
+        return -1;
+    *p = (const char *)map->base + offset;
+    return 0;
+}
+
+static int vlc_cache_map_strings(const struct vlc_cache_map_file *map,
+                                 uint32_t index, uint32_t count,
+                                 const char **tab)
+{
+    const uint32_t *strtab = (const uint32_t *)(map->base + map->hdr.strtab);
+
+    if ((uint64_t)index + count > map->hdr.strtab_count)
+        return -1;
+
+    for (uint32_t i = 0; i < count; i++)
+        if (vlc_cache_map_string(map, strtab[index + i], &tab[i])
+         || tab[i] == NULL)
+            return -1;
+    return 0;
+}
+
+#define MAP_STRING(a, off) \
+    if (vlc_cache_map_string(map, (off), &(a))) \
+        goto error
+
+static int vlc_cache_map_config(const struct vlc_cache_map_file *map,
+                                const struct vlc_cache_map_config *rec,
+                                module_config_t *cfg, const char ***tabp)
+{
+    cfg->i_type = rec->i_type;
+    cfg->i_short = rec->i_short;
+    cfg->b_advanced = (rec->flags & CACHE_MAP_ADVANCED) != 0;
+    cfg->b_internal = (rec->flags & CACHE_MAP_INTERNAL) != 0;
+    cfg->b_unsaveable = (rec->flags & CACHE_MAP_UNSAVEABLE) != 0;
+    cfg->b_safe = (rec->flags & CACHE_MAP_SAFE) != 0;
+    cfg->b_removed = (rec->flags & CACHE_MAP_REMOVED) != 0;
+    MAP_STRING(cfg->psz_type, rec->type);
+    MAP_STRING(cfg->psz_name, rec->name);
+    MAP_STRING(cfg->psz_text, rec->text);
+    MAP_STRING(cfg->psz_longtext, rec->longtext);
+    MAP_STRING(cfg->list_cb_name, rec->list_cb_name);
+    cfg->list_count = rec->list_count;
+
+    if (IsConfigStringType(cfg->i_type))
+    {
+        const char *psz;
+
+        if (rec->orig > UINT32_MAX)
+            goto error;
+        MAP_STRING(psz, (uint32_t)rec->orig);
+        cfg->orig.psz = (char *)psz;
+        cfg->value.psz = (psz != NULL) ? strdup(psz) : NULL;
+
+        if (cfg->list_count > 0)
+        {
+            cfg->list.psz = *tabp;
+            *tabp += cfg->list_count;
+            if (vlc_cache_map_strings(map, rec->list, cfg->list_count,
+                                      cfg->list.psz))
+                goto error;
+        }
+    }
+    else
+    {
+        memcpy(&cfg->orig, &rec->orig, sizeof (cfg->orig));
+        memcpy(&cfg->min, &rec->min, sizeof (cfg->min));
+        memcpy(&cfg->max, &rec->max, sizeof (cfg->max));
+        cfg->value = cfg->orig;
+
+        if (cfg->list_count > 0)
+        {
+            if (rec->list < map->hdr.ints)
+                goto error;
+            cfg->list.i = vlc_cache_map_table(map, rec->list, cfg->list_count,
+                                              sizeof (*cfg->list.i),
+                                              alignof (*cfg->list.i));
+            if (cfg->list.i == NULL)
+                goto error;
+        }
+    }
+
+    if (cfg->list_count > 0)
+    {
+        cfg->list_text = *tabp;
+        *tabp += cfg->list_count;
+        if (vlc_cache_map_strings(map, rec->list_text, cfg->list_count,
+                                  cfg->list_text))
+            goto error;
+    }
+    return 0;
+error:
+    return -1;
+}
+
+static int vlc_cache_map_module(const struct vlc_cache_map_file *map,
+                                const struct vlc_cache_map_module *rec,
+                                module_t *module, const char ***tabp)
+{
+    MAP_STRING(module->psz_shortname, rec->shortname);
+    MAP_STRING(module->psz_longname, rec->longname);
+    MAP_STRING(module->psz_help, rec->help);
+    MAP_STRING(module->activate_name, rec->activate);
+    MAP_STRING(module->deactivate_name, rec->deactivate);
+    MAP_STRING(module->psz_capability, rec->capability);
+    module->i_score = rec->score;
+    MAP_STRING(module->psz_signatures, rec->signatures);
+    MAP_STRING(module->psz_extensions, rec->extensions);
+    MAP_STRING(module->psz_mime_types, rec->mime_types);
+    module->pf_activate = NULL;
+    module->pf_deactivate = NULL;
+
+    if (rec->shortcut_count > MODULE_SHORTCUT_MAX)
+        goto error;
+    module->i_shortcuts = rec->shortcut_count;
+    module->pp_shortcuts = *tabp;
+    *tabp += rec->shortcut_count;
+    return vlc_cache_map_strings(map, rec->shortcuts, rec->shortcut_count,
+                                 module->pp_shortcuts);
+error:
+    return -1;
+}
+
+static int vlc_cache_map_header(struct vlc_cache_map_file *map, size_t size)
+{
+    struct vlc_cache_map_header *hdr = &map->hdr;
+    const char *tag;
+
+    if (size < sizeof (*hdr) || size > UINT32_MAX)
+        return -1;
+    memcpy(hdr, map->base, sizeof (*hdr));
+
+    if (memcmp(hdr->magic, CACHE_MAP_MAGIC, sizeof (hdr->magic))
+     || hdr->version != CACHE_SUBVERSION_NUM
+     || hdr->byte_order != CACHE_MAP_BYTE_ORDER
+     || hdr->size != size
+     || hdr->strings < sizeof (*hdr) || hdr->strings >= size
+     || map->base[size - 1] != '\0'
+     || hdr->ints > hdr->strings)
+        return -1;
+
+    if (vlc_cache_map_string(map, hdr->tag, &tag) || tag == NULL
+     || strcmp(tag, CACHE_MAP_TAG))
+        return -1;
+
+    if (vlc_cache_map_table(map, hdr->plugins, hdr->plugin_count,
+                            sizeof (struct vlc_cache_map_plugin),
+                            alignof (struct vlc_cache_map_plugin)) == NULL
+     || vlc_cache_map_table(map, hdr->modules, hdr->module_count,
+                            sizeof (struct vlc_cache_map_module),
+                            alignof (struct vlc_cache_map_module)) == NULL
+     || vlc_cache_map_table(map, hdr->configs, hdr->config_count,
+                            sizeof (struct vlc_cache_map_config),
+                            alignof (struct vlc_cache_map_config)) == NULL
+     || vlc_cache_map_table(map, hdr->caps, hdr->cap_count,
+                            sizeof (struct vlc_cache_map_cap),
+                            alignof (struct vlc_cache_map_cap)) == NULL
+     || vlc_cache_map_table(map, hdr->refs, hdr->ref_count,
+                            sizeof (uint32_t), alignof (uint32_t)) == NULL
+     || vlc_cache_map_table(map, hdr->strtab, hdr->strtab_count,
+                            sizeof (uint32_t), alignof (uint32_t)) == NULL)
+        return -1;
+    return 0;
+}
+
+/**
+ * Loads a memory-mapped plugins cache file.
+ *
+ * This is equivalent to vlc_cache_load(), except that the descriptors of all
+ * cached plugins are allocated at once and refer to the file mapping, which
+ * is appended to the backing blocks. On success, *capsp points to the
+ * capability table of the cache (even if there are no plugins).
+ */
+vlc_plugin_t *vlc_cache_map(vlc_object_t *p_this, const char *dir,
+                            block_t **backingp, vlc_cache_caps_t **capsp)
+{
+    char *psz_filename;
+
+    assert(dir != NULL);
+    *capsp = NULL;
+
+    if (asprintf(&psz_filename, "%s"DIR_SEP CACHE_MAP_NAME, dir) == -1)
+        return NULL;
+
+    msg_Dbg(p_this, "mapping plugins cache file %s", psz_filename);
+
+    block_t *file = block_FilePath(psz_filename, false);
+    if (file == NULL)
+        msg_Dbg(p_this, "cannot read %s: %s", psz_filename,
+                vlc_strerror_c(errno));
+    free(psz_filename);
+    if (file == NULL)
+        return NULL;
+
+    struct vlc_cache_map_file mapping = { .base = file->p_buffer }, *map;
+    map = &mapping;
+
+    if (vlc_cache_map_header(map, file->i_buffer))
+    {
+        msg_Warn(p_this, "This doesn't look like a valid plugins cache");
+        block_Release(file);
+        return NULL;
+    }
+
+    const struct vlc_cache_map_header *hdr = &map->hdr;
+    const struct vlc_cache_map_plugin *plugrecs =
+        (const void *)(map->base + hdr->plugins);
+    const struct vlc_cache_map_module *modrecs =
+        (const void *)(map->base + hdr->modules);
+    const struct vlc_cache_map_config *cfgrecs =
+        (const void *)(map->base + hdr->configs);
+    const struct vlc_cache_map_cap *caprecs =
+        (const void *)(map->base + hdr->caps);
+    const uint32_t *refs = (const uint32_t *)(map->base + hdr->refs);
+
+    /* Compute the size of the absolute paths */
+    size_t dirlen = strlen(dir);
+    size_t pathsize = 0;
+
+    for (uint32_t i = 0; i < hdr->plugin_count; i++)
+    {
+        const char *path;
+
+        if (vlc_cache_map_string(map, plugrecs[i].path, &path) || path == NULL)
+            goto corrupt;
+        pathsize += dirlen + strlen(DIR_SEP) + strlen(path) + 1;
+    }
+
+    /* Allocate all descriptors at once */
+    size_t arenasize = sizeof (vlc_cache_caps_t)
+        + hdr->plugin_count * sizeof (vlc_plugin_t)
+        + hdr->module_count * sizeof (module_t)
+        + hdr->config_count * sizeof (module_config_t)
+        + hdr->cap_count * sizeof (*(*capsp)->caps)
+        + hdr->ref_count * sizeof (module_t *)
+        + hdr->strtab_count * sizeof (const char *)
+        + pathsize;
+    unsigned char *arena = calloc(1, arenasize);
+    if (unlikely(arena == NULL))
+    {
+        block_Release(file);
+        return NULL;
+    }
+
+    block_t *backing = block_heap_Alloc(arena, arenasize);
+    if (unlikely(backing == NULL))
+    {
+        block_Release(file);
+        return NULL;
+    }
+
+    vlc_cache_caps_t *caps = (void *)arena;
+    vlc_plugin_t *plugins = (void *)(caps + 1);
+    module_t *modules = (void *)(plugins + hdr->plugin_count);
+    module_config_t *configs = (void *)(modules + hdr->module_count);
+    void *capv = configs + hdr->config_count;
+    module_t **refv = (void *)((char *)capv
+                               + hdr->cap_count * sizeof (*caps->caps));
+    const char **tab = (void *)(refv + hdr->ref_count);
+    char *abspath = (void *)(tab + hdr->strtab_count);
+
+    caps->plugins = plugins;
+    caps->plugin_count = hdr->plugin_count;
+    caps->caps = capv;
+    caps->count = hdr->cap_count;
+
+    vlc_plugin_t *cache = NULL;
+    uint32_t next_module = 0, next_config = 0;
+
+    for (uint32_t i = 0; i < hdr->plugin_count; i++)
+    {
+        const struct vlc_cache_map_plugin *rec = &plugrecs[i];
+        vlc_plugin_t *plugin = &plugins[i];
+
+        /* Modules and items of each plugin follow those of the previous one */
+        if (rec->module_first != next_module
+         || rec->config_first != next_config
+         || rec->module_count > hdr->module_count - next_module
+         || rec->config_count > hdr->config_count - next_config
+         || rec->unloadable > 1)
+            goto error;
+        next_module += rec->module_count;
+        next_config += rec->config_count;
+
+        plugin->modules_count = rec->module_count;
+        plugin->conf.items = rec->config_count ? configs + rec->config_first
+                                               : NULL;
+        plugin->conf.size = rec->config_count;
+        atomic_init(&plugin->loaded, false);
+        plugin->unloadable = rec->unloadable;
+        plugin->handle = NULL;
+        plugin->mapped = true;
+        plugin->mtime = rec->mtime;
+        plugin->size = rec->size;
+
+        const char *path;
+
+        MAP_STRING(plugin->textdomain, rec->textdomain);
+        MAP_STRING(path, rec->path);
+        plugin->path = (char *)path;
+
+        /* Keep the module order, the first one owns the configuration */
+        module_t **pp = &plugin->module;
+        for (uint32_t j = 0; j < rec->module_count; j++)
+        {
+            module_t *module = &modules[rec->module_first + j];
+
+            if (vlc_cache_map_module(map, &modrecs[rec->module_first + j],
+                                     module, &tab))
+                goto error;
+            module->plugin = plugin;
+            *pp = module;
+            pp = &module->next;
+        }
+        *pp = NULL;
+
+        for (uint32_t j = 0; j < rec->config_count; j++)
+        {
+            module_config_t *item = &configs[rec->config_first + j];
+
+            if (vlc_cache_map_config(map, &cfgrecs[rec->config_first + j],
+                                     item, &tab))
+                goto error;
+
+            if (CONFIG_ITEM(item->i_type))
+            {
+                plugin->conf.count++;
+                if (item->i_type == CONFIG_ITEM_BOOL)
+                    plugin->conf.booleans++;
+            }
+            item->owner = plugin;
+        }
+
+        plugin->abspath = abspath;
+        abspath += sprintf(abspath, "%s" DIR_SEP "%s", dir, plugin->path) + 1;
+
+        if (plugin->textdomain != NULL)
+            vlc_bindtextdomain(plugin->textdomain);
+
+        plugin->next = cache;
+        cache = plugin;
+    }
+
+    if (next_module != hdr->module_count || next_config != hdr->config_count)
+        goto error;
+
+    /* Capability table */
+    for (uint32_t i = 0; i < hdr->cap_count; i++)
+    {
+        const struct vlc_cache_map_cap *rec = &caprecs[i];
+
+        if (rec->first > hdr->ref_count
+         || rec->count > hdr->ref_count - rec->first)
+            goto error;
+
+        MAP_STRING(caps->caps[i].name, rec->name);
+        if (caps->caps[i].name == NULL)
+            goto error;
+        caps->caps[i].modv = refv + rec->first;
+        caps->caps[i].modc = rec->count;
+
+        for (uint32_t j = 0; j < rec->count; j++)
+        {
+            uint32_t index = refs[rec->first + j];
+
+            if (index >= hdr->module_count)
+                goto error;
+            caps->caps[i].modv[j] = &modules[index];
+        }
+    }
+
+    file->p_next = backing;
+    backing->p_next = *backingp;
+    *backingp = file;
+    *capsp = caps;
+    return cache;
+
+error:
+    /* Only the string values are owned by mapped configuration items */
+    for (uint32_t i = 0; i < hdr->config_count; i++)
+        if (IsConfigStringType(configs[i].i_type))
+            free(configs[i].value.psz);
+    block_Release(backing);
+corrupt:
+    msg_Warn(p_this, "plugins cache not mapped (corrupted)");
+    block_Release(file);
+    return NULL;
+}
+
 #define SAVE_IMMEDIATE( a ) \
     if (fwrite (&(a), sizeof(a), 1, file) != 1) \
         goto error
@@ -589,6 +1103,9 @@ static int CacheSaveModule(FILE *file, const module_t *module)
     SAVE_STRING(module->deactivate_name);
     SAVE_STRING(module->psz_capability);
     SAVE_IMMEDIATE(module->i_score);
+    SAVE_STRING(module->psz_signatures);
+    SAVE_STRING(module->psz_extensions);
+    SAVE_STRING(module->psz_mime_types);
     return 0;
 error:
     return -1;
@@ -650,15 +1167,316 @@ error:
     return -1;
 }
 
-/**
- * Saves a module cache to disk, and release cache data from memory.
- */
-void CacheSave(vlc_object_t *p_this, const char *dir,
-               vlc_plugin_t *const *entries, size_t n)
+struct cache_map_pool
+{
+    char *data;
+    size_t size;
+    size_t alloc;
+    uint32_t base;
+};
+
+static int CacheMapString(struct cache_map_pool *pool, const char *str,
+                          uint32_t *offset)
+{
+    if (str == NULL)
+    {
+        *offset = 0;
+        return 0;
+    }
+
+    size_t len = strlen(str) + 1;
+
+    if ((uint64_t)pool->base + pool->size + len > UINT32_MAX)
+        return -1;
+
+    if (pool->size + len > pool->alloc)
+    {
+        size_t alloc = pool->alloc ? pool->alloc * 2 : 65536;
+        while (alloc < pool->size + len)
+            alloc *= 2;
+
+        char *data = realloc(pool->data, alloc);
+        if (unlikely(data == NULL))
+            return -1;
+        pool->data = data;
+        pool->alloc = alloc;
+    }
+
+    memcpy(pool->data + pool->size, str, len);
+    *offset = pool->base + pool->size;
+    pool->size += len;
+    return 0;
+}
+
+#define MAP_SAVE_STRING(a, str) \
+    if (CacheMapString(&pool, (str), &(a))) \
+        goto error
+
+struct cache_map_ref
+{
+    const char *capability;
+    int score;
+    uint32_t index;
+};
+
+static int CacheMapRefCmp(const void *a, const void *b)
+{
+    const struct cache_map_ref *ra = a, *rb = b;
+    int ret = strcmp(ra->capability, rb->capability);
+
+    if (ret != 0)
+        return ret;
+    /* Highest score first, as vlc_module_cmp() does */
+    if (ra->score != rb->score)
+        return (ra->score > rb->score) ? -1 : 1;
+    return (ra->index > rb->index) - (ra->index < rb->index);
+}
+
+static size_t CacheMapAlign(size_t offset, size_t align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+static int CacheSaveMap(FILE *file, vlc_plugin_t *const *cache, size_t n)
+{
+    struct vlc_cache_map_header hdr = {
+        .magic = CACHE_MAP_MAGIC,
+        .version = CACHE_SUBVERSION_NUM,
+        .byte_order = CACHE_MAP_BYTE_ORDER,
+        .plugin_count = n,
+    };
+    struct cache_map_pool pool = { NULL, 0, 0, 0 };
+    struct cache_map_ref *refs = NULL;
+    unsigned char *image = NULL;
+    size_t ints = 0;
+
+    /* Count the records and tables entries */
+    for (size_t i = 0; i < n; i++)
+    {
+        const vlc_plugin_t *plugin = cache[i];
+
+        for (const module_t *module = plugin->module;
+             module != NULL;
+             module = module->next)
+        {
+            hdr.module_count++;
+            hdr.strtab_count += module->i_shortcuts;
+            if (module->psz_capability != NULL)
+                hdr.ref_count++;
+        }
+
+        hdr.config_count += plugin->conf.size;
+        for (size_t j = 0; j < plugin->conf.size; j++)
+        {
+            const module_config_t *cfg = plugin->conf.items + j;
+
+            if (IsConfigStringType(cfg->i_type))
+                hdr.strtab_count += cfg->list_count;
+            else
+                ints += cfg->list_count;
+            hdr.strtab_count += cfg->list_count;
+        }
+    }
+
+    refs = vlc_alloc(hdr.ref_count, sizeof (*refs));
+    if (unlikely(refs == NULL && hdr.ref_count > 0))
+        goto error;
+
+    /* Sort the modules by capability, then by decreasing score */
+    uint32_t index = 0, ref = 0;
+
+    for (size_t i = 0; i < n; i++)
+        for (const module_t *module = cache[i]->module;
+             module != NULL;
+             module = module->next, index++)
+            if (module->psz_capability != NULL)
+            {
+                refs[ref].capability = module->psz_capability;
+                refs[ref].score = module->i_score;
+                refs[ref].index = index;
+                ref++;
+            }
+
+    if (hdr.ref_count > 0)
+        qsort(refs, hdr.ref_count, sizeof (*refs), CacheMapRefCmp);
+
+    for (size_t i = 0; i < hdr.ref_count; i++)
+        if (i == 0 || strcmp(refs[i - 1].capability, refs[i].capability))
+            hdr.cap_count++;
+
+    /* Lay out the tables */
+    size_t offset = sizeof (hdr);
+
+#define MAP_LAYOUT(field, count, type) \
+    offset = CacheMapAlign(offset, alignof (type)); \
+    hdr.field = offset; \
+    offset += (size_t)(count) * sizeof (type)
+
+    MAP_LAYOUT(plugins, hdr.plugin_count, struct vlc_cache_map_plugin);
+    MAP_LAYOUT(modules, hdr.module_count, struct vlc_cache_map_module);
+    MAP_LAYOUT(configs, hdr.config_count, struct vlc_cache_map_config);
+    MAP_LAYOUT(caps, hdr.cap_count, struct vlc_cache_map_cap);
+    MAP_LAYOUT(refs, hdr.ref_count, uint32_t);
+    MAP_LAYOUT(strtab, hdr.strtab_count, uint32_t);
+    MAP_LAYOUT(ints, ints, int);
+#undef MAP_LAYOUT
+
+    if (offset > UINT32_MAX)
+        goto error;
+    hdr.strings = offset;
+    pool.base = offset;
+
+    image = calloc(1, offset);
+    if (unlikely(image == NULL))
+        goto error;
+
+    struct vlc_cache_map_plugin *plugrecs = (void *)(image + hdr.plugins);
+    struct vlc_cache_map_module *modrecs = (void *)(image + hdr.modules);
+    struct vlc_cache_map_config *cfgrecs = (void *)(image + hdr.configs);
+    struct vlc_cache_map_cap *caprecs = (void *)(image + hdr.caps);
+    uint32_t *refrecs = (void *)(image + hdr.refs);
+    uint32_t *strtab = (void *)(image + hdr.strtab);
+    int *intv = (void *)(image + hdr.ints);
+    uint32_t mi = 0, ci = 0, si = 0;
+    size_t ii = 0;
+
+    MAP_SAVE_STRING(hdr.tag, CACHE_MAP_TAG);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const vlc_plugin_t *plugin = cache[i];
+        struct vlc_cache_map_plugin *prec = &plugrecs[i];
+
+        prec->mtime = plugin->mtime;
+        prec->size = plugin->size;
+        MAP_SAVE_STRING(prec->path, plugin->path);
+        MAP_SAVE_STRING(prec->textdomain, plugin->textdomain);
+        prec->unloadable = plugin->unloadable;
+        prec->module_first = mi;
+        prec->config_first = ci;
+
+        for (const module_t *module = plugin->module;
+             module != NULL;
+             module = module->next)
+        {
+            struct vlc_cache_map_module *mrec = &modrecs[mi++];
+
+            MAP_SAVE_STRING(mrec->shortname, module->psz_shortname);
+            MAP_SAVE_STRING(mrec->longname, module->psz_longname);
+            MAP_SAVE_STRING(mrec->help, module->psz_help);
+            MAP_SAVE_STRING(mrec->activate, module->activate_name);
+            MAP_SAVE_STRING(mrec->deactivate, module->deactivate_name);
+            MAP_SAVE_STRING(mrec->capability, module->psz_capability);
+            mrec->score = module->i_score;
+            MAP_SAVE_STRING(mrec->signatures, module->psz_signatures);
+            MAP_SAVE_STRING(mrec->extensions, module->psz_extensions);
+            MAP_SAVE_STRING(mrec->mime_types, module->psz_mime_types);
+            mrec->shortcuts = si;
+            mrec->shortcut_count = module->i_shortcuts;
+            for (unsigned j = 0; j < module->i_shortcuts; j++)
+                MAP_SAVE_STRING(strtab[si++], module->pp_shortcuts[j]);
+        }
+        prec->module_count = mi - prec->module_first;
+
+        for (size_t j = 0; j < plugin->conf.size; j++)
+        {
+            const module_config_t *cfg = plugin->conf.items + j;
+            struct vlc_cache_map_config *crec = &cfgrecs[ci++];
+
+            crec->i_type = cfg->i_type;
+            crec->i_short = cfg->i_short;
+            crec->flags = (cfg->b_advanced ? CACHE_MAP_ADVANCED : 0)
+                        | (cfg->b_internal ? CACHE_MAP_INTERNAL : 0)
+                        | (cfg->b_unsaveable ? CACHE_MAP_UNSAVEABLE : 0)
+                        | (cfg->b_safe ? CACHE_MAP_SAFE : 0)
+                        | (cfg->b_removed ? CACHE_MAP_REMOVED : 0);
+            MAP_SAVE_STRING(crec->type, cfg->psz_type);
+            MAP_SAVE_STRING(crec->name, cfg->psz_name);
+            MAP_SAVE_STRING(crec->text, cfg->psz_text);
+            MAP_SAVE_STRING(crec->longtext, cfg->psz_longtext);
+            crec->list_count = cfg->list_count;
+
+            if (IsConfigStringType(cfg->i_type))
+            {
+                uint32_t orig;
+
+                MAP_SAVE_STRING(orig, cfg->orig.psz);
+                crec->orig = orig;
+                if (cfg->list_count == 0)
+                    MAP_SAVE_STRING(crec->list_cb_name, cfg->list_cb_name);
+
+                crec->list = si;
+                for (unsigned k = 0; k < cfg->list_count; k++)
+                {
+                    const char *str = cfg->list.psz[k];
+                    MAP_SAVE_STRING(strtab[si++], str ? str : "");
+                }
+            }
+            else
+            {
+                memcpy(&crec->orig, &cfg->orig, sizeof (crec->orig));
+                memcpy(&crec->min, &cfg->min, sizeof (crec->min));
+                memcpy(&crec->max, &cfg->max, sizeof (crec->max));
+                if (cfg->list_count == 0)
+                    MAP_SAVE_STRING(crec->list_cb_name, cfg->list_cb_name);
+
+                crec->list = hdr.ints + ii * sizeof (*intv);
+                for (unsigned k = 0; k < cfg->list_count; k++)
+                    intv[ii++] = cfg->list.i[k];
+            }
+
+            crec->list_text = si;
+            for (unsigned k = 0; k < cfg->list_count; k++)
+            {
+                const char *str = cfg->list_text[k];
+                MAP_SAVE_STRING(strtab[si++], str ? str : "");
+            }
+        }
+        prec->config_count = ci - prec->config_first;
+    }
+
+    for (size_t i = 0, cap = 0; i < hdr.ref_count; i++)
+    {
+        if (i > 0 && !strcmp(refs[i - 1].capability, refs[i].capability))
+            caprecs[cap - 1].count++;
+        else
+        {
+            MAP_SAVE_STRING(caprecs[cap].name, refs[i].capability);
+            caprecs[cap].first = i;
+            caprecs[cap].count = 1;
+            cap++;
+        }
+        refrecs[i] = refs[i].index;
+    }
+
+    hdr.size = hdr.strings + pool.size;
+    memcpy(image, &hdr, sizeof (hdr));
+
+    if (fwrite(image, 1, hdr.strings, file) != hdr.strings
+     || fwrite(pool.data, 1, pool.size, file) != pool.size
+     || fflush(file))
+        goto error;
+
+    free(image);
+    free(pool.data);
+    free(refs);
+    return 0;
+
+error:
+    free(image);
+    free(pool.data);
+    free(refs);
+    return -1;
+}
+
+static void CacheSaveFile(vlc_object_t *p_this, const char *dir,
+                          const char *name,
+                          int (*save)(FILE *, vlc_plugin_t *const *, size_t),
+                          vlc_plugin_t *const *entries, size_t n)
 {
     char *filename = NULL, *tmpname = NULL;
 
-    if (asprintf (&filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1)
+    if (asprintf (&filename, "%s"DIR_SEP"%s", dir, name) == -1)
         goto out;
 
     if (asprintf (&tmpname, "%s.%"PRIu32, filename, (uint32_t)getpid ()) == -1)
@@ -674,7 +1492,7 @@ void CacheSave(vlc_object_t *p_this, const char *dir,
         goto out;
     }
 
-    if (CacheSaveBank(file, entries, n))
+    if (save(file, entries, n))
     {
         msg_Warn (p_this, "cannot write %s: %s", tmpname,
                   vlc_strerror_c(errno));
@@ -697,6 +1515,16 @@ out:
     free (tmpname);
 }
 
+/**
+ * Saves a module cache to disk, in both the serialized and mapped formats.
+ */
+void CacheSave(vlc_object_t *p_this, const char *dir,
+               vlc_plugin_t *const *entries, size_t n)
+{
+    CacheSaveFile(p_this, dir, CACHE_NAME, CacheSaveBank, entries, n);
+    CacheSaveFile(p_this, dir, CACHE_MAP_NAME, CacheSaveMap, entries, n);
+}
+
 /**
  * Looks up a plugin file in a table of cached plugins.
  */
@@ -70,6 +70,9 @@ module_t *vlc_module_create(vlc_plugin_t *plugin)
     module->i_shortcuts = 0;
     module->psz_capability = NULL;
     module->i_score = (parent != NULL) ? parent->i_score : 1;
+    module->psz_signatures = NULL;
+    module->psz_extensions = NULL;
+    module->psz_mime_types = NULL;
     module->activate_name = NULL;
     module->deactivate_name = NULL;
     module->pf_activate = NULL;
@@ -108,6 +111,7 @@ vlc_plugin_t *vlc_plugin_create(void)
     plugin->abspath = NULL;
     atomic_init(&plugin->loaded, false);
     plugin->unloadable = true;
+    plugin->mapped = false;
     plugin->handle = NULL;
     plugin->abspath = NULL;
     plugin->path = NULL;
@@ -127,6 +131,14 @@ void vlc_plugin_destroy(vlc_plugin_t *plugin)
     assert(plugin != NULL);
 #ifdef HAVE_DYNAMIC_PLUGINS
     assert(!plugin->unloadable || !atomic_load(&plugin->loaded));
+
+    if (plugin->mapped)
+    {   /* Descriptors are released with the cache mapping */
+        for (size_t i = 0; i < plugin->conf.size; i++)
+            if (IsConfigStringType(plugin->conf.items[i].i_type))
+                free(plugin->conf.items[i].value.psz);
+        return;
+    }
 #endif
 
     if (plugin->module != NULL)
@@ -316,6 +328,18 @@ static int vlc_plugin_desc_cb(void *ctx, void *tgt, int propid, ...)
             plugin->textdomain = va_arg(ap, const char *);
             break;
 
+        case VLC_MODULE_PROBE_SIGNATURES:
+            module->psz_signatures = va_arg (ap, const char *);
+            break;
+
+        case VLC_MODULE_PROBE_EXTENSIONS:
+            module->psz_extensions = va_arg (ap, const char *);
+            break;
+
+        case VLC_MODULE_PROBE_MIME_TYPES:
+            module->psz_mime_types = va_arg (ap, const char *);
+            break;
+
         case VLC_CONFIG_NAME:
         {
             const char *name = va_arg (ap, const char *);
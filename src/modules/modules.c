@@ -190,30 +190,107 @@ static int module_load (vlc_object_t *obj, module_t *m,
     return ret;
 }
 
-#undef vlc_module_load
+static bool module_match_list (const char *list, const char *value)
+{
+    size_t len = strlen (value);
+
+    while (*list)
+    {
+        size_t slen = strcspn (list, ",");
+
+        if (slen == len && !strncasecmp (list, value, len))
+            return true;
+        list += slen;
+        list += strspn (list, ",");
+    }
+    return false;
+}
+
+static int hex_value (char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static bool module_match_signature (const char *pattern,
+                                    const struct vlc_probe_hints *hints)
+{
+    const char *hex = strchr (pattern, ':');
+    uint8_t sig[32];
+    size_t len = 0;
+
+    if (hex == NULL)
+        return true; /* malformed: do not second-guess the module */
+
+    for (hex++; hex_value (hex[0]) >= 0 && hex_value (hex[1]) >= 0; hex += 2)
+    {
+        if (len >= sizeof (sig))
+            return true;
+        sig[len++] = (hex_value (hex[0]) << 4) | hex_value (hex[1]);
+    }
+    if (len == 0)
+        return true;
+
+    if (pattern[0] == '*')
+    {
+        for (size_t i = 0; i + len <= hints->peek_size; i++)
+            if (!memcmp (hints->peek + i, sig, len))
+                return true;
+        return false;
+    }
+
+    size_t offset = strtoul (pattern, NULL, 10);
+    return offset + len <= hints->peek_size
+        && !memcmp (hints->peek + offset, sig, len);
+}
+
 /**
- * Finds and instantiates the best module of a certain type.
- * All candidates modules having the specified capability and name will be
- * sorted in decreasing order of priority. Then the probe callback will be
- * invoked for each module, until it succeeds (returns 0), or all candidate
- * module failed to initialize.
- *
- * The probe callback first parameter is the address of the module entry point.
- * Further parameters are passed as an argument list; it corresponds to the
- * variable arguments passed to this function. This scheme is meant to
- * support arbitrary prototypes for the module entry point.
- *
- * \param obj VLC object
- * \param capability capability, i.e. class of module
- * \param name name of the module asked, if any
- * \param strict if true, do not fallback to plugin with a different name
- *                 but the same capability
- * \param probe module probe callback
- * \return the module or NULL in case of a failure
+ * Checks whether a stream may be accepted by a module, according to the
+ * probe hints declared by the module, if any.
  */
-module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
-                          const char *name, bool strict,
-                          vlc_activate_t probe, ...)
+static bool module_match_hints (const module_t *m,
+                                const struct vlc_probe_hints *hints)
+{
+    if (m->psz_signatures == NULL && m->psz_extensions == NULL
+     && m->psz_mime_types == NULL)
+        return true;
+
+    if (m->psz_extensions != NULL && hints->extension != NULL
+     && module_match_list (m->psz_extensions, hints->extension))
+        return true;
+
+    if (m->psz_mime_types != NULL && hints->mime_type != NULL
+     && module_match_list (m->psz_mime_types, hints->mime_type))
+        return true;
+
+    for (const char *sigs = m->psz_signatures; sigs != NULL && *sigs; )
+    {
+        char pattern[80];
+        size_t slen = strcspn (sigs, " ");
+
+        if (slen < sizeof (pattern))
+        {
+            memcpy (pattern, sigs, slen);
+            pattern[slen] = '\0';
+            if (module_match_signature (pattern, hints))
+                return true;
+        }
+        else
+            return true;
+        sigs += slen;
+        sigs += strspn (sigs, " ");
+    }
+    return false;
+}
+
+static module_t *vlc_module_load_va(vlc_object_t *obj, const char *capability,
+                                    const char *name, bool strict,
+                                    const struct vlc_probe_hints *hints,
+                                    vlc_activate_t probe, va_list args)
 {
     char *var = NULL;
 
@@ -242,9 +319,17 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
 
     module_t *module = NULL;
     const bool b_force_backup = obj->obj.force; /* FIXME: remove this */
-    va_list args;
+    /* Candidates whose probe hints do not match are only tried last */
+    module_t **deferred = NULL;
+    size_t deferred_count = 0;
+
+    if (hints != NULL)
+    {
+        deferred = vlc_alloc (total, sizeof (*deferred));
+        if (unlikely(deferred == NULL))
+            hints = NULL;
+    }
 
-    va_start(args, probe);
     while (*name)
     {
         char buf[32];
@@ -276,6 +361,13 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
                 continue;
             mods[i] = NULL; // only try each module once at most...
 
+            if (hints != NULL && !obj->obj.force
+             && !module_match_hints (cand, hints))
+            {
+                deferred[deferred_count++] = cand;
+                continue;
+            }
+
             int ret = module_load (obj, cand, probe, args);
             switch (ret)
             {
@@ -298,6 +390,12 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
             if (cand == NULL || module_get_score (cand) <= 0)
                 continue;
 
+            if (hints != NULL && !module_match_hints (cand, hints))
+            {
+                deferred[deferred_count++] = cand;
+                continue;
+            }
+
             int ret = module_load (obj, cand, probe, args);
             switch (ret)
             {
@@ -309,9 +407,29 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
             }
         }
     }
+
+    /* Finally, try the candidates whose hints did not match, in case the
+     * hints are incomplete */
+    obj->obj.force = false;
+    for (size_t i = 0; i < deferred_count; i++)
+    {
+        module_t *cand = deferred[i];
+
+        int ret = module_load (obj, cand, probe, args);
+        switch (ret)
+        {
+            case VLC_SUCCESS:
+                msg_Warn (obj, "module \"%s\" probe hints did not match",
+                          module_get_object (cand));
+                module = cand;
+                /* fall through */
+            case VLC_ETIMEOUT:
+                goto done;
+        }
+    }
 done:
-    va_end (args);
     obj->obj.force = b_force_backup;
+    free (deferred);
     module_list_free (mods);
     free (var);
 
@@ -326,6 +444,60 @@ done:
     return module;
 }
 
+#undef vlc_module_load
+/**
+ * Finds and instantiates the best module of a certain type.
+ * All candidates modules having the specified capability and name will be
+ * sorted in decreasing order of priority. Then the probe callback will be
+ * invoked for each module, until it succeeds (returns 0), or all candidate
+ * module failed to initialize.
+ *
+ * The probe callback first parameter is the address of the module entry point.
+ * Further parameters are passed as an argument list; it corresponds to the
+ * variable arguments passed to this function. This scheme is meant to
+ * support arbitrary prototypes for the module entry point.
+ *
+ * \param obj VLC object
+ * \param capability capability, i.e. class of module
+ * \param name name of the module asked, if any
+ * \param strict if true, do not fallback to plugin with a different name
+ *                 but the same capability
+ * \param probe module probe callback
+ * \return the module or NULL in case of a failure
+ */
+module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
+                          const char *name, bool strict,
+                          vlc_activate_t probe, ...)
+{
+    va_list args;
+
+    va_start(args, probe);
+    module_t *module = vlc_module_load_va(obj, capability, name, strict,
+                                          NULL, probe, args);
+    va_end(args);
+    return module;
+}
+
+/**
+ * Finds and instantiates the best module of a certain type, like
+ * vlc_module_load(), but first skips the candidates whose probe hints do not
+ * match the given stream properties. Those are only tried if no other
+ * candidate could be instantiated. Forced candidates are always tried first.
+ */
+module_t *vlc_module_load_hinted(vlc_object_t *obj, const char *capability,
+                                 const char *name, bool strict,
+                                 const struct vlc_probe_hints *hints,
+                                 vlc_activate_t probe, ...)
+{
+    va_list args;
+
+    va_start(args, probe);
+    module_t *module = vlc_module_load_va(obj, capability, name, strict,
+                                          hints, probe, args);
+    va_end(args);
+    return module;
+}
+
 #undef vlc_module_unload
 /**
  * Deinstantiates a module.
@@ -25,6 +25,7 @@
 # define LIBVLC_MODULES_H 1
 
 # include <vlc_atomic.h>
+# include <vlc_modules.h>
 
 /** The plugin handle type */
 typedef void *module_handle_t;
@@ -52,6 +53,7 @@ typedef struct vlc_plugin_t
 #ifdef HAVE_DYNAMIC_PLUGINS
     atomic_bool loaded; /**< Whether the plug-in is mapped in memory */
     bool unloadable; /**< Whether the plug-in can be unloaded safely */
+    bool mapped; /**< Whether the descriptors belong to a mapped cache */
     module_handle_t handle; /**< Run-time linker handle (if loaded) */
     char *abspath; /**< Absolute path */
 
@@ -96,6 +98,11 @@ struct module_t
     const char *psz_capability;                              /**< Capability */
     int      i_score;                          /**< Score for the capability */
 
+    /* Probe hints (see set_probe_signatures()) */
+    const char *psz_signatures;
+    const char *psz_extensions;
+    const char *psz_mime_types;
+
     /* Callbacks */
     const char *activate_name;
     const char *deactivate_name;
@@ -119,6 +126,22 @@ int module_Map(vlc_object_t *, vlc_plugin_t *);
 
 ssize_t module_list_cap (module_t ***, const char *);
 
+/** Stream properties matched against the module probe hints */
+struct vlc_probe_hints
+{
+    const uint8_t *peek; /**< First bytes of the stream (or NULL) */
+    size_t peek_size;
+    const char *extension; /**< File extension without dot (or NULL) */
+    const char *mime_type; /**< MIME type without parameters (or NULL) */
+};
+
+/** Number of bytes to peek for signature matching */
+#define VLC_PROBE_HINTS_PEEK 256
+
+module_t *vlc_module_load_hinted(vlc_object_t *, const char *, const char *,
+                                 bool, const struct vlc_probe_hints *,
+                                 vlc_activate_t, ...) VLC_USED;
+
 int vlc_bindtextdomain (const char *);
 
 /* Low-level OS-dependent handler */
@@ -128,6 +151,23 @@ void module_Unload (module_handle_t);
 
 /* Plugins cache */
 vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
+
+/** Capability table of a memory-mapped plugins cache */
+typedef struct vlc_cache_caps
+{
+    vlc_plugin_t *plugins; /**< Table of the mapped plugins */
+    size_t plugin_count;
+    struct
+    {
+        const char *name;
+        module_t **modv; /**< Modules by decreasing score */
+        size_t modc;
+    } *caps; /**< Capabilities by name */
+    size_t count;
+} vlc_cache_caps_t;
+
+vlc_plugin_t *vlc_cache_map(vlc_object_t *, const char *, block_t **,
+                            vlc_cache_caps_t **);
 vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **, const char *relpath);
 
 void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t);
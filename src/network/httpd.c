@@ -53,6 +53,12 @@
 # include <poll.h>
 #endif
 
+#ifdef __linux__
+# define HTTPD_EPOLL 1
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
+
 #if defined(_WIN32)
 #   include <winsock2.h>
 #else
@@ -66,8 +72,25 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Maximum number of stream blocks sent at once */
+#define HTTPD_CL_IOV 64
+
+/* Maximum number of receive or send calls for a client in a row */
+#define HTTPD_CL_STEPS 64
+
+#define HTTPD_EPOLL_EVENTS 256
+
+/* Minimum delay between two runs of the clients waiting for stream data, so
+ * that small stream blocks are sent together */
+#define HTTPD_WAKE_DELAY (CLOCK_FREQ / 200)
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+static void httpd_HostRemoveClient(httpd_host_t *host, httpd_client_t *cl);
+static int httpd_AppendData(httpd_stream_t *stream, const block_t *p_block);
+static void httpd_HostWake(httpd_host_t *host);
+#ifdef HTTPD_EPOLL
+static void httpd_ClientSetReady(httpd_host_t *host, httpd_client_t *cl);
+#endif
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -96,6 +119,19 @@ struct httpd_host_t
     int            i_client;
     httpd_client_t **client;
 
+#ifdef HTTPD_EPOLL
+    int         epfd;
+    int         wakefd;     /* signaled when a stream has new data */
+    bool        b_wake_pending;
+    mtime_t     i_wake_date; /* next run of the waiting clients */
+
+    /* clients to run in the next loop */
+    httpd_client_t **ready;
+    size_t      i_ready;
+    size_t      i_ready_alloc;
+    mtime_t     i_sweep_date;
+#endif
+
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -152,6 +188,8 @@ struct httpd_client_t
     int     i_buffer_size;
     int     i_buffer;
     uint8_t *p_buffer;
+    block_t *p_buffer_block; /* if set, owns p_buffer (stream data) */
+    block_t *p_answer_block; /* if set, owns answer.p_body (stream data) */
 
     /*
      * If waiting for a keyframe, this is the position (in bytes) of the
@@ -164,6 +202,11 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+#ifdef HTTPD_EPOLL
+    bool    b_readable;     /* until receiving would block */
+    bool    b_writable;     /* until sending would block */
+    bool    b_ready;        /* in the host list of clients to run */
+#endif
 };
 
 
@@ -587,6 +630,19 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+
+/* Blocks smaller than this are copied together into chunks of
+ * HTTPD_STREAM_CHUNK bytes, larger ones are referenced as they are. */
+#define HTTPD_STREAM_COPY_MAX 4096
+#define HTTPD_STREAM_CHUNK    65536
+
+typedef struct
+{
+    block_t *p_block;   /* shareable, see block_Shareable() */
+    int64_t i_pos;      /* absolute position of the first byte */
+    bool    b_append;   /* owned by the stream, more data may be copied in */
+} httpd_stream_chunk_t;
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -606,9 +662,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* circular array of the data blocks, oldest first. Clients send
+     * references to the blocks rather than copies of the data. */
+    int         i_buffer_size;      /* minimum history size in bytes */
+    httpd_stream_chunk_t *p_chunks;
+    size_t      i_chunks;
+    size_t      i_chunks_first;     /* index of the oldest chunk */
+    size_t      i_chunks_alloc;
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -617,6 +677,33 @@ struct httpd_stream_t
     httpd_header * p_http_headers;
 };
 
+static httpd_stream_chunk_t *httpd_StreamChunk(httpd_stream_t *stream,
+                                               size_t i)
+{
+    return &stream->p_chunks[(stream->i_chunks_first + i)
+                             % stream->i_chunks_alloc];
+}
+
+/* Finds the chunk holding the byte at the given position, if still there */
+static const httpd_stream_chunk_t *httpd_StreamFind(httpd_stream_t *stream,
+                                                    int64_t i_pos)
+{
+    size_t lo = 0, hi = stream->i_chunks;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const httpd_stream_chunk_t *chunk = httpd_StreamChunk(stream, mid);
+
+        if (i_pos < chunk->i_pos)
+            hi = mid;
+        else if (i_pos >= chunk->i_pos + (int64_t)chunk->p_block->i_buffer)
+            lo = mid + 1;
+        else
+            return chunk;
+    }
+    return NULL;
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -627,34 +714,53 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
+        vlc_mutex_lock(&stream->lock);
 
         if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+            goto wait;              /* wait, no data available */
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
             if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
                 /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+                goto wait;
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
+        const httpd_stream_chunk_t *chunk =
+            httpd_StreamFind(stream, answer->i_body_offset);
+        if (chunk == NULL) {
+            /* this client isn't fast enough */
+            answer->i_body_offset = stream->i_buffer_last_pos;
+            chunk = httpd_StreamFind(stream, answer->i_body_offset);
+            if (chunk == NULL)
+                goto wait;
+        }
+
+        /* Send references to the following chunks, as far as they have
+         * been written now */
+        block_t *p_body = NULL, **pp_last = &p_body;
+        int64_t i_write = 0;
+        size_t i_skip = answer->i_body_offset - chunk->i_pos;
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+        for (unsigned i = 0; i < HTTPD_CL_IOV && chunk != NULL; i++) {
+            block_t *p_ref = block_Share(chunk->p_block);
+            if (unlikely(p_ref == NULL))
+                break;
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+            p_ref->p_buffer += i_skip;
+            p_ref->i_buffer -= i_skip;
+            i_write += p_ref->i_buffer;
+            block_ChainLastAppend(&pp_last, p_ref);
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+            chunk = httpd_StreamFind(stream, answer->i_body_offset + i_write);
+            i_skip = 0;
+        }
+        if (p_body == NULL)
+            goto wait;
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
@@ -662,12 +768,15 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         answer->i_type   = HTTPD_MSG_ANSWER;
 
         answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
+        answer->p_body = p_body->p_buffer;
+        cl->p_answer_block = p_body;
 
         answer->i_body_offset += i_write;
 
         return VLC_SUCCESS;
+wait:
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -764,7 +873,10 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->p_chunks = NULL;
+    stream->i_chunks = 0;
+    stream->i_chunks_first = 0;
+    stream->i_chunks_alloc = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -800,22 +912,112 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static int httpd_StreamPush(httpd_stream_t *stream, block_t *p_block,
+                            bool b_append)
+{
+    if (stream->i_chunks == stream->i_chunks_alloc) {
+        size_t i_alloc = stream->i_chunks_alloc ? 2 * stream->i_chunks_alloc
+                                                : 64;
+        httpd_stream_chunk_t *p_chunks =
+            vlc_alloc(i_alloc, sizeof (*p_chunks));
+        if (unlikely(p_chunks == NULL)) {
+            block_Release(p_block);
+            return VLC_ENOMEM;
+        }
+
+        for (size_t i = 0; i < stream->i_chunks; i++)
+            p_chunks[i] = *httpd_StreamChunk(stream, i);
+        free(stream->p_chunks);
+        stream->p_chunks = p_chunks;
+        stream->i_chunks_first = 0;
+        stream->i_chunks_alloc = i_alloc;
+    }
+
+    httpd_stream_chunk_t *chunk = httpd_StreamChunk(stream, stream->i_chunks);
+    chunk->p_block = p_block;
+    chunk->i_pos = stream->i_buffer_pos;
+    chunk->b_append = b_append;
+    stream->i_chunks++;
+    return VLC_SUCCESS;
+}
+
+/* Drops the oldest chunks not needed for the history */
+static void httpd_StreamTrim(httpd_stream_t *stream)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
+    while (stream->i_chunks > 1) {
+        httpd_stream_chunk_t *chunk = httpd_StreamChunk(stream, 0);
+        int64_t i_end = chunk->i_pos + chunk->p_block->i_buffer;
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+        if (stream->i_buffer_pos - i_end < stream->i_buffer_size)
+            break;
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+        block_Release(chunk->p_block);
+        stream->i_chunks_first = (stream->i_chunks_first + 1)
+                                 % stream->i_chunks_alloc;
+        stream->i_chunks--;
     }
+}
 
-    stream->i_buffer_pos += i_data;
+static void httpd_StreamClear(httpd_stream_t *stream)
+{
+    for (size_t i = 0; i < stream->i_chunks; i++)
+        block_Release(httpd_StreamChunk(stream, i)->p_block);
+    stream->i_chunks = 0;
+    stream->i_chunks_first = 0;
+}
+
+static int httpd_AppendData(httpd_stream_t *stream, const block_t *p_block)
+{
+    size_t i_data = p_block->i_buffer;
+
+    if (i_data == 0)
+        return VLC_SUCCESS;
+
+    if (stream->i_chunks > 0) {
+        httpd_stream_chunk_t *last =
+            httpd_StreamChunk(stream, stream->i_chunks - 1);
+        block_t *p_last = last->p_block;
+
+        /* Only the unused end of the chunk is written to, so that the data
+         * already referenced by the clients never changes. */
+        if (last->b_append && i_data <= HTTPD_STREAM_COPY_MAX
+         && p_last->p_buffer + p_last->i_buffer + i_data
+                                    <= p_last->p_start + p_last->i_size) {
+            memcpy(p_last->p_buffer + p_last->i_buffer, p_block->p_buffer,
+                   i_data);
+            p_last->i_buffer += i_data;
+            stream->i_buffer_pos += i_data;
+            return VLC_SUCCESS;
+        }
+    }
+
+    block_t *p_chunk;
+    bool b_append = false;
+
+    if (i_data <= HTTPD_STREAM_COPY_MAX) {
+        p_chunk = block_Alloc(HTTPD_STREAM_CHUNK);
+        if (unlikely(p_chunk == NULL))
+            return VLC_ENOMEM;
+        memcpy(p_chunk->p_buffer, p_block->p_buffer, i_data);
+        p_chunk->i_buffer = i_data;
+        b_append = true;
+    } else {
+        /* No copy if the block is already shared */
+        p_chunk = block_Share(p_block);
+        if (unlikely(p_chunk == NULL))
+            return VLC_ENOMEM;
+    }
+
+    p_chunk = block_Shareable(p_chunk);
+    if (unlikely(p_chunk == NULL))
+        return VLC_ENOMEM;
+
+    int ret = httpd_StreamPush(stream, p_chunk, b_append);
+    if (ret == VLC_SUCCESS) {
+        stream->i_buffer_pos += i_data;
+        httpd_StreamTrim(stream);
+    }
+    return ret;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
@@ -833,10 +1035,11 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    int ret = httpd_AppendData(stream, p_block);
 
     vlc_mutex_unlock(&stream->lock);
-    return VLC_SUCCESS;
+    httpd_HostWake(stream->url->host);
+    return ret;
 }
 
 void httpd_StreamDelete(httpd_stream_t *stream)
@@ -850,7 +1053,8 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    httpd_StreamClear(stream);
+    free(stream->p_chunks);
     free(stream);
 }
 
@@ -965,6 +1169,34 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->client   = NULL;
     host->p_tls    = p_tls;
 
+#ifdef HTTPD_EPOLL
+    host->ready = NULL;
+    host->i_ready = 0;
+    host->i_ready_alloc = 0;
+    host->i_sweep_date = 0;
+    host->b_wake_pending = false;
+    host->i_wake_date = 0;
+    host->wakefd = -1;
+    host->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (host->epfd == -1) {
+        msg_Err(p_this, "cannot create HTTP host poll: %s",
+                vlc_strerror_c(errno));
+        goto error;
+    }
+
+    host->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (host->wakefd == -1
+     || epoll_ctl(host->epfd, EPOLL_CTL_ADD, host->wakefd,
+                  &(struct epoll_event){ .events = EPOLLIN,
+                                         .data.ptr = &host->wakefd }))
+        goto error;
+    for (unsigned i = 0; i < host->nfd; i++)
+        if (epoll_ctl(host->epfd, EPOLL_CTL_ADD, host->fds[i],
+                      &(struct epoll_event){ .events = EPOLLIN,
+                                             .data.ptr = &host->fds[i] }))
+            goto error;
+#endif
+
     /* create the thread */
     if (vlc_clone(&host->thread, httpd_HostThread, host,
                    VLC_THREAD_PRIORITY_LOW)) {
@@ -982,6 +1214,14 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+#ifdef HTTPD_EPOLL
+        if (host->fds != NULL) {
+            if (host->wakefd != -1)
+                vlc_close(host->wakefd);
+            if (host->epfd != -1)
+                vlc_close(host->epfd);
+        }
+#endif
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1025,6 +1265,11 @@ void httpd_HostDelete(httpd_host_t *host)
         httpd_ClientDestroy(host->client[i]);
     }
     TAB_CLEAN(host->i_client, host->client);
+#ifdef HTTPD_EPOLL
+    free(host->ready);
+    vlc_close(host->wakefd);
+    vlc_close(host->epfd);
+#endif
 
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
@@ -1102,12 +1347,20 @@ void httpd_UrlDelete(httpd_url_t *url)
 
         /* TODO complete it */
         msg_Warn(host, "force closing connections");
-        TAB_REMOVE(host->i_client, host->client, client);
-        httpd_ClientDestroy(client);
+#ifdef HTTPD_EPOLL
+        /* The host thread may be handling events of the client: it will
+         * destroy it. */
+        client->url = NULL;
+        client->i_state = HTTPD_CLIENT_DEAD;
+        httpd_ClientSetReady(host, client);
+#else
+        httpd_HostRemoveClient(host, client);
         i--;
+#endif
     }
     free(url);
     vlc_mutex_unlock(&host->lock);
+    httpd_HostWake(host);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1187,6 +1440,8 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->i_buffer_size = HTTPD_CL_BUFSIZE;
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
+    cl->p_buffer_block = NULL;
+    cl->p_answer_block = NULL;
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
 
@@ -1204,16 +1459,67 @@ char* httpd_ServerIP(const httpd_client_t *cl, char *ip, int *port)
     return net_GetSockAddress(vlc_tls_GetFD(cl->sock), ip, port) ? NULL : ip;
 }
 
+static void httpd_ClientBufferRelease(httpd_client_t *cl)
+{
+    if (cl->p_buffer_block != NULL) {
+        block_ChainRelease(cl->p_buffer_block);
+        cl->p_buffer_block = NULL;
+    } else
+        free(cl->p_buffer);
+    cl->p_buffer = NULL;
+}
+
+/* Sends the answer body next, without copying it */
+static void httpd_ClientBufferBody(httpd_client_t *cl)
+{
+    httpd_ClientBufferRelease(cl);
+    cl->p_buffer       = cl->answer.p_body;
+    cl->p_buffer_block = cl->p_answer_block;
+    cl->i_buffer_size  = cl->answer.i_body;
+    cl->i_buffer       = 0;
+
+    cl->answer.i_body       = 0;
+    cl->answer.p_body       = NULL;
+    cl->p_answer_block      = NULL;
+}
+
+static void httpd_ClientAnswerClean(httpd_client_t *cl)
+{
+    if (cl->p_answer_block != NULL) {
+        block_ChainRelease(cl->p_answer_block);
+        cl->p_answer_block = NULL;
+        cl->answer.p_body = NULL; /* owned by the blocks */
+    }
+    httpd_MsgClean(&cl->answer);
+}
+
 static void httpd_ClientDestroy(httpd_client_t *cl)
 {
     vlc_tls_Close(cl->sock);
-    httpd_MsgClean(&cl->answer);
+    httpd_ClientAnswerClean(cl);
     httpd_MsgClean(&cl->query);
 
-    free(cl->p_buffer);
+    httpd_ClientBufferRelease(cl);
     free(cl);
 }
 
+static void httpd_HostRemoveClient(httpd_host_t *host, httpd_client_t *cl)
+{
+#ifdef HTTPD_EPOLL
+    if (cl->b_ready) {
+        for (size_t i = 0; i < host->i_ready; i++)
+            if (host->ready[i] == cl) {
+                memmove(host->ready + i, host->ready + i + 1,
+                        (--host->i_ready - i) * sizeof (*host->ready));
+                break;
+            }
+    }
+    epoll_ctl(host->epfd, EPOLL_CTL_DEL, vlc_tls_GetFD(cl->sock), NULL);
+#endif
+    TAB_REMOVE(host->i_client, host->client, cl);
+    httpd_ClientDestroy(cl);
+}
+
 static httpd_client_t *httpd_ClientNew(vlc_tls_t *sock, mtime_t now)
 {
     httpd_client_t *cl = malloc(sizeof(httpd_client_t));
@@ -1244,6 +1550,40 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return sock->writev(sock, &iov, 1);
 }
 
+/* Sends the chain of blocks of the body with a single system call, and
+ * releases the blocks as they are sent */
+static
+ssize_t httpd_NetSendChain (httpd_client_t *cl)
+{
+    vlc_tls_t *sock = cl->sock;
+    struct iovec iov[HTTPD_CL_IOV];
+    unsigned i_iov = 0;
+
+    for (block_t *b = cl->p_buffer_block; b != NULL && i_iov < HTTPD_CL_IOV;
+         b = b->p_next) {
+        iov[i_iov].iov_base = b->p_buffer;
+        iov[i_iov].iov_len = b->i_buffer;
+        i_iov++;
+    }
+
+    ssize_t i_len = sock->writev(sock, iov, i_iov);
+
+    for (size_t i_sent = i_len > 0 ? i_len : 0; i_sent > 0;) {
+        block_t *b = cl->p_buffer_block;
+
+        if (i_sent < b->i_buffer) {
+            b->p_buffer += i_sent;
+            b->i_buffer -= i_sent;
+            break;
+        }
+        i_sent -= b->i_buffer;
+        cl->p_buffer_block = b->p_next;
+        block_Release(b);
+    }
+    cl->p_buffer = cl->p_buffer_block ? cl->p_buffer_block->p_buffer : NULL;
+    return i_len;
+}
+
 
 static const struct
 {
@@ -1267,7 +1607,8 @@ msg_type[] =
 };
 
 
-static void httpd_ClientRecv(httpd_client_t *cl)
+/* Returns true if no more data could be received for now */
+static bool httpd_ClientRecv(httpd_client_t *cl)
 {
     int i_len;
 
@@ -1549,11 +1890,13 @@ static void httpd_ClientRecv(httpd_client_t *cl)
     /* XXX: for QT I have to disable timeout. Try to find why */
     if (cl->query.i_proto == HTTPD_PROTO_RTSP)
         cl->i_activity_timeout = 0;
+    return i_len < 0;
 }
 
-static void httpd_ClientSend(httpd_client_t *cl)
+/* Returns true if no more data could be sent for now */
+static bool httpd_ClientSend(httpd_client_t *cl)
 {
-    int i_len;
+    ssize_t i_len;
 
     if (cl->i_buffer < 0) {
         /* We need to create the header */
@@ -1566,9 +1909,9 @@ static void httpd_ClientSend(httpd_client_t *cl)
             i_size += strlen(cl->answer.p_headers[i].name) + 2 +
                       strlen(cl->answer.p_headers[i].value) + 2;
 
-        if (cl->i_buffer_size < i_size) {
+        if (cl->i_buffer_size < i_size || cl->p_buffer_block != NULL) {
             cl->i_buffer_size = i_size;
-            free(cl->p_buffer);
+            httpd_ClientBufferRelease(cl);
             cl->p_buffer = xmalloc(i_size);
         }
         p = (char *)cl->p_buffer;
@@ -1586,8 +1929,11 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
+    if (cl->p_buffer_block != NULL)
+        i_len = httpd_NetSendChain(cl);
+    else
+        i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                              cl->i_buffer_size - cl->i_buffer);
     if (i_len >= 0) {
         cl->i_buffer += i_len;
 
@@ -1597,7 +1943,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
                 int     i_msg = cl->query.i_type;
                 int64_t i_offset = cl->answer.i_body_offset;
 
-                httpd_MsgClean(&cl->answer);
+                httpd_ClientAnswerClean(cl);
                 cl->answer.i_body_offset = i_offset;
 
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
@@ -1606,13 +1952,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
 
             if (cl->answer.i_body > 0) {
                 /* send the body data */
-                free(cl->p_buffer);
-                cl->p_buffer = cl->answer.p_body;
-                cl->i_buffer_size = cl->answer.i_body;
-                cl->i_buffer = 0;
-
-                cl->answer.i_body = 0;
-                cl->answer.p_body = NULL;
+                httpd_ClientBufferBody(cl);
             } else /* send finished */
                 cl->i_state = HTTPD_CLIENT_SEND_DONE;
         }
@@ -1627,6 +1967,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
             cl->i_state = HTTPD_CLIENT_DEAD;
         }
     }
+    return i_len < 0;
 }
 
 static void httpd_ClientTlsHandshake(httpd_host_t *host, httpd_client_t *cl)
@@ -1680,6 +2021,450 @@ auth_failed:
     return false;
 }
 
+/* Handles the requests and the end of the answers */
+static void httpd_ClientPrepare(httpd_host_t *host, httpd_client_t *cl)
+{
+    int64_t i_offset;
+
+    if (cl->i_state == HTTPD_CLIENT_RECEIVE_DONE) {
+        httpd_message_t *answer = &cl->answer;
+        httpd_message_t *query  = &cl->query;
+
+        httpd_MsgInit(answer);
+
+        /* Handle what we received */
+        switch (query->i_type) {
+            case HTTPD_MSG_ANSWER:
+                cl->url     = NULL;
+                cl->i_state = HTTPD_CLIENT_DEAD;
+                break;
+
+            case HTTPD_MSG_OPTIONS:
+                answer->i_type   = HTTPD_MSG_ANSWER;
+                answer->i_proto  = query->i_proto;
+                answer->i_status = 200;
+                answer->i_body = 0;
+                answer->p_body = NULL;
+
+                httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                httpd_MsgAdd(answer, "Content-Length", "0");
+
+                switch(query->i_proto) {
+                case HTTPD_PROTO_HTTP:
+                    answer->i_version = 1;
+                    httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                    break;
+
+                case HTTPD_PROTO_RTSP:
+                    answer->i_version = 0;
+
+                    const char *p = httpd_MsgGet(query, "Cseq");
+                    if (p)
+                        httpd_MsgAdd(answer, "Cseq", "%s", p);
+                    p = httpd_MsgGet(query, "Timestamp");
+                    if (p)
+                        httpd_MsgAdd(answer, "Timestamp", "%s", p);
+
+                    p = httpd_MsgGet(query, "Require");
+                    if (p) {
+                        answer->i_status = 551;
+                        httpd_MsgAdd(query, "Unsupported", "%s", p);
+                    }
+
+                    httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                            "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                    break;
+                }
+
+                if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                    httpd_MsgAdd(answer, "Connection", "close");
+
+                cl->i_buffer = -1;  /* Force the creation of the answer in
+                                     * httpd_ClientSend */
+                cl->i_state = HTTPD_CLIENT_SENDING;
+                break;
+
+            case HTTPD_MSG_NONE:
+                if (query->i_proto == HTTPD_PROTO_NONE) {
+                    cl->url = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                } else {
+                    /* unimplemented */
+                    answer->i_proto  = query->i_proto ;
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_version= 0;
+                    answer->i_status = 501;
+
+                    char *p;
+                    answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                    answer->p_body = (uint8_t *)p;
+                    httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                    httpd_MsgAdd(answer, "Connection", "close");
+
+                    cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+                break;
+
+            default: {
+                int i_msg = query->i_type;
+                bool b_auth_failed = false;
+
+                /* Search the url and trigger callbacks */
+                for (int i = 0; i < host->i_url; i++) {
+                    httpd_url_t *url = host->url[i];
+
+                    if (strcmp(url->psz_url, query->psz_url))
+                        continue;
+                    if (!url->catch[i_msg].cb)
+                        continue;
+
+                    if (answer) {
+                        b_auth_failed = !httpdAuthOk(url->psz_user,
+                           url->psz_password,
+                           httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                        if (b_auth_failed)
+                           break;
+                    }
+
+                    if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                        continue;
+
+                    if (answer->i_proto == HTTPD_PROTO_NONE)
+                        cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                    else
+                        cl->i_buffer = -1;
+
+                    /* only one url can answer */
+                    answer = NULL;
+                    if (!cl->url)
+                        cl->url = url;
+                }
+
+                if (answer) {
+                    answer->i_proto  = query->i_proto;
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_version= 0;
+
+                   if (b_auth_failed) {
+                        httpd_MsgAdd(answer, "WWW-Authenticate",
+                                "Basic realm=\"VLC stream\"");
+                        answer->i_status = 401;
+                    } else
+                        answer->i_status = 404; /* no url registered */
+
+                    char *p;
+                    answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                            query->psz_url);
+                    answer->p_body = (uint8_t *)p;
+
+                    cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                    httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                    httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                    if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                        httpd_MsgAdd(answer, "Connection", "close");
+                }
+
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+        }
+    }
+
+    if (cl->i_state == HTTPD_CLIENT_SEND_DONE) {
+        if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+            bool do_close = false;
+
+            cl->url = NULL;
+
+            if (cl->query.i_proto != HTTPD_PROTO_HTTP
+             || cl->query.i_version > 0)
+            {
+                const char *psz_connection = httpd_MsgGet(&cl->answer,
+                                                         "Connection");
+                if (psz_connection != NULL)
+                    do_close = !strcasecmp(psz_connection, "close");
+            }
+            else
+                do_close = true;
+
+            if (!do_close) {
+                httpd_MsgClean(&cl->query);
+                httpd_MsgInit(&cl->query);
+
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 1000;
+                httpd_ClientBufferRelease(cl);
+                // Allocate an extra byte for the null terminating byte
+                cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
+                cl->i_state = HTTPD_CLIENT_RECEIVING;
+            } else
+                cl->i_state = HTTPD_CLIENT_DEAD;
+            httpd_ClientAnswerClean(cl);
+        } else {
+            i_offset = cl->answer.i_body_offset;
+            httpd_ClientAnswerClean(cl);
+
+            cl->answer.i_body_offset = i_offset;
+            httpd_ClientBufferRelease(cl);
+            cl->i_buffer = 0;
+            cl->i_buffer_size = 0;
+
+            cl->i_state = HTTPD_CLIENT_WAITING;
+        }
+    }
+
+    /* also right after the end of the previous answer */
+    if (cl->i_state == HTTPD_CLIENT_WAITING) {
+        i_offset = cl->answer.i_body_offset;
+        int i_msg = cl->query.i_type;
+
+        httpd_MsgInit(&cl->answer);
+        cl->answer.i_body_offset = i_offset;
+
+        cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                &cl->answer, &cl->query);
+        if (cl->answer.i_type != HTTPD_MSG_NONE) {
+            /* we have new data, so re-enter send mode */
+            httpd_ClientBufferBody(cl);
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+    }
+}
+
+static bool httpd_ClientExpired(const httpd_client_t *cl, mtime_t now)
+{
+    return cl->i_ref < 0 || (cl->i_ref == 0 &&
+                (cl->i_state == HTTPD_CLIENT_DEAD ||
+                  (cl->i_activity_timeout > 0 &&
+                    cl->i_activity_date+cl->i_activity_timeout < now)));
+}
+
+/* accept a new connection */
+static httpd_client_t *httpd_HostAccept(httpd_host_t *host, int fd,
+                                        mtime_t now)
+{
+    httpd_client_t *cl;
+
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return NULL;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
+    if (unlikely(sk == NULL))
+    {
+        vlc_close(fd);
+        return NULL;
+    }
+
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+        vlc_tls_t *tls;
+
+        tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
+        if (tls == NULL)
+        {
+            vlc_tls_SessionDelete(sk);
+            return NULL;
+        }
+        sk = tls;
+    }
+
+    cl = httpd_ClientNew(sk, now);
+    if (unlikely(cl == NULL))
+    {
+        vlc_tls_Close(sk);
+        return NULL;
+    }
+
+    if (host->p_tls != NULL)
+        cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
+
+    TAB_APPEND(host->i_client, host->client, cl);
+    return cl;
+}
+
+#ifdef HTTPD_EPOLL
+static void httpd_HostWake(httpd_host_t *host)
+{
+    uint64_t val = 1;
+
+    if (write(host->wakefd, &val, sizeof (val)) < 0)
+        assert(errno == EAGAIN); /* the counter cannot overflow */
+}
+
+static void httpd_ClientSetReady(httpd_host_t *host, httpd_client_t *cl)
+{
+    if (cl->b_ready)
+        return;
+
+    assert(host->i_ready < (size_t)host->i_client);
+    cl->b_ready = true;
+    host->ready[host->i_ready++] = cl;
+}
+
+/* Runs the client until its socket would block. Returns true if it stopped
+ * before, not to delay the other clients. */
+static bool httpd_ClientRun(httpd_host_t *host, httpd_client_t *cl,
+                            mtime_t now)
+{
+    for (unsigned i = 0; i < HTTPD_CL_STEPS; i++) {
+        httpd_ClientPrepare(host, cl);
+
+        switch (cl->i_state) {
+            case HTTPD_CLIENT_RECEIVING:
+                if (!cl->b_readable)
+                    return false;
+                cl->b_readable = !httpd_ClientRecv(cl);
+                break;
+
+            case HTTPD_CLIENT_SENDING:
+                if (!cl->b_writable)
+                    return false;
+                cl->b_writable = !httpd_ClientSend(cl);
+                break;
+
+            case HTTPD_CLIENT_TLS_HS_IN:
+            case HTTPD_CLIENT_TLS_HS_OUT:
+                if (!(cl->i_state == HTTPD_CLIENT_TLS_HS_IN ? cl->b_readable
+                                                             : cl->b_writable))
+                    return false;
+                httpd_ClientTlsHandshake(host, cl);
+                if (cl->i_state == HTTPD_CLIENT_TLS_HS_IN)
+                    cl->b_readable = false;
+                if (cl->i_state == HTTPD_CLIENT_TLS_HS_OUT)
+                    cl->b_writable = false;
+                break;
+
+            default: /* dead, or waiting for stream data */
+                return false;
+        }
+        cl->i_activity_date = now;
+    }
+    return true;
+}
+
+/* Only the clients with socket events, or new stream data if they wait for
+ * it, are looked at, and their sockets are registered once (edge-triggered),
+ * so that the load depends on the sent data rather than the client count. */
+static void httpdLoop(httpd_host_t *host)
+{
+    struct epoll_event ev[HTTPD_EPOLL_EVENTS];
+
+    while (host->i_url <= 0) {
+        mutex_cleanup_push(&host->lock);
+        vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+    }
+
+    int timeout = -1;
+    if (host->i_ready > 0)
+        timeout = 0;
+    else if (host->b_wake_pending)
+        timeout = __MAX(host->i_wake_date - mdate() + 999, 0) / 1000;
+    else if (host->i_client > 0)
+        timeout = 1000; /* for the activity timeouts */
+    vlc_mutex_unlock(&host->lock);
+
+    int n = epoll_wait(host->epfd, ev, ARRAY_SIZE(ev), timeout);
+    if (n < 0) {
+        if (errno != EINTR)
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+        n = 0;
+    }
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&host->lock);
+
+    mtime_t now = mdate();
+
+    for (int i = 0; i < n; i++) {
+        void *ptr = ev[i].data.ptr;
+
+        if (ptr == &host->wakefd) {
+            uint64_t val;
+
+            if (read(host->wakefd, &val, sizeof (val)) > 0)
+                host->b_wake_pending = true; /* new stream data */
+        } else if ((int *)ptr >= host->fds
+                && (int *)ptr < host->fds + host->nfd) {
+            httpd_client_t *cl = httpd_HostAccept(host, *(int *)ptr, now);
+            if (cl == NULL)
+                continue;
+
+            if ((size_t)host->i_client > host->i_ready_alloc) {
+                host->i_ready_alloc = 2 * host->i_client;
+                host->ready = xrealloc(host->ready, host->i_ready_alloc
+                                                    * sizeof (*host->ready));
+            }
+
+            struct epoll_event cev = {
+                .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                .data.ptr = cl,
+            };
+            cl->b_readable = cl->b_writable = true;
+            cl->b_ready = false;
+            if (epoll_ctl(host->epfd, EPOLL_CTL_ADD, vlc_tls_GetFD(cl->sock),
+                          &cev)) {
+                httpd_HostRemoveClient(host, cl);
+                continue;
+            }
+            httpd_ClientSetReady(host, cl);
+        } else {
+            httpd_client_t *cl = ptr;
+
+            if (ev[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                cl->b_readable = true;
+            if (ev[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+                cl->b_writable = true;
+            httpd_ClientSetReady(host, cl);
+        }
+    }
+
+    if (host->b_wake_pending && now >= host->i_wake_date) {
+        for (int i = 0; i < host->i_client; i++)
+            if (host->client[i]->i_state == HTTPD_CLIENT_WAITING)
+                httpd_ClientSetReady(host, host->client[i]);
+        host->b_wake_pending = false;
+        host->i_wake_date = now + HTTPD_WAKE_DELAY;
+    }
+
+    if (now >= host->i_sweep_date) {
+        for (int i = 0; i < host->i_client; i++)
+            if (httpd_ClientExpired(host->client[i], now))
+                httpd_ClientSetReady(host, host->client[i]);
+        host->i_sweep_date = now + CLOCK_FREQ;
+    }
+
+    /* The clients to run again are put back in place, as each one is at most
+     * once in the list */
+    size_t i_ready = host->i_ready;
+    host->i_ready = 0;
+
+    for (size_t i = 0; i < i_ready; i++) {
+        httpd_client_t *cl = host->ready[i];
+        bool b_more;
+
+        cl->b_ready = false;
+        b_more = httpd_ClientRun(host, cl, now);
+
+        if (httpd_ClientExpired(cl, now))
+            httpd_HostRemoveClient(host, cl);
+        else if (b_more)
+            httpd_ClientSetReady(host, cl);
+    }
+
+    vlc_restorecancel(canc);
+}
+
+#else
+static void httpd_HostWake(httpd_host_t *host)
+{
+    (void) host;
+}
+
 static void httpdLoop(httpd_host_t *host)
 {
     struct pollfd ufd[host->nfd + host->i_client];
@@ -1702,15 +2487,10 @@ static void httpdLoop(httpd_host_t *host)
 
     int canc = vlc_savecancel();
     for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
         httpd_client_t *cl = host->client[i_client];
-        if (cl->i_ref < 0 || (cl->i_ref == 0 &&
-                    (cl->i_state == HTTPD_CLIENT_DEAD ||
-                      (cl->i_activity_timeout > 0 &&
-                        cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            TAB_REMOVE(host->i_client, host->client, cl);
+        if (httpd_ClientExpired(cl, now)) {
+            httpd_HostRemoveClient(host, cl);
             i_client--;
-            httpd_ClientDestroy(cl);
             continue;
         }
 
@@ -1720,6 +2500,8 @@ static void httpdLoop(httpd_host_t *host)
         pufd->fd = vlc_tls_GetFD(cl->sock);
         pufd->events = pufd->revents = 0;
 
+        httpd_ClientPrepare(host, cl);
+
         switch (cl->i_state) {
             case HTTPD_CLIENT_RECEIVING:
             case HTTPD_CLIENT_TLS_HS_IN:
@@ -1730,214 +2512,6 @@ static void httpdLoop(httpd_host_t *host)
             case HTTPD_CLIENT_TLS_HS_OUT:
                 pufd->events = POLLOUT;
                 break;
-
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
-
-                httpd_MsgInit(answer);
-
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
-
-                    case HTTPD_MSG_OPTIONS:
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
-
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
-
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
-
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
-
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
-
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
-
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
-                        }
-
-                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                            httpd_MsgAdd(answer, "Connection", "close");
-
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
-
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Connection", "close");
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
-
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
-
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                            if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                                httpd_MsgAdd(answer, "Connection", "close");
-                        }
-
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
-                }
-                break;
-            }
-
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    bool do_close = false;
-
-                    cl->url = NULL;
-
-                    if (cl->query.i_proto != HTTPD_PROTO_HTTP
-                     || cl->query.i_version > 0)
-                    {
-                        const char *psz_connection = httpd_MsgGet(&cl->answer,
-                                                                 "Connection");
-                        if (psz_connection != NULL)
-                            do_close = !strcasecmp(psz_connection, "close");
-                    }
-                    else
-                        do_close = true;
-
-                    if (!do_close) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        // Allocate an extra byte for the null terminating byte
-                        cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
-
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
-
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
-
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
-
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
         }
 
         if (pufd->events != 0)
@@ -1988,52 +2562,17 @@ static void httpdLoop(httpd_host_t *host)
 
     /* Handle server sockets (accept new connections) */
     for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
+        assert (ufd[nfd].fd == host->fds[nfd]);
 
         if (ufd[nfd].revents == 0)
             continue;
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
-
-        vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
-        if (unlikely(sk == NULL))
-        {
-            vlc_close(fd);
-            continue;
-        }
-
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
-            vlc_tls_t *tls;
-
-            tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
-            if (tls == NULL)
-            {
-                vlc_tls_SessionDelete(sk);
-                continue;
-            }
-            sk = tls;
-        }
-
-        cl = httpd_ClientNew(sk, now);
-
-        if (host->p_tls != NULL)
-            cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
-
-        TAB_APPEND(host->i_client, host->client, cl);
+        httpd_HostAccept(host, ufd[nfd].fd, now);
     }
 
     vlc_restorecancel(canc);
 }
+#endif
 
 static void* httpd_HostThread(void *data)
 {
@@ -208,6 +208,9 @@ playlist_t *playlist_Create( vlc_object_t *p_parent )
 
     p->input_tree = NULL;
     p->id_tree = NULL;
+    p->search = NULL;
+    /* Without the index, live search falls back to walking the tree */
+    playlist_SearchInit( p_playlist );
 
     TAB_INIT( pl_priv(p_playlist)->i_sds, pl_priv(p_playlist)->pp_sds );
 
@@ -352,6 +355,7 @@ void playlist_Destroy( playlist_t *p_playlist )
     assert( p_playlist->root.i_children <= 0 );
     PL_UNLOCK;
 
+    playlist_SearchClean( p_playlist );
     vlc_cond_destroy( &p_sys->signal );
     vlc_mutex_destroy( &p_sys->lock );
 
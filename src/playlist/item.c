@@ -233,6 +233,18 @@ static void input_item_changed( const vlc_event_t * p_event,
     var_SetAddress( p_playlist, "item-change", p_event->p_obj );
 }
 
+/*****************************************************************************
+ * An input item's meta or name has changed (Event Callback)
+ *****************************************************************************/
+static void input_item_meta_changed( const vlc_event_t * p_event,
+                                     void * user_data )
+{
+    playlist_t *p_playlist = user_data;
+
+    playlist_SearchItemChanged( p_playlist, p_event->p_obj );
+    var_SetAddress( p_playlist, "item-change", p_event->p_obj );
+}
+
 static int playlist_ItemCmpId( const void *a, const void *b )
 {
     const playlist_item_t *pa = a, *pb = b;
@@ -306,6 +318,7 @@ playlist_item_t *playlist_ItemNewFromInput( playlist_t *p_playlist,
 
     p->i_last_playlist_id = p_item->i_id;
     input_item_Hold( p_item->p_input );
+    playlist_SearchAddItem( p_playlist, p_item );
 
     vlc_event_manager_t *p_em = &p_item->p_input->event_manager;
 
@@ -314,9 +327,9 @@ playlist_item_t *playlist_ItemNewFromInput( playlist_t *p_playlist,
     vlc_event_attach( p_em, vlc_InputItemDurationChanged,
                       input_item_changed, p_playlist );
     vlc_event_attach( p_em, vlc_InputItemMetaChanged,
-                      input_item_changed, p_playlist );
+                      input_item_meta_changed, p_playlist );
     vlc_event_attach( p_em, vlc_InputItemNameChanged,
-                      input_item_changed, p_playlist );
+                      input_item_meta_changed, p_playlist );
     vlc_event_attach( p_em, vlc_InputItemInfoChanged,
                       input_item_changed, p_playlist );
     vlc_event_attach( p_em, vlc_InputItemErrorWhenReadingChanged,
@@ -349,16 +362,17 @@ void playlist_ItemRelease( playlist_t *p_playlist, playlist_item_t *p_item )
     vlc_event_detach( p_em, vlc_InputItemSubItemTreeAdded,
                       input_item_add_subitem_tree, p_playlist );
     vlc_event_detach( p_em, vlc_InputItemMetaChanged,
-                      input_item_changed, p_playlist );
+                      input_item_meta_changed, p_playlist );
     vlc_event_detach( p_em, vlc_InputItemDurationChanged,
                       input_item_changed, p_playlist );
     vlc_event_detach( p_em, vlc_InputItemNameChanged,
-                      input_item_changed, p_playlist );
+                      input_item_meta_changed, p_playlist );
     vlc_event_detach( p_em, vlc_InputItemInfoChanged,
                       input_item_changed, p_playlist );
     vlc_event_detach( p_em, vlc_InputItemErrorWhenReadingChanged,
                       input_item_changed, p_playlist );
 
+    playlist_SearchRemoveItem( p_playlist, p_item );
     input_item_Release( p_item->p_input );
 
     tdelete( p_item, &p->input_tree, playlist_ItemCmpInput );
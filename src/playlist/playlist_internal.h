@@ -52,6 +52,7 @@ typedef struct playlist_private_t
     void *input_tree; /**< Search tree for input item
                            to playlist item mapping */
     void *id_tree; /**< Search tree for item ID to item mapping */
+    struct playlist_search_t *search; /**< Live search index (or NULL) */
 
     vlc_sd_internal_t   **pp_sds;
     int                   i_sds;   /**< Number of service discovery modules */
@@ -114,6 +115,13 @@ playlist_item_t * get_current_status_node( playlist_t * p_playlist );
 void set_current_status_item( playlist_t *, playlist_item_t * );
 void set_current_status_node( playlist_t *, playlist_item_t * );
 
+/* Live search index */
+int playlist_SearchInit( playlist_t * );
+void playlist_SearchClean( playlist_t * );
+void playlist_SearchAddItem( playlist_t *, playlist_item_t * );
+void playlist_SearchRemoveItem( playlist_t *, playlist_item_t * );
+void playlist_SearchItemChanged( playlist_t *, input_item_t * );
+
 /* Load/Save */
 int playlist_MLLoad( playlist_t *p_playlist );
 int playlist_MLDump( playlist_t *p_playlist );
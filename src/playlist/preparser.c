@@ -122,8 +122,10 @@ playlist_preparser_t* playlist_preparser_New( vlc_object_t *parent )
 {
     playlist_preparser_t* preparser = malloc( sizeof *preparser );
 
+    int threads = var_InheritInteger( parent, "preparse-threads" );
     struct background_worker_config conf = {
         .default_timeout = var_InheritInteger( parent, "preparse-timeout" ),
+        .max_threads = threads > 0 ? (unsigned)threads : vlc_GetCPUCount(),
         .pf_start = PreparserOpenInput,
         .pf_probe = PreparserProbeInput,
         .pf_stop = PreparserCloseInput,
@@ -152,7 +154,7 @@ playlist_preparser_t* playlist_preparser_New( vlc_object_t *parent )
 
 void playlist_preparser_Push( playlist_preparser_t *preparser,
     input_item_t *item, input_item_meta_request_option_t i_options,
-    int timeout, void *id )
+    int timeout, void *id, int priority )
 {
     if( atomic_load( &preparser->deactivated ) )
         return;
@@ -175,7 +177,8 @@ void playlist_preparser_Push( playlist_preparser_t *preparser,
             return;
     }
 
-    if( background_worker_Push( preparser->worker, item, id, timeout ) )
+    if( background_worker_Push( preparser->worker, item, id, timeout,
+                                priority ) )
         input_item_SignalPreparseEnded( item, ITEM_PREPARSE_FAILED );
 }
 
@@ -35,6 +35,18 @@
  */
 typedef struct playlist_preparser_t playlist_preparser_t;
 
+/**
+ * Preparsing priorities.
+ *
+ * Requests that the user is waiting for jump ahead of the bulk ones, such as
+ * the automatic preparsing of every item added to the playlist.
+ */
+enum playlist_preparser_priority
+{
+    PREPARSER_PRIORITY_BACKGROUND,
+    PREPARSER_PRIORITY_USER,
+};
+
 /**
  * This function creates the preparser object and thread.
  */
@@ -53,10 +65,11 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
  * indefinitely. If > 0, the timeout will be used (in milliseconds).
  * @param id unique id provided by the caller. This is can be used to cancel
  * the request with playlist_preparser_Cancel()
+ * @param priority one of the playlist_preparser_priority values
  */
 void playlist_preparser_Push( playlist_preparser_t *, input_item_t *,
                               input_item_meta_request_option_t,
-                              int timeout, void *id );
+                              int timeout, void *id, int priority );
 
 void playlist_preparser_fetcher_Push( playlist_preparser_t *, input_item_t *,
                                       input_item_meta_request_option_t );
@@ -79,7 +92,7 @@ void playlist_preparser_Delete( playlist_preparser_t * );
  * This function deactivates the preparser
  *
  * All pending requests will be removed, and it will block until the currently
- * running entity has finished (if any).
+ * running entities have finished (if any).
  */
 void playlist_preparser_Deactivate( playlist_preparser_t * );
 
@@ -24,16 +24,568 @@
 # include "config.h"
 #endif
 #include <assert.h>
+#include <search.h>
+#include <wctype.h>
 
 #include <vlc_common.h>
 #include <vlc_playlist.h>
 #include <vlc_charset.h>
+#include <vlc_memstream.h>
 #include "playlist_internal.h"
 
 /***************************************************************************
  * Item search functions
  ***************************************************************************/
 
+/*
+ * The search index maps the trigrams (3 consecutive bytes) of the case-folded
+ * search text of each item to the list of the items containing them. A search
+ * only compares the text of the items listed under the rarest trigram of the
+ * string, or the previous matches when the string was refined.
+ *
+ * Index entries are immutable: when an item changes, its entry is killed and
+ * a new one is appended. Trigram lists are compacted once dead entries
+ * outnumber live ones, so that they stay sorted and cheap to update.
+ *
+ * Items are indexed lazily, as the meta-data of new items is usually not
+ * known yet. Meta-data change events only mark items as dirty, as they are
+ * not sent with the playlist lock held.
+ */
+
+/* Field separator in the search text: not found in folded strings */
+#define SEARCH_SEP '\xFF'
+#define SEARCH_NONE UINT32_MAX
+
+typedef struct search_item_t
+{
+    input_item_t *p_input; /**< Key (NULL if removed while dirty) */
+    playlist_item_t *p_item;
+    uint32_t i_slot; /**< Current entry or SEARCH_NONE */
+    bool b_dirty;
+} search_item_t;
+
+typedef struct
+{
+    search_item_t *p_owner; /**< NULL if the entry is dead */
+    char *psz_text; /**< Case-folded search text */
+} search_entry_t;
+
+typedef struct
+{
+    uint32_t i_key; /**< Trigram (0 if the bucket is free) */
+    uint32_t i_count;
+    uint32_t i_max;
+    uint32_t *p_slots; /**< Entries containing the trigram, in order */
+} search_trigram_t;
+
+struct playlist_search_t
+{
+    vlc_mutex_t lock; /**< Also taken by meta-data change events */
+    void *items; /**< Tree of search_item_t by input item */
+
+    search_entry_t *p_entries;
+    uint32_t i_entries;
+    uint32_t i_entries_max;
+    uint32_t i_dead;
+
+    search_trigram_t *p_trigrams; /**< Open addressing hash table */
+    uint32_t i_trigrams_mask;
+    uint32_t i_trigrams;
+
+    search_item_t **pp_dirty; /**< Items to (re)index */
+    size_t i_dirty;
+    size_t i_dirty_max;
+
+    /* Previous search, for refinements */
+    uint64_t i_generation; /**< Incremented whenever the entries change */
+    uint64_t i_last_generation;
+    char *psz_last;
+    uint32_t *p_results;
+    uint32_t i_results;
+};
+
+static int search_ItemCmp( const void *a, const void *b )
+{
+    const search_item_t *pa = a, *pb = b;
+
+    if( pa->p_input == pb->p_input )
+        return 0;
+    return (((uintptr_t)pa->p_input) > ((uintptr_t)pb->p_input))
+        ? +1 : -1;
+}
+
+/**
+ * Appends a string case-folded as vlc_strcasestr() compares characters,
+ * i.e. with towlower() on each code point, up to the first invalid sequence.
+ * Folded strings are UTF-8 so that strstr() on them matches the same as
+ * vlc_strcasestr() on the originals.
+ * @return false if the string was not valid UTF-8
+ */
+static bool search_Fold( struct vlc_memstream *ms, const char *psz )
+{
+    for( ;; )
+    {
+        uint32_t cp;
+        size_t len = vlc_towc( psz, &cp );
+
+        if( len == 0 )
+            return true;
+        if( unlikely(len == (size_t)-1) )
+            return false;
+        psz += len;
+
+        cp = towlower( cp );
+        if( cp < 0x80 )
+        {
+            vlc_memstream_putc( ms, cp );
+            continue;
+        }
+        if( cp < 0x800 )
+        {
+            vlc_memstream_putc( ms, 0xC0 | (cp >> 6) );
+        }
+        else if( cp < 0x10000 )
+        {
+            vlc_memstream_putc( ms, 0xE0 | (cp >> 12) );
+            vlc_memstream_putc( ms, 0x80 | ((cp >> 6) & 0x3F) );
+        }
+        else
+        {
+            vlc_memstream_putc( ms, 0xF0 | (cp >> 18) );
+            vlc_memstream_putc( ms, 0x80 | ((cp >> 12) & 0x3F) );
+            vlc_memstream_putc( ms, 0x80 | ((cp >> 6) & 0x3F) );
+        }
+        vlc_memstream_putc( ms, 0x80 | (cp & 0x3F) );
+    }
+}
+
+/**
+ * Builds the search text of an item: its title (or name), album and artist,
+ * as compared by playlist_LiveSearchUpdateInternal().
+ */
+static char *search_ItemText( input_item_t *p_input )
+{
+    struct vlc_memstream ms;
+
+    if( vlc_memstream_open( &ms ) )
+        return NULL;
+
+    vlc_mutex_lock( &p_input->lock );
+    if( p_input->p_meta )
+    {
+        const char *psz_title = vlc_meta_Get( p_input->p_meta, vlc_meta_Title );
+        if( !psz_title )
+            psz_title = p_input->psz_name;
+        const char *psz_album = vlc_meta_Get( p_input->p_meta, vlc_meta_Album );
+        const char *psz_artist = vlc_meta_Get( p_input->p_meta, vlc_meta_Artist );
+
+        if( psz_title )
+            search_Fold( &ms, psz_title );
+        vlc_memstream_putc( &ms, SEARCH_SEP );
+        if( psz_album )
+            search_Fold( &ms, psz_album );
+        vlc_memstream_putc( &ms, SEARCH_SEP );
+        if( psz_artist )
+            search_Fold( &ms, psz_artist );
+    }
+    else if( p_input->psz_name )
+        search_Fold( &ms, p_input->psz_name );
+    vlc_mutex_unlock( &p_input->lock );
+
+    if( vlc_memstream_close( &ms ) )
+        return NULL;
+    return ms.ptr;
+}
+
+static uint32_t search_Trigram( const char *psz )
+{
+    return ((uint32_t)(uint8_t)psz[0] << 16) | ((uint32_t)(uint8_t)psz[1] << 8)
+         | (uint8_t)psz[2];
+}
+
+static search_trigram_t *search_TrigramFind( struct playlist_search_t *s,
+                                             uint32_t i_key )
+{
+    uint32_t h = i_key * 0x9E3779B1u;
+    h ^= h >> 15;
+
+    for( uint32_t i = h;; i++ )
+    {
+        search_trigram_t *t = &s->p_trigrams[i & s->i_trigrams_mask];
+        if( t->i_key == i_key || t->i_key == 0 )
+            return t;
+    }
+}
+
+static bool search_TrigramsGrow( struct playlist_search_t *s )
+{
+    uint32_t i_old = s->i_trigrams_mask + 1;
+    search_trigram_t *p_old = s->p_trigrams;
+    uint32_t i_size = i_old * 2;
+
+    s->p_trigrams = calloc( i_size, sizeof( *s->p_trigrams ) );
+    if( unlikely(s->p_trigrams == NULL) )
+    {
+        s->p_trigrams = p_old;
+        return false;
+    }
+    s->i_trigrams_mask = i_size - 1;
+
+    for( uint32_t i = 0; i < i_old; i++ )
+        if( p_old[i].i_key != 0 )
+            *search_TrigramFind( s, p_old[i].i_key ) = p_old[i];
+    free( p_old );
+    return true;
+}
+
+/* Adds an entry to the lists of the trigrams of its text */
+static void search_EntryLink( struct playlist_search_t *s, uint32_t i_slot )
+{
+    const char *psz = s->p_entries[i_slot].psz_text;
+
+    for( size_t i_len = strlen( psz ); i_len >= 3; i_len--, psz++ )
+    {
+        uint32_t i_key = search_Trigram( psz );
+        search_trigram_t *t = search_TrigramFind( s, i_key );
+
+        if( t->i_key == 0 )
+        {   /* Keep the load factor under 1/2 */
+            if( 2 * (s->i_trigrams + 1) > s->i_trigrams_mask + 1 )
+            {
+                if( !search_TrigramsGrow( s ) )
+                    continue; /* the entry will not be found by this trigram */
+                t = search_TrigramFind( s, i_key );
+            }
+            t->i_key = i_key;
+            s->i_trigrams++;
+        }
+        else if( t->p_slots[t->i_count - 1] == i_slot )
+            continue; /* repeated trigram */
+
+        if( t->i_count == t->i_max )
+        {
+            uint32_t i_max = t->i_max ? 2 * t->i_max : 4;
+            uint32_t *p_slots = realloc( t->p_slots, i_max * sizeof( *p_slots ) );
+            if( unlikely(p_slots == NULL) )
+                continue;
+            t->p_slots = p_slots;
+            t->i_max = i_max;
+        }
+        t->p_slots[t->i_count++] = i_slot;
+    }
+}
+
+/* Drops dead entries and rebuilds the trigram lists */
+static void search_Compact( struct playlist_search_t *s )
+{
+    uint32_t i_live = 0;
+
+    for( uint32_t i = 0; i < s->i_entries; i++ )
+    {
+        search_entry_t *e = &s->p_entries[i];
+        if( e->p_owner == NULL )
+            continue;
+        e->p_owner->i_slot = i_live;
+        s->p_entries[i_live++] = *e;
+    }
+    s->i_entries = i_live;
+    s->i_dead = 0;
+
+    for( uint32_t i = 0; i <= s->i_trigrams_mask; i++ )
+    {
+        free( s->p_trigrams[i].p_slots );
+        s->p_trigrams[i] = (search_trigram_t) { 0, 0, 0, NULL };
+    }
+    s->i_trigrams = 0;
+
+    for( uint32_t i = 0; i < i_live; i++ )
+        search_EntryLink( s, i );
+}
+
+static void search_EntryKill( struct playlist_search_t *s, search_item_t *si )
+{
+    if( si->i_slot == SEARCH_NONE )
+        return;
+
+    search_entry_t *e = &s->p_entries[si->i_slot];
+    free( e->psz_text );
+    e->psz_text = NULL;
+    e->p_owner = NULL;
+    si->i_slot = SEARCH_NONE;
+    s->i_dead++;
+    s->i_generation++;
+}
+
+/* (Re)indexes an item */
+static void search_ItemIndex( struct playlist_search_t *s, search_item_t *si )
+{
+    search_EntryKill( s, si );
+
+    if( s->i_entries == s->i_entries_max )
+    {
+        uint32_t i_max = s->i_entries_max ? 2 * s->i_entries_max : 256;
+        search_entry_t *p_entries = realloc( s->p_entries,
+                                             i_max * sizeof( *p_entries ) );
+        if( unlikely(p_entries == NULL) )
+            return;
+        s->p_entries = p_entries;
+        s->i_entries_max = i_max;
+    }
+
+    char *psz_text = search_ItemText( si->p_input );
+    if( unlikely(psz_text == NULL) )
+        return;
+
+    si->i_slot = s->i_entries++;
+    s->p_entries[si->i_slot].p_owner = si;
+    s->p_entries[si->i_slot].psz_text = psz_text;
+    search_EntryLink( s, si->i_slot );
+    s->i_generation++;
+}
+
+/* Indexes the dirty items */
+static void search_Flush( struct playlist_search_t *s )
+{
+    for( size_t i = 0; i < s->i_dirty; i++ )
+    {
+        search_item_t *si = s->pp_dirty[i];
+
+        if( si->p_input == NULL )
+        {   /* removed from the playlist in the mean time */
+            free( si );
+            continue;
+        }
+        si->b_dirty = false;
+        search_ItemIndex( s, si );
+    }
+    s->i_dirty = 0;
+
+    if( s->i_dead > 1024 && s->i_dead > s->i_entries - s->i_dead )
+        search_Compact( s );
+}
+
+static void search_SetDirty( struct playlist_search_t *s, search_item_t *si )
+{
+    if( si->b_dirty )
+        return;
+
+    if( s->i_dirty == s->i_dirty_max )
+    {
+        size_t i_max = s->i_dirty_max ? 2 * s->i_dirty_max : 64;
+        search_item_t **pp_dirty = realloc( s->pp_dirty,
+                                            i_max * sizeof( *pp_dirty ) );
+        if( unlikely(pp_dirty == NULL) )
+            return; /* the item keeps its previous text */
+        s->pp_dirty = pp_dirty;
+        s->i_dirty_max = i_max;
+    }
+    s->pp_dirty[s->i_dirty++] = si;
+    si->b_dirty = true;
+}
+
+/**
+ * Finds the indexed items whose search text contains a string.
+ * The result is left in s->p_results.
+ * @return VLC_SUCCESS or VLC_ENOMEM
+ */
+static int search_Match( struct playlist_search_t *s, const char *psz_string )
+{
+    struct vlc_memstream ms;
+
+    if( vlc_memstream_open( &ms ) )
+        return VLC_ENOMEM;
+
+    bool b_valid = search_Fold( &ms, psz_string );
+    if( vlc_memstream_close( &ms ) )
+        return VLC_ENOMEM;
+
+    char *psz_folded = ms.ptr;
+
+    search_Flush( s );
+
+    if( s->i_entries_max > 0 )
+    {
+        uint32_t *p_results = realloc( s->p_results,
+                                       s->i_entries_max * sizeof( *p_results ) );
+        if( unlikely(p_results == NULL) )
+            goto error;
+        s->p_results = p_results;
+    }
+
+    /* Candidates: previous results if the string was refined, else entries
+     * containing the rarest trigram of the string, else all entries. */
+    const uint32_t *p_cand = NULL;
+    uint32_t i_cand = s->i_entries;
+    bool b_refine = s->psz_last != NULL
+                 && s->i_last_generation == s->i_generation
+                 && strstr( psz_folded, s->psz_last ) != NULL;
+
+    if( !b_valid )
+        i_cand = 0; /* vlc_strcasestr() never matches */
+    else if( b_refine )
+    {
+        p_cand = s->p_results;
+        i_cand = s->i_results;
+    }
+
+    for( const char *psz = psz_folded; i_cand > 0 && psz[0] && psz[1] && psz[2];
+         psz++ )
+    {
+        const search_trigram_t *t = search_TrigramFind( s, search_Trigram( psz ) );
+
+        if( t->i_key == 0 )
+            i_cand = 0;
+        else if( t->i_count < i_cand )
+        {
+            p_cand = t->p_slots;
+            i_cand = t->i_count;
+        }
+    }
+
+    /* Check the candidates. Results are filtered in place when refining. */
+    uint32_t i_results = 0;
+    for( uint32_t i = 0; i < i_cand; i++ )
+    {
+        uint32_t i_slot = p_cand ? p_cand[i] : i;
+        const search_entry_t *e = &s->p_entries[i_slot];
+
+        if( e->p_owner != NULL && strstr( e->psz_text, psz_folded ) != NULL )
+            s->p_results[i_results++] = i_slot;
+    }
+    s->i_results = i_results;
+
+    free( s->psz_last );
+    s->psz_last = NULL;
+    if( b_valid ) /* the folded string is truncated otherwise */
+        s->psz_last = psz_folded;
+    else
+        free( psz_folded );
+    s->i_last_generation = s->i_generation;
+    return VLC_SUCCESS;
+
+error:
+    free( psz_folded );
+    return VLC_ENOMEM;
+}
+
+int playlist_SearchInit( playlist_t *p_playlist )
+{
+    struct playlist_search_t *s = calloc( 1, sizeof( *s ) );
+    if( unlikely(s == NULL) )
+        return VLC_ENOMEM;
+
+    s->i_trigrams_mask = 1023;
+    s->p_trigrams = calloc( s->i_trigrams_mask + 1, sizeof( *s->p_trigrams ) );
+    if( unlikely(s->p_trigrams == NULL) )
+    {
+        free( s );
+        return VLC_ENOMEM;
+    }
+    vlc_mutex_init( &s->lock );
+    pl_priv(p_playlist)->search = s;
+    return VLC_SUCCESS;
+}
+
+void playlist_SearchClean( playlist_t *p_playlist )
+{
+    struct playlist_search_t *s = pl_priv(p_playlist)->search;
+    if( s == NULL )
+        return;
+
+    /* All items have been removed */
+    assert( s->items == NULL );
+    for( size_t i = 0; i < s->i_dirty; i++ )
+        free( s->pp_dirty[i] );
+    for( uint32_t i = 0; i < s->i_entries; i++ )
+        free( s->p_entries[i].psz_text );
+    for( uint32_t i = 0; i <= s->i_trigrams_mask; i++ )
+        free( s->p_trigrams[i].p_slots );
+    free( s->pp_dirty );
+    free( s->p_entries );
+    free( s->p_trigrams );
+    free( s->p_results );
+    free( s->psz_last );
+    vlc_mutex_destroy( &s->lock );
+    free( s );
+    pl_priv(p_playlist)->search = NULL;
+}
+
+/**
+ * Adds a new playlist item to the search index.
+ */
+void playlist_SearchAddItem( playlist_t *p_playlist, playlist_item_t *p_item )
+{
+    struct playlist_search_t *s = pl_priv(p_playlist)->search;
+    if( s == NULL )
+        return;
+
+    search_item_t *si = malloc( sizeof( *si ) );
+    if( unlikely(si == NULL) )
+        return;
+
+    si->p_input = p_item->p_input;
+    si->p_item = p_item;
+    si->i_slot = SEARCH_NONE;
+    si->b_dirty = false;
+
+    vlc_mutex_lock( &s->lock );
+    search_item_t **pp = tsearch( si, &s->items, search_ItemCmp );
+    if( unlikely(pp == NULL) )
+        free( si );
+    else
+    {
+        assert( *pp == si );
+        search_SetDirty( s, si );
+    }
+    vlc_mutex_unlock( &s->lock );
+}
+
+/**
+ * Removes a playlist item from the search index.
+ */
+void playlist_SearchRemoveItem( playlist_t *p_playlist, playlist_item_t *p_item )
+{
+    struct playlist_search_t *s = pl_priv(p_playlist)->search;
+    if( s == NULL )
+        return;
+
+    search_item_t key = { .p_input = p_item->p_input };
+
+    vlc_mutex_lock( &s->lock );
+    search_item_t **pp = tfind( &key, &s->items, search_ItemCmp );
+    if( pp != NULL )
+    {
+        search_item_t *si = *pp;
+
+        tdelete( si, &s->items, search_ItemCmp );
+        search_EntryKill( s, si );
+        if( si->b_dirty )
+            si->p_input = NULL; /* freed by search_Flush() */
+        else
+            free( si );
+    }
+    vlc_mutex_unlock( &s->lock );
+}
+
+/**
+ * Marks the playlist item of an input item for reindexing.
+ * The playlist lock need not be held.
+ */
+void playlist_SearchItemChanged( playlist_t *p_playlist, input_item_t *p_input )
+{
+    struct playlist_search_t *s = pl_priv(p_playlist)->search;
+    if( s == NULL )
+        return;
+
+    search_item_t key = { .p_input = p_input };
+
+    vlc_mutex_lock( &s->lock );
+    search_item_t **pp = tfind( &key, &s->items, search_ItemCmp );
+    if( pp != NULL )
+        search_SetDirty( s, *pp );
+    vlc_mutex_unlock( &s->lock );
+}
+
 /***************************************************************************
  * Live search handling
  ***************************************************************************/
@@ -109,6 +661,68 @@ static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
 
 
 
+/**
+ * Disable all items in the playlist
+ * @param p_root: the current root item
+ */
+static void playlist_LiveSearchDisable( playlist_item_t *p_root,
+                                        bool b_recursive )
+{
+    for( int i = 0; i < p_root->i_children; i++ )
+    {
+        playlist_item_t *p_item = p_root->pp_children[i];
+        if( b_recursive && p_item->i_children >= 0 )
+            playlist_LiveSearchDisable( p_item, true );
+        p_item->i_flags |= PLAYLIST_DBL_FLAG;
+    }
+}
+
+/**
+ * Enable/Disable items in the playlist according to the search index
+ * @param p_root: the current root item
+ * @param psz_string: the string to search
+ * @return VLC_SUCCESS or VLC_ENOMEM
+ */
+static int playlist_LiveSearchUpdateIndexed( struct playlist_search_t *s,
+                                             playlist_item_t *p_root,
+                                             const char *psz_string,
+                                             bool b_recursive )
+{
+    vlc_mutex_lock( &s->lock );
+    if( search_Match( s, psz_string ) )
+    {
+        vlc_mutex_unlock( &s->lock );
+        return VLC_ENOMEM;
+    }
+
+    playlist_LiveSearchDisable( p_root, b_recursive );
+
+    /* Enable the matching items below the root, and their parents */
+    for( uint32_t i = 0; i < s->i_results; i++ )
+    {
+        playlist_item_t *p_item = s->p_entries[s->p_results[i]].p_owner->p_item;
+        playlist_item_t *p_parent = p_item->p_parent;
+
+        if( !b_recursive )
+        {
+            if( p_parent == p_root )
+                p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
+            continue;
+        }
+
+        while( p_parent != NULL && p_parent != p_root )
+            p_parent = p_parent->p_parent;
+        if( p_parent == NULL )
+            continue;
+
+        for( ; p_item != p_root && (p_item->i_flags & PLAYLIST_DBL_FLAG);
+             p_item = p_item->p_parent )
+            p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
+    }
+    vlc_mutex_unlock( &s->lock );
+    return VLC_SUCCESS;
+}
+
 /**
  * Launch the recursive search in the playlist
  * @param p_playlist: the playlist
@@ -119,12 +733,16 @@ static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
 int playlist_LiveSearchUpdate( playlist_t *p_playlist, playlist_item_t *p_root,
                                const char *psz_string, bool b_recursive )
 {
+    struct playlist_search_t *s = pl_priv(p_playlist)->search;
+
     PL_ASSERT_LOCKED;
     pl_priv(p_playlist)->b_reset_currently_playing = true;
-    if( *psz_string )
-        playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive );
-    else
+    if( !*psz_string )
         playlist_LiveSearchClean( p_root );
+    else if( s == NULL ||
+             playlist_LiveSearchUpdateIndexed( s, p_root, psz_string,
+                                               b_recursive ) )
+        playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive );
     vlc_cond_signal( &pl_priv(p_playlist)->signal );
     return VLC_SUCCESS;
 }
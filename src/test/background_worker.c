@@ -0,0 +1,334 @@
+/*****************************************************************************
+ * background_worker.c: Test and benchmark for the background worker
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include "../misc/background_worker.h"
+
+/* vlc_clone_detach() is not exported: emulate it, and join the threads once
+ * the workers have been deleted. */
+#define MAX_CLONES 1024
+
+static vlc_thread_t clones[MAX_CLONES];
+static atomic_uint clone_count = ATOMIC_VAR_INIT(0);
+
+int vlc_clone_detach(vlc_thread_t *, void *(*)(void *), void *, int);
+
+int vlc_clone_detach(vlc_thread_t *th, void *(*entry)(void *), void *data,
+                     int priority)
+{
+    unsigned i = atomic_fetch_add(&clone_count, 1);
+
+    assert(i < MAX_CLONES);
+    if (th != NULL)
+        abort(); /* unused by the background worker */
+    return vlc_clone(&clones[i], entry, data, priority);
+}
+
+static void join_clones(void)
+{
+    unsigned count = atomic_exchange(&clone_count, 0);
+
+    for (unsigned i = 0; i < count; i++)
+        vlc_join(clones[i], NULL);
+}
+
+struct task
+{
+    atomic_uint refs;
+    mtime_t duration; /* time spent blocked in pf_start */
+    bool endless; /* only ends when cancelled */
+    unsigned order; /* completion order */
+};
+
+struct owner
+{
+    vlc_mutex_t lock;
+    unsigned done;
+    vlc_sem_t started;
+    vlc_sem_t gate; /* holds tasks with a negative duration */
+    atomic_uint running; /* tasks started and not stopped */
+};
+
+static void TaskHold(void *entity)
+{
+    struct task *task = entity;
+    atomic_fetch_add(&task->refs, 1);
+}
+
+static void TaskRelease(void *entity)
+{
+    struct task *task = entity;
+    unsigned refs = atomic_fetch_sub(&task->refs, 1);
+    assert(refs > 0);
+}
+
+/* Like the preparser, the bulk of the work happens in pf_start */
+static int TaskStart(void *owner_, void *entity, void **out)
+{
+    struct owner *owner = owner_;
+    struct task *task = entity;
+
+    atomic_fetch_add(&owner->running, 1);
+    vlc_sem_post(&owner->started);
+    if (task->duration < 0)
+        vlc_sem_wait(&owner->gate);
+    else if (task->duration > 0)
+        mwait(mdate() + task->duration);
+
+    *out = task;
+    return VLC_SUCCESS;
+}
+
+static int TaskProbe(void *owner, void *handle)
+{
+    struct task *task = handle;
+    (void) owner;
+    return !task->endless;
+}
+
+static void TaskStop(void *owner_, void *handle)
+{
+    struct owner *owner = owner_;
+    struct task *task = handle;
+
+    atomic_fetch_sub(&owner->running, 1);
+    vlc_mutex_lock(&owner->lock);
+    task->order = ++owner->done;
+    vlc_mutex_unlock(&owner->lock);
+}
+
+static struct background_worker *worker_New(struct owner *owner,
+                                            unsigned threads)
+{
+    struct background_worker_config conf = {
+        .default_timeout = 0,
+        .max_threads = threads,
+        .pf_start = TaskStart,
+        .pf_probe = TaskProbe,
+        .pf_stop = TaskStop,
+        .pf_release = TaskRelease,
+        .pf_hold = TaskHold,
+    };
+
+    vlc_mutex_init(&owner->lock);
+    owner->done = 0;
+    atomic_init(&owner->running, 0);
+    vlc_sem_init(&owner->started, 0);
+    vlc_sem_init(&owner->gate, 0);
+
+    struct background_worker *worker = background_worker_New(owner, &conf);
+    assert(worker != NULL);
+    return worker;
+}
+
+static void worker_Delete(struct background_worker *worker,
+                          struct owner *owner)
+{
+    background_worker_Delete(worker);
+    join_clones();
+    vlc_sem_destroy(&owner->gate);
+    vlc_sem_destroy(&owner->started);
+    vlc_mutex_destroy(&owner->lock);
+}
+
+static void wait_done(struct owner *owner, unsigned count)
+{
+    for (;;)
+    {
+        vlc_mutex_lock(&owner->lock);
+        bool done = owner->done >= count;
+        vlc_mutex_unlock(&owner->lock);
+        if (done)
+            break;
+        mwait(mdate() + 1000);
+    }
+}
+
+static void task_Init(struct task *task, mtime_t duration)
+{
+    atomic_init(&task->refs, 0);
+    task->duration = duration;
+    task->endless = false;
+    task->order = 0;
+}
+
+/* Higher priorities jump ahead, equal priorities are processed in order */
+static void test_priority(void)
+{
+    struct owner owner;
+    struct background_worker *worker = worker_New(&owner, 1);
+    struct task blocker, tasks[6];
+    static const int priorities[6] = { 0, 0, 1, 0, 2, 1 };
+    static const unsigned expected[6] = { 5, 6, 3, 7, 2, 4 };
+
+    task_Init(&blocker, -1);
+    assert(background_worker_Push(worker, &blocker, NULL, -1, 0) == 0);
+    vlc_sem_wait(&owner.started);
+
+    for (unsigned i = 0; i < 6; i++)
+    {
+        task_Init(&tasks[i], 0);
+        assert(background_worker_Push(worker, &tasks[i], NULL, -1,
+                                      priorities[i]) == 0);
+    }
+    vlc_sem_post(&owner.gate);
+    wait_done(&owner, 7);
+
+    assert(blocker.order == 1);
+    for (unsigned i = 0; i < 6; i++)
+    {
+        assert(tasks[i].order == expected[i]);
+        assert(atomic_load(&tasks[i].refs) == 0);
+    }
+    worker_Delete(worker, &owner);
+}
+
+/* Cancelling an id stops its running tasks only, and drops its queued ones */
+static void test_cancel(void)
+{
+    struct owner owner;
+    struct background_worker *worker = worker_New(&owner, 2);
+    struct task endless[2], queued[4];
+    int id_a, id_b;
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        task_Init(&endless[i], 0);
+        endless[i].endless = true;
+        assert(background_worker_Push(worker, &endless[i],
+                                      i ? &id_b : &id_a, -1, 0) == 0);
+        vlc_sem_wait(&owner.started);
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        task_Init(&queued[i], 0);
+        assert(background_worker_Push(worker, &queued[i],
+                                      (i & 1) ? &id_b : &id_a, -1, 0) == 0);
+    }
+
+    /* Both threads are busy: cancelling a stops one endless task, and
+     * only the queued tasks of b remain */
+    background_worker_Cancel(worker, &id_a);
+    assert(endless[0].order == 1);
+    assert(atomic_load(&endless[0].refs) == 0);
+    assert(atomic_load(&queued[0].refs) == 0);
+    assert(atomic_load(&queued[2].refs) == 0);
+    wait_done(&owner, 3);
+    vlc_sem_wait(&owner.started);
+    vlc_sem_wait(&owner.started);
+    assert(queued[0].order == 0 && queued[2].order == 0);
+    assert(queued[1].order != 0 && queued[3].order != 0);
+    assert(endless[1].order == 0);
+
+    background_worker_Cancel(worker, &id_b);
+    assert(endless[1].order == 4);
+    for (unsigned i = 0; i < 4; i++)
+        assert(atomic_load(&queued[i].refs) == 0);
+
+    /* Delete stops whatever is left */
+    task_Init(&endless[0], 0);
+    endless[0].endless = true;
+    assert(background_worker_Push(worker, &endless[0], NULL, -1, 0) == 0);
+    vlc_sem_wait(&owner.started);
+    worker_Delete(worker, &owner);
+    assert(endless[0].order == 5);
+    assert(atomic_load(&endless[0].refs) == 0);
+}
+
+/* A burst of tasks runs in parallel, even while a thread is idle */
+static void test_burst(void)
+{
+    struct owner owner;
+    struct background_worker *worker = worker_New(&owner, 4);
+    struct task first, tasks[4];
+
+    task_Init(&first, 0);
+    assert(background_worker_Push(worker, &first, NULL, -1, 0) == 0);
+    wait_done(&owner, 1);
+    mwait(mdate() + 20000); /* let the thread wait for more tasks */
+
+    for (unsigned i = 0; i < 4; i++)
+    {
+        task_Init(&tasks[i], -1);
+        assert(background_worker_Push(worker, &tasks[i], NULL, -1, 0) == 0);
+    }
+
+    mtime_t deadline = mdate() + 5 * CLOCK_FREQ;
+    while (atomic_load(&owner.running) < 4 && mdate() < deadline)
+        mwait(mdate() + 1000);
+    assert(atomic_load(&owner.running) == 4);
+
+    for (unsigned i = 0; i < 4; i++)
+        vlc_sem_post(&owner.gate);
+    wait_done(&owner, 5);
+    worker_Delete(worker, &owner);
+}
+
+/* Tasks block for a while, as the preparser does on I/O */
+#define BENCH_ITEMS    200
+#define BENCH_DURATION 2000
+
+static void bench_throughput(unsigned threads)
+{
+    struct owner owner;
+    struct background_worker *worker = worker_New(&owner, threads);
+    struct task *tasks = malloc(BENCH_ITEMS * sizeof (*tasks));
+    assert(tasks != NULL);
+
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < BENCH_ITEMS; i++)
+    {
+        task_Init(&tasks[i], BENCH_DURATION);
+        assert(background_worker_Push(worker, &tasks[i], NULL, -1, 0) == 0);
+    }
+    wait_done(&owner, BENCH_ITEMS);
+    mtime_t duration = mdate() - start;
+
+    printf("%2u worker(s): %u items in %"PRId64" us (%.0f items/s)\n",
+           threads, BENCH_ITEMS, duration,
+           duration ? BENCH_ITEMS * 1e6 / duration : 0.);
+
+    worker_Delete(worker, &owner);
+    for (unsigned i = 0; i < BENCH_ITEMS; i++)
+        assert(atomic_load(&tasks[i].refs) == 0);
+    free(tasks);
+}
+
+int main(void)
+{
+    test_priority();
+    test_cancel();
+    test_burst();
+
+    static const unsigned threads[] = { 1, 2, 4, 8, 16 };
+    for (size_t i = 0; i < ARRAY_SIZE(threads); i++)
+        bench_throughput(threads[i]);
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*****************************************************************************
+ * block_fifo.c: Test and benchmark for block queues
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+
+#define BLOCKS 200000
+#define PINGS  500
+
+/* Common interface for both queue types */
+struct queue
+{
+    const char *name;
+    void *q;
+    void (*put)(void *, block_t *);
+    block_t *(*get)(void *);
+};
+
+static void fifo_put(void *q, block_t *b) { block_FifoPut(q, b); }
+static block_t *fifo_get(void *q) { return block_FifoGet(q); }
+static void ring_put(void *q, block_t *b) { block_RingPut(q, b); }
+static block_t *ring_get(void *q) { return block_RingGet(q); }
+
+static void test_ring_basic(void)
+{
+    block_ring_t *ring = block_RingNew(3);
+    assert(ring != NULL);
+
+    assert(block_RingDequeue(ring) == NULL);
+    assert(block_RingGetCount(ring) == 0);
+
+    block_t *blocks[5];
+    for (unsigned i = 0; i < 5; i++)
+    {
+        blocks[i] = block_Alloc(i + 1);
+        assert(blocks[i] != NULL);
+    }
+
+    /* Capacity is rounded up to 4 */
+    for (unsigned i = 0; i < 4; i++)
+        assert(block_RingQueue(ring, blocks[i]));
+    assert(!block_RingQueue(ring, blocks[4]));
+    assert(block_RingGetCount(ring) == 4);
+
+    assert(block_RingDequeue(ring) == blocks[0]);
+    assert(block_RingGetCount(ring) == 3);
+    assert(block_RingQueue(ring, blocks[4]));
+    for (unsigned i = 1; i < 5; i++)
+        assert(block_RingGet(ring) == blocks[i]);
+    assert(block_RingGetCount(ring) == 0);
+
+    for (unsigned i = 0; i < 5; i++)
+        block_Release(blocks[i]);
+
+    /* Queued blocks are released with the ring */
+    assert(block_RingQueue(ring, block_Alloc(16)));
+    block_RingRelease(ring);
+}
+
+static atomic_uint cancel_released;
+
+static void cancel_release(block_t *b)
+{
+    atomic_fetch_add(&cancel_released, 1);
+    (void) b;
+}
+
+static void *cancel_producer(void *data)
+{
+    block_ring_t *ring = data;
+    block_t block;
+
+    block_Init(&block, NULL, 0);
+    block.pf_release = cancel_release;
+    block_RingPut(ring, &block); /* full: waits until cancelled */
+    abort();
+}
+
+/* A producer cancelled while waiting for room releases its block */
+static void test_ring_cancel(void)
+{
+    block_ring_t *ring = block_RingNew(1);
+    vlc_thread_t th;
+
+    assert(ring != NULL);
+    assert(block_RingQueue(ring, block_Alloc(16)));
+    atomic_init(&cancel_released, 0);
+
+    assert(vlc_clone(&th, cancel_producer, ring,
+                     VLC_THREAD_PRIORITY_LOW) == 0);
+    mwait(mdate() + 10000);
+    vlc_cancel(th);
+    vlc_join(th, NULL);
+    assert(atomic_load(&cancel_released) == 1);
+    assert(block_RingGetCount(ring) == 1);
+    block_RingRelease(ring);
+}
+
+/* Throughput: the producer queues preallocated blocks as fast as possible */
+static void *throughput_consumer(void *data)
+{
+    struct queue *q = data;
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        block_t *b = q->get(q->q);
+        assert(b->i_dts == (mtime_t)i);
+    }
+    return NULL;
+}
+
+static void bench_throughput(struct queue *q, block_t *blocks)
+{
+    vlc_thread_t th;
+
+    mtime_t start = mdate();
+    if (vlc_clone(&th, throughput_consumer, q, VLC_THREAD_PRIORITY_LOW))
+        abort();
+    for (unsigned i = 0; i < BLOCKS; i++)
+        q->put(q->q, &blocks[i]);
+    vlc_join(th, NULL);
+    mtime_t duration = mdate() - start;
+
+    printf("%s: %u blocks in %"PRId64" us (%.1f Mblocks/s)\n", q->name,
+           BLOCKS, duration, duration ? (double)BLOCKS / duration : 0.);
+}
+
+/* Wakeup latency: the consumer sleeps on an empty queue for every block */
+struct ping
+{
+    struct queue *q;
+    mtime_t total;
+    mtime_t max;
+};
+
+static void *latency_consumer(void *data)
+{
+    struct ping *ping = data;
+
+    for (unsigned i = 0; i < PINGS; i++)
+    {
+        block_t *b = ping->q->get(ping->q->q);
+        mtime_t delay = mdate() - b->i_dts;
+
+        ping->total += delay;
+        if (delay > ping->max)
+            ping->max = delay;
+    }
+    return NULL;
+}
+
+static void bench_latency(struct queue *q, block_t *blocks)
+{
+    struct ping ping = { .q = q, .total = 0, .max = 0 };
+    vlc_thread_t th;
+
+    if (vlc_clone(&th, latency_consumer, &ping, VLC_THREAD_PRIORITY_LOW))
+        abort();
+    for (unsigned i = 0; i < PINGS; i++)
+    {
+        mwait(mdate() + 1000); /* let the consumer fall asleep */
+        blocks[i].i_dts = mdate();
+        q->put(q->q, &blocks[i]);
+    }
+    vlc_join(th, NULL);
+
+    printf("%s: wakeup latency average %"PRId64" us, max %"PRId64" us\n",
+           q->name, ping.total / PINGS, ping.max);
+}
+
+static void noop_release(block_t *b)
+{
+    (void) b;
+}
+
+int main(void)
+{
+    block_t *blocks = malloc(BLOCKS * sizeof (*blocks));
+    assert(blocks != NULL);
+
+    test_ring_basic();
+    test_ring_cancel();
+
+    block_fifo_t *fifo = block_FifoNew();
+    block_ring_t *ring = block_RingNew(1024);
+    assert(fifo != NULL && ring != NULL);
+
+    struct queue queues[] = {
+        { "fifo", fifo, fifo_put, fifo_get },
+        { "ring", ring, ring_put, ring_get },
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(queues); i++)
+    {
+        for (unsigned j = 0; j < BLOCKS; j++)
+        {
+            block_Init(&blocks[j], NULL, 0);
+            blocks[j].pf_release = noop_release;
+            blocks[j].i_dts = j;
+        }
+        bench_throughput(&queues[i], blocks);
+        bench_latency(&queues[i], blocks);
+    }
+
+    block_FifoRelease(fifo);
+    block_RingRelease(ring);
+    free(blocks);
+    return 0;
+}
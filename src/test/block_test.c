@@ -23,6 +23,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #undef NDEBUG
 #include <assert.h>
@@ -86,11 +87,210 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_Layout (block_t *block, size_t size)
+{
+    assert (block->i_buffer == size);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+    assert (block->p_buffer - block->p_start >= 32);
+    assert (block->p_start + block->i_size >= block->p_buffer + size + 32);
+    memset (block->p_buffer - 32, 0xA5, size + 64);
+}
+
+static void *test_block_PoolThread (void *data)
+{
+    block_t **blocks = data;
+
+    for (unsigned i = 0; i < 1000; i++)
+        block_Release (blocks[i]);
+    return NULL;
+}
+
+static void test_block_Pool (void)
+{
+    static const size_t sizes[] = {
+        0, 1, 187, 188, 189, 1316, 1500, 4000, 8192, 65536, 65537, 200000
+    };
+    block_pool_stats_t before, after;
+
+    block_PoolSetEnabled (true);
+    block_PoolGetStats (&before);
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        for (unsigned j = 0; j < 200; j++)
+        {
+            block_t *block = block_Alloc (sizes[i]);
+            assert (block != NULL);
+            test_block_Layout (block, sizes[i]);
+            block_Release (block);
+        }
+    }
+
+    block_PoolGetStats (&after);
+    assert (after.hits > before.hits);
+    assert (after.retained > 0);
+
+    /* Reallocation within and out of the pooled size */
+    block_t *block = block_Alloc (188);
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block = block_Realloc (block, 16, 188);
+    assert (block != NULL);
+    assert (!memcmp (block->p_buffer + 16, text, sizeof (text)));
+    block = block_Realloc (block, 0, 100000);
+    assert (block != NULL);
+    assert (!memcmp (block->p_buffer + 16, text, sizeof (text)));
+    block_Release (block);
+
+    /* Blocks allocated and released by different threads */
+    block_t *blocks[1000];
+    vlc_thread_t th;
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        blocks[i] = block_Alloc (1316);
+        assert (blocks[i] != NULL);
+        test_block_Layout (blocks[i], 1316);
+    }
+    if (vlc_clone (&th, test_block_PoolThread, blocks,
+                   VLC_THREAD_PRIORITY_LOW))
+        abort ();
+    vlc_join (th, NULL);
+
+    block_PoolGetStats (&before);
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        blocks[i] = block_Alloc (1316);
+        assert (blocks[i] != NULL);
+    }
+    for (unsigned i = 0; i < 1000; i++)
+        block_Release (blocks[i]);
+    block_PoolGetStats (&after);
+    /* The exiting thread returned its blocks to the depot */
+    assert (after.hits > before.hits);
+
+    block_PoolSetEnabled (false);
+
+    /* Pooled blocks remain valid after the pool is disabled */
+    block = block_Alloc (1316);
+    assert (block != NULL);
+    block_PoolSetEnabled (true);
+    block_t *pooled = block_Alloc (1316);
+    assert (pooled != NULL);
+    block_PoolSetEnabled (false);
+    block_Release (pooled);
+    block_Release (block);
+}
+
+static void test_block_Share (void)
+{
+    block_t *block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block->i_pts = 42;
+    block->i_flags = BLOCK_FLAG_TYPE_I;
+
+    block = block_Shareable (block);
+    assert (block != NULL);
+    assert (block_Shareable (block) == block);
+
+    /* References see the same payload and properties */
+    block_t *copies[8];
+    for (unsigned i = 0; i < ARRAY_SIZE(copies); i++)
+    {
+        copies[i] = block_Share (block);
+        assert (copies[i] != NULL);
+        assert (copies[i]->p_buffer == block->p_buffer);
+        assert (copies[i]->i_buffer == sizeof (text));
+        assert (copies[i]->i_pts == 42);
+        assert (copies[i]->i_flags == BLOCK_FLAG_TYPE_I);
+    }
+
+    /* Reallocation copies on write */
+    copies[0] = block_Realloc (copies[0], 16, sizeof (text));
+    assert (copies[0] != NULL);
+    assert (copies[0]->p_buffer != block->p_buffer + 16);
+    assert (!memcmp (copies[0]->p_buffer + 16, text, sizeof (text)));
+    assert (copies[0]->i_pts == 42);
+    memset (copies[0]->p_buffer, 'A', copies[0]->i_buffer);
+    assert (!memcmp (block->p_buffer, text, sizeof (text)));
+
+    /* A failed reallocation leaves the shared block untouched */
+    assert (block_TryRealloc (copies[1], 0, 1 << 27) == NULL);
+    assert (copies[1]->p_buffer == block->p_buffer);
+    assert (!memcmp (copies[1]->p_buffer, text, sizeof (text)));
+
+    /* The payload outlives the original block */
+    block_Release (block);
+    for (unsigned i = 1; i < ARRAY_SIZE(copies); i++)
+        assert (!memcmp (copies[i]->p_buffer, text, sizeof (text)));
+    for (unsigned i = 0; i < ARRAY_SIZE(copies); i++)
+        block_Release (copies[i]);
+
+    /* The last reference may be reallocated in place */
+    block = block_Shareable (block_Alloc (sizeof (text)));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block = block_Realloc (block, 0, sizeof (text) - 1);
+    assert (block != NULL);
+    assert (!memcmp (block->p_buffer, text, sizeof (text) - 1));
+    block_Release (block);
+
+    /* Non-shareable blocks are duplicated */
+    block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block_t *dup = block_Share (block);
+    assert (dup != NULL);
+    assert (dup->p_buffer != block->p_buffer);
+    assert (!memcmp (dup->p_buffer, text, sizeof (text)));
+    block_Release (dup);
+    block_Release (block);
+}
+
+#define BENCH_BLOCKS 16
+#define BENCH_ROUNDS 100000
+
+static void bench_block_Alloc (bool pool)
+{
+    static const size_t sizes[] = { 188, 1316, 4608, 65536 };
+    block_t *blocks[BENCH_BLOCKS];
+
+    block_PoolSetEnabled (pool);
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        mtime_t start = mdate ();
+
+        for (unsigned j = 0; j < BENCH_ROUNDS; j++)
+        {
+            for (unsigned k = 0; k < BENCH_BLOCKS; k++)
+            {
+                blocks[k] = block_Alloc (sizes[i]);
+                assert (blocks[k] != NULL);
+                blocks[k]->p_buffer[0] = k;
+            }
+            for (unsigned k = 0; k < BENCH_BLOCKS; k++)
+                block_Release (blocks[k]);
+        }
+
+        mtime_t duration = mdate () - start;
+        printf ("%s: %zu bytes: %.1f Mblocks/s\n", pool ? "pool" : "heap",
+                sizes[i], (double)(BENCH_BLOCKS * BENCH_ROUNDS) / duration);
+    }
+
+    block_PoolSetEnabled (false);
+}
+
 int main (void)
 {
     test_block_File(false);
     test_block_File(true);
     test_block ();
+    test_block_Pool ();
+    test_block_Share ();
+    bench_block_Alloc (false);
+    bench_block_Alloc (true);
     return 0;
 }
 
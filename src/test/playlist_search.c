@@ -0,0 +1,337 @@
+/*****************************************************************************
+ * playlist_search.c: Test and benchmark for the playlist live search
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* A synthetic playlist tree is searched as typed, one keystroke at a time,
+ * with the index and by walking the tree. Both must enable the same items. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../playlist/search.c"
+
+/* after config.h which may define it */
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_input_item.h>
+#include <vlc_meta.h>
+
+#define FOLDERS 100
+#define ITEMS_PER_FOLDER 1000
+
+static const char *const words[] = {
+    "love", "night", "Blue", "the", "of", "Heart", "river", "song", "Dream",
+    "fire", "rain", "light", "Summer", "road", "Home", "moon", "Über", "été",
+    "ÉCOLE", "Straße", "ΑΘΗΝΑ", "wind", "stone", "gold", "time", "Paradise",
+};
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void)
+{   /* xorshift32, so that failures are reproducible */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void rand_words(char *buf, size_t size, unsigned count)
+{
+    buf[0] = '\0';
+    for (unsigned i = 0; i < count; i++)
+    {
+        size_t len = strlen(buf);
+        snprintf(buf + len, size - len, "%s%s%u", i ? " " : "",
+                 words[rand32() % ARRAY_SIZE(words)], (unsigned)rand32() % 100);
+    }
+}
+
+static playlist_item_t *item_New(playlist_t *pl, playlist_item_t *parent,
+                                 bool node)
+{
+    char title[256], artist[64], album[128];
+
+    rand_words(title, sizeof (title), 1 + rand32() % 4);
+    rand_words(artist, sizeof (artist), 1 + rand32() % 2);
+    rand_words(album, sizeof (album), 1 + rand32() % 3);
+
+    input_item_t *input = input_item_New("file:///dev/null", title);
+    assert(input != NULL);
+    /* Some items have meta-data, others only a name */
+    if (!node && rand32() % 4)
+    {
+        input_item_SetTitle(input, title);
+        input_item_SetArtist(input, artist);
+        input_item_SetAlbum(input, album);
+    }
+
+    playlist_item_t *item = calloc(1, sizeof (*item));
+    assert(item != NULL);
+    item->p_input = input;
+    item->p_parent = parent;
+    item->i_children = node ? 0 : -1;
+
+    item->i_flags = PLAYLIST_DBL_FLAG; /* stale result */
+    TAB_APPEND(parent->i_children, parent->pp_children, item);
+    playlist_SearchAddItem(pl, item);
+    return item;
+}
+
+static void item_Delete(playlist_t *pl, playlist_item_t *item)
+{
+    for (int i = 0; i < item->i_children; i++)
+        item_Delete(pl, item->pp_children[i]);
+    playlist_SearchRemoveItem(pl, item);
+    input_item_Release(item->p_input);
+    free(item->pp_children);
+    free(item);
+}
+
+/* Saves the disabled flag of the items below a node */
+static size_t flags_Get(const playlist_item_t *node, bool *flags)
+{
+    size_t n = 0;
+
+    for (int i = 0; i < node->i_children; i++)
+    {
+        const playlist_item_t *item = node->pp_children[i];
+
+        flags[n++] = (item->i_flags & PLAYLIST_DBL_FLAG) != 0;
+        if (item->i_children > 0)
+            n += flags_Get(item, flags + n);
+    }
+    return n;
+}
+
+/* Restores the disabled flag of the items below a node */
+static size_t flags_Set(playlist_item_t *node, const bool *flags)
+{
+    size_t n = 0;
+
+    for (int i = 0; i < node->i_children; i++)
+    {
+        playlist_item_t *item = node->pp_children[i];
+
+        if (flags[n++])
+            item->i_flags |= PLAYLIST_DBL_FLAG;
+        else
+            item->i_flags &= ~PLAYLIST_DBL_FLAG;
+        if (item->i_children > 0)
+            n += flags_Set(item, flags + n);
+    }
+    return n;
+}
+
+static void name_changed(const vlc_event_t *event, void *data)
+{
+    playlist_SearchItemChanged(data, event->p_obj);
+}
+
+static mtime_t bench_time[2];
+
+/* Searches with and without the index, and compares the results */
+static void check(playlist_t *pl, playlist_item_t *root, const char *str,
+                  bool recursive, bool *flags_ref, bool *flags)
+{
+    struct playlist_search_t *s = pl_priv(pl)->search;
+
+    /* Both start from the results of the previous search */
+    size_t n = flags_Get(root, flags);
+
+    mtime_t t0 = mdate();
+    playlist_LiveSearchUpdateInternal(root, str, recursive);
+    mtime_t t1 = mdate();
+    assert(flags_Get(root, flags_ref) == n);
+
+    flags_Set(root, flags);
+
+    mtime_t t2 = mdate();
+    assert(playlist_LiveSearchUpdateIndexed(s, root, str, recursive) == 0);
+    mtime_t t3 = mdate();
+    assert(flags_Get(root, flags) == n);
+
+    bench_time[0] += t1 - t0;
+    bench_time[1] += t3 - t2;
+
+    for (size_t i = 0; i < n; i++)
+        if (flags[i] != flags_ref[i])
+        {
+            fprintf(stderr, "mismatch searching \"%s\" (item %zu)\n", str, i);
+            abort();
+        }
+}
+
+/* Types a string one character at a time */
+static void type(playlist_t *pl, playlist_item_t *root, const char *str,
+                 bool recursive, bool *flags_ref, bool *flags)
+{
+    char buf[256];
+    size_t len = strlen(str);
+
+    assert(len < sizeof (buf));
+    for (size_t i = 1; i <= len; i++)
+    {
+        if ((str[i] & 0xC0) == 0x80)
+            continue; /* in the middle of a character */
+        memcpy(buf, str, i);
+        buf[i] = '\0';
+        check(pl, root, buf, recursive, flags_ref, flags);
+    }
+}
+
+int main(void)
+{
+    playlist_private_t *p = calloc(1, sizeof (*p));
+    assert(p != NULL);
+
+    playlist_t *pl = &p->public_data;
+
+    vlc_mutex_init(&p->lock);
+    vlc_cond_init(&p->signal);
+    assert(playlist_SearchInit(pl) == 0);
+
+    vlc_mutex_lock(&p->lock);
+
+    playlist_item_t root = { .i_children = 0 };
+    const size_t count = FOLDERS * (ITEMS_PER_FOLDER + 1) + 2 * (FOLDERS / 10);
+    bool *flags_ref = malloc(count * sizeof (*flags_ref));
+    bool *flags = malloc(count * sizeof (*flags));
+    assert(flags_ref != NULL && flags != NULL);
+
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < FOLDERS; i++)
+    {
+        playlist_item_t *folder = item_New(pl, &root, true);
+
+        for (unsigned j = 0; j < ITEMS_PER_FOLDER; j++)
+            item_New(pl, folder, false);
+        if (i % 10 == 0)
+        {   /* nested folder */
+            playlist_item_t *sub = item_New(pl, folder, true);
+            item_New(pl, sub, false);
+        }
+    }
+    /* Items are indexed by the first search */
+    check(pl, &root, "x", true, flags_ref, flags);
+    printf("%zu items indexed in %"PRId64" ms\n", count,
+           (mdate() - start) / 1000);
+
+    static const char *const queries[] = {
+        "the blue", "heart1", "Love night", "über", "ÜBER5", "straße",
+        "αθηνα", "École", "été4", "moon 9", "zzz", "o", "e",
+    };
+
+    bench_time[0] = bench_time[1] = 0;
+    unsigned keys = 0;
+    for (unsigned i = 0; i < ARRAY_SIZE(queries); i++)
+    {
+        type(pl, &root, queries[i], true, flags_ref, flags);
+        keys += strlen(queries[i]);
+    }
+    printf("%u keystrokes: tree walk %"PRId64" ms, index %"PRId64" ms\n",
+           keys, bench_time[0] / 1000, bench_time[1] / 1000);
+
+    /* Non-recursive search of a folder, and of the root */
+    type(pl, root.pp_children[3], "river", false, flags_ref, flags);
+    type(pl, &root, "gold", false, flags_ref, flags);
+
+    /* Meta-data changes (not under the playlist lock) */
+    playlist_item_t *item = root.pp_children[7]->pp_children[42];
+    input_item_SetTitle(item->p_input, "Unique Needle");
+    playlist_SearchItemChanged(pl, item->p_input);
+    check(pl, &root, "unique needl", true, flags_ref, flags);
+    assert(!(item->i_flags & PLAYLIST_DBL_FLAG));
+    assert(!(item->p_parent->i_flags & PLAYLIST_DBL_FLAG));
+    check(pl, &root, "unique needle", true, flags_ref, flags);
+    input_item_SetTitle(item->p_input, NULL);
+    playlist_SearchItemChanged(pl, item->p_input);
+    check(pl, &root, "unique needle", true, flags_ref, flags);
+    assert(item->i_flags & PLAYLIST_DBL_FLAG);
+
+    /* Renaming an item without a title, as the playlist does on events */
+    vlc_event_manager_t *em = &item->p_input->event_manager;
+    vlc_event_attach(em, vlc_InputItemNameChanged, name_changed, pl);
+    input_item_SetName(item->p_input, "Renamed Needle");
+    check(pl, &root, "renamed needle", true, flags_ref, flags);
+    assert(!(item->i_flags & PLAYLIST_DBL_FLAG));
+    vlc_event_detach(em, vlc_InputItemNameChanged, name_changed, pl);
+
+    /* Meta-data merged from the demuxer, as the input does, still no title */
+    vlc_meta_t *meta = vlc_meta_New();
+    assert(meta != NULL);
+    vlc_meta_Set(meta, vlc_meta_Artist, "Merged Artist");
+    vlc_meta_Set(meta, vlc_meta_Album, "Merged Album");
+    vlc_mutex_lock(&item->p_input->lock);
+    vlc_meta_Merge(item->p_input->p_meta, meta);
+    vlc_mutex_unlock(&item->p_input->lock);
+    vlc_meta_Delete(meta);
+    playlist_SearchItemChanged(pl, item->p_input);
+    check(pl, &root, "merged artist", true, flags_ref, flags);
+    assert(!(item->i_flags & PLAYLIST_DBL_FLAG));
+    check(pl, &root, "merged album", true, flags_ref, flags);
+    assert(!(item->i_flags & PLAYLIST_DBL_FLAG));
+
+    /* Removals, including of items not indexed yet */
+    for (unsigned i = 0; i < 20; i++)
+    {
+        playlist_item_t *folder = root.pp_children[root.i_children - 1];
+
+        TAB_ERASE(root.i_children, root.pp_children, root.i_children - 1);
+        if (i % 2)
+        {
+            playlist_SearchItemChanged(pl, folder->pp_children[0]->p_input);
+            item_New(pl, &root, false);
+        }
+        item_Delete(pl, folder);
+        check(pl, &root, "love", true, flags_ref, flags);
+    }
+    type(pl, &root, "heart5", true, flags_ref, flags);
+
+    /* Invalid UTF-8 matches nothing */
+    check(pl, &root, "\xC3(", true, flags_ref, flags);
+
+    /* The public function, with the index and without */
+    playlist_LiveSearchUpdate(pl, &root, "the", true);
+    flags_Get(&root, flags);
+    playlist_LiveSearchUpdateInternal(&root, "the", true);
+    for (size_t i = 0, n = flags_Get(&root, flags_ref); i < n; i++)
+        assert(flags[i] == flags_ref[i]);
+    playlist_LiveSearchUpdate(pl, &root, "", true);
+    assert(!(root.pp_children[0]->i_flags & PLAYLIST_DBL_FLAG));
+
+    for (int i = 0; i < root.i_children; i++)
+        item_Delete(pl, root.pp_children[i]);
+    free(root.pp_children);
+    vlc_mutex_unlock(&p->lock);
+
+    playlist_SearchClean(pl);
+    assert(pl_priv(pl)->search == NULL);
+
+    free(flags);
+    free(flags_ref);
+    vlc_cond_destroy(&p->signal);
+    vlc_mutex_destroy(&p->lock);
+    free(p);
+    return 0;
+}
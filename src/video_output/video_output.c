@@ -54,6 +54,7 @@
 #include "display.h"
 #include "window.h"
 #include "../misc/variables.h"
+#include "../misc/frame_trace.h"
 
 /*****************************************************************************
  * Local prototypes
@@ -1187,7 +1188,9 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     /* Display the direct buffer returned by vout_RenderPicture */
     vout->p->displayed.date = mdate();
     //msg_Warn(vout, "%ld frameTrace now display picture(%lld),pts: %lld,data-mdata():%lld", vlc_thread_id(), mdate_count(), todisplay->date, todisplay->date-vout->p->displayed.date);
+    const mtime_t date = todisplay->date;
     vout_display_Display(vd, todisplay, subpic);
+    vlc_frame_Trace(VLC_FRAME_DISPLAY, -1, VLC_TS_INVALID, date);
 
     vout_statistic_AddDisplayed(&vout->p->statistic, 1);
 
@@ -0,0 +1,248 @@
+/*****************************************************************************
+ * rtp.c: RTP reordering buffer test
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Synthetic packet traces, with network jitter (hence reordering) and loss,
+ * are fed to the RTP session on a simulated clock. The packets must come out
+ * in sequence; the delay added by the buffer and the packets it had to give
+ * up on are reported. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_demux.h>
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+const char vlc_module_name[] = "test_rtp";
+
+/* The session reads the time from the simulated clock */
+static mtime_t now;
+#define mdate() (test_now())
+static mtime_t test_now(void)
+{
+    return now;
+}
+#include "../../../modules/access/rtp/session.c"
+
+/* after config.h which may define it */
+#undef NDEBUG
+#include <assert.h>
+
+#define PACKETS  20000
+#define INTERVAL 1000 /* packet interval (us) */
+#define FREQ     90000
+#define FIRST_SEQ 65000 /* so that the sequence wraps around */
+
+struct packet
+{
+    unsigned index;
+    mtime_t arrival;
+};
+
+static struct
+{
+    mtime_t arrival[PACKETS];
+    unsigned next; /* lowest index which may still be decoded */
+    unsigned decoded;
+    unsigned discontinuities;
+    mtime_t delay_sum;
+    mtime_t delay_max;
+} out;
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void)
+{   /* xorshift32, so that failures are reproducible */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void decode(demux_t *demux, void *data, block_t *block)
+{
+    assert(block->i_buffer == 4);
+
+    unsigned index = GetDWBE(block->p_buffer);
+
+    assert(index < PACKETS);
+    assert(index >= out.next); /* in order, once */
+    /* The sequence starts from the first received packet */
+    if (index > out.next && out.decoded > 0)
+        assert(block->i_flags & BLOCK_FLAG_DISCONTINUITY);
+    if (block->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        out.discontinuities++;
+    out.next = index + 1;
+    out.decoded++;
+
+    mtime_t delay = now - out.arrival[index];
+    assert(delay >= 0);
+    out.delay_sum += delay;
+    if (delay > out.delay_max)
+        out.delay_max = delay;
+
+    block_Release(block);
+    (void) demux; (void) data;
+}
+
+static block_t *packet_New(unsigned index)
+{
+    block_t *block = block_Alloc(16);
+    assert(block != NULL);
+
+    uint8_t *p = block->p_buffer;
+
+    p[0] = 0x80; /* version 2 */
+    p[1] = 96; /* payload type */
+    SetWBE(p + 2, FIRST_SEQ + index);
+    SetDWBE(p + 4, index * (FREQ / (CLOCK_FREQ / INTERVAL)));
+    SetDWBE(p + 8, 0x12345678); /* SSRC */
+    SetDWBE(p + 12, index);
+    return block;
+}
+
+static int packet_Cmp(const void *a, const void *b)
+{
+    const struct packet *x = a, *y = b;
+
+    if (x->arrival != y->arrival)
+        return (x->arrival > y->arrival) - (x->arrival < y->arrival);
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/**
+ * Runs a trace.
+ * \param jitter maximum network delay variation (us)
+ * \param loss packet loss probability (per mille)
+ */
+static void run(demux_t *demux, const char *name, mtime_t jitter,
+                unsigned loss)
+{
+    struct packet *trace = malloc(PACKETS * sizeof (*trace));
+    unsigned received = 0;
+
+    assert(trace != NULL);
+    for (unsigned i = 0; i < PACKETS; i++)
+    {
+        if (rand32() % 1000 < loss)
+            continue;
+
+        mtime_t arrival = CLOCK_FREQ + i * INTERVAL;
+        if (jitter > 0)
+            arrival += rand32() % jitter;
+
+        trace[received].index = i;
+        trace[received].arrival = arrival;
+        out.arrival[i] = arrival;
+        received++;
+    }
+    qsort(trace, received, sizeof (*trace), packet_Cmp);
+
+    out.next = out.decoded = out.discontinuities = 0;
+    out.delay_sum = out.delay_max = 0;
+
+    rtp_session_t *session = rtp_session_create(demux);
+    assert(session != NULL);
+
+    const rtp_pt_t pt = { .decode = decode, .frequency = FREQ, .number = 96 };
+    assert(rtp_add_type(demux, session, &pt) == 0);
+
+    mtime_t deadline = 0;
+    bool pending = false;
+
+    for (unsigned i = 0; i < received; i++)
+    {
+        /* Timer expiries until the next packet */
+        while (pending && deadline <= trace[i].arrival)
+        {
+            now = deadline;
+            pending = rtp_dequeue(demux, session, &deadline);
+        }
+
+        now = trace[i].arrival;
+        rtp_queue(demux, session, packet_New(trace[i].index));
+        pending = rtp_dequeue(demux, session, &deadline);
+    }
+
+    while (pending)
+    {
+        now = deadline;
+        pending = rtp_dequeue(demux, session, &deadline);
+    }
+    rtp_session_destroy(demux, session);
+    free(trace);
+
+    unsigned late = received - out.decoded;
+
+    printf("%-14s: %5u lost, %4u late (%5.2f%%), added delay: "
+           "average %5.2f ms, max %5.2f ms\n", name, PACKETS - received,
+           late, 100. * late / received,
+           out.delay_sum / (1000. * out.decoded), out.delay_max / 1000.);
+
+    if (jitter <= INTERVAL)
+    {   /* No reordering: nothing can be late */
+        assert(late == 0);
+        /* With no jitter, a gap is given up after the shortest delay */
+        if (jitter == 0)
+            assert(out.delay_max <= RTP_MIN_DELAY);
+    }
+    if (loss == 0 && jitter == 0)
+        assert(out.delay_max == 0 && out.discontinuities == 0);
+    /* Reordering is learnt quickly: few packets are given up */
+    assert(late <= received / 200);
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *argv[] = { "--ignore-config", "-q" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    demux_t *demux = vlc_object_create(vlc->p_libvlc_int, sizeof (*demux));
+    assert(demux != NULL);
+
+    demux_sys_t sys = {
+        .timeout = 5 * CLOCK_FREQ,
+        .max_dropout = 3000,
+        .max_misorder = 100,
+        .max_src = 1,
+    };
+    demux->p_sys = &sys;
+
+    run(demux, "in order", 0, 0);
+    run(demux, "1% loss", 0, 10);
+    run(demux, "5% loss", 0, 50);
+    run(demux, "1 ms jitter", INTERVAL, 0);
+    run(demux, "5 ms jitter", 5 * INTERVAL, 0);
+    run(demux, "20 ms jitter", 20 * INTERVAL, 0);
+    run(demux, "5 ms, 2% loss", 5 * INTERVAL, 20);
+
+    vlc_object_release(demux);
+    libvlc_release(vlc);
+    return 0;
+}
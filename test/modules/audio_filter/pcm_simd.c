@@ -0,0 +1,309 @@
+/*****************************************************************************
+ * pcm_simd.c: PCM conversion kernels test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vlc_common.h>
+#include "../modules/audio_filter/converter/pcm_simd.h"
+
+struct kernels
+{
+    const char *name;
+    bool (*supported)(void);
+    void (*s16_fl32)(float *, const int16_t *, size_t);
+    void (*fl32_s16)(int16_t *, const float *, size_t);
+    void (*s32_fl32)(float *, const int32_t *, size_t);
+    void (*amp_fl32)(float *, size_t, float);
+    void (*amp_fl64)(double *, size_t, double);
+};
+
+static bool always(void)
+{
+    return true;
+}
+
+#ifdef PCM_SIMD
+# if defined(__i386__) || defined(__x86_64__)
+static bool has_sse2(void)
+{
+    return vlc_CPU_SSE2();
+}
+
+static bool has_avx2(void)
+{
+    return vlc_CPU_AVX2();
+}
+# endif
+#endif
+
+#define KERNELS(suffix, supported) \
+    { #suffix, supported, pcm_S16toFl32_##suffix, pcm_Fl32toS16_##suffix, \
+      pcm_S32toFl32_##suffix, pcm_AmplifyFl32_##suffix, \
+      pcm_AmplifyFl64_##suffix }
+
+static const struct kernels reference = KERNELS(c, always);
+
+static const struct kernels variants[] = {
+#ifdef PCM_SIMD
+# if defined(__i386__) || defined(__x86_64__)
+    KERNELS(sse2, has_sse2),
+    KERNELS(avx2, has_avx2),
+# else
+    KERNELS(vec, always),
+# endif
+#endif
+    { "dispatch", always, pcm_S16toFl32, pcm_Fl32toS16, pcm_S32toFl32,
+      pcm_AmplifyFl32, pcm_AmplifyFl64 },
+};
+
+#define SAMPLES 65536
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void)
+{   /* xorshift32, so that failures are reproducible */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static float float_bits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof (f));
+    return f;
+}
+
+/* Interesting float samples, followed by random bit patterns */
+static void fill_floats(float *buf, size_t n)
+{
+    static const float specials[] = {
+        0.f, -0.f, 1.f, -1.f, 0.5f, -0.5f, 1.5f, -1.5f, 2.f, -2.f,
+        32767.f / 32768.f, -32767.f / 32768.f, 32767.5f / 32768.f,
+        -32768.5f / 32768.f, 1.f / 65536.f, -1.f / 65536.f,
+        3.f / 65536.f, -3.f / 65536.f, 1e-30f, -1e-30f, 1e30f, -1e30f,
+        INFINITY, -INFINITY, NAN, -NAN,
+    };
+    size_t i = 0;
+
+    for (; i < ARRAY_SIZE(specials) && i < n; i++)
+        buf[i] = specials[i];
+    for (; i < n / 2; i++)
+        buf[i] = (float)(int32_t)rand32() / 1073741824.f; /* [-2, 2[ */
+    for (; i < n; i++)
+        buf[i] = float_bits(rand32());
+}
+
+static void check_s16_fl32(const struct kernels *k, size_t offset)
+{
+    int16_t *src = malloc((SAMPLES + offset) * sizeof (*src));
+    float *ref = malloc(SAMPLES * sizeof (*ref));
+    float *out = malloc((SAMPLES + offset) * sizeof (*out));
+    assert(src != NULL && ref != NULL && out != NULL);
+
+    for (size_t i = 0; i < SAMPLES; i++)
+        src[offset + i] = i - 32768;
+
+    /* Odd lengths exercise the scalar tails */
+    for (size_t n = SAMPLES - 7; n <= SAMPLES; n += 7)
+    {
+        reference.s16_fl32(ref, src + offset, n);
+        k->s16_fl32(out + offset, src + offset, n);
+        assert(!memcmp(ref, out + offset, n * sizeof (*ref)));
+    }
+    assert(ref[0] == -1.f && ref[32768] == 0.f);
+
+    free(out);
+    free(ref);
+    free(src);
+}
+
+static void check_fl32_s16(const struct kernels *k, size_t offset)
+{
+    float *src = malloc((SAMPLES + offset) * sizeof (*src));
+    int16_t *ref = malloc(SAMPLES * sizeof (*ref));
+    float *buf = malloc((SAMPLES + offset) * sizeof (*buf));
+    assert(src != NULL && ref != NULL && buf != NULL);
+
+    fill_floats(src + offset, SAMPLES);
+    reference.fl32_s16(ref, src + offset, SAMPLES - 3);
+
+    /* In place, as in the converter */
+    memcpy(buf + offset, src + offset, SAMPLES * sizeof (*buf));
+    int16_t *out = (int16_t *)(buf + offset);
+    k->fl32_s16(out, buf + offset, SAMPLES - 3);
+    assert(!memcmp(ref, out, (SAMPLES - 3) * sizeof (*ref)));
+
+    /* Clipping */
+    assert(ref[2] == 32767 && ref[3] == -32768);
+    assert(ref[6] == 32767 && ref[7] == -32768);
+    assert(ref[22] == 32767 && ref[23] == -32768);
+
+    free(buf);
+    free(ref);
+    free(src);
+}
+
+static void check_s32_fl32(const struct kernels *k, size_t offset)
+{
+    int32_t *src = malloc((SAMPLES + offset) * sizeof (*src));
+    float *ref = malloc(SAMPLES * sizeof (*ref));
+    int32_t *buf = malloc((SAMPLES + offset) * sizeof (*buf));
+    assert(src != NULL && ref != NULL && buf != NULL);
+
+    src[offset + 0] = INT32_MIN;
+    src[offset + 1] = INT32_MAX;
+    src[offset + 2] = 0;
+    src[offset + 3] = 1;
+    src[offset + 4] = -1;
+    for (size_t i = 5; i < SAMPLES; i++)
+        src[offset + i] = rand32();
+
+    reference.s32_fl32(ref, src + offset, SAMPLES - 5);
+    memcpy(buf + offset, src + offset, SAMPLES * sizeof (*buf));
+    float *out = (float *)(buf + offset);
+    k->s32_fl32(out, buf + offset, SAMPLES - 5);
+    assert(!memcmp(ref, out, (SAMPLES - 5) * sizeof (*ref)));
+    assert(ref[0] == -1.f && ref[1] == 1.f);
+
+    free(buf);
+    free(ref);
+    free(src);
+}
+
+static void check_amplify(const struct kernels *k, size_t offset)
+{
+    static const float mults[] = { 0.f, 0.5f, 0.3f, 1.7f, 8.f };
+    float *src = malloc(SAMPLES * sizeof (*src));
+    float *ref = malloc(SAMPLES * sizeof (*ref));
+    float *out = malloc((SAMPLES + offset) * sizeof (*out));
+    double *ref64 = malloc(SAMPLES * sizeof (*ref64));
+    double *out64 = malloc((SAMPLES + offset) * sizeof (*out64));
+    assert(src != NULL && ref != NULL && out != NULL);
+    assert(ref64 != NULL && out64 != NULL);
+
+    fill_floats(src, SAMPLES);
+
+    for (size_t m = 0; m < ARRAY_SIZE(mults); m++)
+    {
+        const size_t n = SAMPLES - m;
+
+        memcpy(ref, src, n * sizeof (*ref));
+        memcpy(out + offset, src, n * sizeof (*out));
+        reference.amp_fl32(ref, n, mults[m]);
+        k->amp_fl32(out + offset, n, mults[m]);
+        assert(!memcmp(ref, out + offset, n * sizeof (*ref)));
+
+        for (size_t i = 0; i < n; i++)
+            ref64[i] = out64[offset + i] = src[i];
+        reference.amp_fl64(ref64, n, mults[m]);
+        k->amp_fl64(out64 + offset, n, mults[m]);
+        assert(!memcmp(ref64, out64 + offset, n * sizeof (*ref64)));
+    }
+
+    free(out64);
+    free(ref64);
+    free(out);
+    free(ref);
+    free(src);
+}
+
+/* About 1 second of 48 kHz stereo audio per buffer */
+#define BENCH_SAMPLES 96000
+#define BENCH_RUNS    1000
+
+static void bench(const struct kernels *k)
+{
+    float *f = malloc(BENCH_SAMPLES * sizeof (*f));
+    int16_t *s16 = malloc(BENCH_SAMPLES * sizeof (*s16));
+    int32_t *s32 = malloc(BENCH_SAMPLES * sizeof (*s32));
+    assert(f != NULL && s16 != NULL && s32 != NULL);
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++)
+        s16[i] = s32[i] = rand32();
+
+    mtime_t start, t[4];
+
+    start = mdate();
+    for (unsigned i = 0; i < BENCH_RUNS; i++)
+        k->s16_fl32(f, s16, BENCH_SAMPLES);
+    t[0] = mdate() - start;
+
+    start = mdate();
+    for (unsigned i = 0; i < BENCH_RUNS; i++)
+        k->fl32_s16(s16, f, BENCH_SAMPLES);
+    t[1] = mdate() - start;
+
+    start = mdate();
+    for (unsigned i = 0; i < BENCH_RUNS; i++)
+        k->s32_fl32(f, s32, BENCH_SAMPLES);
+    t[2] = mdate() - start;
+
+    start = mdate();
+    for (unsigned i = 0; i < BENCH_RUNS; i++)
+        k->amp_fl32(f, BENCH_SAMPLES, 0.999f);
+    t[3] = mdate() - start;
+
+    printf("%-8s S16->FL32 %5"PRId64" us, FL32->S16 %5"PRId64" us, "
+           "S32->FL32 %5"PRId64" us, FL32 volume %5"PRId64" us\n",
+           k->name, t[0], t[1], t[2], t[3]);
+
+    free(s32);
+    free(s16);
+    free(f);
+}
+
+int main(void)
+{
+    bench(&reference);
+
+    for (size_t i = 0; i < ARRAY_SIZE(variants); i++)
+    {
+        const struct kernels *k = &variants[i];
+
+        if (!k->supported())
+        {
+            printf("%-8s not supported by this CPU\n", k->name);
+            continue;
+        }
+
+        /* Aligned and misaligned buffers */
+        for (size_t offset = 0; offset < 2; offset++)
+        {
+            check_s16_fl32(k, offset);
+            check_fl32_s16(k, offset);
+            check_s32_fl32(k, offset);
+            check_amplify(k, offset);
+        }
+        bench(k);
+    }
+    return 0;
+}
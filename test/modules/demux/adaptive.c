@@ -0,0 +1,466 @@
+/*****************************************************************************
+ * adaptive.c: adaptive streaming downloads test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* A local HTTP server stands in for a remote one: each request is answered
+ * after a round-trip time, and each connection is limited in rate, as TCP
+ * on a high latency link. It serves an HLS playlist of packed audio
+ * segments, which are demuxed as fast as possible with serial and with
+ * parallel downloads. The stream is checked, and the time to the first
+ * block and to the end of the stream are reported.
+ * VLC_ADAPTIVE_RTT (ms) and VLC_ADAPTIVE_RATE (bytes per second and per
+ * connection) change the link. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include <vlc_atomic.h>
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#define SEGMENTS       20
+#define SEGMENT_FRAMES 94   /* 2 seconds of 48 kHz AAC */
+#define FRAME_SIZE     1000
+#define FRAME_DURATION (CLOCK_FREQ * 1024 / 48000)
+#define ID3_SIZE       (10 + 10 + 53)
+#define SEGMENT_SIZE   (ID3_SIZE + SEGMENT_FRAMES * FRAME_SIZE)
+
+/*****************************************************************************
+ * Server
+ *****************************************************************************/
+struct server
+{
+    int fd;
+    unsigned port;
+    mtime_t rtt;
+    unsigned rate;
+    atomic_bool stop;
+    atomic_uint requests;
+    vlc_thread_t thread;
+    vlc_thread_t conns[64];
+    unsigned connections;
+};
+
+struct connection
+{
+    struct server *server;
+    int fd;
+};
+
+static void MakeSegment(uint8_t *buf, unsigned index)
+{
+    /* ID3 tag with the HLS timestamp */
+    static const char owner[] = "com.apple.streaming.transportStreamTimestamp";
+
+    memcpy(buf, "ID3\x04\x00\x00", 6);
+    SetDWBE(buf + 6, ID3_SIZE - 10); /* synchsafe, but small enough */
+    memcpy(buf + 10, "PRIV", 4);
+    SetDWBE(buf + 14, 53);
+    SetWBE(buf + 18, 0);
+    memcpy(buf + 20, owner, sizeof (owner));
+    SetQWBE(buf + 20 + sizeof (owner),
+            (uint64_t)index * SEGMENT_FRAMES * FRAME_DURATION * 9 / 100);
+
+    /* AAC LC, 48 kHz, stereo ADTS frames, numbered */
+    for (unsigned i = 0; i < SEGMENT_FRAMES; i++)
+    {
+        uint8_t *frame = buf + ID3_SIZE + i * FRAME_SIZE;
+
+        frame[0] = 0xFF;
+        frame[1] = 0xF1;
+        frame[2] = (1 << 6) | (3 << 2);
+        frame[3] = (2 << 6) | (FRAME_SIZE >> 11);
+        frame[4] = FRAME_SIZE >> 3;
+        frame[5] = ((FRAME_SIZE & 7) << 5) | 0x1F;
+        frame[6] = 0xFC;
+        memset(frame + 7, 0, FRAME_SIZE - 7);
+        SetDWBE(frame + 7, index * SEGMENT_FRAMES + i);
+    }
+}
+
+static char *MakePlaylist(size_t *size)
+{
+    char *str;
+    size_t len;
+    FILE *stream = open_memstream(&str, &len);
+    assert(stream != NULL);
+
+    fprintf(stream, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:3\n"
+                    "#EXT-X-MEDIA-SEQUENCE:0\n");
+    for (unsigned i = 0; i < SEGMENTS; i++)
+        fprintf(stream, "#EXTINF:%f,\nsegment%u.aac\n",
+                (double)(SEGMENT_FRAMES * FRAME_DURATION) / CLOCK_FREQ, i);
+    fprintf(stream, "#EXT-X-ENDLIST\n");
+    assert(fclose(stream) == 0);
+    *size = len;
+    return str;
+}
+
+/* Sends at the connection rate */
+static bool Send(struct server *srv, int fd, const void *data, size_t len)
+{
+    const size_t burst = 4096;
+    mtime_t deadline = mdate();
+
+    while (len > 0)
+    {
+        size_t n = __MIN(len, burst);
+        ssize_t val = send(fd, data, n, MSG_NOSIGNAL);
+
+        if (val <= 0)
+            return false;
+        data = (const uint8_t *)data + val;
+        len -= val;
+        deadline += CLOCK_FREQ * val / srv->rate;
+        mwait(deadline);
+    }
+    return true;
+}
+
+static void *ConnectionThread(void *data)
+{
+    struct connection *conn = data;
+    struct server *srv = conn->server;
+    char req[4096];
+    size_t reqlen = 0;
+    uint8_t *segment = malloc(SEGMENT_SIZE);
+    assert(segment != NULL);
+
+    while (!atomic_load(&srv->stop))
+    {
+        struct pollfd ufd = { .fd = conn->fd, .events = POLLIN };
+
+        if (poll(&ufd, 1, 50) <= 0)
+            continue;
+
+        ssize_t val = recv(conn->fd, req + reqlen, sizeof (req) - 1 - reqlen,
+                           0);
+        if (val <= 0)
+            break;
+        reqlen += val;
+        req[reqlen] = '\0';
+
+        char *end = strstr(req, "\r\n\r\n");
+        if (end == NULL)
+        {
+            assert(reqlen < sizeof (req) - 1);
+            continue;
+        }
+
+        char path[256];
+        unsigned index;
+        assert(sscanf(req, "GET %255s HTTP/1.", path) == 1);
+        atomic_fetch_add(&srv->requests, 1);
+
+        /* the request and the response headers take one round trip */
+        msleep(srv->rtt);
+
+        char header[256];
+        const void *body;
+        size_t bodylen;
+        char *playlist = NULL;
+        const char *type;
+
+        if (!strcmp(path, "/index.m3u8"))
+        {
+            playlist = MakePlaylist(&bodylen);
+            body = playlist;
+            type = "application/vnd.apple.mpegurl";
+        }
+        else if (sscanf(path, "/segment%u.aac", &index) == 1
+              && index < SEGMENTS)
+        {
+            MakeSegment(segment, index);
+            body = segment;
+            bodylen = SEGMENT_SIZE;
+            type = "audio/aac";
+        }
+        else
+        {
+            body = "";
+            bodylen = 0;
+            type = NULL;
+        }
+
+        int hlen = snprintf(header, sizeof (header),
+                            "HTTP/1.1 %s\r\nContent-Length: %zu\r\n"
+                            "Content-Type: %s\r\n\r\n",
+                            type ? "200 OK" : "404 Not Found", bodylen,
+                            type ? type : "text/plain");
+        bool ok = send(conn->fd, header, hlen, MSG_NOSIGNAL) == hlen
+               && Send(srv, conn->fd, body, bodylen);
+        free(playlist);
+        if (!ok)
+            break;
+
+        end += 4;
+        reqlen -= end - req;
+        memmove(req, end, reqlen + 1);
+    }
+
+    free(segment);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+static void *ServerThread(void *data)
+{
+    struct server *srv = data;
+
+    while (!atomic_load(&srv->stop))
+    {
+        struct pollfd ufd = { .fd = srv->fd, .events = POLLIN };
+
+        if (poll(&ufd, 1, 50) <= 0)
+            continue;
+
+        struct connection *conn = malloc(sizeof (*conn));
+        assert(conn != NULL);
+        conn->server = srv;
+        conn->fd = accept(srv->fd, NULL, NULL);
+        if (conn->fd == -1)
+        {
+            free(conn);
+            continue;
+        }
+
+        assert(srv->connections < ARRAY_SIZE(srv->conns));
+        if (vlc_clone(&srv->conns[srv->connections++], ConnectionThread,
+                      conn, VLC_THREAD_PRIORITY_LOW))
+            abort();
+    }
+    return NULL;
+}
+
+static int ServerStart(struct server *srv, mtime_t rtt, unsigned rate)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(srv->fd != -1);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof (addr))
+     || listen(srv->fd, 16)
+     || getsockname(srv->fd, (struct sockaddr *)&addr, &addrlen))
+    {
+        close(srv->fd);
+        return -1;
+    }
+
+    srv->port = ntohs(addr.sin_port);
+    srv->rtt = rtt;
+    srv->rate = rate;
+    atomic_init(&srv->stop, false);
+    atomic_init(&srv->requests, 0);
+    srv->connections = 0;
+    if (vlc_clone(&srv->thread, ServerThread, srv, VLC_THREAD_PRIORITY_LOW))
+        abort();
+    return 0;
+}
+
+static void ServerStop(struct server *srv)
+{
+    atomic_store(&srv->stop, true);
+    vlc_join(srv->thread, NULL);
+    for (unsigned i = 0; i < srv->connections; i++)
+        vlc_join(srv->conns[i], NULL);
+    close(srv->fd);
+}
+
+/*****************************************************************************
+ * ES output checking the frames
+ *****************************************************************************/
+struct test_es_out
+{
+    es_out_t out;
+    es_out_id_t *id;
+    uint32_t next; /* next expected frame */
+    mtime_t first; /* date of the first frame */
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(fmt->i_cat == AUDIO_ES);
+    assert(ctx->id == NULL);
+    ctx->id = malloc(1);
+    return ctx->id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(id == ctx->id);
+    if (ctx->next == 0)
+        ctx->first = mdate();
+
+    /* frames are numbered after their header, if it was not stripped */
+    const uint8_t *p = block->p_buffer;
+    if (p[0] == 0xFF)
+        p += 7;
+    assert(block->p_buffer + block->i_buffer >= p + 4);
+    assert(GetDWBE(p) == ctx->next);
+    ctx->next++;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDelete(es_out_t *out, es_out_id_t *id)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(id == ctx->id);
+    free(id);
+    ctx->id = NULL;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    (void) out;
+    switch (query)
+    {
+        case ES_OUT_GET_ES_STATE:
+            va_arg(args, es_out_id_t *);
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_GET_EMPTY:
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_SET_META:
+        case ES_OUT_SET_GROUP_META:
+        case ES_OUT_RESET_PCR:
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void EsOutDestroy(es_out_t *out)
+{
+    (void) out;
+}
+
+/*****************************************************************************
+ * Tests
+ *****************************************************************************/
+static unsigned getenv_uint(const char *name, unsigned def)
+{
+    const char *str = getenv(name);
+    return (str != NULL) ? strtoul(str, NULL, 0) : def;
+}
+
+static void run(unsigned downloads, unsigned prefetch, mtime_t rtt,
+                unsigned rate)
+{
+    struct server srv;
+    if (ServerStart(&srv, rtt, rate))
+    {
+        fprintf(stderr, "cannot start the server\n");
+        exit(77);
+    }
+
+    char url[64], downloadsarg[32], prefetcharg[32];
+    snprintf(url, sizeof (url), "http://127.0.0.1:%u/index.m3u8", srv.port);
+    snprintf(downloadsarg, sizeof (downloadsarg), "--adaptive-downloads=%u",
+             downloads);
+    snprintf(prefetcharg, sizeof (prefetcharg), "--adaptive-prefetch=%u",
+             prefetch);
+
+    const char *argv[] = {
+        "--ignore-config", "-q", downloadsarg, prefetcharg,
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    struct test_es_out ctx = {
+        .out = {
+            .pf_add = EsOutAdd,
+            .pf_send = EsOutSend,
+            .pf_del = EsOutDelete,
+            .pf_control = EsOutControl,
+            .pf_destroy = EsOutDestroy,
+        },
+    };
+
+    mtime_t start = mdate();
+    stream_t *s = vlc_stream_NewURL(obj, url);
+    assert(s != NULL);
+    demux_t *demux = demux_New(obj, "adaptive", url, s, &ctx.out);
+    assert(demux != NULL);
+
+    /* the demuxer returns a positive value while buffering, too */
+    int val;
+    while ((val = demux_Demux(demux)) != VLC_DEMUXER_EOF)
+        assert(val != VLC_DEMUXER_EGENERIC);
+    mtime_t duration = mdate() - start;
+
+    demux_Delete(demux); /* deletes the stream too */
+    libvlc_release(vlc);
+    ServerStop(&srv);
+
+    assert(ctx.next == SEGMENTS * SEGMENT_FRAMES);
+    printf("%u downloads, %u prefetched: first frame %"PRId64" ms, "
+           "%u segments %"PRId64" ms, %u connections, %u requests\n",
+           downloads, prefetch, (ctx.first - start) / 1000, SEGMENTS,
+           duration / 1000, srv.connections,
+           atomic_load(&srv.requests));
+}
+
+int main(void)
+{
+    mtime_t rtt = getenv_uint("VLC_ADAPTIVE_RTT", 50) * 1000;
+    unsigned rate = getenv_uint("VLC_ADAPTIVE_RATE", 1000000);
+
+    test_init();
+
+    /* one download at a time, as before, then in parallel */
+    run(1, 0, rtt, rate);
+    run(4, 2, rtt, rate);
+    return 0;
+}
@@ -0,0 +1,492 @@
+/*****************************************************************************
+ * mp4.c: MP4 demuxer sample tables test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+/* 10 hours of 25 fps video, one sample per chunk, with B-frames: this is the
+ * worst case for the sample tables */
+#define SAMPLES   900000
+#define TIMESCALE 90000
+
+static uint32_t SampleDelta(uint32_t i)
+{   /* variable frame rate, one stts entry every 3 samples */
+    return ((i / 3) & 1) ? 3000 : 4200;
+}
+
+static uint32_t SampleOffset(uint32_t i)
+{   /* one ctts entry per sample */
+    return (i % 3) * 3000;
+}
+
+static uint32_t SampleSize(uint32_t i)
+{
+    return 1 + i % 7;
+}
+
+static mtime_t SampleDTS(uint64_t dts)
+{
+    return VLC_TS_0 + dts * CLOCK_FREQ / TIMESCALE;
+}
+
+/*****************************************************************************
+ * Synthetic file writer
+ *****************************************************************************/
+struct writer
+{
+    uint8_t *buf;
+    size_t size;
+    size_t alloc;
+};
+
+static void Put(struct writer *w, const void *data, size_t len)
+{
+    if (w->size + len > w->alloc)
+    {
+        w->alloc = (w->size + len) * 2;
+        w->buf = realloc(w->buf, w->alloc);
+        assert(w->buf != NULL);
+    }
+    memcpy(w->buf + w->size, data, len);
+    w->size += len;
+}
+
+static void Put32(struct writer *w, uint32_t v)
+{
+    uint8_t b[4];
+    SetDWBE(b, v);
+    Put(w, b, 4);
+}
+
+static void Put16(struct writer *w, uint16_t v)
+{
+    uint8_t b[2];
+    SetWBE(b, v);
+    Put(w, b, 2);
+}
+
+static void PutZero(struct writer *w, size_t len)
+{
+    while (len-- > 0)
+        Put(w, "", 1);
+}
+
+static size_t BoxStart(struct writer *w, const char *type)
+{
+    size_t pos = w->size;
+    Put32(w, 0);
+    Put(w, type, 4);
+    return pos;
+}
+
+static void BoxEnd(struct writer *w, size_t pos)
+{
+    SetDWBE(w->buf + pos, w->size - pos);
+}
+
+static void PutMatrix(struct writer *w)
+{
+    static const uint32_t matrix[9] = {
+        0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000
+    };
+    for (unsigned i = 0; i < 9; i++)
+        Put32(w, matrix[i]);
+}
+
+static void WriteStbl(struct writer *w, uint32_t data_offset)
+{
+    size_t stbl = BoxStart(w, "stbl");
+
+    size_t stsd = BoxStart(w, "stsd");
+    Put32(w, 0);
+    Put32(w, 1);
+    size_t mp4v = BoxStart(w, "mp4v");
+    PutZero(w, 6);
+    Put16(w, 1); /* data reference index */
+    PutZero(w, 16);
+    Put16(w, 320);
+    Put16(w, 240);
+    Put32(w, 0x480000);
+    Put32(w, 0x480000);
+    Put32(w, 0);
+    Put16(w, 1); /* frame count */
+    PutZero(w, 32);
+    Put16(w, 24);
+    Put16(w, 0xffff);
+    BoxEnd(w, mp4v);
+    BoxEnd(w, stsd);
+
+    size_t stts = BoxStart(w, "stts");
+    Put32(w, 0);
+    Put32(w, (SAMPLES + 2) / 3);
+    for (uint32_t i = 0; i < SAMPLES; i += 3)
+    {
+        Put32(w, __MIN(3, SAMPLES - i));
+        Put32(w, SampleDelta(i));
+    }
+    BoxEnd(w, stts);
+
+    size_t ctts = BoxStart(w, "ctts");
+    Put32(w, 0);
+    Put32(w, SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        Put32(w, 1);
+        Put32(w, SampleOffset(i));
+    }
+    BoxEnd(w, ctts);
+
+    size_t stsc = BoxStart(w, "stsc");
+    Put32(w, 0);
+    Put32(w, 1);
+    Put32(w, 1); /* first chunk */
+    Put32(w, 1); /* samples per chunk */
+    Put32(w, 1); /* sample description index */
+    BoxEnd(w, stsc);
+
+    size_t stsz = BoxStart(w, "stsz");
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+        Put32(w, SampleSize(i));
+    BoxEnd(w, stsz);
+
+    size_t stco = BoxStart(w, "stco");
+    Put32(w, 0);
+    Put32(w, SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        Put32(w, data_offset);
+        data_offset += SampleSize(i);
+    }
+    BoxEnd(w, stco);
+
+    BoxEnd(w, stbl);
+}
+
+/* ftyp, mdat, then the moov at the end, as recorders write them */
+static void WriteFile(struct writer *w)
+{
+    uint64_t duration = 0;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+        duration += SampleDelta(i);
+
+    size_t ftyp = BoxStart(w, "ftyp");
+    Put(w, "isom", 4);
+    Put32(w, 0);
+    Put(w, "isom", 4);
+    BoxEnd(w, ftyp);
+
+    size_t mdat = BoxStart(w, "mdat");
+    const uint32_t data_offset = w->size;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        uint8_t sample[8];
+        memset(sample, i & 0xff, sizeof (sample));
+        Put(w, sample, SampleSize(i));
+    }
+    BoxEnd(w, mdat);
+
+    size_t moov = BoxStart(w, "moov");
+
+    size_t mvhd = BoxStart(w, "mvhd");
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, 1000);
+    Put32(w, duration * 1000 / TIMESCALE);
+    Put32(w, 0x10000);
+    Put16(w, 0x100);
+    PutZero(w, 10);
+    PutMatrix(w);
+    PutZero(w, 24);
+    Put32(w, 2); /* next track ID */
+    BoxEnd(w, mvhd);
+
+    size_t trak = BoxStart(w, "trak");
+    size_t tkhd = BoxStart(w, "tkhd");
+    Put32(w, 3); /* enabled, in movie */
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, 1); /* track ID */
+    Put32(w, 0);
+    Put32(w, duration * 1000 / TIMESCALE);
+    PutZero(w, 16);
+    PutMatrix(w);
+    Put32(w, 320 << 16);
+    Put32(w, 240 << 16);
+    BoxEnd(w, tkhd);
+
+    size_t mdia = BoxStart(w, "mdia");
+    size_t mdhd = BoxStart(w, "mdhd");
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, 0);
+    Put32(w, TIMESCALE);
+    Put32(w, duration);
+    Put16(w, 0x55c4); /* und */
+    Put16(w, 0);
+    BoxEnd(w, mdhd);
+
+    size_t hdlr = BoxStart(w, "hdlr");
+    Put32(w, 0);
+    Put32(w, 0);
+    Put(w, "vide", 4);
+    PutZero(w, 13);
+    BoxEnd(w, hdlr);
+
+    size_t minf = BoxStart(w, "minf");
+    size_t vmhd = BoxStart(w, "vmhd");
+    Put32(w, 1);
+    PutZero(w, 8);
+    BoxEnd(w, vmhd);
+
+    size_t dinf = BoxStart(w, "dinf");
+    size_t dref = BoxStart(w, "dref");
+    Put32(w, 0);
+    Put32(w, 1);
+    size_t url = BoxStart(w, "url ");
+    Put32(w, 1); /* self contained */
+    BoxEnd(w, url);
+    BoxEnd(w, dref);
+    BoxEnd(w, dinf);
+
+    WriteStbl(w, data_offset);
+
+    BoxEnd(w, minf);
+    BoxEnd(w, mdia);
+    BoxEnd(w, trak);
+    BoxEnd(w, moov);
+}
+
+/*****************************************************************************
+ * ES output collecting the timestamps
+ *****************************************************************************/
+struct test_es_out
+{
+    es_out_t out;
+    es_out_id_t *id;
+    unsigned count; /* blocks received */
+    mtime_t first_dts;
+    mtime_t first_pts;
+    size_t first_size;
+    uint32_t next; /* next expected sample */
+    uint64_t next_dts;
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(fmt->i_cat == VIDEO_ES);
+    assert(ctx->id == NULL);
+    ctx->id = malloc(1);
+    return ctx->id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(id == ctx->id);
+    if (ctx->count++ == 0)
+    {
+        ctx->first_dts = block->i_dts;
+        ctx->first_pts = block->i_pts;
+        ctx->first_size = block->i_buffer;
+    }
+
+    const uint32_t i = ctx->next++;
+
+    assert(block->i_buffer == SampleSize(i));
+    assert(block->p_buffer[0] == (i & 0xff));
+    assert(block->i_dts == SampleDTS(ctx->next_dts));
+    assert(block->i_pts == SampleDTS(ctx->next_dts) +
+                           (mtime_t)SampleOffset(i) * CLOCK_FREQ / TIMESCALE);
+    ctx->next_dts += SampleDelta(i);
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDelete(es_out_t *out, es_out_id_t *id)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(id == ctx->id);
+    free(id);
+    ctx->id = NULL;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    (void) out;
+    switch (query)
+    {
+        case ES_OUT_GET_ES_STATE:
+            va_arg(args, es_out_id_t *);
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_GET_EMPTY:
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_SET_META:
+        case ES_OUT_RESET_PCR:
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void EsOutDestroy(es_out_t *out)
+{
+    (void) out;
+}
+
+/*****************************************************************************
+ * Tests
+ *****************************************************************************/
+static size_t GetRSS(void)
+{
+    size_t size, resident = 0;
+    FILE *stream = fopen("/proc/self/statm", "r");
+
+    if (stream != NULL)
+    {
+        if (fscanf(stream, "%zu %zu", &size, &resident) != 2)
+            resident = 0;
+        fclose(stream);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void Seek(demux_t *demux, struct test_es_out *ctx, uint32_t i,
+                 uint64_t dts)
+{
+    /* slightly after the sample, as the time is rounded to microseconds */
+    const mtime_t time = SampleDTS(dts) - VLC_TS_0 + 12;
+
+    assert(demux_Control(demux, DEMUX_SET_TIME, time, false) == VLC_SUCCESS);
+    ctx->count = 0;
+    ctx->next = i;
+    ctx->next_dts = dts;
+    while (ctx->count == 0 && demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    assert(ctx->count > 0);
+}
+
+#define SEEKS 10000
+
+static void test_mp4(libvlc_int_t *obj)
+{
+    struct writer w = { NULL, 0, 0 };
+    WriteFile(&w);
+    log("%zu bytes file, %u samples\n", w.size, SAMPLES);
+
+    stream_t *s = vlc_stream_MemoryNew(VLC_OBJECT(obj), w.buf, w.size, true);
+    assert(s != NULL);
+
+    struct test_es_out ctx = {
+        .out = {
+            .pf_add = EsOutAdd,
+            .pf_send = EsOutSend,
+            .pf_del = EsOutDelete,
+            .pf_control = EsOutControl,
+            .pf_destroy = EsOutDestroy,
+        },
+        .next = 0,
+        .next_dts = 0,
+    };
+
+    size_t rss = GetRSS();
+    mtime_t start = mdate();
+    demux_t *demux = demux_New(VLC_OBJECT(obj), "mp4", "", s, &ctx.out);
+    mtime_t duration = mdate() - start;
+    assert(demux != NULL);
+    rss = GetRSS() - rss;
+    log("open: %"PRId64" us, %zu kB RSS\n", duration, rss / 1024);
+
+    /* Timestamps and sizes, in sequence */
+    while (ctx.next < 10000)
+        assert(demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+
+    /* Seeks, checking the timestamps of the following samples */
+    uint64_t *dts = malloc(SAMPLES * sizeof (*dts));
+    assert(dts != NULL);
+    dts[0] = 0;
+    for (uint32_t i = 1; i < SAMPLES; i++)
+        dts[i] = dts[i - 1] + SampleDelta(i - 1);
+
+    static const uint32_t samples[] = {
+        0, 1, 2, 3, 4, 5, 1000, 123457, SAMPLES / 2, SAMPLES - 2,
+    };
+    for (size_t k = 0; k < ARRAY_SIZE(samples); k++)
+    {
+        const uint32_t i = samples[k];
+        Seek(demux, &ctx, i, dts[i]);
+        assert(ctx.first_dts == SampleDTS(dts[i]));
+    }
+
+    /* Random seeks */
+    srand(0);
+    start = mdate();
+    for (unsigned k = 0; k < SEEKS; k++)
+    {
+        const uint32_t i = (uint32_t)rand() % (SAMPLES - 1);
+        Seek(demux, &ctx, i, dts[i]);
+        assert(ctx.first_dts == SampleDTS(dts[i]));
+        assert(ctx.first_size == SampleSize(i));
+    }
+    duration = mdate() - start;
+    log("seek: %"PRId64" us average\n", duration / SEEKS);
+
+    free(dts);
+    demux_Delete(demux); /* deletes the stream too */
+    free(w.buf);
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *argv[] = { "--ignore-config", "-q" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    test_mp4(vlc->p_libvlc_int);
+
+    libvlc_release(vlc);
+    return 0;
+}
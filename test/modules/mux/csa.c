@@ -0,0 +1,295 @@
+/*****************************************************************************
+ * csa.c: CSA scalar and bitsliced engines test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vlc_common.h>
+
+const char vlc_module_name[] = "test_csa";
+
+#define TS_NO_CSA_CK_MSG
+#include "../modules/mux/mpeg/csa.c"
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void)
+{   /* xorshift32, so that failures are reproducible */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void rand_bytes(uint8_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        buf[i] = rand32();
+}
+
+static csa_t *new_csa(const char *odd, const char *even)
+{
+    csa_t *c = csa_New();
+    assert(c != NULL);
+    assert(csa_SetCW(NULL, c, (char *)odd, true) == VLC_SUCCESS);
+    assert(csa_SetCW(NULL, c, (char *)even, false) == VLC_SUCCESS);
+    return c;
+}
+
+struct engine
+{
+    const char *name;
+    bool (*supported)(void);
+    unsigned lanes;
+    void (*stream)(const uint8_t *, unsigned, const uint8_t (*)[8],
+                   uint8_t (*)[CSA_KS_SIZE], unsigned);
+};
+
+static bool always(void)
+{
+    return true;
+}
+
+#if defined(CSA_BS_X86)
+static bool has_sse2(void)
+{
+    return vlc_CPU_SSE2();
+}
+
+static bool has_avx2(void)
+{
+    return vlc_CPU_AVX2();
+}
+#endif
+
+static const struct engine engines[] = {
+    { "64", always, 64, csa_BitsliceStream_64 },
+#if defined(CSA_BS_X86)
+    { "sse2", has_sse2, 128, csa_BitsliceStream_sse2 },
+    { "avx2", has_avx2, 256, csa_BitsliceStream_avx2 },
+#elif defined(CSA_BS_VEC)
+    { "vec", always, 128, csa_BitsliceStream_vec },
+#endif
+};
+
+/* Bitsliced stream cypher against csa_StreamCypher() */
+static void test_stream(csa_t *c, const struct engine *e)
+{
+    const unsigned blocks = CSA_KS_SIZE / 8;
+    uint8_t ck[8];
+
+    rand_bytes(ck, sizeof (ck));
+    rand_bytes(&c->sb[0][0], sizeof (c->sb));
+    memset(c->sb[1], 0, 8);
+    memset(c->sb[2], 0xff, 8);
+
+    /* All lanes, and a partial batch */
+    const unsigned counts[] = { e->lanes, 5 };
+
+    for (size_t n = 0; n < ARRAY_SIZE(counts); n++)
+    {
+        const unsigned count = counts[n];
+
+        memset(c->ks, 0x55, sizeof (c->ks));
+        e->stream(ck, count, (const uint8_t (*)[8])c->sb, c->ks, blocks);
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            uint8_t block[8];
+
+            csa_StreamCypher(c, 1, ck, c->sb[i], block);
+            for (unsigned k = 0; k < blocks; k++)
+            {
+                csa_StreamCypher(c, 0, ck, NULL, block);
+                assert(!memcmp(block, &c->ks[i][8 * k], 8));
+            }
+        }
+        for (unsigned i = count; i < CSA_BATCH_MAX; i++)
+            assert(c->ks[i][0] == 0x55);
+    }
+}
+
+static void test_block(csa_t *c)
+{
+    uint8_t in[CSA_BATCH_MAX][8], out[8];
+
+    rand_bytes(&in[0][0], sizeof (in));
+    for (unsigned i = 0; i < CSA_BATCH_MAX; i++)
+        c->blk[i] = GetQWLE(in[i]);
+
+    csa_BlockCypherBatch(c->o_kk, c->blk, CSA_BATCH_MAX);
+    for (unsigned i = 0; i < CSA_BATCH_MAX; i++)
+    {
+        csa_BlockCypher(c->o_kk, in[i], out);
+        assert(GetQWLE(out) == c->blk[i]);
+    }
+
+    csa_BlockDecypherBatch(c->o_kk, c->blk, CSA_BATCH_MAX);
+    for (unsigned i = 0; i < CSA_BATCH_MAX; i++)
+        assert(GetQWLE(in[i]) == c->blk[i]);
+}
+
+#define PACKETS 1000
+
+/* Random TS packets with all sorts of adaptation fields */
+static void make_packets(uint8_t (*pkts)[188], unsigned count)
+{
+    rand_bytes(&pkts[0][0], count * 188);
+    for (unsigned i = 0; i < count; i++)
+    {
+        pkts[i][0] = 0x47;
+        pkts[i][3] &= 0x3f;
+        if (pkts[i][3] & 0x20)
+            pkts[i][4] = i % 184;
+    }
+}
+
+static void test_packets(csa_t *c, int i_pkt_size)
+{
+    static uint8_t ref[PACKETS][188], out[PACKETS][188], orig[PACKETS][188];
+    uint8_t *pp[PACKETS];
+
+    make_packets(orig, PACKETS);
+
+    for (unsigned count = 1; count <= PACKETS; count = count * 3 + 1)
+    {
+        for (unsigned i = 0; i < count; i++)
+            pp[i] = out[i];
+
+        /* Encryption with either key */
+        c->use_odd = count & 1;
+        memcpy(ref, orig, sizeof (ref));
+        memcpy(out, orig, sizeof (out));
+        for (unsigned i = 0; i < count; i++)
+            csa_Encrypt(c, ref[i], i_pkt_size);
+        csa_EncryptBatch(c, pp, count, i_pkt_size);
+        assert(!memcmp(ref, out, count * 188));
+
+        /* Mixed keys and clear packets */
+        for (unsigned i = 0; i < count; i += 3)
+        {
+            c->use_odd = !c->use_odd;
+            memcpy(ref[i], orig[i], 188);
+            csa_Encrypt(c, ref[i], i_pkt_size);
+            if (i % 2)
+                memcpy(ref[i], orig[i], 188);
+        }
+        memcpy(out, ref, sizeof (out));
+
+        for (unsigned i = 0; i < count; i++)
+            csa_Decrypt(c, ref[i], i_pkt_size);
+        csa_DecryptBatch(c, pp, count, i_pkt_size);
+        assert(!memcmp(ref, out, count * 188));
+        assert(!memcmp(orig, out, count * 188));
+    }
+}
+
+/* Regression check of the cypher itself, both engines being compared with
+ * one another above */
+static void test_vector(csa_t *c)
+{
+    uint8_t pkts[CSA_BATCH_MAX][188];
+    uint8_t *pp[CSA_BATCH_MAX];
+    uint32_t sum = 0;
+
+    rand_state = 1;
+    make_packets(pkts, CSA_BATCH_MAX);
+    for (unsigned i = 0; i < CSA_BATCH_MAX; i++)
+        pp[i] = pkts[i];
+
+    c->use_odd = true;
+    csa_EncryptBatch(c, pp, CSA_BATCH_MAX, 188);
+    for (unsigned i = 0; i < CSA_BATCH_MAX; i++)
+        for (unsigned j = 0; j < 188; j++)
+            sum = sum * 31 + pkts[i][j];
+
+    printf("vector checksum %08"PRIx32"\n", sum);
+    assert(sum == 0x31801833);
+}
+
+#define BENCH_PACKETS 65536
+
+static void bench(csa_t *c)
+{
+    static uint8_t pkts[BENCH_PACKETS][188];
+    uint8_t *pp[BENCH_PACKETS];
+
+    make_packets(pkts, BENCH_PACKETS);
+    for (unsigned i = 0; i < BENCH_PACKETS; i++)
+        pp[i] = pkts[i];
+
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < BENCH_PACKETS; i++)
+        csa_Encrypt(c, pkts[i], 188);
+    mtime_t t_scalar = mdate() - start;
+
+    start = mdate();
+    for (unsigned i = 0; i < BENCH_PACKETS; i++)
+        csa_Decrypt(c, pkts[i], 188);
+    mtime_t t_scalar_dec = mdate() - start;
+
+    start = mdate();
+    csa_EncryptBatch(c, pp, BENCH_PACKETS, 188);
+    mtime_t t_batch = mdate() - start;
+
+    start = mdate();
+    csa_DecryptBatch(c, pp, BENCH_PACKETS, 188);
+    mtime_t t_batch_dec = mdate() - start;
+
+    printf("%u packets: scalar encrypt %"PRId64" us, decrypt %"PRId64" us\n",
+           BENCH_PACKETS, t_scalar, t_scalar_dec);
+    printf("%u packets: batch  encrypt %"PRId64" us, decrypt %"PRId64" us "
+           "(%u lanes)\n", BENCH_PACKETS, t_batch, t_batch_dec,
+           csa_BatchLanes());
+}
+
+int main(void)
+{
+    csa_t *c = new_csa("0x0123456789abcdef", "fedcba9876543210");
+
+    for (size_t i = 0; i < ARRAY_SIZE(engines); i++)
+    {
+        if (!engines[i].supported())
+        {
+            printf("%-4s not supported by this CPU\n", engines[i].name);
+            continue;
+        }
+        test_stream(c, &engines[i]);
+    }
+    test_block(c);
+
+    /* Whole packets, and partial encryption (csa-pkt) */
+    test_packets(c, 188);
+    test_packets(c, 100);
+    test_packets(c, 12);
+
+    test_vector(c);
+    bench(c);
+    csa_Delete(c);
+    return 0;
+}
@@ -119,6 +119,32 @@ static void testannexbin( const uint8_t *p_data, size_t i_data,
         }
     }
 }
+/* The payload is shared with another block, which must not see changes */
+static void testannexbin_shared( const uint8_t *p_data, size_t i_data,
+                                 const uint8_t **pp_res, size_t *pi_res )
+{
+    for( unsigned int i=0; i<3; i++)
+    {
+        block_t *p_orig = block_Alloc( i_data );
+        assert( p_orig );
+        memcpy( p_orig->p_buffer, p_data, i_data );
+        p_orig = block_Shareable( p_orig );
+        assert( p_orig );
+
+        block_t *p_block = block_Share( p_orig );
+        assert( p_block );
+        p_block = hxxx_AnnexB_to_xVC( p_block, 1 << i );
+        assert( p_block );
+        assert( p_block->i_buffer == pi_res[i] );
+        assert( memcmp( p_block->p_buffer, pp_res[i], pi_res[i] ) == 0 );
+        block_Release( p_block );
+
+        assert( p_orig->i_buffer == i_data );
+        assert( memcmp( p_orig->p_buffer, p_data, i_data ) == 0 );
+        block_Release( p_orig );
+    }
+}
+
 #define runtest(number, name, testfunction) \
     printf("\nTEST %d %s\n", number, name);\
     p_res[0] = test##number##_avcdata1;  rgi_res[0] = sizeof(test##number##_avcdata1);\
@@ -197,6 +223,10 @@ static void test_annexb()
     runtest(1, "mixed nal set", testannexbin);
     runtest(6, "startcode repeat / empty nal", testannexbin);
 
+    runtest(2, "SHARED single nal test", testannexbin_shared);
+    runtest(5, "SHARED 4 bytes prefixed nal only", testannexbin_shared);
+    runtest(1, "SHARED mixed nal set", testannexbin_shared);
+
     runtest(1, "IT mixed nal set", test_iterators);
     runtest(2, "IT single nal test", test_iterators);
     runtest(3, "IT single nal test, startcode 3", test_iterators);
@@ -41,6 +41,9 @@ void vlc_run_args_init(struct vlc_run_args *args)
 
     args->name = getenv("VLC_TARGET");
     args->test_demux_controls = getenv_atoi("VLC_DEMUX_CONTROLS");
+    args->report_latency = getenv_atoi("VLC_DEMUX_LATENCY");
+    args->probe_hints = getenv("VLC_DEMUX_PROBE_HINTS") == NULL
+                     || getenv_atoi("VLC_DEMUX_PROBE_HINTS");
 }
 
 libvlc_instance_t *libvlc_create(const struct vlc_run_args *args)
@@ -54,7 +57,7 @@ libvlc_instance_t *libvlc_create(const struct vlc_run_args *args)
 
     /* Override argc/argv with "--verbose lvl" or "--quiet" depending on the V
      * environment variable */
-    const char *argv[2];
+    const char *argv[3];
     char verbose[2];
     int argc = args->verbose == 0 ? 1 : 2;
 
@@ -67,6 +70,9 @@ libvlc_instance_t *libvlc_create(const struct vlc_run_args *args)
     else
         argv[0] = "--quiet";
 
+    if (!args->probe_hints)
+        argv[argc++] = "--no-demux-probe-hints";
+
     libvlc_instance_t *vlc = libvlc_new(argc, argv);
     if (vlc == NULL)
         fprintf(stderr, "Error: cannot initialize LibVLC.\n");
@@ -37,6 +37,12 @@ struct vlc_run_args
 
     /* true to test demux controls */
     bool test_demux_controls;
+
+    /* true to print the open and first frame latencies */
+    bool report_latency;
+
+    /* false to disable the demux probe hints */
+    bool probe_hints;
 };
 
 void vlc_run_args_init(struct vlc_run_args *args);
@@ -42,6 +42,7 @@
 #include <vlc_meta.h>
 #include <vlc_es_out.h>
 #include <vlc_url.h>
+#include <vlc_modules.h>
 #include "../lib/libvlc_internal.h"
 
 #include <vlc/vlc.h>
@@ -53,6 +54,7 @@ struct test_es_out_t
 {
     struct es_out_t out;
     struct es_out_id_t *ids;
+    mtime_t first_send; /* date of the first block, 0 if none yet */
 };
 
 struct es_out_id_t
@@ -97,8 +99,12 @@ static void EsOutCheckId(es_out_t *out, es_out_id_t *id)
 
 static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
 {
+    struct test_es_out_t *ctx = (struct test_es_out_t *) out;
+
     //debug("[%p] Sent    ES: %zu\n", (void *)idd, block->i_buffer);
     EsOutCheckId(out, id);
+    if (ctx->first_send == 0)
+        ctx->first_send = mdate();
 #ifdef HAVE_DECODERS
     if (id->decoder)
         test_decoder_process(id->decoder, block);
@@ -204,6 +210,7 @@ static es_out_t *test_es_out_create(vlc_object_t *parent)
     }
 
     ctx->ids = NULL;
+    ctx->first_send = 0;
 
     es_out_t *out = &ctx->out;
     out->pf_add = EsOutAdd;
@@ -269,7 +276,9 @@ static int demux_process_stream(const struct vlc_run_args *args, stream_t *s)
     if (out == NULL)
         return -1;
 
+    mtime_t start = mdate();
     demux_t *demux = demux_New(VLC_OBJECT(s), name, "", s, out);
+    mtime_t opened = mdate();
     if (demux == NULL)
     {
         es_out_Delete(out);
@@ -305,6 +314,15 @@ static int demux_process_stream(const struct vlc_run_args *args, stream_t *s)
         i++;
     }
 
+    if (args->report_latency)
+    {
+        const struct test_es_out_t *ctx = (struct test_es_out_t *) out;
+
+        printf("%s: open %"PRId64" us, first frame %"PRId64" us\n",
+               module_get_object(demux->p_module), opened - start,
+               ctx->first_send ? ctx->first_send - start : -1);
+    }
+
     demux_Delete(demux);
     es_out_Delete(out);
 
@@ -0,0 +1,236 @@
+/*****************************************************************************
+ * messages.c: logging test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Messages are written to a log file by the file logger, either from the
+ * calling threads or from the logging thread (--log-async). The file is
+ * checked against snprintf(), and the cost of msg_Dbg() is reported in both
+ * modes. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
+#include <vlc_common.h>
+#include "../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+const char vlc_module_name[] = "test";
+
+#define THREADS  4
+#define MESSAGES 20000 /* per thread */
+
+static char path[] = "/tmp/vlc-test-messages-XXXXXX";
+static const char *volatile null_string = NULL;
+/* Characters not followed by a nul, as a FourCC */
+static const char *unterminated;
+
+static libvlc_instance_t *create(bool async)
+{
+    char logfile[sizeof (path) + 16];
+    const char *args[] = {
+        "--ignore-config", "--verbose=2", "--file-logging", logfile,
+        async ? "--log-async" : "--no-log-async",
+    };
+
+    snprintf(logfile, sizeof (logfile), "--logfile=%s", path);
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    return vlc;
+}
+
+/* Conversions which are captured and formatted later, or not */
+#define FORMATS(X) \
+    X("plain text") \
+    X("%d %i %u %x %X %o %c %%", -42, 42, 42u, 0xbeefu, 0xbeefu, 8u, 'v') \
+    X("%hhd %hd %ld %lu %lld %llu", -1, 300, -70000L, 70000UL, -1LL, 1ULL) \
+    X("%jd %zu %zd %td", (intmax_t)-5, (size_t)6, (ssize_t)-7, (ptrdiff_t)8) \
+    X("%"PRId64" %"PRIu64" %"PRIx64, INT64_MIN, UINT64_MAX, UINT64_C(255)) \
+    X("%f %.3e %-10.2g| %+G %a", 3.5, 1e10, 0.5, -2.0, 1.0) \
+    X("%Lf", 2.5L) \
+    X("[%s] [%10s] [%-6s] [%.3s] [%.*s]", "abc", "right", "left", \
+      "truncated", 2, "xyz") \
+    X("%*d|%-*d|%*.*f", 5, 1, 4, 2, 8, 3, 3.14159) \
+    X("%s", null_string) \
+    X("[%4.4s] [%.*s] [%.2s] [%.*s]", unterminated, 3, unterminated, \
+      unterminated, -1, "negative") \
+    X("%#x %#o %08.3f % d %'d", 255u, 8u, 1.5, 7, 1000000) \
+    X("%2$s %1$s", "positional", "arguments") \
+    X("%ls", L"wide") \
+    X("%s", "a long string argument which does not fit in one slot ......" \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      ".................................................................." \
+      "................................................................!")
+
+static void log_formats(libvlc_int_t *obj)
+{
+#define X(...) msg_Dbg(obj, __VA_ARGS__);
+    FORMATS(X)
+#undef X
+}
+
+static void check_formats(FILE *stream)
+{
+    char line[4096], expected[4096];
+
+#define X(...) \
+    do { \
+        snprintf(expected, sizeof (expected), "test debug: " __VA_ARGS__); \
+        strcat(expected, "\n"); \
+        do \
+            assert(fgets(line, sizeof (line), stream) != NULL); \
+        while (strncmp(line, "test debug: ", 12)); \
+        if (strcmp(line, expected)) \
+        { \
+            fprintf(stderr, "expected: %sgot:      %s", expected, line); \
+            abort(); \
+        } \
+    } while (0);
+    FORMATS(X)
+#undef X
+}
+
+struct bench
+{
+    libvlc_int_t *obj;
+    unsigned id;
+    mtime_t duration;
+};
+
+static void *bench_thread(void *data)
+{
+    struct bench *b = data;
+    mtime_t start = mdate();
+
+    for (unsigned i = 0; i < MESSAGES; i++)
+        msg_Dbg(b->obj, "thread %u message %u: %s %d %f", b->id, i,
+                "some text", -1, 1.5);
+
+    b->duration = mdate() - start;
+    return NULL;
+}
+
+static void run(bool async)
+{
+    libvlc_instance_t *vlc = create(async);
+    libvlc_int_t *obj = vlc->p_libvlc_int;
+    struct bench b[THREADS];
+    vlc_thread_t th[THREADS];
+
+    log_formats(obj);
+
+    for (unsigned i = 0; i < THREADS; i++)
+    {
+        b[i].obj = obj;
+        b[i].id = i;
+        if (vlc_clone(&th[i], bench_thread, &b[i], VLC_THREAD_PRIORITY_LOW))
+            abort();
+    }
+
+    mtime_t duration = 0;
+    for (unsigned i = 0; i < THREADS; i++)
+    {
+        vlc_join(th[i], NULL);
+        duration += b[i].duration;
+    }
+    libvlc_release(vlc); /* flushes the log */
+
+    /* Check the log file */
+    FILE *stream = fopen(path, "rt");
+    assert(stream != NULL);
+    check_formats(stream);
+
+    char line[4096];
+    unsigned next[THREADS] = { 0 }, count = 0, dropped = 0;
+
+    while (fgets(line, sizeof (line), stream) != NULL)
+    {
+        unsigned id, i, n;
+
+        if (sscanf(line, "test debug: thread %u message %u:", &id, &i) == 2)
+        {
+            assert(id < THREADS);
+            assert(i >= next[id]); /* in order */
+            assert(strstr(line, ": some text -1 1.500000\n") != NULL);
+            next[id] = i + 1;
+            count++;
+        }
+        else if (sscanf(line, "core warning: %u log message(s) dropped",
+                        &n) == 1)
+            dropped += n;
+    }
+    fclose(stream);
+    unlink(path);
+
+    assert(count + dropped >= THREADS * MESSAGES);
+    assert(async || dropped == 0);
+
+    printf("%-5s: %"PRId64" ns per message, %u/%u messages written\n",
+           async ? "async" : "sync", duration * 1000 / (THREADS * MESSAGES),
+           count, THREADS * MESSAGES);
+}
+
+/* Puts the string at the end of a page followed by an inaccessible page, so
+ * that reading past it crashes. */
+static void make_unterminated(void)
+{
+    static const char fourcc[4] = { 'm', 'p', '4', 'a' };
+#ifdef HAVE_MMAP
+    long size = sysconf(_SC_PAGESIZE);
+    char *p = mmap(NULL, 2 * size, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    assert(p != MAP_FAILED);
+    assert(mprotect(p + size, size, PROT_NONE) == 0);
+    memcpy(p + size - 4, fourcc, 4);
+    unterminated = p + size - 4;
+#else
+    unterminated = fourcc;
+#endif
+}
+
+int main(void)
+{
+    test_init();
+    make_unterminated();
+
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    run(false);
+    run(true);
+    return 0;
+}
@@ -443,6 +443,131 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_inherit( libvlc_int_t *p_libvlc )
+{
+    vlc_object_t *root = VLC_OBJECT(p_libvlc), *objs[4];
+    vlc_object_t *parent = root;
+
+    for( unsigned i = 0; i < ARRAY_SIZE(objs); i++ )
+    {
+        objs[i] = vlc_object_create( parent, sizeof( vlc_object_t ) );
+        assert( objs[i] != NULL );
+        parent = objs[i];
+    }
+    vlc_object_t *mid = objs[1], *leaf = objs[3];
+
+    /* Set, shadowed and destroyed variables */
+    var_Create( root, "inherit-a", VLC_VAR_INTEGER );
+    var_Create( root, "inherit-b", VLC_VAR_INTEGER );
+    var_SetInteger( root, "inherit-a", 1 );
+    var_SetInteger( root, "inherit-b", 10 );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 1 );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 1 );
+    var_SetInteger( root, "inherit-a", 2 );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 2 );
+    var_Create( mid, "inherit-a", VLC_VAR_INTEGER );
+    var_SetInteger( mid, "inherit-a", 3 );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 3 );
+    assert( var_InheritInteger( objs[0], "inherit-a" ) == 2 );
+    var_IncInteger( mid, "inherit-a" );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 4 );
+    var_Destroy( mid, "inherit-a" );
+    assert( var_InheritInteger( leaf, "inherit-a" ) == 2 );
+
+    /* Same name address, different names */
+    char name[16];
+    strcpy( name, "inherit-a" );
+    assert( var_InheritInteger( leaf, name ) == 2 );
+    strcpy( name, "inherit-b" );
+    assert( var_InheritInteger( leaf, name ) == 10 );
+
+    /* Strings */
+    var_Create( root, "inherit-s", VLC_VAR_STRING );
+    var_SetString( root, "inherit-s", "foo" );
+    for( unsigned i = 0; i < 2; i++ )
+    {
+        char *str = var_InheritString( leaf, "inherit-s" );
+        assert( str != NULL && !strcmp( str, "foo" ) );
+        free( str );
+    }
+    var_SetString( root, "inherit-s", "bar" );
+    char *str = var_InheritString( leaf, "inherit-s" );
+    assert( str != NULL && !strcmp( str, "bar" ) );
+    free( str );
+
+    /* Configuration */
+    int64_t port = config_GetInt( root, "http-port" );
+    assert( var_InheritInteger( leaf, "http-port" ) == port );
+    config_PutInt( root, "http-port", port + 1 );
+    assert( var_InheritInteger( leaf, "http-port" ) == port + 1 );
+    config_PutInt( root, "http-port", port );
+    assert( var_InheritInteger( leaf, "http-port" ) == port );
+
+    var_Destroy( root, "inherit-s" );
+    var_Destroy( root, "inherit-b" );
+    var_Destroy( root, "inherit-a" );
+    for( unsigned i = ARRAY_SIZE(objs); i-- > 0; )
+        vlc_object_release( objs[i] );
+}
+
+#define BENCH_NAMES 64
+
+/* Inheritance from the top of trees of various depths, from the cache, and
+ * with more names than the cache holds */
+static void bench_inherit( libvlc_int_t *p_libvlc )
+{
+    static const unsigned depths[] = { 1, 4, 16 };
+    vlc_object_t *objs[16];
+    char *names[BENCH_NAMES];
+
+    for( unsigned i = 0; i < BENCH_NAMES; i++ )
+    {
+        assert( asprintf( &names[i], "bench-%u", i ) > 0 );
+        var_Create( p_libvlc, names[i], VLC_VAR_INTEGER );
+        var_SetInteger( p_libvlc, names[i], i );
+    }
+
+    vlc_object_t *parent = VLC_OBJECT(p_libvlc);
+    for( unsigned i = 0; i < ARRAY_SIZE(objs); i++ )
+    {
+        objs[i] = vlc_object_create( parent, sizeof( vlc_object_t ) );
+        assert( objs[i] != NULL );
+        parent = objs[i];
+    }
+
+    for( unsigned d = 0; d < ARRAY_SIZE(depths); d++ )
+    {
+        vlc_object_t *leaf = objs[depths[d] - 1];
+        const unsigned count = 100000;
+        int64_t sum = 0;
+
+        mtime_t start = mdate();
+        for( unsigned i = 0; i < count; i++ )
+            sum += var_InheritInteger( leaf, names[1] );
+        mtime_t cached = mdate() - start;
+
+        start = mdate();
+        for( unsigned i = 0; i < count; i++ )
+            sum += var_InheritInteger( leaf, names[i % BENCH_NAMES] );
+        mtime_t uncached = mdate() - start;
+
+        assert( sum == count + (int64_t)(count / BENCH_NAMES)
+                                * (BENCH_NAMES * (BENCH_NAMES - 1) / 2)
+                + (count % BENCH_NAMES) * (count % BENCH_NAMES - 1) / 2 );
+        log( "depth %2u: %"PRId64" ns per cached inheritance, "
+             "%"PRId64" ns uncached\n", depths[d],
+             cached * 1000 / count, uncached * 1000 / count );
+    }
+
+    for( unsigned i = ARRAY_SIZE(objs); i-- > 0; )
+        vlc_object_release( objs[i] );
+    for( unsigned i = 0; i < BENCH_NAMES; i++ )
+    {
+        var_Destroy( p_libvlc, names[i] );
+        free( names[i] );
+    }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +605,10 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing inheritance\n" );
+    test_inherit( p_libvlc );
+    bench_inherit( p_libvlc );
 }
 
 
@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * cache.c: plugins cache formats test and startup benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_configuration.h>
+
+#define ITERATIONS 20
+
+static const char *const args_parse[] = {
+    "--ignore-config", "-q", "--no-plugins-cache-mmap",
+};
+
+static const char *const args_mmap[] = {
+    "--ignore-config", "-q", "--plugins-cache-mmap",
+};
+
+static int compare_lines(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Describes every module and configuration item, one sorted line each */
+static char **describe(libvlc_instance_t *vlc, size_t *countp)
+{
+    size_t count, n = 0;
+    module_t **list = module_list_get(&count);
+    char **lines = NULL;
+
+    assert(list != NULL);
+    (void) vlc;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const module_t *module = list[i];
+        unsigned confsize;
+        module_config_t *config = module_config_get(module, &confsize);
+        char *line;
+
+        lines = realloc(lines, (n + 1 + confsize) * sizeof (*lines));
+        assert(lines != NULL);
+
+        assert(asprintf(&line, "%s %s %s %d %s",
+                        module_get_object(module),
+                        module_get_name(module, true),
+                        module_get_capability(module),
+                        module_get_score(module),
+                        module_get_help(module) ? module_get_help(module)
+                                                : "") >= 0);
+        lines[n++] = line;
+
+        for (unsigned j = 0; j < confsize; j++)
+        {
+            const module_config_t *cfg = config + j;
+            char *value;
+
+            switch (config_GetType(cfg->psz_name ? cfg->psz_name : ""))
+            {
+                case VLC_VAR_STRING:
+                    value = strdup(cfg->value.psz ? cfg->value.psz : "");
+                    break;
+                case VLC_VAR_INTEGER:
+                case VLC_VAR_BOOL:
+                    assert(asprintf(&value, "%"PRId64, cfg->value.i) >= 0);
+                    break;
+                case VLC_VAR_FLOAT:
+                    assert(asprintf(&value, "%f", cfg->value.f) >= 0);
+                    break;
+                default:
+                    value = strdup("");
+            }
+            assert(value != NULL);
+
+            assert(asprintf(&line, "%s.%s %d %d %u %s",
+                            module_get_object(module),
+                            cfg->psz_name ? cfg->psz_name : "",
+                            cfg->i_type, cfg->b_advanced,
+                            (unsigned)cfg->list_count, value) >= 0);
+            free(value);
+            lines[n++] = line;
+        }
+        module_config_free(config);
+    }
+    module_list_free(list);
+
+    qsort(lines, n, sizeof (*lines), compare_lines);
+    *countp = n;
+    return lines;
+}
+
+static void free_lines(char **lines, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(lines[i]);
+    free(lines);
+}
+
+static void test_formats(void)
+{
+    libvlc_instance_t *vlc;
+    size_t parsed_count, mapped_count;
+    char **parsed, **mapped;
+
+    vlc = libvlc_new(ARRAY_SIZE(args_parse), args_parse);
+    assert(vlc != NULL);
+    parsed = describe(vlc, &parsed_count);
+    libvlc_release(vlc);
+
+    vlc = libvlc_new(ARRAY_SIZE(args_mmap), args_mmap);
+    assert(vlc != NULL);
+    mapped = describe(vlc, &mapped_count);
+    libvlc_release(vlc);
+
+    log("%zu modules and items\n", parsed_count);
+    assert(parsed_count == mapped_count);
+    for (size_t i = 0; i < parsed_count; i++)
+        assert(!strcmp(parsed[i], mapped[i]));
+
+    free_lines(parsed, parsed_count);
+    free_lines(mapped, mapped_count);
+}
+
+static void bench_startup(const char *name, const char *cache_arg,
+                          const char *scan_arg)
+{
+    const char *args[] = { "--ignore-config", "-q", cache_arg, scan_arg };
+    mtime_t total = 0, best = INT64_MAX;
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        mtime_t start = mdate();
+        libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+        mtime_t duration = mdate() - start;
+
+        assert(vlc != NULL);
+        libvlc_release(vlc);
+
+        total += duration;
+        if (duration < best)
+            best = duration;
+    }
+
+    log("%s, %s: libvlc_new() average %"PRId64" us, best %"PRId64" us\n",
+        name, scan_arg, total / ITERATIONS, best);
+}
+
+int main(void)
+{
+    test_init();
+
+    test_formats();
+
+    /* Without scanning, startup only depends on the cache */
+    bench_startup("parsed cache", "--no-plugins-cache-mmap",
+                  "--no-plugins-scan");
+    bench_startup("mapped cache", "--plugins-cache-mmap", "--no-plugins-scan");
+    bench_startup("parsed cache", "--no-plugins-cache-mmap", "--plugins-scan");
+    bench_startup("mapped cache", "--plugins-cache-mmap", "--plugins-scan");
+    return 0;
+}
@@ -0,0 +1,310 @@
+/*****************************************************************************
+ * httpd.c: HTTP stream server test and load test
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* N local clients read a synthetic stream made of records carrying their
+ * sequence number and sending date. The stream is checked, and the total
+ * throughput and the per-client lag are reported.
+ * VLC_HTTPD_CLIENTS, VLC_HTTPD_SECONDS and VLC_HTTPD_RATE (bytes per second
+ * and per client) change the load. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_httpd.h>
+#include <vlc_atomic.h>
+#include "../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#define RECORD_MAGIC  UINT32_C(0x56484c54)
+#define RECORD_HEADER 16
+
+struct client
+{
+    int fd;
+    unsigned header_state;  /* matched bytes of "\r\n\r\n" */
+    uint8_t rec[RECORD_HEADER];
+    size_t rec_off;
+    uint32_t next_seq;
+    bool started;
+
+    uint64_t bytes;
+    unsigned records;
+    unsigned resets;        /* the server skipped data, client too slow */
+    mtime_t lag_sum, lag_max;
+};
+
+struct producer
+{
+    httpd_stream_t *stream;
+    size_t size;
+    mtime_t interval;
+    atomic_bool stop;
+    uint32_t seq;
+};
+
+static void *producer_thread(void *data)
+{
+    struct producer *p = data;
+    mtime_t deadline = mdate();
+
+    while (!atomic_load(&p->stop))
+    {
+        block_t *block = block_Alloc(p->size);
+        assert(block != NULL);
+
+        for (size_t i = RECORD_HEADER; i < p->size; i++)
+            block->p_buffer[i] = p->seq + i;
+        SetDWBE(block->p_buffer, RECORD_MAGIC);
+        SetDWBE(block->p_buffer + 4, p->seq++);
+        SetQWBE(block->p_buffer + 8, mdate());
+
+        /* as access_output/http */
+        block = block_Shareable(block);
+        assert(block != NULL);
+        assert(httpd_StreamSend(p->stream, block) == VLC_SUCCESS);
+        block_Release(block);
+
+        deadline += p->interval;
+        mwait(deadline);
+    }
+    return NULL;
+}
+
+static int client_connect(unsigned port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    static const char req[] = "GET /stream HTTP/1.0\r\n\r\n";
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd != -1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)))
+    {
+        perror("connect");
+        abort();
+    }
+    assert(write(fd, req, strlen(req)) == (ssize_t)strlen(req));
+    return fd;
+}
+
+static void client_parse(struct client *c, const uint8_t *buf, size_t len,
+                         size_t size)
+{
+    while (len > 0 && c->header_state < 4)
+    {
+        static const char end[] = "\r\n\r\n";
+
+        if (*buf == end[c->header_state])
+            c->header_state++;
+        else
+            c->header_state = (*buf == '\r');
+        buf++;
+        len--;
+    }
+
+    while (len > 0)
+    {
+        size_t n = __MIN(len, size - c->rec_off);
+
+        if (c->rec_off < RECORD_HEADER)
+        {
+            size_t h = __MIN(n, RECORD_HEADER - c->rec_off);
+
+            memcpy(c->rec + c->rec_off, buf, h);
+            if (c->rec_off + h == RECORD_HEADER)
+            {
+                assert(GetDWBE(c->rec) == RECORD_MAGIC);
+
+                uint32_t seq = GetDWBE(c->rec + 4);
+                if (c->started && seq != c->next_seq)
+                    c->resets++;
+                c->started = true;
+                c->next_seq = seq;
+            }
+        }
+
+        /* Check the ends of the payload, not to slow the clients down */
+        size_t last = c->rec_off + n - 1;
+        if (last >= RECORD_HEADER)
+            assert(buf[n - 1] == (uint8_t)(c->next_seq + last));
+        if (c->rec_off >= RECORD_HEADER)
+            assert(buf[0] == (uint8_t)(c->next_seq + c->rec_off));
+
+        c->rec_off += n;
+        buf += n;
+        len -= n;
+
+        if (c->rec_off == size)
+        {
+            mtime_t lag = mdate() - (mtime_t)GetQWBE(c->rec + 8);
+
+            c->lag_sum += lag;
+            if (lag > c->lag_max)
+                c->lag_max = lag;
+            c->records++;
+            c->next_seq++;
+            c->rec_off = 0;
+        }
+    }
+}
+
+static unsigned getenv_uint(const char *name, unsigned def)
+{
+    const char *str = getenv(name);
+    return (str != NULL) ? strtoul(str, NULL, 0) : def;
+}
+
+static void run(httpd_host_t *host, unsigned port, size_t size,
+                unsigned count, unsigned seconds, unsigned rate)
+{
+    httpd_stream_t *stream = httpd_StreamNew(host, "/stream",
+                                             "application/octet-stream",
+                                             NULL, NULL);
+    assert(stream != NULL);
+
+    struct producer p = {
+        .stream = stream,
+        .size = size,
+        .interval = CLOCK_FREQ * size / rate,
+    };
+    vlc_thread_t th;
+
+    atomic_init(&p.stop, false);
+    if (vlc_clone(&th, producer_thread, &p, VLC_THREAD_PRIORITY_LOW))
+        abort();
+
+    struct client *clients = calloc(count, sizeof (*clients));
+    struct pollfd *ufd = calloc(count, sizeof (*ufd));
+    uint8_t *buf = malloc(1 << 16);
+    assert(clients != NULL && ufd != NULL && buf != NULL);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        clients[i].fd = client_connect(port);
+        ufd[i].fd = clients[i].fd;
+        ufd[i].events = POLLIN;
+    }
+
+    mtime_t start = mdate(), end = start + seconds * CLOCK_FREQ;
+
+    while (mdate() < end)
+    {
+        int n = poll(ufd, count, 100);
+        assert(n >= 0 || errno == EINTR);
+
+        for (unsigned i = 0; i < count && n > 0; i++)
+        {
+            if (ufd[i].revents == 0)
+                continue;
+            n--;
+
+            ssize_t len = recv(ufd[i].fd, buf, 1 << 16, 0);
+            assert(len > 0);
+            clients[i].bytes += len;
+            client_parse(&clients[i], buf, len, size);
+        }
+    }
+    mtime_t duration = mdate() - start;
+
+    atomic_store(&p.stop, true);
+    vlc_join(th, NULL);
+
+    uint64_t bytes = 0;
+    unsigned records = 0, resets = 0;
+    mtime_t lag_sum = 0, lag_max = 0, lag_worst_avg = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        const struct client *c = &clients[i];
+
+        assert(c->records > 0);
+        bytes += c->bytes;
+        records += c->records;
+        resets += c->resets;
+        lag_sum += c->lag_sum;
+        lag_max = __MAX(lag_max, c->lag_max);
+        lag_worst_avg = __MAX(lag_worst_avg, c->lag_sum / c->records);
+        close(c->fd);
+    }
+
+    printf("%u clients, %zu bytes records: %.1f MB/s in total, "
+           "%u/%u records expected\n", count, size,
+           (double)bytes / duration, records, count * p.seq);
+    printf("  lag: average %"PRId64" us, worst client average %"PRId64
+           " us, maximum %"PRId64" us, %u resets\n",
+           lag_sum / records, lag_worst_avg, lag_max, resets);
+
+    free(buf);
+    free(ufd);
+    free(clients);
+    httpd_StreamDelete(stream);
+}
+
+int main(void)
+{
+    unsigned count = getenv_uint("VLC_HTTPD_CLIENTS", 100);
+    unsigned seconds = getenv_uint("VLC_HTTPD_SECONDS", 1);
+    unsigned rate = getenv_uint("VLC_HTTPD_RATE", 1000000);
+    unsigned port = 20000 + (getpid() % 10000);
+    char portarg[32];
+
+    test_init();
+
+    snprintf(portarg, sizeof (portarg), "--http-port=%u", port);
+    const char *args[] = {
+        "--ignore-config", "-q", "--http-host=127.0.0.1", portarg,
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+
+    httpd_host_t *host = vlc_http_HostNew(VLC_OBJECT(vlc->p_libvlc_int));
+    if (host == NULL)
+    {
+        fprintf(stderr, "cannot listen on port %u\n", port);
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    /* small blocks copied into the stream chunks, and referenced blocks */
+    run(host, port, 1316, count, seconds, rate);
+    run(host, port, 65536, count, seconds, rate);
+
+    httpd_HostDelete(host);
+    libvlc_release(vlc);
+    return 0;
+}